@@ -19,6 +19,240 @@
 #include "AlignColorSpace.h"
 #include "RGMatch.h"
 #include "Align.h"
+#include "Metrics.h"
+
+/* Counts the non-zero four bit fields in a word whose fields have been
+ * folded onto their low bit */
+static int32_t AlignPackedCount(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(x);
+#else
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int32_t)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* Packs a sequence into four bits per base.  Returns 0 if the sequence
+ * contains a base that cannot be packed, in which case the caller must
+ * fall back to comparing characters. */
+static int32_t AlignPackSequence(char *s,
+		int32_t length,
+		uint64_t *words)
+{
+	int32_t i;
+	uint64_t code;
+
+	memset(words, 0, sizeof(uint64_t)*ALIGN_PACKED_NUM_WORDS(length));
+	for(i=0;i<length;i++) {
+		switch(s[i]) {
+			case 'a':
+			case 'A':
+				code = 0; break;
+			case 'c':
+			case 'C':
+				code = 1; break;
+			case 'g':
+			case 'G':
+				code = 2; break;
+			case 't':
+			case 'T':
+				code = 3; break;
+			case 'n':
+			case 'N':
+				code = 4; break;
+			default:
+				return 0;
+		}
+		words[i/ALIGN_PACKED_BASES_PER_WORD] |= code << (4*(i%ALIGN_PACKED_BASES_PER_WORD));
+	}
+	return 1;
+}
+
+/* Packs the constrained positions of the mask, all four bits set
+ * where the read must match the reference */
+static void AlignPackMask(char *mask,
+		int32_t length,
+		uint64_t *words)
+{
+	int32_t i;
+
+	memset(words, 0, sizeof(uint64_t)*ALIGN_PACKED_NUM_WORDS(length));
+	for(i=0;i<length;i++) {
+		if('1' == mask[i]) {
+			words[i/ALIGN_PACKED_BASES_PER_WORD] |= ((uint64_t)0xF) << (4*(i%ALIGN_PACKED_BASES_PER_WORD));
+		}
+	}
+}
+
+/* Returns the number of mismatches between the packed read and the
+ * packed reference starting at the given diagonal, or -1 if a
+ * constrained position (when a packed mask is given) does not match.
+ * The reference must have one word of padding past its end. */
+static int32_t AlignPackedMismatches(uint64_t *read,
+		uint64_t *mask,
+		int32_t readLength,
+		uint64_t *reference,
+		int32_t diagonal)
+{
+	int32_t j, numWords, start, shift;
+	int32_t numMismatches = 0;
+	uint64_t r, x;
+
+	numWords = ALIGN_PACKED_NUM_WORDS(readLength);
+	start = diagonal / ALIGN_PACKED_BASES_PER_WORD;
+	shift = 4*(diagonal % ALIGN_PACKED_BASES_PER_WORD);
+	for(j=0;j<numWords;j++) {
+		if(0 == shift) {
+			r = reference[start+j];
+		}
+		else {
+			r = (reference[start+j] >> shift) | (reference[start+j+1] << (64 - shift));
+		}
+		x = r ^ read[j];
+		if(j == numWords - 1 && 0 != (readLength % ALIGN_PACKED_BASES_PER_WORD)) {
+			x &= (((uint64_t)1) << (4*(readLength % ALIGN_PACKED_BASES_PER_WORD))) - 1;
+		}
+		if(NULL != mask && 0 != (x & mask[j])) {
+			return -1;
+		}
+		x |= (x >> 1);
+		x |= (x >> 2);
+		numMismatches += AlignPackedCount(x & 0x1111111111111111ULL);
+	}
+	return numMismatches;
+}
+
+/* Ungapped nucleotide alignment on packed sequences, giving the same
+ * result as AlignNTSpaceUngapped.  Diagonals scoring below the given
+ * bound are not copied over. */
+static int32_t AlignNTSpaceUngappedPacked(char *read,
+		uint64_t *packedRead,
+		uint64_t *packedMask,
+		int32_t readLength,
+		char *reference,
+		uint64_t *packedReference,
+		int32_t referenceLength,
+		ScoringMatrix *sm,
+		AlignedEntry *a,
+		int32_t offset,
+		int32_t position,
+		char strand,
+		int32_t lowerBound)
+{
+	int32_t i;
+	int32_t maxScore = NEGATIVE_INFINITY;
+	int32_t alignmentOffset=-1;
+	int32_t curScore, numMismatches;
+
+	assert(readLength <= referenceLength);
+
+	for(i=offset;i<referenceLength-readLength-offset+1;i++) {
+		numMismatches = AlignPackedMismatches(packedRead, packedMask, readLength, packedReference, i);
+		if(numMismatches < 0) {
+			continue;
+		}
+		curScore = (readLength - numMismatches)*sm->ntMatch + numMismatches*sm->ntMismatch;
+		if(maxScore < curScore) {
+			maxScore = curScore;
+			alignmentOffset = i;
+		}
+	}
+
+	if(NEGATIVE_INFINITY < maxScore && !(maxScore < lowerBound)) {
+		AlignedEntryUpdateAlignment(a,
+				(REVERSE == strand) ? (position + referenceLength - readLength - alignmentOffset) : (position + alignmentOffset),
+				maxScore, 
+				readLength, 
+				readLength,
+				read,
+				reference + alignmentOffset);
+		return 1;
+	}
+	return 0;
+}
+
+/* Returns an upper bound on the score of aligning the whole read
+ * against the reference.  In nucleotide space an alignment without
+ * gaps scores at most the best diagonal, found from the packed 
+ * sequences when given.  One with gaps pays at least a gap open, and
+ * can only match as many read bases as the base composition of the 
+ * reference allows, every other read base scoring at best a mismatch
+ * or a gap extension.  In color space the bases are decoded against 
+ * the reference, so only the perfect score is used. */
+static int32_t AlignUpperBound(int32_t *readCounts,
+		uint64_t *packedRead,
+		int32_t readLength,
+		char *reference,
+		uint64_t *packedReference,
+		int32_t referenceLength,
+		ScoringMatrix *sm,
+		int32_t space)
+{
+	int32_t i;
+	int32_t referenceCounts[ALPHABET_SIZE+1];
+	int32_t numMatches = 0;
+	int32_t numMismatches;
+	int32_t ungappedBound, gappedBound;
+
+	/* The gapped bound assumes a read base in a gap costs at least a gap
+	 * extension, which does not hold if a gap open costs less */
+	if(0 < sm->gapOpenPenalty || 0 < sm->gapExtensionPenalty ||
+			sm->gapExtensionPenalty < sm->gapOpenPenalty ||
+			sm->ntMatch < sm->ntMismatch) {
+		return INT_MAX;
+	}
+
+	if(ColorSpace == space) {
+		return readLength*(sm->ntMatch + GETMAX(sm->colorMatch, sm->colorMismatch));
+	}
+
+	for(i=0;i<ALPHABET_SIZE+1;i++) {
+		referenceCounts[i] = 0;
+	}
+	for(i=0;i<referenceLength;i++) {
+		referenceCounts[BaseToInt(reference[i])]++;
+	}
+	for(i=0;i<ALPHABET_SIZE+1;i++) {
+		numMatches += GETMIN(readCounts[i], referenceCounts[i]);
+	}
+	gappedBound = GETMIN(readLength*sm->ntMatch + sm->gapOpenPenalty,
+			numMatches*sm->ntMatch + (readLength - numMatches)*GETMAX(sm->ntMismatch, sm->gapExtensionPenalty));
+
+	if(NULL == packedRead || NULL == packedReference) {
+		ungappedBound = readLength*sm->ntMatch;
+	}
+	else {
+		for(i=0, numMismatches=readLength;
+				0 < numMismatches && i <= referenceLength - readLength;
+				i++) {
+			numMismatches = GETMIN(numMismatches, 
+					AlignPackedMismatches(packedRead, NULL, readLength, packedReference, i));
+		}
+		ungappedBound = (readLength - numMismatches)*sm->ntMatch + numMismatches*sm->ntMismatch;
+	}
+
+	return GETMAX(ungappedBound, gappedBound);
+}
+
+/* Orders the entry indexes by decreasing bound */
+static void AlignSortByBound(int32_t *order,
+		int32_t *bounds,
+		int32_t numEntries)
+{
+	int32_t i, j, gap, tmp;
+
+	for(gap=numEntries/2;0<gap;gap/=2) {
+		for(i=gap;i<numEntries;i++) {
+			tmp = order[i];
+			for(j=i;gap<=j && bounds[order[j-gap]] < bounds[tmp];j-=gap) {
+				order[j] = order[j-gap];
+			}
+			order[j] = tmp;
+		}
+	}
+}
 
 int AlignRGMatches(RGMatches *m,
 		RGBinary *rg,
@@ -33,12 +267,14 @@ int AlignRGMatches(RGMatches *m,
 		int32_t pairedEndLength,
 		int32_t mirroringType,
 		int32_t forceMirroring,
-		AlignMatrix *matrix)
+		AlignMatrix *matrix,
+		int64_t *numPruned)
 {
 	double bestScore;
 	int32_t i;
 	int32_t numLocalAlignments = 0;
 	int32_t numAligned=0;
+	int32_t numEndPruned=0;
 
 	/* Check to see if we should try to align one read with no candidate
 	 * locations if the other one has candidate locations.
@@ -72,6 +308,7 @@ int AlignRGMatches(RGMatches *m,
 				bestOnly,
 				&bestScore,
 				&numAligned,
+				&numEndPruned,
 				matrix);
 		if(BestOnly == bestOnly) {
 			numLocalAlignments += AlignRGMatchesKeepBestScore(&a->ends[i],
@@ -80,6 +317,7 @@ int AlignRGMatches(RGMatches *m,
 		else {
 			numLocalAlignments += numAligned;
 		}
+		(*numPruned) += numEndPruned;
 	}
 	return numLocalAlignments;
 }
@@ -96,11 +334,14 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 		int32_t bestOnly,
 		double *bestScore,
 		int32_t *numAligned,
+		int32_t *numPruned,
 		AlignMatrix *matrix)
 {
 	char *FnName="AlignRGMatchOneEnd";
-	int32_t i;
+	int32_t i, j;
 	char **references=NULL;
+	char *referenceBuffer=NULL;
+	int32_t referenceBufferLength;
 	char **masks=NULL;
 	int32_t *referenceLengths=NULL;
 	int32_t *referencePositions=NULL;
@@ -110,9 +351,18 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	char read[SEQUENCE_LENGTH]="\0";
 	char colors[SEQUENCE_LENGTH]="\0";
 	int32_t readLength;
+	uint64_t packedRead[ALIGN_PACKED_NUM_WORDS(SEQUENCE_LENGTH)];
+	uint64_t packedMask[ALIGN_PACKED_NUM_WORDS(SEQUENCE_LENGTH)];
+	int32_t readPacked;
+	uint64_t *packedReferences=NULL;
+	int32_t packedReferenceLength=0;
+	int32_t *referencePacked=NULL;
 	int32_t ctr=0;
 	int32_t numberFound = 0;
 	int32_t prevIndex;
+	int32_t readCounts[ALPHABET_SIZE+1];
+	int32_t *bounds=NULL;
+	int32_t *order=NULL;
 
         if(m->maxReached < 0) { // ignore
             AlignedEndAllocate(end,
@@ -123,6 +373,7 @@ void AlignRGMatchesOneEnd(RGMatch *m,
         }
 
 	(*bestScore)=NEGATIVE_INFINITY;
+	(*numPruned)=0;
 
 	strcpy(read, m->read);
 
@@ -155,6 +406,9 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	if(matrix->nrow < readLength+1) {
 		AlignMatrixReallocate(matrix, readLength+1, GETMAX(matrix->ncol, readLength+1));
 	}
+	/* Pack the read so that the exact and ungapped filters compare 
+	 * sixteen bases at a time */
+	readPacked = AlignPackSequence(read, readLength, packedRead);
 
 	/* Allocate */
 	AlignedEndAllocate(end,
@@ -163,11 +417,16 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 			m->numEntries);
         end->keyMissFraction = m->maxReached; // stores the key missed fraction as (uint8_t)(F * 255) 
 
-	/* Get all the references */
+	/* Get all the references, decoded into one buffer */
 	references = malloc(sizeof(char*)*m->numEntries);
 	if(NULL==references) {
 		PrintError(FnName, "references", "Could not allocate memory", Exit, MallocMemory);
 	}
+	referenceBufferLength = GETMAX(1, readLength + 2*offset) + 1;
+	referenceBuffer = malloc(sizeof(char)*referenceBufferLength*m->numEntries);
+	if(NULL==referenceBuffer) {
+		PrintError(FnName, "referenceBuffer", "Could not allocate memory", Exit, MallocMemory);
+	}
 	masks = malloc(sizeof(char*)*m->numEntries);
 	if(NULL==masks) {
 		PrintError(FnName, "masks", "Could not allocate memory", Exit, MallocMemory);
@@ -192,16 +451,28 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	if(NULL==referencePositions) {
 		PrintError(FnName, "referencePositions", "Could not allocate memory", Exit, MallocMemory);
 	}
+	if(1 == readPacked) {
+		/* One extra word so the last word can be shifted in */
+		packedReferenceLength = ALIGN_PACKED_NUM_WORDS(referenceBufferLength) + 1;
+		packedReferences = malloc(sizeof(uint64_t)*packedReferenceLength*m->numEntries);
+		if(NULL==packedReferences) {
+			PrintError(FnName, "packedReferences", "Could not allocate memory", Exit, MallocMemory);
+		}
+		referencePacked = malloc(sizeof(int32_t)*m->numEntries);
+		if(NULL==referencePacked) {
+			PrintError(FnName, "referencePacked", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
 	for((*numAligned)=0,i=0,ctr=0;i<m->numEntries;i++) {
-		references[ctr]=NULL; /* This is needed for RGBinaryGetReference */
+		references[ctr]=referenceBuffer + ((int64_t)ctr)*referenceBufferLength;
 
 		/* Get references */
-		RGBinaryGetReference(rg,
+		RGBinaryGetReferenceBuffer(rg,
 				m->contigs[i],
 				m->positions[i],
 				m->strands[i], 
 				offset,
-				&references[ctr],
+				references[ctr],
 				readLength,
 				&referenceLengths[ctr],
 				&referencePositions[ctr]);
@@ -258,7 +529,14 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 							readEndInsertionLengths[ctr] + 1));
 			}
 			/* Copy over mask */
-			masks[ctr] = RGMatchMaskToString(m->masks[i], m->readLength);
+			masks[ctr] = RGMatchMaskToString(GETMASK(m, i), m->readLength);
+			/* Pack the reference */
+			if(1 == readPacked) {
+				referencePacked[ctr] = AlignPackSequence(references[ctr], 
+						referenceLengths[ctr], 
+						packedReferences + ((int64_t)ctr)*packedReferenceLength);
+				packedReferences[((int64_t)ctr)*packedReferenceLength + ALIGN_PACKED_NUM_WORDS(referenceLengths[ctr])] = 0;
+			}
 			/* Update contig name and strand */
 			end->entries[ctr].contig = m->contigs[i];
 			end->entries[ctr].strand = m->strands[i];
@@ -276,8 +554,7 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 			ctr++;
 		}
 		else {
-			/* Free retrieved reference sequence */
-			free(references[ctr]);
+			/* The reference sequence buffer is reused */
 			references[ctr]=NULL;
 			masks[ctr]=NULL;
 		}
@@ -311,6 +588,15 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	/* Try exact alignment */
 	for(i=0;i<end->numEntries;i++) {
 		if(readLength <= referenceLengths[i] &&
+				(1 != readPacked || 
+				 1 != referencePacked[i] ||
+				 referenceOffsets[i] < 0 ||
+				 referenceLengths[i] < referenceOffsets[i] + readLength ||
+				 0 == AlignPackedMismatches(packedRead,
+					 NULL,
+					 readLength,
+					 packedReferences + ((int64_t)i)*packedReferenceLength,
+					 referenceOffsets[i])) &&
 				1==AlignExact(read, 
 					readLength, 
 					references[i], 
@@ -323,6 +609,7 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 					end->entries[i].strand)) {
 			foundExact=1;
 			numberFound++;
+			MetricsCount(MetricsExactAlignments, 1);
 			if((*bestScore) < end->entries[i].score) {
 				(*bestScore) = end->entries[i].score;
 			}
@@ -332,16 +619,18 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	/* If we are to only output the best alignments and we have found an exact alignment, return */
 	if(1==foundExact && bestOnly == BestOnly) {
 		for(i=0;i<end->numEntries;i++) {
-			free(references[i]);
 			free(masks[i]);
 		}
 		free(references);
+		free(referenceBuffer);
 		free(masks);
 		free(referenceLengths);
 		free(referencePositions);
 		free(referenceOffsets);
 		free(readStartInsertionLengths);
 		free(readEndInsertionLengths);
+		free(packedReferences);
+		free(referencePacked);
 		return;
 	}
 #endif
@@ -358,19 +647,46 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 			for(i=0;i<end->numEntries;i++) {
 				if(readLength <= referenceLengths[i] &&
 						!(NEGATIVE_INFINITY < end->entries[i].score)) { // If we did not find an exact match
-					numberFound += AlignUngapped(read,
-							colors,
-							masks[i],
-							readLength,
-							references[i],
-							referenceLengths[i],
-							unconstrained,
-							sm,
-							&end->entries[i],
-							space,
-							referenceOffsets[i],
-							referencePositions[i],
-							end->entries[i].strand);
+					if(NTSpace == space &&
+							1 == readPacked &&
+							1 == referencePacked[i] &&
+							(Unconstrained == unconstrained || 0 <= referenceOffsets[i])) {
+						if(Constrained == unconstrained) {
+							AlignPackMask(masks[i], readLength, packedMask);
+						}
+						/* When only the best alignments are kept and there is
+						 * no gapped alignment to follow, do not copy over 
+						 * alignments that cannot beat the best so far */
+						numberFound += AlignNTSpaceUngappedPacked(read,
+								packedRead,
+								(Constrained == unconstrained) ? packedMask : NULL,
+								readLength,
+								references[i],
+								packedReferences + ((int64_t)i)*packedReferenceLength,
+								referenceLengths[i],
+								sm,
+								&end->entries[i],
+								(Unconstrained == unconstrained) ? 0 : referenceOffsets[i],
+								referencePositions[i],
+								end->entries[i].strand,
+								(BestOnly == bestOnly && Ungapped == ungapped) ? (int32_t)(*bestScore) : NEGATIVE_INFINITY);
+					}
+					else {
+						numberFound += AlignUngapped(read,
+								colors,
+								masks[i],
+								readLength,
+								references[i],
+								referenceLengths[i],
+								unconstrained,
+								sm,
+								&end->entries[i],
+								space,
+								referenceOffsets[i],
+								referencePositions[i],
+								end->entries[i].strand);
+					}
+					MetricsCount(MetricsUngappedAlignments, 1);
 					if((*bestScore) < end->entries[i].score) {
 						(*bestScore) = end->entries[i].score;
 					}
@@ -404,17 +720,19 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 				// Reallocate
 				AlignedEndReallocate(end, prevIndex);
 			}
-			for(i=0;i<end->numEntries;i++) {
-				free(references[i]);
+			for(i=0;i<ctr;i++) { // end->numEntries may have shrunk
 				free(masks[i]);
 			}
 			free(references);
+			free(referenceBuffer);
 			free(masks);
 			free(referenceLengths);
 			free(referencePositions);
 			free(referenceOffsets);
 			free(readStartInsertionLengths);
 			free(readEndInsertionLengths);
+			free(packedReferences);
+			free(referencePacked);
 
 			return;
 			/* These compiler commands aren't necessary, but are here for vim tab indenting */
@@ -424,8 +742,45 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 	}
 #endif
 
+	/* When only the best alignments are kept, bound the score of each 
+	 * candidate, align the most promising candidates first, and skip
+	 * those that cannot reach the best score found so far */
+	if(BestOnly == bestOnly && 0 < end->numEntries) {
+		bounds = malloc(sizeof(int32_t)*end->numEntries);
+		if(NULL==bounds) {
+			PrintError(FnName, "bounds", "Could not allocate memory", Exit, MallocMemory);
+		}
+		order = malloc(sizeof(int32_t)*end->numEntries);
+		if(NULL==order) {
+			PrintError(FnName, "order", "Could not allocate memory", Exit, MallocMemory);
+		}
+		for(i=0;i<ALPHABET_SIZE+1;i++) {
+			readCounts[i] = 0;
+		}
+		for(i=0;i<readLength;i++) {
+			readCounts[BaseToInt(read[i])]++;
+		}
+		for(i=0;i<end->numEntries;i++) {
+			bounds[i] = AlignUpperBound(readCounts,
+					(1 == readPacked) ? packedRead : NULL,
+					readLength,
+					references[i],
+					(1 == readPacked && 1 == referencePacked[i]) ? packedReferences + ((int64_t)i)*packedReferenceLength : NULL,
+					referenceLengths[i],
+					sm,
+					space);
+			order[i] = i;
+		}
+		AlignSortByBound(order, bounds, end->numEntries);
+	}
+
 	/* Run Gapped */
-	for(i=0;i<end->numEntries;i++) {
+	for(j=0;j<end->numEntries;j++) {
+		i = (NULL == order) ? j : order[j];
+		if(NULL != bounds && bounds[i] < (*bestScore)) {
+			(*numPruned)++;
+			continue;
+		}
 		AlignGapped(read,
 				colors,
 				masks[i],
@@ -447,18 +802,22 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 			(*bestScore) = end->entries[i].score;
 		}
 	}
+	free(bounds);
+	free(order);
 
 	for(i=0;i<end->numEntries;i++) {
-		free(references[i]);
 		free(masks[i]);
 	}
 	free(references);
+	free(referenceBuffer);
 	free(masks);
 	free(referenceLengths);
 	free(referencePositions);
 	free(referenceOffsets);
 	free(readStartInsertionLengths);
 	free(readEndInsertionLengths);
+	free(packedReferences);
+	free(referencePacked);
 }
 
 /* TODO */
@@ -698,6 +1057,7 @@ int AlignGapped(char *read,
 			break;
 
 	}
+	MetricsCount(MetricsGappedAlignments, 1);
 	return 1;
 }
 
@@ -822,23 +1182,69 @@ int32_t AlignRGMatchesKeepBestScore(AlignedEnd *end,
 		if(bestScore < end->entries[i].score) {
 			PrintError(FnName, "bestScore", "Best score is incorrect", Exit, OutOfRange);
 		}
-		else if(!(end->entries[i].score < bestScore)) {
-			/* Free */
-			AlignedEntryFree(&end->entries[i]);
-		}
-		else {
+		else if(NEGATIVE_INFINITY < end->entries[i].score &&
+				!(end->entries[i].score < bestScore)) {
 			/* Copy over to cur index */
-			AlignedEntryCopyAtIndex(end->entries, curIndex, end->entries, i);
+			if(curIndex != i) {
+				AlignedEntryCopyAtIndex(end->entries, curIndex, end->entries, i);
+				AlignedEntryFree(&end->entries[i]);
+			}
 			curIndex++;
 		}
+		else {
+			/* Free */
+			AlignedEntryFree(&end->entries[i]);
+		}
 	}
-	assert(curIndex > 0);
 
 	end->numEntries = curIndex;
-	end->entries = realloc(end->entries, sizeof(AlignedEntry*)*end->numEntries);
-	if(NULL == end->entries) {
+	end->entries = realloc(end->entries, sizeof(AlignedEntry)*end->numEntries);
+	if(NULL == end->entries && 0 < end->numEntries) {
 		PrintError(FnName, "end->entries", "Could not reallocate memory", Exit, MallocMemory);
 	}
 
 	return numLocalAlignments;
 }
+
+/* 0 to fill in the whole rectangle in the constrained gapped alignment
+ * instead of the band, see AlignSetBanded */
+static int32_t AlignBanded = 1;
+
+/* Sets whether the constrained gapped alignment fills in only the band.
+ * Both give the same alignments, which bkernelbench compares. */
+void AlignSetBanded(int32_t banded)
+{
+	AlignBanded = banded;
+}
+
+/* TODO */
+int32_t AlignIsBanded()
+{
+	return AlignBanded;
+}
+
+/* Returns how many diagonals away from a given diagonal an optimal path
+ * can stray.  Every path scores at most maxScore, straying k diagonals
+ * costs at least a gap open and k-1 gap extensions, and the path along
+ * the diagonal scores minScore.  Returns maxWidth if gaps cannot be 
+ * bounded this way. */
+int32_t AlignGetBandWidth(ScoringMatrix *sm,
+		int64_t maxScore,
+		int64_t minScore,
+		int32_t maxWidth)
+{
+	int64_t width;
+
+	if(0 <= sm->gapExtensionPenalty || 
+			sm->gapExtensionPenalty < sm->gapOpenPenalty) {
+		return maxWidth;
+	}
+
+	width = maxScore + sm->gapOpenPenalty - minScore;
+	if(width < 0) {
+		return 0;
+	}
+	width = 1 + width / (-sm->gapExtensionPenalty);
+
+	return (width < maxWidth) ? width : maxWidth;
+}
@@ -33,13 +33,16 @@ enum {
 	NoFromCS /* 16 */
 };
 
-int AlignRGMatches(RGMatches*, RGBinary*, AlignedRead*, int32_t, int32_t, ScoringMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, AlignMatrix*);
-void AlignRGMatchesOneEnd(RGMatch*, RGBinary*, AlignedEnd*, int32_t, int32_t, ScoringMatrix*, int32_t, int32_t, int32_t, double*, int32_t*, AlignMatrix*);
+int AlignRGMatches(RGMatches*, RGBinary*, AlignedRead*, int32_t, int32_t, ScoringMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, AlignMatrix*, int64_t*);
+void AlignRGMatchesOneEnd(RGMatch*, RGBinary*, AlignedEnd*, int32_t, int32_t, ScoringMatrix*, int32_t, int32_t, int32_t, double*, int32_t*, int32_t*, AlignMatrix*);
 int32_t AlignExact(char*, int32_t, char*, int32_t, ScoringMatrix*, AlignedEntry*, int32_t, int32_t, int32_t, char);
 int32_t AlignUngapped(char*, char*, char*, int32_t, char*, int32_t, int32_t, ScoringMatrix*, AlignedEntry*, int32_t, int32_t, int32_t, char);
 int AlignGapped(char*, char*, char*, int32_t, char*, int32_t, int32_t, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, char, double);
 void AlignGappedBounded(char*, char*, int32_t, char*, int32_t, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, int32_t, char, double, int32_t, int32_t);
 void AlignGappedConstrained(char*, char*, char*, int32_t, char*, int32_t, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, char);
 int32_t AlignRGMatchesKeepBestScore(AlignedEnd*, double);
+void AlignSetBanded(int32_t);
+int32_t AlignIsBanded();
+int32_t AlignGetBandWidth(ScoringMatrix*, int64_t, int64_t, int32_t);
 
 #endif
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <config.h>
 #include "BLib.h"
 #include "BLibDefinitions.h"
 #include "BError.h"
@@ -11,6 +12,7 @@
 #include "ScoringMatrix.h"
 #include "Align.h"
 #include "AlignColorSpace.h"
+#include "Metrics.h"
 
 // Remove debugging code
 // Fill in end insertion
@@ -31,13 +33,12 @@ int32_t AlignColorSpaceUngapped(char *colors,
 {
 	/* read goes on the rows, reference on the columns */
 	char *FnName = "AlignColorSpaceUngapped";
-	int i, j, k, l;
+	int i;
 
 	int offsetAligned=-1;
-	int32_t prevScore[ALPHABET_SIZE+1];
-	int prevNT[ALPHABET_SIZE+1][SEQUENCE_LENGTH];
+	int32_t numOffsets;
 	int32_t maxScore = NEGATIVE_INFINITY;
-	int maxNT[SEQUENCE_LENGTH];
+	char maxNT[SEQUENCE_LENGTH];
 	char DNA[ALPHABET_SIZE+1] = "ACGTN";
 	char readAligned[SEQUENCE_LENGTH]="\0";
 	char referenceAligned[SEQUENCE_LENGTH]="\0";
@@ -46,93 +47,34 @@ int32_t AlignColorSpaceUngapped(char *colors,
 	
 	assert(readLength <= referenceLength);
 
-	alphabetSize = AlignColorSpaceGetAlphabetSize(colors, readLength, reference, referenceLength);
-
-	for(i=offset;i<referenceLength-readLength-offset+1;i++) { /* Starting position */
-		/* Initialize */
-		for(j=0;j<alphabetSize;j++) {
-			if(DNA[j] == COLOR_SPACE_START_NT) { 
-				prevScore[j] = 0;
-			}
-			else {
-				prevScore[j] = NEGATIVE_INFINITY;
-			}
-		}
-		for(j=0;j<readLength;j++) { /* Position in the alignment */
-			int32_t nextScore[ALPHABET_SIZE+1];
-			char nextNT[ALPHABET_SIZE+1];
-			for(k=0;k<alphabetSize;k++) { /* To NT */
-
-				/* Get the best score to this NT */
-				int32_t bestScore = NEGATIVE_INFINITY;
-				int bestNT=-1;
-				char bestColor = 'X';
-
-				if(Constrained == unconstrained && '1' == mask[j]) { // If we are to use the constraint and it exists
-					char fromNT;
-					int32_t fromNTInt;
-
-					if(0 == ConvertBaseAndColor(DNA[k], BaseToInt(colors[j]), &fromNT)) {
-						PrintError(FnName, "fromNT", "Could not convert base and color space", Exit, OutOfRange);
-					}
-					fromNTInt = BaseToInt(fromNT);
+	numOffsets = referenceLength - readLength - 2*offset + 1;
+	if(numOffsets <= 0) {
+		return 0;
+	}
 
-					AlignColorSpaceUngappedGetBest(sm, 
-							prevScore[fromNTInt],
-							colors[j],
-							reference[i+j],
-							k,
-							fromNTInt, // Use the from base (as an integer)
-							alphabetSize,
-							&bestScore,
-							&bestNT,
-							&bestColor);
-				}
-				else { // Ignore constraint, go through all possible transitions
-					for(l=0;l<alphabetSize;l++) { /* From NT */
-						AlignColorSpaceUngappedGetBest(sm, 
-								prevScore[l],
-								colors[j],
-								reference[i+j],
-								k,
-								l,
-								alphabetSize,
-								&bestScore,
-								&bestNT,
-								&bestColor);
-					}
-				}
-				nextScore[k] = bestScore;
-				nextNT[k] = bestNT;
-			}
+	alphabetSize = AlignColorSpaceGetAlphabetSize(colors, readLength, reference, referenceLength);
 
-			for(k=0;k<alphabetSize;k++) { /* To NT */
-				prevScore[k] = nextScore[k];
-				prevNT[k][j] = nextNT[k];
-			}
-		}
-		/* Check if the score is better than the max */
-		k=0;
-		for(j=0;j<alphabetSize;j++) { /* To NT */
-			if(prevScore[k] < prevScore[j]) {
-				k=j;
-			}
-		}
-		if(maxScore < prevScore[k]) {
-			maxScore = prevScore[k];
-			/* TO GET COLORS WE NEED TO BACKTRACK */
-			for(j=readLength-1;0<=j;j--) {
-				maxNT[j] = k;
-				k=prevNT[k][j];
-			}
-			offsetAligned = i;
+	if(1 == numOffsets) {
+		/* Only one starting position, so keep the path as we go */
+		offsetAligned = offset;
+		maxScore = AlignColorSpaceUngappedTraceback(colors, mask, readLength, reference + offsetAligned, 
+				unconstrained, sm, alphabetSize, maxNT);
+	}
+	else {
+		maxScore = AlignColorSpaceUngappedLanes(colors, mask, readLength, reference, referenceLength, 
+				unconstrained, sm, offset, numOffsets, alphabetSize, &offsetAligned);
+		/* TO GET COLORS WE NEED TO BACKTRACK */
+		if(NEGATIVE_INFINITY < maxScore &&
+				maxScore != AlignColorSpaceUngappedTraceback(colors, mask, readLength, reference + offsetAligned, 
+					unconstrained, sm, alphabetSize, maxNT)) {
+			PrintError(FnName, "maxScore", "Traceback did not reproduce the best score", Exit, OutOfRange);
 		}
 	}
 
 	if(NEGATIVE_INFINITY < maxScore) {
 		for(i=0;i<readLength;i++) {
 			char c[2];
-			readAligned[i] = DNA[maxNT[i]];
+			readAligned[i] = DNA[(int)maxNT[i]];
 			referenceAligned[i] = reference[i+offsetAligned];
 			c[0] = colors[i];
 			ConvertBaseToColorSpace((i==0)?COLOR_SPACE_START_NT:readAligned[i-1],
@@ -161,6 +103,247 @@ int32_t AlignColorSpaceUngapped(char *colors,
 	}
 }
 
+/* Scores ALIGN_COLOR_SPACE_UNGAPPED_LANES starting positions at a time, 
+ * keeping only the scores, and returns the best score and its starting 
+ * position (the first one in case of ties) */
+int32_t AlignColorSpaceUngappedLanes(char *colors,
+		char *mask,
+		int readLength,
+		char *reference,
+		int referenceLength,
+		int unconstrained,
+		ScoringMatrix *sm,
+		int offset,
+		int32_t numOffsets,
+		int32_t alphabetSize,
+		int *offsetAligned)
+{
+	char *FnName = "AlignColorSpaceUngappedLanes";
+	int i, j, k, l, lane;
+	int32_t numLanes;
+	int32_t prevScore[ALPHABET_SIZE+1][ALIGN_COLOR_SPACE_UNGAPPED_LANES];
+	int32_t nextScore[ALPHABET_SIZE+1][ALIGN_COLOR_SPACE_UNGAPPED_LANES];
+	int32_t colorScores[ALPHABET_SIZE+1][ALPHABET_SIZE+1];
+	char transitionColors[ALPHABET_SIZE+1][ALPHABET_SIZE+1];
+	int32_t fromNTInts[ALPHABET_SIZE+1];
+	char referenceIntsBuffer[SEQUENCE_LENGTH + 2*OFFSET_LENGTH + ALIGN_COLOR_SPACE_UNGAPPED_LANES];
+	char *referenceInts=referenceIntsBuffer;
+	int32_t maxScore = NEGATIVE_INFINITY;
+	char DNA[ALPHABET_SIZE+1] = "ACGTN";
+
+	/* The color of each transition between bases */
+	for(l=0;l<alphabetSize;l++) { /* From NT */
+		for(k=0;k<alphabetSize;k++) { /* To NT */
+			if(0 == ConvertBaseToColorSpace(DNA[l], DNA[k], &transitionColors[l][k])) {
+				PrintError(FnName, "transitionColors", "Could not convert base to color space", Exit, OutOfRange);
+			}
+			transitionColors[l][k] = COLORFROMINT(transitionColors[l][k]);
+		}
+	}
+
+	/* The reference as bases (ALPHABET_SIZE+1 matches no base), padded so 
+	 * that every lane can read past the last start offset.  The buffer on
+	 * the stack fits the default offset length, so memory is only 
+	 * allocated for longer offsets. */
+	if(sizeof(referenceIntsBuffer) < referenceLength + ALIGN_COLOR_SPACE_UNGAPPED_LANES) {
+		referenceInts = malloc(sizeof(char)*(referenceLength + ALIGN_COLOR_SPACE_UNGAPPED_LANES));
+		if(NULL == referenceInts) {
+			PrintError(FnName, "referenceInts", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	for(i=0;i<referenceLength;i++) {
+		switch(ToUpper(reference[i])) {
+			case 'A': referenceInts[i] = 0; break;
+			case 'C': referenceInts[i] = 1; break;
+			case 'G': referenceInts[i] = 2; break;
+			case 'T': referenceInts[i] = 3; break;
+			case 'N': referenceInts[i] = 4; break;
+			default: referenceInts[i] = ALPHABET_SIZE+1; break;
+		}
+	}
+	for(i=referenceLength;i<referenceLength + ALIGN_COLOR_SPACE_UNGAPPED_LANES;i++) {
+		referenceInts[i] = ALPHABET_SIZE+1;
+	}
+
+	for(i=offset;i<offset+numOffsets;i+=ALIGN_COLOR_SPACE_UNGAPPED_LANES) { /* Starting positions */
+		/* Initialize */
+		for(k=0;k<alphabetSize;k++) {
+			for(lane=0;lane<ALIGN_COLOR_SPACE_UNGAPPED_LANES;lane++) {
+				prevScore[k][lane] = (DNA[k] == COLOR_SPACE_START_NT) ? 0 : NEGATIVE_INFINITY;
+			}
+		}
+		for(j=0;j<readLength;j++) { /* Position in the alignment */
+			char *curReferenceInts = referenceInts + i + j;
+
+			/* Score for the observed color given each transition */
+			for(l=0;l<alphabetSize;l++) { /* From NT */
+				for(k=0;k<alphabetSize;k++) { /* To NT */
+					colorScores[l][k] = ScoringMatrixGetColorScore(colors[j], transitionColors[l][k], sm);
+				}
+			}
+
+			if(Constrained == unconstrained && '1' == mask[j]) { // If we are to use the constraint and it exists
+				for(k=0;k<alphabetSize;k++) { /* To NT */
+					char fromNT;
+					if(0 == ConvertBaseAndColor(DNA[k], BaseToInt(colors[j]), &fromNT)) {
+						PrintError(FnName, "fromNT", "Could not convert base and color space", Exit, OutOfRange);
+					}
+					fromNTInts[k] = BaseToInt(fromNT);
+				}
+				for(k=0;k<alphabetSize;k++) { /* To NT */
+					int32_t *from = prevScore[fromNTInts[k]];
+					int32_t colorScore = colorScores[fromNTInts[k]][k];
+					for(lane=0;lane<ALIGN_COLOR_SPACE_UNGAPPED_LANES;lane++) {
+						int32_t curScore = from[lane] + colorScore + 
+							((k == curReferenceInts[lane]) ? sm->ntMatch : sm->ntMismatch);
+						nextScore[k][lane] = (curScore < NEGATIVE_INFINITY) ? NEGATIVE_INFINITY : curScore;
+					}
+				}
+			}
+			else { // Ignore constraint, go through all possible transitions
+				for(k=0;k<alphabetSize;k++) { /* To NT */
+					for(lane=0;lane<ALIGN_COLOR_SPACE_UNGAPPED_LANES;lane++) {
+						nextScore[k][lane] = NEGATIVE_INFINITY;
+					}
+					for(l=0;l<alphabetSize;l++) { /* From NT */
+						int32_t colorScore = colorScores[l][k];
+						for(lane=0;lane<ALIGN_COLOR_SPACE_UNGAPPED_LANES;lane++) {
+							int32_t curScore = prevScore[l][lane] + colorScore + 
+								((k == curReferenceInts[lane]) ? sm->ntMatch : sm->ntMismatch);
+							if(nextScore[k][lane] < curScore) {
+								nextScore[k][lane] = curScore;
+							}
+						}
+					}
+				}
+			}
+
+			memcpy(prevScore, nextScore, sizeof(int32_t)*ALIGN_COLOR_SPACE_UNGAPPED_LANES*alphabetSize);
+		}
+		/* Check if the score is better than the max, in order of starting position */
+		numLanes = GETMIN(ALIGN_COLOR_SPACE_UNGAPPED_LANES, offset + numOffsets - i);
+		for(lane=0;lane<numLanes;lane++) {
+			k=0;
+			for(j=0;j<alphabetSize;j++) { /* To NT */
+				if(prevScore[k][lane] < prevScore[j][lane]) {
+					k=j;
+				}
+			}
+			if(maxScore < prevScore[k][lane]) {
+				maxScore = prevScore[k][lane];
+				(*offsetAligned) = i + lane;
+			}
+		}
+	}
+	if(referenceInts != referenceIntsBuffer) {
+		free(referenceInts);
+	}
+
+	return maxScore;
+}
+
+/* Runs the ungapped alignment for one starting position keeping the 
+ * previous base of each state, and returns the best score and its bases */
+int32_t AlignColorSpaceUngappedTraceback(char *colors,
+		char *mask,
+		int readLength,
+		char *reference,
+		int unconstrained,
+		ScoringMatrix *sm,
+		int32_t alphabetSize,
+		char *maxNT)
+{
+	char *FnName = "AlignColorSpaceUngappedTraceback";
+	int j, k, l;
+	int32_t prevScore[ALPHABET_SIZE+1];
+	int32_t maxScore;
+	char *prevNT=NULL;
+	char DNA[ALPHABET_SIZE+1] = "ACGTN";
+
+	/* One byte per state and position */
+	prevNT = malloc(sizeof(char)*readLength*(ALPHABET_SIZE+1));
+	if(NULL == prevNT) {
+		PrintError(FnName, "prevNT", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Initialize */
+	for(j=0;j<ALPHABET_SIZE+1;j++) {
+		if(DNA[j] == COLOR_SPACE_START_NT) { 
+			prevScore[j] = 0;
+		}
+		else {
+			prevScore[j] = NEGATIVE_INFINITY;
+		}
+	}
+	for(j=0;j<readLength;j++) { /* Position in the alignment */
+		int32_t nextScore[ALPHABET_SIZE+1];
+		char nextNT[ALPHABET_SIZE+1];
+		for(k=0;k<alphabetSize;k++) { /* To NT */
+
+			/* Get the best score to this NT */
+			int32_t bestScore = NEGATIVE_INFINITY;
+			int bestNT=-1;
+			char bestColor = 'X';
+
+			if(Constrained == unconstrained && '1' == mask[j]) { // If we are to use the constraint and it exists
+				char fromNT;
+				int32_t fromNTInt;
+
+				if(0 == ConvertBaseAndColor(DNA[k], BaseToInt(colors[j]), &fromNT)) {
+					PrintError(FnName, "fromNT", "Could not convert base and color space", Exit, OutOfRange);
+				}
+				fromNTInt = BaseToInt(fromNT);
+
+				AlignColorSpaceUngappedGetBest(sm, 
+						prevScore[fromNTInt],
+						colors[j],
+						reference[j],
+						k,
+						fromNTInt, // Use the from base (as an integer)
+						alphabetSize,
+						&bestScore,
+						&bestNT,
+						&bestColor);
+			}
+			else { // Ignore constraint, go through all possible transitions
+				for(l=0;l<alphabetSize;l++) { /* From NT */
+					AlignColorSpaceUngappedGetBest(sm, 
+							prevScore[l],
+							colors[j],
+							reference[j],
+							k,
+							l,
+							alphabetSize,
+							&bestScore,
+							&bestNT,
+							&bestColor);
+				}
+			}
+			nextScore[k] = bestScore;
+			nextNT[k] = bestNT;
+		}
+
+		for(k=0;k<alphabetSize;k++) { /* To NT */
+			prevScore[k] = nextScore[k];
+			prevNT[j*(ALPHABET_SIZE+1) + k] = nextNT[k];
+		}
+	}
+	k=0;
+	for(j=0;j<alphabetSize;j++) { /* To NT */
+		if(prevScore[k] < prevScore[j]) {
+			k=j;
+		}
+	}
+	maxScore = prevScore[k];
+	for(j=readLength-1;0<=j;j--) {
+		maxNT[j] = k;
+		k=prevNT[j*(ALPHABET_SIZE+1) + k];
+	}
+	free(prevNT);
+
+	return maxScore;
+}
+
 void AlignColorSpaceUngappedGetBest(
 		ScoringMatrix *sm,
 		int32_t curScore, // previous score (prevScore[l])
@@ -211,6 +394,7 @@ void AlignColorSpaceGappedBounded(char *colors,
 {
 	//char *FnName = "AlignColorSpaceGappedBounded";
 	int i, j;
+	int64_t numCells=0;
 	int alphabetSize=ALPHABET_SIZE;
 
 	assert(0 < readLength);
@@ -229,7 +413,9 @@ void AlignColorSpaceGappedBounded(char *colors,
 			assert(i-maxV <= j && j <= referenceLength - (readLength - maxH) + i);
 			AlignColorSpaceFillInCell(colors, readLength, reference, referenceLength, sm, matrix, i, j, colors[i], maxH, maxV, alphabetSize);
 		}
+		numCells += j - GETMAX(0, i - maxV);
 	}
+	MetricsCount(MetricsDPCells, numCells);
 
 	AlignColorSpaceRecoverAlignmentFromMatrix(a, matrix, colors, readLength, reference, referenceLength, 0, 0, readLength - maxV, position, strand, alphabetSize, 0);
 }
@@ -256,6 +442,7 @@ void AlignColorSpaceGappedConstrained(char *colors,
 	char *maskAfterInsertion = mask + readStartInsertionLength;
 	int32_t readAfterInsertionLength = readLength - readStartInsertionLength;
 	char prevBase, curBase;
+	int32_t diagonal, width;
 
 
 	/* Get where to transition */
@@ -314,11 +501,12 @@ void AlignColorSpaceGappedConstrained(char *colors,
 
 	/* Step 1 - upper left */
 	AlignColorSpaceInitializeAtStart(colorsAfterInsertion, matrix, sm, endRowStepOne, endColStepTwo, alphabetSize, prevBase);
-	for(i=0;i<endRowStepOne;i++) { /* read/rows */
-		for(j=0;j<endColStepOne;j++) { /* reference/columns */
-			AlignColorSpaceFillInCell(colorsAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, i, j, colorsAfterInsertion[i], readAfterInsertionLength, readAfterInsertionLength, alphabetSize);
-		}
-	}
+	/* Only fill in the band around the diagonal ending at the mask */
+	diagonal = endColStepOne - endRowStepOne;
+	width = AlignColorSpaceGetBandWidth(colorsAfterInsertion, reference, sm, matrix, 0, endRowStepOne, diagonal, alphabetSize, 
+			endRowStepOne + endColStepOne);
+	AlignColorSpaceFillInBand(colorsAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, 
+			1, endRowStepOne, 1, endColStepOne, diagonal, width, alphabetSize);
 
 	/* Step 2 - align along the mask */
 	// Must consider ins, del, and match on first "color"
@@ -430,12 +618,15 @@ void AlignColorSpaceGappedConstrained(char *colors,
 	AlignColorSpaceInitializeToExtend(colorsAfterInsertion, matrix, sm, readAfterInsertionLength, referenceLength, endRowStepTwo, endColStepTwo, alphabetSize);
 	// Note: we ignore any cells on row==endRowStepTwo or col==endRowStepTwo
 	// since we assumed they were filled in by the previous re-initialization
-	for(i=endRowStepTwo;i<readAfterInsertionLength-readEndInsertionLength;i++) { /* read/rows */
-		/* Get the current color for the read */
-		for(j=endColStepTwo;j<referenceLength;j++) { /* reference/columns */
-			AlignColorSpaceFillInCell(colorsAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, i, j, colorsAfterInsertion[i], readAfterInsertionLength, readAfterInsertionLength, alphabetSize);
-		}
+	diagonal = endColStepTwo - endRowStepTwo;
+	width = readAfterInsertionLength + referenceLength;
+	if(endColStepTwo + readAfterInsertionLength - readEndInsertionLength - endRowStepTwo <= referenceLength) {
+		/* Only fill in the band around the diagonal starting at the mask */
+		width = AlignColorSpaceGetBandWidth(colorsAfterInsertion, reference, sm, matrix, 
+				endRowStepTwo, readAfterInsertionLength - readEndInsertionLength, diagonal, alphabetSize, width);
 	}
+	AlignColorSpaceFillInBand(colorsAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, 
+			endRowStepTwo+1, readAfterInsertionLength - readEndInsertionLength, endColStepTwo+1, referenceLength, diagonal, width, alphabetSize);
 
 	/* Step 4 - recover alignment */
 	AlignColorSpaceRecoverAlignmentFromMatrix(a, matrix, colors, readLength, reference, referenceLength, 
@@ -444,6 +635,153 @@ void AlignColorSpaceGappedConstrained(char *colors,
 			endColStepTwo, position, strand, alphabetSize, 0);
 }
 
+/* Returns the width of the band around the diagonal that must be
+ * filled in for the rows from startRow to endRow, all paths starting 
+ * from the cell on the diagonal at startRow, which must be filled in.  
+ * The diagonal is the column minus the row and must start within the 
+ * reference. */
+int32_t AlignColorSpaceGetBandWidth(char *colors,
+		char *reference,
+		ScoringMatrix *sm,
+		AlignMatrix *matrix,
+		int32_t startRow,
+		int32_t endRow,
+		int32_t diagonal,
+		int32_t alphabetSize,
+		int32_t maxWidth)
+{
+#ifndef UNOPTIMIZED_SMITH_WATERMAN
+	char *FnName="AlignColorSpaceGetBandWidth";
+	int32_t i, k, l;
+	int32_t maxRowScore;
+	int64_t maxScore, minScore;
+	int32_t prevScores[ALPHABET_SIZE+1], curScores[ALPHABET_SIZE+1];
+
+	/* Every row must score at most a match with any color */
+	maxRowScore = sm->ntMatch + GETMAX(sm->colorMatch, sm->colorMismatch);
+	if(0 == AlignIsBanded() || diagonal < 0 || sm->ntMatch < 0 || sm->ntMatch < sm->ntMismatch || maxRowScore < 0) {
+		return maxWidth;
+	}
+
+	/* Score the best path along the diagonal to each base */
+	for(k=0;k<ALPHABET_SIZE+1;k++) {
+		prevScores[k] = (k < alphabetSize) ? matrix->cells[startRow][startRow+diagonal].s.score[k] : NEGATIVE_INFINITY-1;
+	}
+	for(i=startRow;i<endRow;i++) {
+		for(k=0;k<alphabetSize;k++) { /* To NT */
+			curScores[k] = NEGATIVE_INFINITY-1;
+			for(l=0;l<alphabetSize;l++) { /* From NT */
+				char convertedColor='X';
+				int32_t curScore;
+				if(0 == ConvertBaseToColorSpace(DNA[l], DNA[k], &convertedColor)) {
+					PrintError(FnName, "convertedColor", "Could not convert base to color space", Exit, OutOfRange);
+				}
+				convertedColor=COLORFROMINT(convertedColor);
+				curScore = prevScores[l] + 
+					ScoringMatrixGetNTScore(reference[i+diagonal], DNA[k], sm) +
+					ScoringMatrixGetColorScore(colors[i], convertedColor, sm);
+				LOWERBOUNDSCORE(curScore);
+				if(curScore > curScores[k]) {
+					curScores[k] = curScore;
+				}
+			}
+		}
+		for(k=0;k<alphabetSize;k++) {
+			prevScores[k] = curScores[k];
+		}
+	}
+
+	if(0 == startRow) {
+		/* Every base at the end of the path must be reached, so use the worst */
+		minScore = prevScores[0];
+		maxScore = 0;
+		for(k=1;k<alphabetSize;k++) {
+			minScore = GETMIN(minScore, prevScores[k]);
+		}
+	}
+	else {
+		/* Any base may end the path, so use the best */
+		minScore = prevScores[0];
+		maxScore = matrix->cells[startRow][startRow+diagonal].s.score[0];
+		for(k=1;k<alphabetSize;k++) {
+			minScore = GETMAX(minScore, prevScores[k]);
+			maxScore = GETMAX(maxScore, matrix->cells[startRow][startRow+diagonal].s.score[k]);
+		}
+	}
+	if(!(NEGATIVE_INFINITY < minScore)) {
+		return maxWidth;
+	}
+
+	return AlignGetBandWidth(sm, 
+			maxScore + ((int64_t)(endRow - startRow))*maxRowScore, 
+			minScore, 
+			maxWidth);
+#else
+	return maxWidth;
+#endif
+}
+
+/* Fills in the cells from startRow to endRow and startCol to endCol
+ * that are within width diagonals of the given diagonal.  The cells 
+ * bordering the band, and the rest of the last row, are set to 
+ * negative infinity so that they are never used. */
+void AlignColorSpaceFillInBand(char *colors,
+		int32_t readLength,
+		char *reference,
+		int32_t referenceLength,
+		ScoringMatrix *sm,
+		AlignMatrix *matrix,
+		int32_t startRow,
+		int32_t endRow,
+		int32_t startCol,
+		int32_t endCol,
+		int32_t diagonal,
+		int32_t width,
+		int32_t alphabetSize)
+{
+	int32_t i, j;
+	int32_t curStartCol=startCol, curEndCol=endCol;
+	int64_t numCells=0;
+
+	for(i=startRow;i<endRow+1;i++) { /* read/rows */
+		curStartCol = GETMAX(startCol, i + diagonal - width);
+		curEndCol = GETMIN(endCol, i + diagonal + width);
+		if(startCol < curStartCol) {
+			AlignColorSpaceSetCellToNegativeInfinity(matrix, i, curStartCol-1, alphabetSize);
+		}
+		for(j=curStartCol;j<curEndCol+1;j++) { /* reference/columns */
+			AlignColorSpaceFillInCell(colors, readLength, reference, referenceLength, sm, matrix, i-1, j-1, colors[i-1], readLength, readLength, alphabetSize);
+		}
+		numCells += j - curStartCol;
+		if(curEndCol < endCol) {
+			AlignColorSpaceSetCellToNegativeInfinity(matrix, i, curEndCol+1, alphabetSize);
+		}
+	}
+	/* The alignment is chosen from the last row */
+	if(startRow <= endRow) {
+		for(j=startCol;j<curStartCol-1;j++) {
+			AlignColorSpaceSetCellToNegativeInfinity(matrix, endRow, j, alphabetSize);
+		}
+		for(j=curEndCol+2;j<endCol+1;j++) {
+			AlignColorSpaceSetCellToNegativeInfinity(matrix, endRow, j, alphabetSize);
+		}
+	}
+	MetricsCount(MetricsDPCells, numCells);
+}
+
+void AlignColorSpaceSetCellToNegativeInfinity(AlignMatrix *matrix,
+		int32_t row,
+		int32_t col,
+		int32_t alphabetSize)
+{
+	int32_t k;
+	for(k=0;k<alphabetSize;k++) {
+		matrix->cells[row][col].h.score[k] = matrix->cells[row][col].s.score[k] = matrix->cells[row][col].v.score[k] = NEGATIVE_INFINITY-1;
+		matrix->cells[row][col].h.from[k] = matrix->cells[row][col].s.from[k] = matrix->cells[row][col].v.from[k] = NoFromCS;
+		matrix->cells[row][col].h.length[k] = matrix->cells[row][col].s.length[k] = matrix->cells[row][col].v.length[k] = INT_MIN;
+	}
+}
+
 void AlignColorSpaceRecoverAlignmentFromMatrix(AlignedEntry *a,
 		AlignMatrix *matrix,
 		char *colors,
@@ -4,9 +4,14 @@
 #include "BLibDefinitions.h"
 
 int32_t AlignColorSpaceUngapped(char*, char*, int, char*, int, int, ScoringMatrix*, AlignedEntry*, int, int32_t, char);
+int32_t AlignColorSpaceUngappedLanes(char*, char*, int, char*, int, int, ScoringMatrix*, int, int32_t, int32_t, int*);
+int32_t AlignColorSpaceUngappedTraceback(char*, char*, int, char*, int, ScoringMatrix*, int32_t, char*);
 void AlignColorSpaceUngappedGetBest(ScoringMatrix*, int32_t, char, char, int32_t, int32_t, int32_t, int32_t*, int32_t*, char*);
 void AlignColorSpaceGappedBounded(char*, int, char*, int, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, char, int32_t, int32_t);
 void AlignColorSpaceGappedConstrained(char*, char*, int, char*, int, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, char);
+int32_t AlignColorSpaceGetBandWidth(char*, char*, ScoringMatrix*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t);
+void AlignColorSpaceFillInBand(char*, int32_t, char*, int32_t, ScoringMatrix*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+void AlignColorSpaceSetCellToNegativeInfinity(AlignMatrix*, int32_t, int32_t, int32_t);
 void AlignColorSpaceRecoverAlignmentFromMatrix(AlignedEntry*, AlignMatrix*, char*, int, char*, int, int32_t, int32_t, int, int32_t, char, int, int);
 
 void AlignColorSpaceInitializeAtStart(char*, AlignMatrix*, ScoringMatrix*, int32_t, int32_t, int32_t, char);
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <config.h>
 #include "BLibDefinitions.h"
 #include "BLib.h"
 #include "BError.h"
@@ -12,6 +13,7 @@
 #include "Align.h"
 #include "AlignMatrix.h"
 #include "AlignNTSpace.h"
+#include "Metrics.h"
 
 // DEBUGGING CODE NEEDS TO BE CLEANED UP
 
@@ -92,6 +94,7 @@ void AlignNTSpaceGappedBounded(char *read,
 	//char *FnName = "AlignNTSpaceFullWithBound";
 	/* read goes on the rows, reference on the columns */
 	int i, j;
+	int64_t numCells=0;
 
 	assert(maxV >= 0 && maxH >= 0);
 	assert(readLength < matrix->nrow);
@@ -109,7 +112,9 @@ void AlignNTSpaceGappedBounded(char *read,
 			// Fill in the cell
 			AlignNTSpaceFillInCell(read, readLength, reference, referenceLength, sm, matrix, i+1, j+1, maxH, maxV);
 		}
+		numCells += j - GETMAX(0, i - maxV);
 	}
+	MetricsCount(MetricsDPCells, numCells);
 
 	AlignNTSpaceRecoverAlignmentFromMatrix(a, matrix, read, readLength, reference, referenceLength, 0, 0, readLength - maxV + 1, position, strand, 0);
 }
@@ -131,6 +136,7 @@ void AlignNTSpaceGappedConstrained(char *read,
 	char *FnName="AlignNTSpaceGappedConstrained";
 	int32_t i, j;
 	int32_t endRowStepOne, endColStepOne, endRowStepTwo, endColStepTwo;
+	int32_t diagonal, width;
 	char *readAfterInsertion = read + readStartInsertionLength;
 	char *maskAfterInsertion = mask + readStartInsertionLength;
 	int32_t readAfterInsertionLength = readLength - readStartInsertionLength;
@@ -167,11 +173,11 @@ void AlignNTSpaceGappedConstrained(char *read,
 
 	/* Step 1 - upper left */
 	AlignNTSpaceInitializeAtStart(matrix, sm, endRowStepOne, endColStepOne);
-	for(i=1;i<endRowStepOne+1;i++) { /* read/rows */ 
-		for(j=1;j<endColStepOne+1;j++) { /* reference/columns */
-			AlignNTSpaceFillInCell(readAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, i, j, readAfterInsertionLength, readAfterInsertionLength);
-		}
-	}
+	/* Only fill in the band around the diagonal ending at the mask */
+	diagonal = endColStepOne - endRowStepOne;
+	width = AlignNTSpaceGetBandWidth(readAfterInsertion, reference, sm, 0, endRowStepOne, diagonal, 0, endRowStepOne + endColStepOne);
+	AlignNTSpaceFillInBand(readAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, 
+			1, endRowStepOne, 1, endColStepOne, diagonal, width);
 
 	/* Step 2 - align along the mask */
 	for(i=endRowStepOne,j=endColStepOne;
@@ -193,11 +199,16 @@ void AlignNTSpaceGappedConstrained(char *read,
 	AlignNTSpaceInitializeToExtend(matrix, sm, readAfterInsertionLength, referenceLength, endRowStepTwo, endColStepTwo);
 	// Note: we ignore any cells on row==endRowStepTwo or col==endRowStepTwo
 	// since we assumed they were filled in by the previous re-initialization
-	for(i=endRowStepTwo+1;i<readAfterInsertionLength-readEndInsertionLength+1;i++) { /* read/rows */ 
-		for(j=endColStepTwo+1;j<referenceLength+1;j++) { /* reference/columns */
-			AlignNTSpaceFillInCell(readAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, i, j, readAfterInsertionLength, readAfterInsertionLength);
-		}
+	diagonal = endColStepTwo - endRowStepTwo;
+	width = readAfterInsertionLength + referenceLength;
+	if(endColStepTwo + readAfterInsertionLength - readEndInsertionLength - endRowStepTwo <= referenceLength) {
+		/* Only fill in the band around the diagonal starting at the mask */
+		width = AlignNTSpaceGetBandWidth(readAfterInsertion, reference, sm, 
+				endRowStepTwo, readAfterInsertionLength - readEndInsertionLength, diagonal, 
+				matrix->cells[endRowStepTwo][endColStepTwo].s.score[0], width);
 	}
+	AlignNTSpaceFillInBand(readAfterInsertion, readAfterInsertionLength, reference, referenceLength, sm, matrix, 
+			endRowStepTwo+1, readAfterInsertionLength - readEndInsertionLength, endColStepTwo+1, referenceLength, diagonal, width);
 
 	/* Step 4 - recover alignment */
 	AlignNTSpaceRecoverAlignmentFromMatrix(a, matrix, read, readLength, reference, referenceLength, 
@@ -206,6 +217,98 @@ void AlignNTSpaceGappedConstrained(char *read,
 			endColStepTwo+1, position, strand, 0);
 }
 
+/* Returns the width of the band around the diagonal that must be
+ * filled in for the rows from startRow to endRow, all paths starting 
+ * from a cell scoring startScore.  The diagonal is the column minus the 
+ * row and must start within the reference. */
+int32_t AlignNTSpaceGetBandWidth(char *read,
+		char *reference,
+		ScoringMatrix *sm,
+		int32_t startRow,
+		int32_t endRow,
+		int32_t diagonal,
+		int32_t startScore,
+		int32_t maxWidth)
+{
+#ifndef UNOPTIMIZED_SMITH_WATERMAN
+	int32_t i;
+	int64_t score;
+
+	/* Every row must score at most a match */
+	if(0 == AlignIsBanded() || diagonal < 0 || sm->ntMatch < 0 || sm->ntMatch < sm->ntMismatch) {
+		return maxWidth;
+	}
+
+	/* Score the path along the diagonal */
+	for(i=startRow, score=startScore;i<endRow;i++) {
+		score += ScoringMatrixGetNTScore(read[i], reference[diagonal+i], sm);
+	}
+
+	return AlignGetBandWidth(sm, 
+			startScore + ((int64_t)(endRow - startRow))*sm->ntMatch, 
+			score, 
+			maxWidth);
+#else
+	return maxWidth;
+#endif
+}
+
+/* Fills in the cells from startRow to endRow and startCol to endCol
+ * that are within width diagonals of the given diagonal.  The cells 
+ * bordering the band, and the rest of the last row, are set to 
+ * negative infinity so that they are never used. */
+void AlignNTSpaceFillInBand(char *read,
+		int32_t readLength,
+		char *reference,
+		int32_t referenceLength,
+		ScoringMatrix *sm,
+		AlignMatrix *matrix,
+		int32_t startRow,
+		int32_t endRow,
+		int32_t startCol,
+		int32_t endCol,
+		int32_t diagonal,
+		int32_t width)
+{
+	int32_t i, j;
+	int32_t curStartCol=startCol, curEndCol=endCol;
+	int64_t numCells=0;
+
+	for(i=startRow;i<endRow+1;i++) { /* read/rows */
+		curStartCol = GETMAX(startCol, i + diagonal - width);
+		curEndCol = GETMIN(endCol, i + diagonal + width);
+		if(startCol < curStartCol) {
+			AlignNTSpaceSetCellToNegativeInfinity(matrix, i, curStartCol-1);
+		}
+		for(j=curStartCol;j<curEndCol+1;j++) { /* reference/columns */
+			AlignNTSpaceFillInCell(read, readLength, reference, referenceLength, sm, matrix, i, j, readLength, readLength);
+		}
+		numCells += j - curStartCol;
+		if(curEndCol < endCol) {
+			AlignNTSpaceSetCellToNegativeInfinity(matrix, i, curEndCol+1);
+		}
+	}
+	/* The alignment is chosen from the last row */
+	if(startRow <= endRow) {
+		for(j=startCol;j<curStartCol-1;j++) {
+			AlignNTSpaceSetCellToNegativeInfinity(matrix, endRow, j);
+		}
+		for(j=curEndCol+2;j<endCol+1;j++) {
+			AlignNTSpaceSetCellToNegativeInfinity(matrix, endRow, j);
+		}
+	}
+	MetricsCount(MetricsDPCells, numCells);
+}
+
+void AlignNTSpaceSetCellToNegativeInfinity(AlignMatrix *matrix,
+		int32_t row,
+		int32_t col)
+{
+	matrix->cells[row][col].h.score[0] = matrix->cells[row][col].s.score[0] = matrix->cells[row][col].v.score[0] = NEGATIVE_INFINITY;
+	matrix->cells[row][col].h.from[0] = matrix->cells[row][col].s.from[0] = matrix->cells[row][col].v.from[0] = NoFromNT;
+	matrix->cells[row][col].h.length[0] = matrix->cells[row][col].s.length[0] = matrix->cells[row][col].v.length[0] = 0;
+}
+
 /* TODO */
 void AlignNTSpaceRecoverAlignmentFromMatrix(AlignedEntry *a,
 		AlignMatrix *matrix,
@@ -7,6 +7,9 @@
 int32_t AlignNTSpaceUngapped(char*, char*, int, char*, int, int, ScoringMatrix*, AlignedEntry*, int, int32_t, char);
 void AlignNTSpaceGappedBounded(char*, int, char*, int, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, char, int32_t, int32_t);
 void AlignNTSpaceGappedConstrained(char*, char*, int, char*, int, ScoringMatrix*, AlignedEntry*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, char);
+int32_t AlignNTSpaceGetBandWidth(char*, char*, ScoringMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t);
+void AlignNTSpaceFillInBand(char*, int32_t, char*, int32_t, ScoringMatrix*, AlignMatrix*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+void AlignNTSpaceSetCellToNegativeInfinity(AlignMatrix*, int32_t, int32_t);
 void AlignNTSpaceRecoverAlignmentFromMatrix(AlignedEntry*, AlignMatrix*, char*, int, char*, int, int32_t, int32_t, int, int32_t, char, int);
 void AlignNTSpaceInitializeAtStart(AlignMatrix*, ScoringMatrix*, int32_t, int32_t);
 void AlignNTSpaceInitializeToExtend(AlignMatrix*, ScoringMatrix*, int32_t, int32_t, int32_t, int32_t);
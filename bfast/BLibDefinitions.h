@@ -22,7 +22,8 @@
 #define MAXIMUM_MAPPING_QUALITY 255
 #define ONE_GIGABYTE (int64_t)1073741824
 #define MERGE_MEMORY_LIMIT 12*((int64_t)1073741824) /* In Gigabytes */
-#define RGINDEXLAYOUT_MAX_HASH_WIDTH 18
+#define RGINDEXLAYOUT_MAX_HASH_WIDTH 31 /* The hash index is a 64-bit integer */
+#define RGRANGES_MAX_MERGE_LENGTH 64 /* Longer previous ranges are not searched for duplicates */
 #define READS_BUFFER_LENGTH 40000
 #define BFAST_MATCH_THREAD_SLEEP 1
 
@@ -41,8 +42,26 @@ extern int32_t VERBOSE;
 #define RGINDEX_SHELL_SORT_MAX 50
 #define RGINDEX_MERGE_BUFFER_LENGTH 1048576
 #define RGMATCH_SHELL_SORT_MAX 50
+#define RGMATCH_RADIX_SORT_MIN 64
 #define ALIGNEDENTRY_SHELL_SORT_MAX 50
 #define RGRANGES_SHELL_SORT_MAX 50
+/* Packed reads/references for the exact and ungapped filters: four bits per base */
+#define ALIGN_PACKED_BASES_PER_WORD 16
+#define ALIGN_PACKED_NUM_WORDS(_len) (((_len) + ALIGN_PACKED_BASES_PER_WORD - 1) / ALIGN_PACKED_BASES_PER_WORD)
+/* The number of 64-bit words holding _len entries of _width bits each */
+#define RGINDEX_PACKED_NUM_WORDS(_len, _width) ((((int64_t)(_len))*(_width) + 63) >> 6)
+/* Indexes with wider hashes, or with UINT_MAX or more entries, store only
+ * the distinct hashes in the index and the first entry of each, both 
+ * Elias-Fano coded, with one select sample for every 
+ * 2^RGINDEX_STARTS_SELECT_SHIFT values and high buckets.  These are written
+ * with the id BFAST_CODED_STARTS_ID, since earlier releases wrote 32-bit 
+ * starts for all widths. */
+#define RGINDEX_MAX_NARROW_HASH_WIDTH 16
+#define RGINDEX_STARTS_SELECT_SHIFT 8
+/* The most masked bases kept in the key of a read, two bits per base */
+#define RGINDEX_KEYS_MAX_BASES 32
+/* Start offsets scored together in the color space ungapped alignment */
+#define ALIGN_COLOR_SPACE_UNGAPPED_LANES 16
 #define RGREADS_SHELL_SORT_MAX 50
 
 /* Get opt */
@@ -98,6 +117,7 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 // the next define should be the int representation of the previous define
 #define COLOR_SPACE_START_NT_INT 0
 #define BFAST_ID 'B'+'F'+'A'+'S'+'T'
+#define BFAST_CODED_STARTS_ID (BFAST_ID+1)
 #define AVG_MISMATCH_QUALITY 10
 #define INSERT_MAX_STD 3.0
 
@@ -126,6 +146,7 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define WHICHSTRAND(_mode) ((0 == _mode) ? "[Both Strands]" : ((1 == _mode) ? "[Forward Strand]" : "[Reverse Strand]"))
 #define MIRRORINGTYPE(_mode) ((0 == _mode) ? "[Not Using]" : ((1 == _mode) ? "[First before the Second]" : ((2 == _mode) ? "[Second before the First]" : "[Both directions]")))
 #define COMPRESSION(_c) ((AFILE_NO_COMPRESSION == _c) ? "[Not Using]" : ((AFILE_GZ_COMPRESSION == _c) ? "[gzip]" : ((AFILE_BZ2_COMPRESSION == _c) ? "[bzip2]" : "[Unknown]")))
+#define NUMAMODE(_mode) ((NumaNone == _mode) ? "[Not Using]" : ((NumaReplicate == _mode) ? "[Replicate]" : "[Interleave]"))
 #define LOWERBOUNDSCORE(_score) (_score = (_score < NEGATIVE_INFINITY) ? NEGATIVE_INFINITY : _score)
 #define GETMIN(_X, _Y)  ((_X) < (_Y) ? (_X) : (_Y))
 #define GETMAX(_X, _Y)  ((_X) < (_Y) ? (_Y) : (_X))
@@ -135,6 +156,8 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define GETMASKNUMBYTES(_m) (((int)((_m->readLength + 7)/8)))
 #define GETMASKNUMBYTESFROMLENGTH(_l) (((int)((_l + 7)/8)))
 #define GETMASKBYTE(_pos) ((int)(_pos / 8))
+#define GETMASK(_m, _i) ((_m)->masks + (int64_t)(_i)*GETMASKNUMBYTES((_m)))
+#define GETOFFSETS(_m, _i) ((_m)->offsets + (_m)->offsetsStart[(_i)])
 #define ROUND(_x) ((int)((_x) + 0.5))
 #define COLORFROMINT(_c) (COLORS[(int)_c])
 #define COMPAREINTS(_a, _b) ((_a < _b) ? -1 : ((_a == _b) ? 0 : 1))
@@ -142,6 +165,9 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 /* For FindMatches.c */
 #define FM_ROTATE_NUM 10000
 #define DEFAULT_MATCHES_QUEUE_LENGTH 250000
+#define PREFETCH_MEMORY_AVAILABLE -1 /* budget the next index by the free physical memory */
+#define DEFAULT_CASCADE_COVERAGE 50 /* percent of a resolved read covered by its keys */
+#define READS_STREAM_BATCH_SIZE 1024
 
 #define NEGATIVE_INFINITY INT_MIN/16 /* cannot make this too small, otherwise we will not have numerical stability, i.e. become positive */
 #define VERY_NEGATIVE_INFINITY (INT_MIN/16)-1000 /* cannot make this too small, otherwise we will not have numerical stability, i.e. become positive */
@@ -169,6 +195,7 @@ enum {BFASTReferenceGenomeFile, BFASTIndexFile};
 enum {RGBinaryPacked, RGBinaryUnPacked};
 enum {NoMirroring, MirrorForward, MirrorReverse, MirrorBoth};
 enum {IndexesMemorySerial, IndexesMemoryAll};
+enum {NumaNone, NumaReplicate, NumaInterleave};
 /* For RGIndexAccuracy */
 enum {SearchForRGIndexAccuracies, EvaluateRGIndexAccuracies, ProgramParameters};
 enum {NO_EVENT, MISMATCH, INSERTION, DELETION};
@@ -206,10 +233,13 @@ typedef struct {
 	uint32_t *contigs;
 	int32_t *positions;
 	char *strands;
-	char **masks;
+	char *masks; /* GETMASKNUMBYTES bytes per entry, see GETMASK */
 	// these are only used when the index is split into pieces
 	int32_t *numOffsets;
-	int32_t **offsets; 
+	int32_t *offsetsStart; /* start of each entry's offsets, see GETOFFSETS */
+	int32_t *offsets; 
+	int32_t offsetsLength;
+	int32_t offsetsMaxLength;
 } RGMatch;
 
 /* TODO */
@@ -228,8 +258,25 @@ typedef struct {
 	int32_t *numOffsets;
 	int32_t *offset;
 	int32_t numEntries;
+	int32_t maxNumEntries;
 } RGRanges;
 
+/* The keys of a read for one index, at each offset and on both strands,
+ * see RGIndexKeysCompute.  The forward key at an offset is at that offset
+ * and the reverse key numOffsets after it. */
+typedef struct {
+	int32_t readLength;
+	int32_t numOffsets;
+	int32_t maxNumOffsets;
+	/* 1 if the keys hold all the masked bases */
+	int32_t hasKeys;
+	/* The reverse compliment (reverse in color space) of the read */
+	int8_t reverseRead[SEQUENCE_LENGTH];
+	int8_t *valid;
+	int64_t *hashIndex;
+	uint64_t *keys;
+} RGIndexKeys;
+
 /* TODO */
 typedef struct {
 	int32_t numReads;
@@ -263,6 +310,18 @@ typedef struct {
 	int32_t space;
 } RGBinary;
 
+/* An increasing sequence of values less than universe, Elias-Fano coded:
+ * the low bits of each value stored as is and the rest in unary */
+typedef struct {
+	int64_t length;
+	int64_t universe;
+	int32_t lowBits;
+	uint64_t *low;
+	uint64_t *high;
+	int64_t *select; /* the high bit of every 2^RGINDEX_STARTS_SELECT_SHIFT-th value */
+	int64_t *buckets; /* the zero ending every 2^RGINDEX_STARTS_SELECT_SHIFT-th high bucket */
+} RGIndexEliasFano;
+
 /* TODO */
 typedef struct {
 	/* Storage type */
@@ -294,6 +353,25 @@ typedef struct {
 	uint32_t hashWidth; /* in bases */
 	int64_t hashLength; 
 	uint32_t *starts;
+	/* Coded starts, used instead of starts for wide hashes or long 
+	 * indexes: the distinct hashes, and the first entry of each followed 
+	 * by the length, see RGIndexCreateHash */
+	RGIndexEliasFano startsHashes;
+	RGIndexEliasFano startsEntries;
+	/* Keys occurring more than keyFilterThreshold times, in an open
+	 * addressing hash table, see RGIndexCreateKeyFilter */
+	int32_t keyFilterThreshold;
+	int32_t keyFilterWidth;
+	int64_t keyFilterNumKeys;
+	int64_t keyFilterLength; /* a power of two */
+	uint64_t *keyFilterKeys;
+	uint32_t *keyFilterCounts; /* zero for an empty slot */
+	/* Bit packed contigs and positions, see RGIndexPack */
+	int32_t packedWidth; /* in bits, zero if not packed */
+	uint64_t *packed;
+	uint32_t packedStartContig;
+	int32_t packedNumContigs;
+	int64_t *packedContigStarts; /* the first coordinate of each contig */
 } RGIndex;
 
 /* TODO */
@@ -435,4 +513,35 @@ typedef struct {
 	int32_t *maxMismatches;
 } RGIndexAccuracyMismatchProfile;
 
+/* RGIndexAccuracy.c */
+typedef struct {
+	int32_t readLength;
+	int32_t numWords; /* words per read */
+	int32_t numReads; /* reads per level */
+	int32_t numSNPs;
+	int32_t numColorErrors;
+	int32_t numLevels;
+	uint64_t *bits; /* one bit per position that can not be indexed */
+	char *found; /* reads already found by the current set */
+	int32_t *numFound; /* per level */
+} ReadBitsSet;
+
+/* RGIndexAccuracy.c */
+typedef struct {
+	RGIndexAccuracySet *curSet;
+	ReadBitsSet *reads;
+	int32_t keySize;
+	int32_t maxKeyWidth;
+	int32_t accuracyThreshold;
+	int32_t numIndexesToSample;
+	int32_t setSize;
+	int32_t seed;
+	int32_t numThreads;
+	int32_t threadID;
+	/* The best index found by this thread */
+	RGIndexAccuracy best;
+	int32_t bestSample;
+	int32_t *bestNumCorrect;
+} ThreadRGIndexAccuracyData;
+
 #endif
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
@@ -12,7 +13,10 @@
 #include "BLib.h"
 #include "RunAlign.h"
 #include "aflib.h"
+#include "ThreadPool.h"
 #include "BfastAlign.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
@@ -20,7 +24,7 @@
    */
 enum { 
 	DescInputFilesTitle, DescFastaFileName, DescReadsFileName, DescLoadAllIndexes, DescCompressionBZ2, DescCompressionGZ,
-	DescAlgoTitle, DescSpace, DescNumThreads, 
+	DescAlgoTitle, DescSpace, DescNumThreads, DescCpuAffinity, 
 	DescOutputTitle, DescTmpDir, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -34,9 +38,15 @@ static struct argp_option options[] = {
 	{0, 0, 0, 0, "=========== Algorithm Options: (Unless specified, default value = 0) ================", 2},
 	{"space", 'A', "space", 0, "0: NT space 1: Color space", 2},
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"cpuAffinity", 'c', 0, OPTION_NO_USAGE, "Specifies to pin each thread to a CPU", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 3},
+	{"traceJSON", 'Z', "traceFileName", 0, "Specifies to write the spans of the reading, searching or aligning,"
+		"\n\t\t\t waiting, merging and output of each thread as Chrome trace events"
+		"\n\t\t\t to this file (also --trace-json)", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 4},
@@ -44,7 +54,13 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"f:n:r:A:T:hjptz";
+"f:n:r:A:J:Z:T:chjptz";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{"trace-json", required_argument, 0, 'Z'},
+	{0, 0, 0, 0}
+};
 
 	int
 BfastAlign(int argc, char **argv)
@@ -79,9 +95,12 @@ BfastAlign(int argc, char **argv)
 
 					}
 					BfastAlignPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("align", arguments.metricsFileName);
+					TRACE_INITIALIZE("align", arguments.traceFileName);
 					/* Execute Program */
 
 					/* Run Matches */
+					ThreadPoolStart(arguments.numThreads, arguments.cpuAffinity);
 					RunAlign(
 							arguments.fastaFileName,
 							arguments.readsFileName,
@@ -90,6 +109,10 @@ BfastAlign(int argc, char **argv)
 							arguments.numThreads,
 							arguments.tmpDir,
 							arguments.timing);
+					ThreadPoolStop();
+
+					MetricsFree();
+					TRACE_FREE();
 
 					if(arguments.timing == 1) {
 						endTime = time(NULL);
@@ -183,6 +206,12 @@ int BfastAlignValidateInputs(struct arguments *args) {
 	/* If this does not hold, we have done something wrong internally */	
 	assert(args->timing == 0 || args->timing == 1);
 
+#ifdef DISABLE_TRACE
+	if(NULL != args->traceFileName) {
+		PrintError(FnName, "traceFileName", "The tracer was compiled out with --disable-trace", Exit, OutOfRange);
+	}
+#endif
+
 	return 1;
 }
 
@@ -200,6 +229,7 @@ BfastAlignAssignDefaultValues(struct arguments *args)
 	args->compression = AFILE_NO_COMPRESSION;
 	args->space = NTSpace;
 	args->numThreads = 1;
+	args->cpuAffinity = 0;
 
 	args->tmpDir =
 		(char*)malloc(sizeof(DEFAULT_OUTPUT_DIR));
@@ -207,6 +237,8 @@ BfastAlignAssignDefaultValues(struct arguments *args)
 	strcpy(args->tmpDir, DEFAULT_OUTPUT_DIR);
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
+	args->traceFileName = NULL;
 
 	return;
 }
@@ -224,8 +256,11 @@ BfastAlignPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "compression:\t\t\t\t%s\n", COMPRESSION(args->compression));
 		fprintf(fp, "space:\t\t\t\t\t%s\n", SPACE(args->space));
 		fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
+		fprintf(fp, "cpuAffinity:\t\t\t\t%s\n", INTUSING(args->cpuAffinity));
 		fprintf(fp, "tmpDir:\t\t\t\t\t%s\n", args->tmpDir);
 		fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
+		fprintf(fp, "metricsFileName:\t\t\t%s\n", FILEUSING(args->metricsFileName));
+		fprintf(fp, "traceFileName:\t\t\t\t%s\n", FILEUSING(args->traceFileName));
 		fprintf(fp, BREAK_LINE);
 	}
 	return;
@@ -240,6 +275,10 @@ void BfastAlignFreeProgramParameters(struct arguments *args)
 	args->readsFileName=NULL;
 	free(args->tmpDir);
 	args->tmpDir=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
+	free(args->traceFileName);
+	args->traceFileName=NULL;
 }
 
 /* TODO */
@@ -274,11 +313,13 @@ BfastAlignGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
 		switch (key) {
+			case 'c':
+				arguments->cpuAffinity = 1;break;
 			case 'f':
 				arguments->fastaFileName = strdup(optarg); break;
 			case 'h':
@@ -293,6 +334,10 @@ BfastAlignGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->readsFileName=strdup(optarg); break;
 			case 't':
 				arguments->timing = 1; break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
+			case 'Z':
+				arguments->traceFileName = strdup(optarg); break;
 			case 'z':
 				arguments->compression=AFILE_GZ_COMPRESSION; break;
 			case 'A':
@@ -12,8 +12,11 @@ struct arguments
 	int compression;						/* -j, -z */ 
 	int space;								/* -A */
 	int numThreads;							/* -n */
+	int cpuAffinity;						/* -c */
 	char *tmpDir;							/* -T */
 	int timing;								/* -t */
+	char *metricsFileName;					/* -J */
+	char *traceFileName;					/* -Z */
 	int programMode;						/* -h */ 
 };
 
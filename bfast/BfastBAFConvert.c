@@ -5,11 +5,13 @@
 #include <zlib.h>
 #include <config.h>
 #include <unistd.h>
+#include <getopt.h>
 #include "BLibDefinitions.h"
 #include "AlignedRead.h"
 #include "AlignedReadConvert.h"
 #include "BError.h"
 #include "BLib.h"
+#include "Metrics.h"
 
 #define Name "bfast bafconvert"
 #define BAFCONVERT_ROTATE_NUM 100000
@@ -29,6 +31,8 @@ void BfastBAFConvertUsage()
 	fprintf(stderr, "\t-o\t\toutput ID to append to the read name (SAM only)\n");
 	fprintf(stderr, "\t-r\t\tSpecifies the file that contains the read group" 
 			"\n\t\t\t  to add to the SAM header and reads (SAM only)\n");
+	fprintf(stderr, "\t-J\t\twrite the time spent in each stage and the counters\n"
+			"\t\t\t  as JSON to this file (also --metrics-json)\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
 			PACKAGE_BUGREPORT);
@@ -52,10 +56,17 @@ int BfastBAFConvert(int argc, char *argv[])
 	AlignedRead a;
 	RGBinary rg;
 	char fileExtension[256]="\0";
+	char *metricsFileName=NULL;
+	int64_t startTime;
+	static struct option longOptions[]={
+		{"metrics-json", required_argument, 0, 'J'},
+		{0, 0, 0, 0}
+	};
 
 	// Get parameters
-	while((c = getopt(argc, argv, "f:o:r:O:h")) >= 0) {
+	while((c = getopt_long(argc, argv, "f:o:r:J:O:h", longOptions, NULL)) >= 0) {
 		switch(c) {
+			case 'J': free(metricsFileName); metricsFileName=strdup(optarg); break;
 			case 'O': outputType = atoi(optarg); break;
 			case 'f': strcpy(fastaFileName, optarg); break;
 			case 'o': strcpy(outputID, optarg); break;
@@ -70,6 +81,8 @@ int BfastBAFConvert(int argc, char *argv[])
 		BfastBAFConvertUsage(); return 1;
 	}
 
+	MetricsInitialize("bafconvert", metricsFileName);
+
 	/* Only read in the brg if necessary */
 	switch(outputType) {
 		case 2:
@@ -78,9 +91,11 @@ int BfastBAFConvert(int argc, char *argv[])
 			if(0 == strlen(fastaFileName)) {
 				PrintError(Name, "fastaFileName", "Required command line argument", Exit, InputArguments);
 			}
+			startTime = MetricsStart();
 			RGBinaryReadBinary(&rg,
 					NTSpace,
 					fastaFileName);
+			MetricsStop(MetricsLoad, startTime);
 			break;
 		default:
 			break;
@@ -163,6 +178,7 @@ int BfastBAFConvert(int argc, char *argv[])
 		AlignedReadInitialize(&a);
 		counter = 0;
 		fprintf(stderr, "Currently on:\n0");
+		startTime = MetricsStart();
 		/* Read in each match */
 		while((TextInput == inputType && EOF != AlignedReadReadText(&a, fpIn)) ||
 				(BinaryInput == inputType && EOF != AlignedReadRead(&a, fpInGZ))) {
@@ -188,18 +204,23 @@ int BfastBAFConvert(int argc, char *argv[])
 		}
 		fprintf(stderr, "\r%lld\n",
 				counter);
+		MetricsStop(MetricsFormat, startTime);
 		/* Close the input file */
 		if(TextInput == inputType) {
+			MetricsCountFile(MetricsBytesIn, fpIn);
 			fclose(fpIn);
 		}
 		else {
+			MetricsCountGZ(MetricsBytesIn, fpInGZ);
 			gzclose(fpInGZ);
 		}
 		/* Close the output file */
 		if(TextOutput == outputSubType) {
+			MetricsCountFile(MetricsBytesOut, fpOut);
 			fclose(fpOut);
 		}
 		else {
+			MetricsCountGZ(MetricsBytesOut, fpOutGZ);
 			gzclose(fpOutGZ);
 		}
 	}
@@ -209,6 +230,8 @@ int BfastBAFConvert(int argc, char *argv[])
 	free(readGroupFileName);
 	free(readGroup);
 	free(readGroupString);
+	MetricsFree();
+	free(metricsFileName);
 
 	fprintf(stderr, "Terminating successfully!\n");
 	return 0;
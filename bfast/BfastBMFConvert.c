@@ -5,11 +5,13 @@
 #include <zlib.h>
 #include <config.h>
 #include <unistd.h>
+#include <getopt.h>
 
 #include "RGMatches.h"
 #include "BLibDefinitions.h"
 #include "BError.h"
 #include "BLib.h"
+#include "Metrics.h"
 
 #define Name "bfast bmfconvert"
 #define BMFCONVERT_ROTATE_NUM 100000
@@ -25,6 +27,8 @@ int BfastBMFConvertUsage()
 				"\t\t\t\t0-BMF text to BMF binary\n"
 				"\t\t\t\t1-BMF binary to BMF text\n"
 				"\t\t\t\t2-BMF binary to FASTQ\n");
+		fprintf(stderr, "\t-J\t\twrite the time spent in each stage and the counters\n"
+				"\t\t\tas JSON to this file (also --metrics-json)\n");
 		fprintf(stderr, "\t-h\t\tprints this help message\n");
 		fprintf(stderr, "\nsend bugs to %s\n",
 				PACKAGE_BUGREPORT);
@@ -45,10 +49,17 @@ int BfastBMFConvert(int argc, char *argv[])
 	char *last;
 	RGMatches m;
 	char fileExtension[256]="\0";
+	char *metricsFileName=NULL;
+	int64_t startTime;
+	static struct option longOptions[]={
+		{"metrics-json", required_argument, 0, 'J'},
+		{0, 0, 0, 0}
+	};
 
 	// Get parameters
-	while((c = getopt(argc, argv, "O:h")) >= 0) {
+	while((c = getopt_long(argc, argv, "J:O:h", longOptions, NULL)) >= 0) {
 		switch(c) {
+			case 'J': free(metricsFileName); metricsFileName=strdup(optarg); break;
 			case 'O': outputType=atoi(optarg); break;
 			case 'h':
 					  BfastBMFConvertUsage(); return 1;
@@ -80,6 +91,7 @@ int BfastBMFConvert(int argc, char *argv[])
 				PrintError(Name, NULL, "Could not understand output type", Exit, OutOfRange);		
 		}		
 
+	MetricsInitialize("bmfconvert", metricsFileName);
 	for(argnum = optind; argnum < argc; argnum++) {
 
 		assert(argnum<argc);
@@ -126,6 +138,7 @@ int BfastBMFConvert(int argc, char *argv[])
 		counter = 0;
 		fprintf(stderr, "Input:%s\nOutput:%s\n", inputFileName, outputFileName);
 		fprintf(stderr, "Currently on:\n0");
+		startTime = MetricsStart();
 		/* Read in each match */
 		while((TextInput == binaryInput && EOF != RGMatchesReadText(fpIn, &m)) ||
 				(BinaryInput == binaryInput && EOF != RGMatchesRead(fpInGZ, &m))) {
@@ -152,22 +165,29 @@ int BfastBMFConvert(int argc, char *argv[])
 		}	
 		fprintf(stderr, "\r%lld\n", 
 				counter);
+		MetricsStop(MetricsFormat, startTime);
 		/* Close the input file */
 		if(TextInput == binaryInput) {
+			MetricsCountFile(MetricsBytesIn, fpIn);
 			fclose(fpIn);
 		}
 		else {
+			MetricsCountGZ(MetricsBytesIn, fpInGZ);
 			gzclose(fpInGZ);
 		}
 		/* Close the output file */
 		if(TextOutput == binaryOutput) {
+			MetricsCountFile(MetricsBytesOut, fpOut);
 			fclose(fpOut);
 		}
 		else {
+			MetricsCountGZ(MetricsBytesOut, fpOutGZ);
 			gzclose(fpOutGZ);
 		}
 		free(inputFileName);
 	}
+	MetricsFree();
+	free(metricsFileName);
 
 	fprintf(stderr, "Terminating successfully!\n");
 	return 0;
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
@@ -15,6 +16,7 @@
 #include "BError.h"
 #include "BLib.h"
 #include "BfastFasta2BRG.h"
+#include "Metrics.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
@@ -34,6 +36,8 @@ static struct argp_option options[] = {
 	{"space", 'A', "space", 0, "0: NT space 1: Color space", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 4},
@@ -41,7 +45,12 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"d:f:o:A:hpt";
+"d:f:o:A:J:hpt";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{0, 0, 0, 0}
+};
 
 	int
 BfastFasta2BRG(int argc, char **argv)
@@ -50,6 +59,7 @@ BfastFasta2BRG(int argc, char **argv)
 	RGBinary rg;
 	time_t startTime = time(NULL);
 	time_t endTime;
+	int64_t stageStart;
 
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
@@ -74,19 +84,26 @@ BfastFasta2BRG(int argc, char **argv)
 						PrintError("PrintError", NULL, "validating command-line inputs", Exit, InputArguments);
 					}
 					BfastFasta2BRGPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("fasta2brg", arguments.metricsFileName);
 
 					/* Read fasta files */
+					stageStart = MetricsStart();
 					RGBinaryRead(arguments.fastaFileName, 
 							&rg,
 							arguments.space);
+					MetricsStop(MetricsLoad, stageStart);
 					/* Write binary */
+					stageStart = MetricsStart();
 					RGBinaryWriteBinary(&rg,
 							arguments.space,
 							arguments.fastaFileName);
+					MetricsStop(MetricsWrite, stageStart);
 
 					/* Free the Reference Genome */
 					RGBinaryDelete(&rg);
 
+					MetricsFree();
+
 					if(arguments.timing == 1) {
 						/* Get the time information */
 						endTime = time(NULL);
@@ -157,6 +174,7 @@ BfastFasta2BRGAssignDefaultValues(struct arguments *args)
 	args->space = NTSpace;
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
 
 	return;
 }
@@ -172,6 +190,7 @@ BfastFasta2BRGPrintProgramParameters(FILE* fp, struct arguments *args)
 	fprintf(fp, "fastaFileName:\t\t\t\t%s\n", FILEREQUIRED(args->fastaFileName));
 	fprintf(fp, "space:\t\t\t\t\t%s\n", SPACE(args->space));
 	fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
+	fprintf(fp, "metricsFileName:\t\t\t%s\n", FILEUSING(args->metricsFileName));
 	fprintf(fp, BREAK_LINE);
 	return;
 }
@@ -181,6 +200,8 @@ void BfastFasta2BRGFreeProgramParameters(struct arguments *args)
 {
 	free(args->fastaFileName);
 	args->fastaFileName=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
 }
 
 /* TODO */
@@ -216,7 +237,7 @@ BfastFasta2BRGGetOptParse(int argc, char** argv, char OptionString[], struct arg
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
@@ -229,6 +250,8 @@ BfastFasta2BRGGetOptParse(int argc, char** argv, char OptionString[], struct arg
 				arguments->programMode=ExecutePrintProgramParameters; break;
 			case 't':
 				arguments->timing = 1; break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
 			case 'A':
 				arguments->space=atoi(optarg); break;
 			default:
@@ -7,6 +7,7 @@ struct arguments
 	char *fastaFileName;					/* -f */
 	int space;								/* -A */
 	int timing;                             /* -t */
+	char *metricsFileName;					/* -J */
 	int programMode;						/* -h */ 
 };
 
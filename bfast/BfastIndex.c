@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
@@ -12,9 +13,12 @@
 #include "RGBinary.h"
 #include "RGIndexLayout.h"
 #include "RGIndexExons.h"
+#include "RGIndex.h"
 #include "BError.h"
 #include "BLib.h"
+#include "ThreadPool.h"
 #include "BfastIndex.h"
+#include "Metrics.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
@@ -22,7 +26,7 @@
    */
 enum { 
 	DescInputFilesTitle, DescFastaFileName, DescIndexLayoutFileName,  
-	DescAlgoTitle, DescSpace, DescNumThreads, DescRepeatMasker, DescStartContig, DescStartPos, DescEndContig, DescEndPos, DescExonFileName, 
+	DescAlgoTitle, DescSpace, DescNumThreads, DescCpuAffinity, DescRepeatMasker, DescKeyFilter, DescStartContig, DescStartPos, DescEndContig, DescEndPos, DescExonFileName, 
 	DescOutputTitle, DescTmpDir, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -38,6 +42,8 @@ static struct argp_option options[] = {
 		"\n\t\t\t  4^d parts.", 2},
 	{"indexNumber", 'i', "indexNumber", 0, "Specifies this is the ith index you are creating", 2},
 	{"repeatMasker", 'R', 0, OPTION_NO_USAGE, "Specifies that lower case bases will be ignored", 2},
+	{"keyFilter", 'K', "keyFilter", 0, "Stores the keys with more than this number of matches so"
+		"\n\t\t\t  that bfast match can skip them quickly (Default 0, none)", 2},
 	{"startContig", 's', "startContig", 0, "Specifies the start contig", 2},
 	{"startPos", 'S', "startPos", 0, "Specifies the end position", 2},
 	{"endContig", 'e', "endContig", 0, "Specifies the end contig", 2},
@@ -45,9 +51,12 @@ static struct argp_option options[] = {
 	{"exonsFileName", 'x', "exonsFileName", 0, "Specifies the file name that specifies the exon-like ranges to"
 		"\n\t\t\t  include in the index", 2},
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"cpuAffinity", 'c', 0, OPTION_NO_USAGE, "Specifies to pin each thread to a CPU", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 4},
@@ -55,7 +64,12 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"d:e:f:i:m:n:s:w:x:A:E:S:T:hptR";
+"d:e:f:i:m:n:s:w:x:A:E:J:K:S:T:chptR";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{0, 0, 0, 0}
+};
 
 	int
 BfastIndex(int argc, char **argv)
@@ -89,6 +103,7 @@ BfastIndex(int argc, char **argv)
 						PrintError("PrintError", NULL, "validating command-line inputs", Exit, InputArguments);
 					}
 					BfastIndexPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("index", arguments.metricsFileName);
 
 					/* Read in the RGIndex layout */
 					RGIndexLayoutCreate(arguments.mask, 
@@ -102,6 +117,8 @@ BfastIndex(int argc, char **argv)
 					}
 
 					/* Generate the indexes */
+					ThreadPoolStart(arguments.numThreads, arguments.cpuAffinity);
+					RGIndexSetThreadRunner(ThreadPoolRun);
 					RGIndexCreate(arguments.fastaFileName,
 							&rgLayout,
 							arguments.space,
@@ -115,7 +132,10 @@ BfastIndex(int argc, char **argv)
 							arguments.numThreads,
 							arguments.repeatMasker,
 							0,
+							arguments.keyFilter,
 							arguments.tmpDir);
+					RGIndexSetThreadRunner(NULL);
+					ThreadPoolStop();
 
 					/* Free the RGIndex layout */
 					RGIndexLayoutDelete(&rgLayout);
@@ -129,6 +149,8 @@ BfastIndex(int argc, char **argv)
 						arguments.exonsFileName=NULL;
 					}
 
+					MetricsFree();
+
 					if(arguments.timing == 1) {
 						/* Get the time information */
 						endTime = time(NULL);
@@ -198,6 +220,9 @@ int BfastIndexValidateInputs(struct arguments *args) {
 	if(args->indexNumber <= 0) {
 		PrintError(FnName, "indexNumber", "Command line argument", Exit, OutOfRange);	
 	}	
+	if(args->keyFilter < 0) {
+		PrintError(FnName, "keyFilter", "Command line argument", Exit, OutOfRange);	
+	}	
 	if(args->startContig < 0) {		
 		PrintError(FnName, "startContig", "Command line argument", Exit, OutOfRange);
 	}
@@ -269,12 +294,14 @@ BfastIndexAssignDefaultValues(struct arguments *args)
 	args->depth=0;
 	args->indexNumber=1;
 	args->repeatMasker=0;
+	args->keyFilter=0;
 	args->startContig=0;
 	args->startPos=0;
 	args->endContig=INT_MAX;
 	args->endPos=INT_MAX;
 	args->exonsFileName = NULL;
 	args->numThreads = 1;
+	args->cpuAffinity = 0;
 
 	args->tmpDir =
 		(char*)malloc(sizeof(DEFAULT_OUTPUT_DIR));
@@ -282,6 +309,7 @@ BfastIndexAssignDefaultValues(struct arguments *args)
 	strcpy(args->tmpDir, DEFAULT_OUTPUT_DIR);
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
 
 	return;
 }
@@ -306,14 +334,17 @@ BfastIndexPrintProgramParameters(FILE* fp, struct arguments *args)
 	}
 	fprintf(fp, "indexNumber:\t\t\t\t%d\n", args->indexNumber);
 	fprintf(fp, "repeatMasker:\t\t\t\t%s\n", INTUSING(args->repeatMasker));
+	fprintf(fp, "keyFilter:\t\t\t\t%d\n", args->keyFilter);
 	fprintf(fp, "startContig:\t\t\t\t%d\n", args->startContig);
 	fprintf(fp, "startPos:\t\t\t\t%d\n", args->startPos);
 	fprintf(fp, "endContig:\t\t\t\t%d\n", args->endContig);
 	fprintf(fp, "endPos:\t\t\t\t\t%d\n", args->endPos);
 	fprintf(fp, "exonsFileName:\t\t\t\t%s\n", FILEUSING(args->exonsFileName));
 	fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
+	fprintf(fp, "cpuAffinity:\t\t\t\t%s\n", INTUSING(args->cpuAffinity));
 	fprintf(fp, "tmpDir:\t\t\t\t\t%s\n", args->tmpDir);
 	fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
+	fprintf(fp, "metricsFileName:\t\t\t%s\n", FILEUSING(args->metricsFileName));
 	fprintf(fp, BREAK_LINE);
 	return;
 }
@@ -329,6 +360,8 @@ void BfastIndexFreeProgramParameters(struct arguments *args)
 	args->exonsFileName=NULL;
 	free(args->tmpDir);
 	args->tmpDir=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
 }
 
 /* TODO */
@@ -364,11 +397,13 @@ BfastIndexGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
 		switch (key) {
+			case 'c':
+				arguments->cpuAffinity = 1;break;
 			case 'd':
 				arguments->depth=atoi(optarg);break;
 			case 'e':
@@ -389,6 +424,8 @@ BfastIndexGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->startContig=atoi(optarg);break;
 			case 't':
 				arguments->timing = 1;break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
 			case 'w':
 				arguments->hashWidth=atoi(optarg);break;
 			case 'x':
@@ -397,6 +434,8 @@ BfastIndexGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->space=atoi(optarg);break;
 			case 'E':
 				arguments->endPos=atoi(optarg);break;
+			case 'K':
+				arguments->keyFilter=atoi(optarg);break;
 			case 'R':
 				arguments->repeatMasker=1;break;
 			case 'S':
@@ -12,7 +12,9 @@ struct arguments
 	int depth;								/* -D */
 	int indexNumber;						/* -i */
 	int numThreads;                         /* -n */
+	int cpuAffinity;						/* -c */
 	int repeatMasker;						/* -R */
+	int keyFilter;							/* -K */
 	int startContig;						/* -s */
 	unsigned int startPos;					/* -S */
 	int endContig;							/* -e */
@@ -20,6 +22,7 @@ struct arguments
 	char *exonsFileName;					/* -x */
 	char *tmpDir;                           /* -T */
 	int timing;                             /* -t */
+	char *metricsFileName;					/* -J */
 	int programMode;						/* -h */ 
 };
 
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -12,7 +13,10 @@
 #include "RGBinary.h"
 #include "BLib.h"
 #include "RunLocalAlign.h"
+#include "ThreadPool.h"
 #include "BfastLocalAlign.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
@@ -20,7 +24,7 @@
    */
 enum { 
 	DescInputFilesTitle, DescFastaFileName, DescMatchFileName, DescScoringMatrixFileName, 
-	DescAlgoTitle, DescUngapped, DescUnconstrained, DescSpace, DescStartReadNum, DescEndReadNum, DescOffsetLength, DescMaxNumMatches, DescAvgMismatchQuality, DescNumThreads, DescQueueLength,
+	DescAlgoTitle, DescUngapped, DescUnconstrained, DescSpace, DescStartReadNum, DescEndReadNum, DescOffsetLength, DescMaxNumMatches, DescAvgMismatchQuality, DescNumThreads, DescCpuAffinity, DescQueueLength,
 	DescPairedEndOptionsTitle, DescPairedEndLength, DescMirroringType, DescForceMirroring, 
 	DescOutputTitle, DescTiming, 
 	DescMiscTitle, DescHelp
@@ -44,6 +48,7 @@ static struct argp_option options[] = {
 		"\n\t\t\t  alignment for a given match", 2},
 	{"avgMismatchQuality", 'q', "avgMismatchQuality", 0, "Specifies the average mismatch quality", 2},
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"cpuAffinity", 'c', 0, OPTION_NO_USAGE, "Specifies to pin each thread to a CPU", 2},
 	{"queueLength", 'Q', "queueLength", 0, "Specifies the number of reads to cache", 2},
 	/*
 	{0, 0, 0, 0, "=========== Paired End Options ======================================================", 3},
@@ -62,6 +67,11 @@ static struct argp_option options[] = {
 		*/
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 4},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 4},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 4},
+	{"traceJSON", 'Z', "traceFileName", 0, "Specifies to write the spans of the reading, searching or aligning,"
+		"\n\t\t\t waiting, merging and output of each thread as Chrome trace events"
+		"\n\t\t\t to this file (also --trace-json)", 4},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 5},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 5},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 5},
@@ -69,7 +79,13 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"e:f:m:n:o:q:s:x:A:M:Q:T:hptuU";
+"e:f:m:n:o:q:s:x:A:J:Z:M:Q:T:chptuU";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{"trace-json", required_argument, 0, 'Z'},
+	{0, 0, 0, 0}
+};
 //"e:f:l:m:n:o:q:s:x:A:L:M:Q:T:hptuFU";
 
 	int
@@ -105,8 +121,11 @@ BfastLocalAlign(int argc, char **argv)
 
 					}
 					BfastLocalAlignPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("localalign", arguments.metricsFileName);
+					TRACE_INITIALIZE("localalign", arguments.traceFileName);
 					/* Execute Program */
 					/* Run the aligner */
+					ThreadPoolStart(arguments.numThreads, arguments.cpuAffinity);
 					RunAligner(arguments.fastaFileName,
 							arguments.matchFileName,
 							arguments.scoringMatrixFileName,
@@ -127,6 +146,10 @@ BfastLocalAlign(int argc, char **argv)
 							arguments.forceMirroring,
 							arguments.timing,
 							stdout);
+					ThreadPoolStop();
+
+					MetricsFree();
+					TRACE_FREE();
 
 					if(arguments.timing == 1) {
 
@@ -254,6 +277,12 @@ int BfastLocalAlignValidateInputs(struct arguments *args) {
 		PrintError(FnName, "pairedEndLength", "Must specify a paired end length when using force mirroring", Exit, OutOfRange);	
 	}
 
+#ifdef DISABLE_TRACE
+	if(NULL != args->traceFileName) {
+		PrintError(FnName, "traceFileName", "The tracer was compiled out with --disable-trace", Exit, OutOfRange);
+	}
+#endif
+
 	return 1;
 }
 
@@ -277,6 +306,7 @@ BfastLocalAlignAssignDefaultValues(struct arguments *args)
 	args->maxNumMatches=MAX_NUM_MATCHES;
 	args->avgMismatchQuality=AVG_MISMATCH_QUALITY;
 	args->numThreads = 1;
+	args->cpuAffinity = 0;
 	args->queueLength = DEFAULT_LOCALALIGN_QUEUE_LENGTH;
 	args->usePairedEndLength = 0;
 	args->pairedEndLength = 0;
@@ -284,6 +314,8 @@ BfastLocalAlignAssignDefaultValues(struct arguments *args)
 	args->forceMirroring = 0;
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
+	args->traceFileName = NULL;
 
 	return;
 }
@@ -307,6 +339,7 @@ BfastLocalAlignPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "maxNumMatches:\t\t\t\t%d\n", args->maxNumMatches);
 		fprintf(fp, "avgMismatchQuality:\t\t\t%d\n", args->avgMismatchQuality); 
 		fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
+		fprintf(fp, "cpuAffinity:\t\t\t\t%s\n", INTUSING(args->cpuAffinity));
 		fprintf(fp, "queueLength:\t\t\t\t%d\n", args->queueLength);
 		/*
 		if(1 == args->usePairedEndLength) fprintf(fp, "pairedEndLength:\t\t\t%d\n", args->pairedEndLength);
@@ -315,6 +348,8 @@ BfastLocalAlignPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "forceMirroring:\t\t\t\t%s\n", INTUSING(args->forceMirroring));
 		*/
 		fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
+		fprintf(fp, "metricsFileName:\t\t\t%s\n", FILEUSING(args->metricsFileName));
+		fprintf(fp, "traceFileName:\t\t\t\t%s\n", FILEUSING(args->traceFileName));
 		fprintf(fp, BREAK_LINE);
 	}
 	return;
@@ -330,6 +365,10 @@ void BfastLocalAlignFreeProgramParameters(struct arguments *args)
 	args->matchFileName=NULL;
 	free(args->scoringMatrixFileName);
 	args->scoringMatrixFileName=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
+	free(args->traceFileName);
+	args->traceFileName=NULL;
 }
 
 void
@@ -361,11 +400,13 @@ BfastLocalAlignGetOptParse(int argc, char** argv, char OptionString[], struct ar
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
 		switch (key) {
+			case 'c':
+				arguments->cpuAffinity = 1;break;
 			case 'e':
 				arguments->endReadNum=atoi(optarg);break;
 			case 'f':
@@ -391,6 +432,10 @@ BfastLocalAlignGetOptParse(int argc, char** argv, char OptionString[], struct ar
 				arguments->startReadNum=atoi(optarg);break;
 			case 't':
 				arguments->timing = 1;break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
+			case 'Z':
+				arguments->traceFileName = strdup(optarg); break;
 			case 'u':
 				arguments->ungapped = Ungapped; break;
 			case 'x':
@@ -17,12 +17,15 @@ struct arguments
 	int maxNumMatches;						/* -M */
 	int avgMismatchQuality;					/* -q */
 	int numThreads;                         /* -n */
+	int cpuAffinity;						/* -c */
 	int queueLength;                        /* -Q */
 	int usePairedEndLength;					/* -l - companion to pairedEndLength */
 	int mirroringType;						/* -L */
 	int forceMirroring;						/* -f */
 	int pairedEndLength;					/* -l */
 	int timing;                             /* -t */
+	char *metricsFileName;					/* -J */
+	char *traceFileName;					/* -Z */
 	int programMode;						/* -h */ 
 };
 
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
@@ -12,20 +13,24 @@
 #include "BLib.h"
 #include "RunMatch.h"
 #include "aflib.h"
+#include "ThreadPool.h"
+#include "Numa.h"
 #include "BfastMatch.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
    Order of fields: {NAME, KEY, ARG, FLAGS, DOC, OPTIONAL_GROUP_NAME}.
    */
 enum { 
-	DescInputFilesTitle, DescFastaFileName, DescMainIndexes, DescSecondaryIndexes, DescReadsFileName, DescOffsets,  DescLoadAllIndexes, 
+	DescInputFilesTitle, DescFastaFileName, DescMainIndexes, DescSecondaryIndexes, DescReadsFileName, DescOffsets,  DescLoadAllIndexes, DescPackIndexes, 
 #ifndef DISABLE_BZLIB
 	DescCompressionBZ2, 
 #endif
 	DescCompressionGZ,
 	DescAlgoTitle, DescSpace, DescStartReadNum, DescEndReadNum, 
-	DescKeySize, DescMaxKeyMatches, DescMaxTotalMatches, DescWhichStrand, DescNumThreads, DescQueueLength, 
+	DescKeySize, DescMaxKeyMatches, DescMaxTotalMatches, DescWhichStrand, DescCascadeCandidates, DescCascadeCoverage, DescNumThreads, DescCpuAffinity, DescNumaMode, DescPrefetchMemory, DescQueueLength, 
 	DescOutputTitle, DescTmpDir, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -39,6 +44,8 @@ static struct argp_option options[] = {
 	{"readsFileName", 'r', "readsFileName", 0, "Specifies the file name for the reads (FASTQ format)", 1}, 
 	{"offsets", 'o', "offsets", 0, "Specifies the offsets", 1},
 	{"loadAllIndexes", 'l', "loadAllIndexes", 0, "Specifies to load all main or secondary indexes into memory", 1},
+	{"packIndexes", 'B', 0, OPTION_NO_USAGE, "Specifies to bit pack the contigs and positions of the indexes"
+		"\n\t\t\t\t  to use less memory", 1},
 #ifndef DISABLE_BZLIB
 	{"bz2", 'j', "bz2", 0, "Specifies that the input reads are bz2 compressed (bzip2)", 1},
 #endif
@@ -58,11 +65,27 @@ static struct argp_option options[] = {
 		"\n\t\t\t before the read is discarded", 2},
 	{"whichStrand", 'w', "whichStrand", 0, "0: consider both strands 1: forward strand only 2: reverse"
 		"\n\t\t\t strand only", 2},
+	{"cascadeCandidates", 'C', "cascadeCandidates", 0, "Specifies to not search a read with the remaining indexes"
+		"\n\t\t\t once each end has at most this many matches (0: search"
+		"\n\t\t\t all indexes).  Cannot be used with -l", 2},
+	{"cascadeCoverage", 'D', "cascadeCoverage", 0, "Specifies the percent of the read each of these matches"
+		"\n\t\t\t must cover with matching keys (Default 50)", 2},
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"cpuAffinity", 'c', 0, OPTION_NO_USAGE, "Specifies to pin each thread to a CPU", 2},
+	{"numaMode", 'N', "numaMode", 0, "0: no NUMA placement 1: copy the index and reference to each"
+		"\n\t\t\t NUMA node 2: interleave them over the NUMA nodes", 2},
+	{"prefetchMemory", 'P', "prefetchMemory", 0, "Specifies the memory in megabytes two indexes may use, so"
+		"\n\t\t\t that the next index is loaded while searching (0: never"
+		"\n\t\t\t -1: if it fits in the free memory)", 2},
 	{"queueLength", 'Q', "queueLength", 0, "Specifies the number of reads to cache", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 3},
+	{"traceJSON", 'Z', "traceFileName", 0, "Specifies to write the spans of the reading, searching or aligning,"
+		"\n\t\t\t waiting, merging and output of each thread as Chrome trace events"
+		"\n\t\t\t to this file (also --trace-json)", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 4},
@@ -71,9 +94,15 @@ static struct argp_option options[] = {
 
 static char OptionString[]=
 #ifndef DISABLE_BZLIB
-"e:f:i:k:m:n:o:r:s:w:A:I:K:F:M:Q:T:hjlptz";
+"e:f:i:k:m:n:o:r:s:w:A:I:C:D:J:Z:K:F:M:N:P:Q:T:Bchjlptz";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{"trace-json", required_argument, 0, 'Z'},
+	{0, 0, 0, 0}
+};
 #else
-"e:f:i:k:m:n:o:r:s:w:A:I:K:M:Q:T:hlptz";
+"e:f:i:k:m:n:o:r:s:w:A:I:C:D:J:Z:K:M:N:P:Q:T:Bchlptz";
 #endif
 
 	int
@@ -109,9 +138,13 @@ BfastMatch(int argc, char **argv)
 
 					}
 					BfastMatchPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("match", arguments.metricsFileName);
+					TRACE_INITIALIZE("match", arguments.traceFileName);
 					/* Execute Program */
 
 					/* Run Matches */
+					ThreadPoolStart(arguments.numThreads, arguments.cpuAffinity);
+					NumaInitialize(arguments.numaMode, arguments.numThreads);
 					RunMatch(
 							arguments.fastaFileName,
 							arguments.mainIndexes,
@@ -119,6 +152,10 @@ BfastMatch(int argc, char **argv)
 							arguments.readsFileName,
 							arguments.offsets,
 							arguments.loadAllIndexes,
+							arguments.packIndexes,
+							arguments.prefetchMemory,
+							arguments.cascadeCandidates,
+							arguments.cascadeCoverage,
 							arguments.compression,
 							arguments.space,
 							arguments.startReadNum,
@@ -133,6 +170,11 @@ BfastMatch(int argc, char **argv)
 							arguments.tmpDir,
 							arguments.timing,
 							stdout);
+					NumaFree();
+					ThreadPoolStop();
+
+					MetricsFree();
+					TRACE_FREE();
 
 					if(arguments.timing == 1) {
 						endTime = time(NULL);
@@ -232,6 +274,26 @@ int BfastMatchValidateInputs(struct arguments *args) {
 	if(args->numThreads<=0) {		
 		PrintError(FnName, "numThreads", "Command line argument", Exit, OutOfRange);
 	} 
+	if(!(args->numaMode == NumaNone ||
+				args->numaMode == NumaReplicate ||
+				args->numaMode == NumaInterleave)) {
+		PrintError(FnName, "numaMode", "Command line argument", Exit, OutOfRange);
+	}
+
+	if(args->cascadeCandidates < 0) {
+		PrintError(FnName, "cascadeCandidates", "Command line argument", Exit, OutOfRange);
+	}
+	if(0 < args->cascadeCandidates && IndexesMemoryAll == args->loadAllIndexes) {
+		PrintError(FnName, "cascadeCandidates", "Cannot be used when loading all indexes into memory (-l)", Exit, OutOfRange);
+	}
+
+	if(args->cascadeCoverage < 0 || 100 < args->cascadeCoverage) {
+		PrintError(FnName, "cascadeCoverage", "Command line argument", Exit, OutOfRange);
+	}
+
+	if(args->prefetchMemory < PREFETCH_MEMORY_AVAILABLE) {
+		PrintError(FnName, "prefetchMemory", "Command line argument", Exit, OutOfRange);
+	}
 
 	if(args->queueLength<=0) {
 		PrintError(FnName, "queueLength", "Command line argument", Exit, OutOfRange);	
@@ -247,6 +309,13 @@ int BfastMatchValidateInputs(struct arguments *args) {
 	/* If this does not hold, we have done something wrong internally */	
 	assert(args->timing == 0 || args->timing == 1);
 	assert(IndexesMemorySerial == args->loadAllIndexes || IndexesMemoryAll == args->loadAllIndexes);
+	assert(0 == args->packIndexes || 1 == args->packIndexes);
+
+#ifdef DISABLE_TRACE
+	if(NULL != args->traceFileName) {
+		PrintError(FnName, "traceFileName", "The tracer was compiled out with --disable-trace", Exit, OutOfRange);
+	}
+#endif
 
 	return 1;
 }
@@ -266,6 +335,7 @@ BfastMatchAssignDefaultValues(struct arguments *args)
 	args->readsFileName = NULL;
 	args->offsets = NULL;
 	args->loadAllIndexes = IndexesMemorySerial;
+	args->packIndexes = 0;
 	args->compression = AFILE_NO_COMPRESSION;
 
 	args->space = NTSpace;
@@ -277,7 +347,12 @@ BfastMatchAssignDefaultValues(struct arguments *args)
 	args->keyMissFraction = MAX_KEY_MISS_FRACTION;
 	args->maxNumMatches = MAX_NUM_MATCHES;
 	args->whichStrand = BothStrands;
+	args->cascadeCandidates = 0;
+	args->cascadeCoverage = DEFAULT_CASCADE_COVERAGE;
 	args->numThreads = 1;
+	args->cpuAffinity = 0;
+	args->numaMode = NumaNone;
+	args->prefetchMemory = PREFETCH_MEMORY_AVAILABLE;
 	args->queueLength = DEFAULT_MATCHES_QUEUE_LENGTH;
 
 	args->tmpDir =
@@ -286,6 +361,8 @@ BfastMatchAssignDefaultValues(struct arguments *args)
 	strcpy(args->tmpDir, DEFAULT_OUTPUT_DIR);
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
+	args->traceFileName = NULL;
 
 	return;
 }
@@ -304,6 +381,7 @@ BfastMatchPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "readsFileName:\t\t\t\t%s\n", FILESTDIN(args->readsFileName));
 		fprintf(fp, "offsets:\t\t\t\t%s\n", (NULL == args->offsets) ? "[Using All]" : args->offsets);
 		fprintf(fp, "loadAllIndexes:\t\t\t\t%s\n", INTUSING(args->loadAllIndexes));
+		fprintf(fp, "packIndexes:\t\t\t\t%s\n", INTUSING(args->packIndexes));
 		fprintf(fp, "compression:\t\t\t\t%s\n", COMPRESSION(args->compression));
 		fprintf(fp, "space:\t\t\t\t\t%s\n", SPACE(args->space));
 		fprintf(fp, "startReadNum:\t\t\t\t%d\n", args->startReadNum);
@@ -314,10 +392,17 @@ BfastMatchPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "keyMissFraction:\t\t\t%lf\n", args->keyMissFraction);
 		fprintf(fp, "maxNumMatches:\t\t\t\t%d\n", args->maxNumMatches);
 		fprintf(fp, "whichStrand:\t\t\t\t%s\n", WHICHSTRAND(args->whichStrand));
+		fprintf(fp, "cascadeCandidates:\t\t\t%d\n", args->cascadeCandidates);
+		fprintf(fp, "cascadeCoverage:\t\t\t%d\n", args->cascadeCoverage);
 		fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
+		fprintf(fp, "cpuAffinity:\t\t\t\t%s\n", INTUSING(args->cpuAffinity));
+		fprintf(fp, "numaMode:\t\t\t\t%s\n", NUMAMODE(args->numaMode));
+		fprintf(fp, "prefetchMemory:\t\t\t\t%d\n", args->prefetchMemory);
 		fprintf(fp, "queueLength:\t\t\t\t%d\n", args->queueLength);
 		fprintf(fp, "tmpDir:\t\t\t\t\t%s\n", args->tmpDir);
 		fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
+		fprintf(fp, "metricsFileName:\t\t\t%s\n", FILEUSING(args->metricsFileName));
+		fprintf(fp, "traceFileName:\t\t\t\t%s\n", FILEUSING(args->traceFileName));
 		fprintf(fp, BREAK_LINE);
 	}
 	return;
@@ -338,6 +423,10 @@ void BfastMatchFreeProgramParameters(struct arguments *args)
 	args->offsets=NULL;
 	free(args->tmpDir);
 	args->tmpDir=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
+	free(args->traceFileName);
+	args->traceFileName=NULL;
 }
 
 /* TODO */
@@ -372,11 +461,13 @@ BfastMatchGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
 		switch (key) {
+			case 'c':
+				arguments->cpuAffinity = 1;break;
 			case 'e':
 				arguments->endReadNum = atoi(optarg); break;
 			case 'f':
@@ -405,6 +496,10 @@ BfastMatchGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->startReadNum = atoi(optarg); break;
 			case 't':
 				arguments->timing = 1; break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
+			case 'Z':
+				arguments->traceFileName = strdup(optarg); break;
 			case 'w':
 				arguments->whichStrand = atoi(optarg); break;
 			case 'z':
@@ -419,6 +514,16 @@ BfastMatchGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->keyMissFraction=atof(optarg); break;
 			case 'M':
 				arguments->maxNumMatches=atoi(optarg); break;
+			case 'B':
+				arguments->packIndexes = 1; break;
+			case 'C':
+				arguments->cascadeCandidates=atoi(optarg); break;
+			case 'D':
+				arguments->cascadeCoverage=atoi(optarg); break;
+			case 'N':
+				arguments->numaMode=atoi(optarg); break;
+			case 'P':
+				arguments->prefetchMemory=atoi(optarg); break;
 			case 'Q':
 				arguments->queueLength=atoi(optarg); break;
 			case 'T':
@@ -13,6 +13,8 @@ struct arguments
 	char *readsFileName;					/* -r */
 	char *offsets;							/* -o */
 	int loadAllIndexes;						/* -l */
+	int packIndexes;						/* -B */
+	int prefetchMemory;						/* -P */
 	int compression;						/* -j, -z */ 
 	int space;								/* -A */
 	int startReadNum;						/* -s */
@@ -22,10 +24,16 @@ struct arguments
         double keyMissFraction;                                         /* -F */
 	int maxNumMatches;						/* -M */
 	int whichStrand;						/* -w */
+	int cascadeCandidates;					/* -C */
+	int cascadeCoverage;					/* -D */
 	int numThreads;							/* -n */
+	int cpuAffinity;						/* -c */
+	int numaMode;							/* -N */
 	int queueLength;						/* -Q */
 	char *tmpDir;							/* -T */
 	int timing;								/* -t */
+	char *metricsFileName;					/* -J */
+	char *traceFileName;					/* -Z */
 	int programMode;						/* -h */ 
 };
 
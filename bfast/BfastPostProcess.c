@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <config.h>
+#include <getopt.h>
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
@@ -12,7 +13,10 @@
 #include "BLibDefinitions.h"
 #include "BLib.h"
 #include "RunPostProcess.h"
+#include "ThreadPool.h"
 #include "BfastPostProcess.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 /*
    OPTIONS.  Field 1 in ARGP.
@@ -22,7 +26,7 @@ enum {
 	DescInputFilesTitle, DescFastaFileName, DescInputFileName, 
 	DescAlgoTitle, DescAlgorithm, DescSpace, DescStrandedness, DescPositioning, DescPairing, DescAvgMismatchQuality, 
 	DescScoringMatrixFileName, DescRandomBest, DescMinimumMappingQuality, DescMinimumNormalizedScore,  
-	DescNumThreads, DescQueueLength, 
+	DescNumThreads, DescCpuAffinity, DescQueueLength, 
 	DescOutputTitle, DescOutputFormat, DescOutputID, DescRGFileName, DescBaseQualityType, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -63,6 +67,7 @@ static struct argp_option options[] = {
 	{"insertSizeAvg", 'v', "insertSizeAvg", 0, "Specifies the mean insert size to use when pairing", 2}, 
 	{"insertSizeStdDev", 's', "insertSizeStdDev", 0, "Specifies the standard deviation of the insert size to use when pairing", 2}, 
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"cpuAffinity", 'c', 0, OPTION_NO_USAGE, "Specifies to pin each thread to a CPU", 2},
 	{"queueLength", 'Q', "queueLength", 0, "Specifies the number of reads to cache", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"outputFormat", 'O', "outputFormat", 0, "Specifies the output format 0: BAF 1: SAM", 3},
@@ -77,6 +82,11 @@ static struct argp_option options[] = {
 			"\n\t\t\t  3: Nullify (if either are an error, base quality is zero)",
                         3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
+	{"metricsJSON", 'J', "metricsFileName", 0, "Specifies to write the time spent in each stage and the counters"
+		"\n\t\t\t of each thread as JSON to this file (also --metrics-json)", 3},
+	{"traceJSON", 'Z', "traceFileName", 0, "Specifies to write the spans of the reading, searching or aligning,"
+		"\n\t\t\t waiting, merging and output of each thread as Chrome trace events"
+		"\n\t\t\t to this file (also --trace-json)", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
 	{"Help", 'h', 0, OPTION_NO_USAGE, "Display usage summary", 4},
@@ -84,7 +94,13 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"a:b:i:f:m:n:o:q:r:s:v:x:A:M:O:P:S:Y:Q:hptzRU";
+"a:b:i:f:m:n:o:q:r:s:v:x:A:J:Z:M:O:P:S:Y:Q:chptzRU";
+
+static struct option LongOptions[]={
+	{"metrics-json", required_argument, 0, 'J'},
+	{"trace-json", required_argument, 0, 'Z'},
+	{0, 0, 0, 0}
+};
 
 	int
 BfastPostProcess(int argc, char **argv)
@@ -92,6 +108,7 @@ BfastPostProcess(int argc, char **argv)
 	struct arguments arguments;
 	time_t startTime = time(NULL);
 	time_t endTime;
+	int64_t stageStart;
 	RGBinary rg;
 	char *readGroup=NULL;
 
@@ -120,16 +137,21 @@ BfastPostProcess(int argc, char **argv)
 						PrintError("PrintError", NULL, "validating command-line inputs", Exit, InputArguments);
 					}
 					BfastPostProcessPrintProgramParameters(stderr, &arguments);
+					MetricsInitialize("postprocess", arguments.metricsFileName);
+					TRACE_INITIALIZE("postprocess", arguments.traceFileName);
 					/* Execute program */
 					if(BAF != arguments.outputFormat) {
 						/* Read binary */
+						stageStart = MetricsStart();
 						RGBinaryReadBinary(&rg,
 								NTSpace,
 								arguments.fastaFileName);
+						MetricsStop(MetricsLoad, stageStart);
 						if(SAM == arguments.outputFormat && NULL != arguments.RGFileName) {
 							readGroup = ReadInReadGroup(arguments.RGFileName);
 						}
 					}
+					ThreadPoolStart(arguments.numThreads, arguments.cpuAffinity);
 					ReadInputFilterAndOutput(&rg,
 							arguments.alignFileName,
 							arguments.algorithm,
@@ -152,6 +174,7 @@ BfastPostProcess(int argc, char **argv)
 							readGroup,
                                                         arguments.baseQualityType,
 							stdout);
+					ThreadPoolStop();
 					if(BAF != arguments.outputFormat) {
 						/* Free rg binary */
 						RGBinaryDelete(&rg);
@@ -159,6 +182,9 @@ BfastPostProcess(int argc, char **argv)
 							free(readGroup);
 						}
 					}
+					MetricsFree();
+					TRACE_FREE();
+
 					if(arguments.timing == 1) {
 						/* Get the time information */
 						endTime = time(NULL);
@@ -307,6 +333,12 @@ int BfastPostProcessValidateInputs(struct arguments *args) {
 		}
 	}
 
+#ifdef DISABLE_TRACE
+	if(NULL != args->traceFileName) {
+		PrintError(FnName, "traceFileName", "The tracer was compiled out with --disable-trace", Exit, OutOfRange);
+	}
+#endif
+
 	return 1;
 }
 
@@ -335,6 +367,7 @@ BfastPostProcessAssignDefaultValues(struct arguments *args)
 	args->insertSizeStdDev=0.0;
 	args->avgMismatchQuality=AVG_MISMATCH_QUALITY;
 	args->numThreads=1;
+	args->cpuAffinity = 0;
 	args->queueLength=DEFAULT_POSTPROCESS_QUEUE_LENGTH;
 
 	args->outputFormat=SAM;
@@ -343,6 +376,8 @@ BfastPostProcessAssignDefaultValues(struct arguments *args)
         args->baseQualityType=0;
 
 	args->timing = 0;
+	args->metricsFileName = NULL;
+	args->traceFileName = NULL;
 
 	return;
 }
@@ -382,12 +417,15 @@ BfastPostProcessPrintProgramParameters(FILE* fp, struct arguments *args)
 			fprintf(fp, "insertSizeStdDev:\t\t%s\n", INTUSING(0));
                 }
 		fprintf(fp, "numThreads:\t\t\t%d\n", args->numThreads);
+		fprintf(fp, "cpuAffinity:\t\t\t%s\n", INTUSING(args->cpuAffinity));
 		fprintf(fp, "queueLength:\t\t\t%d\n", args->queueLength);
 		fprintf(fp, "outputFormat:\t\t\t%s\n", outputType[args->outputFormat]);
 		fprintf(fp, "outputID:\t\t\t%s\n", FILEUSING(args->outputID));
 		fprintf(fp, "RGFileName:\t\t\t%s\n", FILEUSING(args->RGFileName));
 		fprintf(fp, "baseQualityType:\t\t\t%s\n", baseQualityType[args->baseQualityType]);
 		fprintf(fp, "timing:\t\t\t\t%s\n", INTUSING(args->timing));
+		fprintf(fp, "metricsFileName:\t\t%s\n", FILEUSING(args->metricsFileName));
+		fprintf(fp, "traceFileName:\t\t\t%s\n", FILEUSING(args->traceFileName));
 		fprintf(fp, BREAK_LINE);
 	}
 	return;
@@ -406,6 +444,10 @@ void BfastPostProcessFreeProgramParameters(struct arguments *args)
 	args->RGFileName=NULL;
 	free(args->scoringMatrixFileName);
 	args->scoringMatrixFileName=NULL;
+	free(args->metricsFileName);
+	args->metricsFileName=NULL;
+	free(args->traceFileName);
+	args->traceFileName=NULL;
 }
 
 /* TODO */
@@ -440,7 +482,7 @@ BfastPostProcessGetOptParse(int argc, char** argv, char OptionString[], struct a
 {
 	int key;
 	int OptErr=0;
-	while((OptErr==0) && ((key = getopt (argc, argv, OptionString)) != -1)) {
+	while((OptErr==0) && ((key = getopt_long(argc, argv, OptionString, LongOptions, NULL)) != -1)) {
 		/*
 		   fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 		   */
@@ -449,6 +491,8 @@ BfastPostProcessGetOptParse(int argc, char** argv, char OptionString[], struct a
 				arguments->algorithm = atoi(optarg);break;
                         case 'b':
                                 arguments->baseQualityType = atoi(optarg);break;
+			case 'c':
+				arguments->cpuAffinity = 1;break;
 			case 'f':
 				arguments->fastaFileName=strdup(optarg);break;
 			case 'h':
@@ -475,6 +519,10 @@ BfastPostProcessGetOptParse(int argc, char** argv, char OptionString[], struct a
 				arguments->insertSizeAvg=atof(optarg);break;
 			case 't':
 				arguments->timing = 1; break;
+			case 'J':
+				arguments->metricsFileName = strdup(optarg); break;
+			case 'Z':
+				arguments->traceFileName = strdup(optarg); break;
 			case 'x':
 				StringCopyAndReallocate(&arguments->scoringMatrixFileName, optarg);
 				break;
@@ -24,12 +24,15 @@ struct arguments
 	double insertSizeAvg;						/* -v */
 	double insertSizeStdDev;					/* -s */
 	int numThreads;							/* -n */
+	int cpuAffinity;						/* -c */
 	int queueLength;						/* -Q */
 	int outputFormat;						/* -O */
 	char *outputID;							/* -o */
 	char *RGFileName;						/* -r */
 	int baseQualityType;						/* -b */
 	int timing;                             /* -t */
+	char *metricsFileName;					/* -J */
+	char *traceFileName;					/* -Z */
 	int programMode;						/* -h */ 
 };
 
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <time.h>
 #include <zlib.h>
+#include <limits.h>
 #include "BError.h"
 #include "BLib.h"
 #include "RGMatch.h"
@@ -101,6 +102,109 @@ static void kseq_AppendToRGMatches(RGMatches *m,
 	strcpy(m->ends[m->numEnds-1].qual, seq->qual.s);
 }
 
+/* TODO */
+/* Parses the reads directly from a FASTQ file.  If copyFP is not NULL,
+ * the reads returned are also copied there for later index passes. */
+void ReadsStreamInitialize(ReadsStream *s,
+		AFILE *seqFP,
+		int startReadNum,
+		int endReadNum,
+		int32_t space,
+		gzFile copyFP)
+{
+	s->seqFP = seqFP;
+	s->seq = (NULL == seqFP) ? NULL : kseq_init(seqFP);
+	s->tmpSeqFP = NULL;
+	RGMatchesInitialize(&s->pending);
+	s->startReadNum = startReadNum;
+	s->endReadNum = endReadNum;
+	s->curReadNum = 1;
+	s->space = space;
+	s->copyFP = copyFP;
+	s->numRead = 0;
+	s->eof = 0;
+}
+
+/* TODO */
+/* Reads back the reads from a temporary file */
+void ReadsStreamInitializeTmp(ReadsStream *s,
+		gzFile tmpSeqFP,
+		int32_t space)
+{
+	ReadsStreamInitialize(s, NULL, 0, INT_MAX, space, NULL);
+	s->tmpSeqFP = tmpSeqFP;
+}
+
+/* TODO */
+void ReadsStreamFree(ReadsStream *s)
+{
+	if(NULL != s->seq) {
+		kseq_destroy((kseq_t*)s->seq);
+	}
+	RGMatchesFree(&s->pending);
+	s->seq = NULL;
+}
+
+/* Gets the next read, whose ends are the consecutive records with the 
+ * same name */
+static int ReadsStreamGetNextFASTQ(ReadsStream *s, RGMatches *m)
+{
+	kseq_t *seq = (kseq_t*)s->seq;
+
+	while(0 == s->eof) {
+		if(kseq_read(seq, s->space) < 0) {
+			s->eof = 1;
+		}
+		else if(0 == s->pending.numEnds || 0 == strcmp(s->pending.readName, seq->name.s)) {
+			// append
+			kseq_AppendToRGMatches(&s->pending, seq);
+		}
+		else {
+			// return the previous and start a new one
+			(*m) = s->pending;
+			RGMatchesInitialize(&s->pending);
+			kseq_AppendToRGMatches(&s->pending, seq);
+			return 1;
+		}
+	}
+	if(0 < s->pending.numEnds) {
+		(*m) = s->pending;
+		RGMatchesInitialize(&s->pending);
+		return 1;
+	}
+	return EOF;
+}
+
+/* TODO */
+/* Returns the number of reads read, up to maxToRead */
+int32_t ReadsStreamGetReads(ReadsStream *s, RGMatches *m, int32_t maxToRead)
+{
+	int32_t numRead = 0;
+
+	if(NULL != s->tmpSeqFP) {
+		numRead = GetReads(s->tmpSeqFP, m, maxToRead, s->space);
+		s->numRead += numRead;
+		return numRead;
+	}
+
+	while(numRead < maxToRead && s->curReadNum <= s->endReadNum) {
+		RGMatchesInitialize(&(m[numRead]));
+		if(EOF == ReadsStreamGetNextFASTQ(s, &(m[numRead]))) break;
+		if(s->startReadNum <= s->curReadNum) {
+			if(NULL != s->copyFP) {
+				RGMatchesPrint(s->copyFP, &(m[numRead]));
+			}
+			numRead++;
+		}
+		else {
+			RGMatchesFree(&(m[numRead]));
+		}
+		s->curReadNum++;
+	}
+	s->numRead += numRead;
+	return numRead;
+}
+
 /* TODO */
 void WriteReadsToTempFile(AFILE *seqFP,
 		gzFile *tmpSeqFP, 
@@ -111,53 +215,26 @@ void WriteReadsToTempFile(AFILE *seqFP,
 		int *numWritten,
 		int32_t space)
 {
-	int curReadNum = 1;
-	RGMatches m;
-	kseq_t *seq=NULL;
+	int32_t i, numRead;
+	RGMatches m[READS_STREAM_BATCH_SIZE];
+	ReadsStream s;
 
 	// Open temporary file
 	(*tmpSeqFP) = OpenTmpGZFile(tmpDir, tmpSeqFileName);
 
-	seq = kseq_init(seqFP);
-	RGMatchesInitialize(&m);
-	(*numWritten)=0;
-	curReadNum=1;
-	while(0 <= kseq_read(seq, space)) {
-		// compare with previous
-		if(0 == m.numEnds || 0 == strcmp(m.readName, seq->name.s)) {
-			// append
-			kseq_AppendToRGMatches(&m, seq);
-		}
-		else {
-			// print
-			if(startReadNum <= curReadNum && curReadNum <= endReadNum) {
-				RGMatchesPrint((*tmpSeqFP), &m);
-				(*numWritten)++;
-			}
-			curReadNum++;
-
-			// make new
-			RGMatchesFree(&m);
-			RGMatchesInitialize(&m);
-			kseq_AppendToRGMatches(&m, seq);
+	ReadsStreamInitialize(&s, seqFP, startReadNum, endReadNum, space, (*tmpSeqFP));
+	while(0 < (numRead = ReadsStreamGetReads(&s, m, READS_STREAM_BATCH_SIZE))) {
+		for(i=0;i<numRead;i++) {
+			RGMatchesFree(&m[i]);
 		}
 	}
-	if(0 < m.numEnds) {
-		if(startReadNum <= curReadNum && curReadNum <= endReadNum) {
-			RGMatchesPrint((*tmpSeqFP), &m);
-			(*numWritten)++;
-		}
-		curReadNum++;
-
-		// make new
-		RGMatchesFree(&m);
-	}
+	(*numWritten) = s.numRead;
 
 	/* reset pointer to temp files to the beginning of the file */
 	ReopenTmpGZFile(tmpSeqFP, tmpSeqFileName);
 
 	// destroy
-	kseq_destroy(seq);
+	ReadsStreamFree(&s);
 }
 
 /* TODO */
@@ -165,7 +242,7 @@ void WriteReadsToTempFile(AFILE *seqFP,
  * at least one match to the final output file.  For those reads that have
  * zero matches, output them to the temporary read file *
  * */
-int ReadTempReadsAndOutput(gzFile tempOutputFP,
+int ReadTempReadsAndOutput(gzFile *tempOutputFP,
 		char *tempOutputFileName,
 		gzFile outputFP,
 		AFILE *tempRGMatchesFP)
@@ -181,10 +258,10 @@ int ReadTempReadsAndOutput(gzFile tempOutputFP,
 	RGMatchesInitialize(&m);
 
 	/* Go to the beginning of the temporary output file */
-	ReopenTmpGZFile(&tempOutputFP,
+	ReopenTmpGZFile(tempOutputFP,
 			&tempOutputFileName);
 
-	while(RGMatchesRead(tempOutputFP, 
+	while(RGMatchesRead((*tempOutputFP), 
 				&m)!=EOF) {
 		/* Output if any end has more than one entry */
 		for(i=hasEntries=0;0==hasEntries && i<m.numEnds;i++) {
@@ -212,7 +289,7 @@ int ReadTempReadsAndOutput(gzFile tempOutputFP,
 	return numReads;
 }
 
-void ReadRGIndex(char *rgIndexFileName, RGIndex *index, int space)
+void ReadRGIndex(char *rgIndexFileName, RGIndex *index, int space, int packIndexes)
 {
 
 	/* Read from file */
@@ -221,6 +298,10 @@ void ReadRGIndex(char *rgIndexFileName, RGIndex *index, int space)
 	if(index->space != space) {
 		PrintError("space", rgIndexFileName, "The index has a different space parity than specified", Exit, OutOfRange);
 	}
+
+	if(1 == packIndexes) {
+		RGIndexPack(index);
+	}
 }
 
 /* TODO */
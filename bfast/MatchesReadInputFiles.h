@@ -7,11 +7,31 @@
 #include "RGIndex.h"
 #include "aflib.h"
 
+/* Reads that are read in, either parsed from a FASTQ file or read back 
+ * from a temporary file */
+typedef struct {
+	AFILE *seqFP;
+	void *seq; /* kseq_t */
+	gzFile tmpSeqFP;
+	RGMatches pending;
+	int startReadNum;
+	int endReadNum;
+	int curReadNum;
+	int32_t space;
+	gzFile copyFP;
+	int32_t numRead;
+	int eof;
+} ReadsStream;
+
 int WriteRead(FILE*, RGMatches*);
 int WriteReadAFILE(AFILE*, RGMatches*);
+void ReadsStreamInitialize(ReadsStream*, AFILE*, int, int, int32_t, gzFile);
+void ReadsStreamInitializeTmp(ReadsStream*, gzFile, int32_t);
+void ReadsStreamFree(ReadsStream*);
+int32_t ReadsStreamGetReads(ReadsStream*, RGMatches*, int32_t);
 void WriteReadsToTempFile(AFILE*, gzFile*, char**, int, int, char*, int*, int32_t);
-int ReadTempReadsAndOutput(gzFile, char*, gzFile, AFILE*); 
-void ReadRGIndex(char*, RGIndex*, int);
+int ReadTempReadsAndOutput(gzFile*, char*, gzFile, AFILE*); 
+void ReadRGIndex(char*, RGIndex*, int, int);
 int GetIndexFileNames(char*, int32_t, char*, char***, int32_t***);
 int32_t ReadOffsets(char*, int32_t**);
 int32_t GetReads(gzFile, RGMatches*, int32_t, int32_t);
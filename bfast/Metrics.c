@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <config.h>
+#include <sys/time.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "aflib.h"
+#include "Metrics.h"
+
+static char *MetricsStageNames[MetricsNumStages] = {"load", "read", "search", "merge", "sort", "align", "filter", "format", "write"};
+static char *MetricsCounterNames[MetricsNumCounters] = {"indexLookups", "keysRejected", "CALs", "exactAlignments", "ungappedAlignments", "gappedAlignments", "DPCells", "bytesIn", "bytesOut"};
+
+/* The metrics of the current command, disabled unless a file was given */
+static Metrics metrics;
+
+/* Enables the metrics, to be written to the given file by MetricsFree.
+ * Nothing is recorded when the file name is NULL. */
+void MetricsInitialize(char *command, char *fileName)
+{
+	char *FnName="MetricsInitialize";
+
+	if(NULL == fileName) {
+		return;
+	}
+	assert(0 == metrics.enabled);
+
+	metrics.command = strdup(command);
+	metrics.fileName = strdup(fileName);
+	if(NULL == metrics.command || NULL == metrics.fileName) {
+		PrintError(FnName, "metrics", "Could not allocate memory", Exit, MallocMemory);
+	}
+	MetricsRegistryInitialize(&metrics.threads, sizeof(MetricsThread), NULL);
+	metrics.startNanos = MetricsGetNanos();
+	metrics.enabled = 1;
+
+	/* The calling thread is always the first */
+	MetricsGetThread();
+}
+
+/* Writes the metrics as JSON and frees them */
+void MetricsFree()
+{
+	char *FnName="MetricsFree";
+	FILE *fp=NULL;
+
+	if(0 == metrics.enabled) {
+		return;
+	}
+
+	if(!(fp = fopen(metrics.fileName, "wb"))) {
+		PrintError(FnName, metrics.fileName, "Could not open file for writing", Exit, OpenFileError);
+	}
+	MetricsPrint(fp);
+	fclose(fp);
+
+	metrics.enabled = 0;
+	MetricsRegistryFree(&metrics.threads);
+	free(metrics.command);
+	metrics.command = NULL;
+	free(metrics.fileName);
+	metrics.fileName = NULL;
+}
+
+/* Returns the time in nanoseconds from a monotonic clock when available */
+int64_t MetricsGetNanos()
+{
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec)*1000000000 + ts.tv_nsec;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return ((int64_t)tv.tv_sec)*1000000000 + ((int64_t)tv.tv_usec)*1000;
+#endif
+}
+
+/* Returns the start of a stage to be given to MetricsStop */
+int64_t MetricsStart()
+{
+	if(0 == metrics.enabled) {
+		return 0;
+	}
+	return MetricsGetNanos();
+}
+
+/* Adds the time since start to the stage of the calling thread */
+void MetricsStop(int32_t stage, int64_t start)
+{
+	MetricsThread *thread=NULL;
+
+	if(0 == metrics.enabled) {
+		return;
+	}
+	assert(0 <= stage && stage < MetricsNumStages);
+	thread = MetricsGetThread();
+	thread->nanos[stage] += MetricsGetNanos() - start;
+	thread->calls[stage]++;
+}
+
+/* Adds to a counter of the calling thread */
+void MetricsCount(int32_t counter, int64_t n)
+{
+	if(0 == metrics.enabled) {
+		return;
+	}
+	assert(0 <= counter && counter < MetricsNumCounters);
+	MetricsGetThread()->counts[counter] += n;
+}
+
+/* Adds the uncompressed position of a gz file to a counter */
+void MetricsCountGZ(int32_t counter, gzFile fp)
+{
+	int64_t pos;
+
+	if(0 == metrics.enabled || NULL == fp) {
+		return;
+	}
+	pos = gztell(fp);
+	if(0 < pos) {
+		MetricsCount(counter, pos);
+	}
+}
+
+/* Adds the position of a file to a counter, which is skipped for pipes */
+void MetricsCountFile(int32_t counter, FILE *fp)
+{
+	int64_t pos;
+
+	if(0 == metrics.enabled || NULL == fp) {
+		return;
+	}
+#ifdef HAVE_FSEEKO
+	pos = ftello(fp);
+#else
+	pos = ftell(fp);
+#endif
+	if(0 < pos) {
+		MetricsCount(counter, pos);
+	}
+}
+
+/* Adds the uncompressed position of a file to a counter.  The position of
+ * bz2 files is not known and is skipped. */
+void MetricsCountAFILE(int32_t counter, AFILE *afp)
+{
+	if(0 == metrics.enabled || NULL == afp) {
+		return;
+	}
+	if(NULL != afp->gz) {
+		MetricsCountGZ(counter, afp->gz);
+	}
+#ifndef DISABLE_BZLIB
+	else if(NULL != afp->bz2) {
+		return;
+	}
+#endif
+	else {
+		MetricsCountFile(counter, afp->fp);
+	}
+}
+
+/* Returns the metrics of the calling thread */
+MetricsThread *MetricsGetThread()
+{
+	return MetricsRegistryGet(&metrics.threads);
+}
+
+/* Sets up an empty registry, whose entries are entrySize bytes long.  take
+ * is called each time a thread takes an entry. */
+void MetricsRegistryInitialize(MetricsRegistry *registry, size_t entrySize, void (*take)(void*))
+{
+	char *FnName="MetricsRegistryInitialize";
+
+	assert(sizeof(MetricsRegistryEntry) <= entrySize);
+	if(0 != pthread_key_create(&registry->key, MetricsRegistryExit)) {
+		PrintError(FnName, "registry->key", "Could not create the thread key", Exit, OutOfRange);
+	}
+	if(0 != pthread_mutex_init(&registry->lock, NULL)) {
+		PrintError(FnName, "registry->lock", "Could not create the lock", Exit, OutOfRange);
+	}
+	registry->entrySize = entrySize;
+	registry->take = take;
+	registry->numEntries = 0;
+	registry->entries = NULL;
+}
+
+/* Frees the entries of the registry.  This should be called once all other
+ * threads are done. */
+void MetricsRegistryFree(MetricsRegistry *registry)
+{
+	int32_t i;
+
+	pthread_setspecific(registry->key, NULL);
+	pthread_key_delete(registry->key);
+	pthread_mutex_destroy(&registry->lock);
+	for(i=0;i<registry->numEntries;i++) {
+		free(registry->entries[i]);
+	}
+	free(registry->entries);
+	registry->entries = NULL;
+	registry->numEntries = 0;
+}
+
+/* Returns the entry of the calling thread, taking a free entry or adding a
+ * new one on the first call */
+void *MetricsRegistryGet(MetricsRegistry *registry)
+{
+	char *FnName="MetricsRegistryGet";
+	MetricsRegistryEntry *entry=NULL;
+	int32_t i;
+
+	entry = pthread_getspecific(registry->key);
+	if(NULL != entry) {
+		return entry;
+	}
+
+	pthread_mutex_lock(&registry->lock);
+	for(i=0;NULL == entry && i<registry->numEntries;i++) {
+		if(0 == registry->entries[i]->inUse) {
+			entry = registry->entries[i];
+		}
+	}
+	if(NULL == entry) {
+		registry->entries = realloc(registry->entries, sizeof(MetricsRegistryEntry*)*(registry->numEntries+1));
+		if(NULL == registry->entries) {
+			PrintError(FnName, "registry->entries", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		entry = calloc(1, registry->entrySize);
+		if(NULL == entry) {
+			PrintError(FnName, "entry", "Could not allocate memory", Exit, MallocMemory);
+		}
+		entry->registry = registry;
+		entry->threadID = registry->numEntries;
+		registry->entries[registry->numEntries++] = entry;
+	}
+	entry->inUse = 1;
+	entry->numThreads++;
+	if(NULL != registry->take) {
+		registry->take(entry);
+	}
+	pthread_mutex_unlock(&registry->lock);
+
+	pthread_setspecific(registry->key, entry);
+	return entry;
+}
+
+/* Frees the entry of an exiting thread for the next thread */
+void MetricsRegistryExit(void *arg)
+{
+	MetricsRegistryEntry *entry=arg;
+
+	pthread_mutex_lock(&entry->registry->lock);
+	entry->inUse = 0;
+	pthread_mutex_unlock(&entry->registry->lock);
+}
+
+/* Prints the totals and then the entry of each thread.  An entry used by
+ * more than one thread, one after the other, holds the sum of their values
+ * and gives their number in "threadsMerged". */
+void MetricsPrint(FILE *fp)
+{
+	MetricsThread *thread=NULL;
+	int64_t nanos[MetricsNumStages], calls[MetricsNumStages], counts[MetricsNumCounters];
+	int32_t i, j;
+
+	for(i=0;i<MetricsNumStages;i++) {
+		nanos[i] = calls[i] = 0;
+	}
+	for(i=0;i<MetricsNumCounters;i++) {
+		counts[i] = 0;
+	}
+	for(i=0;i<metrics.threads.numEntries;i++) {
+		thread = (MetricsThread*)metrics.threads.entries[i];
+		for(j=0;j<MetricsNumStages;j++) {
+			nanos[j] += thread->nanos[j];
+			calls[j] += thread->calls[j];
+		}
+		for(j=0;j<MetricsNumCounters;j++) {
+			counts[j] += thread->counts[j];
+		}
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"command\": \"%s\",\n", metrics.command);
+	fprintf(fp, "  \"version\": \"%s\",\n", PACKAGE_VERSION);
+	fprintf(fp, "  \"wallNanos\": %lld,\n", (long long int)(MetricsGetNanos() - metrics.startNanos));
+	fprintf(fp, "  \"numThreads\": %d,\n", metrics.threads.numEntries);
+	MetricsPrintCounts(fp, nanos, calls, counts, "  ");
+	fprintf(fp, ",\n  \"threads\": [\n");
+	for(i=0;i<metrics.threads.numEntries;i++) {
+		thread = (MetricsThread*)metrics.threads.entries[i];
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"thread\": %d,\n", thread->entry.threadID);
+		fprintf(fp, "      \"threadsMerged\": %d,\n", thread->entry.numThreads);
+		MetricsPrintCounts(fp, thread->nanos, thread->calls, thread->counts, "      ");
+		fprintf(fp, "\n    }%s\n", (i < metrics.threads.numEntries-1) ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+}
+
+/* Prints the "stages" and "counters" members of a JSON object */
+void MetricsPrintCounts(FILE *fp, int64_t *nanos, int64_t *calls, int64_t *counts, char *indent)
+{
+	int32_t i;
+
+	fprintf(fp, "%s\"stages\": {\n", indent);
+	for(i=0;i<MetricsNumStages;i++) {
+		fprintf(fp, "%s  \"%s\": {\"nanos\": %lld, \"calls\": %lld}%s\n",
+				indent,
+				MetricsStageNames[i],
+				(long long int)nanos[i],
+				(long long int)calls[i],
+				(i < MetricsNumStages-1) ? "," : "");
+	}
+	fprintf(fp, "%s},\n", indent);
+	fprintf(fp, "%s\"counters\": {\n", indent);
+	for(i=0;i<MetricsNumCounters;i++) {
+		fprintf(fp, "%s  \"%s\": %lld%s\n",
+				indent,
+				MetricsCounterNames[i],
+				(long long int)counts[i],
+				(i < MetricsNumCounters-1) ? "," : "");
+	}
+	fprintf(fp, "%s}", indent);
+}
@@ -0,0 +1,74 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "BLibDefinitions.h"
+#include "aflib.h"
+
+/* The stages timed by the metrics */
+enum {MetricsLoad, MetricsRead, MetricsSearch, MetricsMerge, MetricsSort, MetricsAlign, MetricsFilter, MetricsFormat, MetricsWrite, MetricsNumStages};
+
+/* The counters kept by the metrics */
+enum {MetricsIndexLookups, MetricsKeysRejected, MetricsCALs, MetricsExactAlignments, MetricsUngappedAlignments, MetricsGappedAlignments, MetricsDPCells, MetricsBytesIn, MetricsBytesOut, MetricsNumCounters};
+
+struct MetricsRegistry;
+
+/* The start of each entry of a registry.  A thread that exits gives its
+ * entry to the next thread that starts, so that short lived threads, such 
+ * as those reading the next reads, share one entry.  numThreads counts the
+ * threads that have used the entry. */
+typedef struct {
+	struct MetricsRegistry *registry;
+	int32_t threadID;
+	int32_t inUse;
+	int32_t numThreads;
+} MetricsRegistryEntry;
+
+/* Gives each thread an entry of entrySize bytes, which must start with a
+ * MetricsRegistryEntry.  Used by both the metrics and the tracer. */
+typedef struct MetricsRegistry {
+	pthread_key_t key;
+	pthread_mutex_t lock;
+	size_t entrySize;
+	/* Called when a thread takes a new or a free entry, may be NULL */
+	void (*take)(void*);
+	int32_t numEntries;
+	MetricsRegistryEntry **entries;
+} MetricsRegistry;
+
+/* The metrics of one thread, see MetricsRegistryEntry */
+typedef struct {
+	MetricsRegistryEntry entry;
+	int64_t nanos[MetricsNumStages];
+	int64_t calls[MetricsNumStages];
+	int64_t counts[MetricsNumCounters];
+} MetricsThread;
+
+typedef struct {
+	int32_t enabled;
+	char *command;
+	char *fileName;
+	int64_t startNanos;
+	MetricsRegistry threads;
+} Metrics;
+
+void MetricsInitialize(char*, char*);
+void MetricsFree();
+int64_t MetricsGetNanos();
+int64_t MetricsStart();
+void MetricsStop(int32_t, int64_t);
+void MetricsCount(int32_t, int64_t);
+void MetricsCountGZ(int32_t, gzFile);
+void MetricsCountFile(int32_t, FILE*);
+void MetricsCountAFILE(int32_t, AFILE*);
+MetricsThread *MetricsGetThread();
+void MetricsRegistryInitialize(MetricsRegistry*, size_t, void (*)(void*));
+void MetricsRegistryFree(MetricsRegistry*);
+void *MetricsRegistryGet(MetricsRegistry*);
+void MetricsRegistryExit(void*);
+void MetricsPrint(FILE*);
+void MetricsPrintCounts(FILE*, int64_t*, int64_t*, int64_t*, char*);
+
+#endif
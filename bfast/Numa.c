@@ -0,0 +1,440 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <config.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "ThreadPool.h"
+#include "RGIndex.h"
+#include "Numa.h"
+
+/* The nodes used by the current stage */
+static Numa numa = {NumaNone, 1, 1, NULL, 0, NULL, NULL, NULL, NULL, NULL};
+
+/* Finds the NUMA nodes with CPUs and binds the workers of the thread pool
+ * to them, the workers being split into one contiguous block per node.
+ * This should be called after ThreadPoolStart. */
+void NumaInitialize(int32_t mode, int32_t numThreads)
+{
+	char *FnName="NumaInitialize";
+	int32_t i, maxNumNodes=1;
+	ThreadNumaData *data=NULL;
+#ifdef HAVE_LIBNUMA
+	struct bitmask *cpus=NULL;
+#endif
+
+	assert(0 < numThreads);
+
+	NumaFree();
+	numa.mode = mode;
+	numa.simulated = 1;
+	numa.numNodes = 0;
+	numa.numThreads = numThreads;
+
+#ifdef HAVE_LIBNUMA
+	if(NumaNone != mode && 0 <= numa_available()) {
+		maxNumNodes = numa_max_node() + 1;
+	}
+#endif
+	numa.nodeIDs = malloc(sizeof(int32_t)*maxNumNodes);
+	if(NULL == numa.nodeIDs) {
+		PrintError(FnName, "numa.nodeIDs", "Could not allocate memory", Exit, MallocMemory);
+	}
+#ifdef HAVE_LIBNUMA
+	if(NumaNone != mode && 0 <= numa_available()) {
+		/* Skip nodes with only memory */
+		cpus = numa_allocate_cpumask();
+		for(i=0;i<maxNumNodes;i++) {
+			if(0 == numa_node_to_cpus(i, cpus) && 0 < numa_bitmask_weight(cpus)) {
+				numa.nodeIDs[numa.numNodes++] = i;
+			}
+		}
+		numa_free_cpumask(cpus);
+		numa.simulated = (0 < numa.numNodes) ? 0 : 1;
+	}
+#endif
+	if(1 == numa.simulated) {
+		if(NumaNone != mode && 0 <= VERBOSE) {
+			fprintf(stderr, "NUMA is not available, using one simulated node.\n");
+		}
+		numa.numNodes = 1;
+		numa.nodeIDs[0] = 0;
+	}
+
+	numa.workerNodes = malloc(sizeof(int32_t)*numThreads);
+	numa.numWorkers = malloc(sizeof(int32_t)*numa.numNodes);
+	numa.numReads = malloc(sizeof(int64_t)*numa.numNodes);
+	numa.seconds = malloc(sizeof(double)*numa.numNodes);
+	if(NULL == numa.workerNodes || NULL == numa.numWorkers || NULL == numa.numReads || NULL == numa.seconds) {
+		PrintError(FnName, "numa", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numa.numNodes;i++) {
+		numa.numWorkers[i] = 0;
+		numa.numReads[i] = 0;
+		numa.seconds[i] = 0.0;
+	}
+	for(i=0;i<numThreads;i++) {
+		numa.workerNodes[i] = (int32_t)((((int64_t)i)*numa.numNodes)/numThreads);
+		numa.numWorkers[numa.workerNodes[i]]++;
+	}
+
+	if(NumaNone != mode) {
+		if(0 <= VERBOSE) {
+			for(i=0;i<numa.numNodes;i++) {
+				fprintf(stderr, "Using NUMA node %d with %d thread%s.\n",
+						numa.nodeIDs[i],
+						numa.numWorkers[i],
+						(1 == numa.numWorkers[i]) ? "" : "s");
+			}
+		}
+		data = malloc(sizeof(ThreadNumaData)*numThreads);
+		if(NULL == data) {
+			PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+		}
+		for(i=0;i<numThreads;i++) {
+			data[i].node = numa.workerNodes[i];
+		}
+		ThreadPoolRun(NumaBindThread, data, sizeof(ThreadNumaData), numThreads);
+		free(data);
+	}
+}
+
+/* TODO */
+void NumaFree()
+{
+	NumaDeleteRGBinaryReplicas();
+	free(numa.nodeIDs);
+	free(numa.workerNodes);
+	free(numa.numWorkers);
+	free(numa.numReads);
+	free(numa.seconds);
+	numa.nodeIDs = NULL;
+	numa.workerNodes = NULL;
+	numa.numWorkers = NULL;
+	numa.numReads = NULL;
+	numa.seconds = NULL;
+	numa.mode = NumaNone;
+	numa.simulated = 1;
+	numa.numNodes = 1;
+	numa.numThreads = 0;
+}
+
+/* TODO */
+int32_t NumaGetMode()
+{
+	return numa.mode;
+}
+
+/* TODO */
+int32_t NumaGetNumNodes()
+{
+	return numa.numNodes;
+}
+
+/* Gets the node of the worker running the given task */
+int32_t NumaGetWorkerNode(int32_t taskID)
+{
+	if(0 == numa.numThreads) {
+		return 0;
+	}
+	return numa.workerNodes[taskID % numa.numThreads];
+}
+
+/* Memory touched by this thread until NumaInterleaveEnd is spread
+ * page-wise over the nodes */
+void NumaInterleaveStart()
+{
+#ifdef HAVE_LIBNUMA
+	if(NumaInterleave == numa.mode && 0 == numa.simulated) {
+		numa_set_interleave_mask(numa_all_nodes_ptr);
+	}
+#endif
+}
+
+/* TODO */
+void NumaInterleaveEnd()
+{
+#ifdef HAVE_LIBNUMA
+	if(NumaInterleave == numa.mode && 0 == numa.simulated) {
+		numa_set_localalloc();
+	}
+#endif
+}
+
+/* Copies the reference genome to each node, the copies replacing the
+ * loaded sequences */
+void NumaReplicateRGBinary(RGBinary *rg)
+{
+	char *FnName="NumaReplicateRGBinary";
+	int32_t i;
+
+	if(NumaReplicate != numa.mode) {
+		return;
+	}
+	NumaDeleteRGBinaryReplicas();
+
+	numa.rgReplicas = malloc(sizeof(RGBinary)*numa.numNodes);
+	if(NULL == numa.rgReplicas) {
+		PrintError(FnName, "numa.rgReplicas", "Could not allocate memory", Exit, MallocMemory);
+	}
+	NumaRun(NumaReplicateRGBinaryThread, NULL, NULL, 0, rg, numa.rgReplicas);
+
+	for(i=0;i<rg->numContigs;i++) {
+		free(rg->contigs[i].sequence);
+		rg->contigs[i].sequence = NULL;
+	}
+}
+
+/* Gets the copy of the reference genome local to the node */
+RGBinary *NumaGetRGBinary(int32_t node, RGBinary *rg)
+{
+	if(NULL == numa.rgReplicas) {
+		return rg;
+	}
+	return &numa.rgReplicas[node];
+}
+
+/* TODO */
+void NumaDeleteRGBinaryReplicas()
+{
+	int32_t i, j;
+
+	if(NULL == numa.rgReplicas) {
+		return;
+	}
+	for(i=0;i<numa.numNodes;i++) {
+		for(j=0;j<numa.rgReplicas[i].numContigs;j++) {
+			free(numa.rgReplicas[i].contigs[j].sequence);
+		}
+		/* The contig names belong to the loaded reference genome */
+		free(numa.rgReplicas[i].contigs);
+	}
+	free(numa.rgReplicas);
+	numa.rgReplicas = NULL;
+}
+
+/* Copies the indexes to each node, the copies replacing the loaded
+ * arrays.  Returns the copies, numIndexes per node, or NULL if the indexes
+ * are not replicated. */
+RGIndex *NumaReplicateRGIndexes(RGIndex *indexes, int32_t numIndexes)
+{
+	char *FnName="NumaReplicateRGIndexes";
+	int32_t i;
+	RGIndex *replicas=NULL;
+
+	if(NumaReplicate != numa.mode) {
+		return NULL;
+	}
+
+	replicas = malloc(sizeof(RGIndex)*numa.numNodes*numIndexes);
+	if(NULL == replicas) {
+		PrintError(FnName, "replicas", "Could not allocate memory", Exit, MallocMemory);
+	}
+	NumaRun(NumaReplicateRGIndexesThread, indexes, replicas, numIndexes, NULL, NULL);
+
+	for(i=0;i<numIndexes;i++) {
+		free(indexes[i].positions);
+		free(indexes[i].contigs_8);
+		free(indexes[i].contigs_32);
+		free(indexes[i].starts);
+		RGIndexEliasFanoFree(&indexes[i].startsHashes);
+		RGIndexEliasFanoFree(&indexes[i].startsEntries);
+		free(indexes[i].packed);
+		indexes[i].positions = NULL;
+		indexes[i].contigs_8 = NULL;
+		indexes[i].contigs_32 = NULL;
+		indexes[i].starts = NULL;
+		indexes[i].packed = NULL;
+	}
+
+	return replicas;
+}
+
+/* TODO */
+void NumaDeleteRGIndexReplicas(RGIndex *replicas, int32_t numIndexes)
+{
+	int32_t i;
+
+	if(NULL == replicas) {
+		return;
+	}
+	/* The mask, the key filter, the contig starts and the package version
+	 * belong to the loaded indexes */
+	for(i=0;i<numa.numNodes*numIndexes;i++) {
+		free(replicas[i].positions);
+		free(replicas[i].contigs_8);
+		free(replicas[i].contigs_32);
+		free(replicas[i].starts);
+		RGIndexEliasFanoFree(&replicas[i].startsHashes);
+		RGIndexEliasFanoFree(&replicas[i].startsEntries);
+		free(replicas[i].packed);
+	}
+	free(replicas);
+}
+
+/* TODO */
+void NumaAddThroughput(int32_t node, int64_t numReads, double seconds)
+{
+	if(NULL == numa.numReads) {
+		return;
+	}
+	numa.numReads[node] += numReads;
+	numa.seconds[node] += seconds;
+}
+
+/* Prints the number of reads searched per second on each node, the
+ * seconds being summed over the threads of the node */
+void NumaPrintThroughput(FILE *fp)
+{
+	int32_t i;
+	double seconds;
+
+	if(NumaNone == numa.mode || NULL == numa.numReads) {
+		return;
+	}
+	for(i=0;i<numa.numNodes;i++) {
+		seconds = (0 < numa.numWorkers[i]) ? numa.seconds[i] / numa.numWorkers[i] : 0.0;
+		fprintf(fp, "NUMA node %d%s: searched %lld reads with %d thread%s at %.1lf reads per second.\n",
+				numa.nodeIDs[i],
+				(1 == numa.simulated) ? " (simulated)" : "",
+				(long long int)numa.numReads[i],
+				numa.numWorkers[i],
+				(1 == numa.numWorkers[i]) ? "" : "s",
+				(0 < seconds) ? numa.numReads[i] / seconds : 0.0);
+	}
+}
+
+/* Runs the function on every worker, the first worker on each node being
+ * marked so that it can make the copy for its node */
+void NumaRun(void *(*function)(void*),
+		RGIndex *indexes,
+		RGIndex *replicas,
+		int32_t numIndexes,
+		RGBinary *rg,
+		RGBinary *rgReplicas)
+{
+	char *FnName="NumaRun";
+	int32_t i, node;
+	ThreadNumaData *data=NULL;
+
+	data = malloc(sizeof(ThreadNumaData)*numa.numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numa.numThreads;i++) {
+		node = numa.workerNodes[i];
+		data[i].node = node;
+		data[i].first = (0 == i || numa.workerNodes[i-1] != node) ? 1 : 0;
+		data[i].indexes = indexes;
+		data[i].replicas = (NULL == replicas) ? NULL : replicas + node*numIndexes;
+		data[i].numIndexes = numIndexes;
+		data[i].rg = rg;
+		data[i].rgReplica = (NULL == rgReplicas) ? NULL : &rgReplicas[node];
+	}
+	ThreadPoolRun(function, data, sizeof(ThreadNumaData), numa.numThreads);
+	free(data);
+}
+
+/* TODO */
+void *NumaBindThread(void *arg)
+{
+#ifdef HAVE_LIBNUMA
+	char *FnName="NumaBindThread";
+	ThreadNumaData *data = (ThreadNumaData*)arg;
+
+	if(0 == numa.simulated) {
+		if(0 != numa_run_on_node(numa.nodeIDs[data->node])) {
+			PrintError(FnName, "numa_run_on_node", "Could not bind the thread to its node", Warn, ThreadError);
+		}
+		numa_set_localalloc();
+	}
+#endif
+	return arg;
+}
+
+/* The copies are first touched by a worker bound to the node, so that
+ * their pages are allocated on the node */
+void *NumaReplicateRGIndexesThread(void *arg)
+{
+	ThreadNumaData *data = (ThreadNumaData*)arg;
+	RGIndex *src=NULL, *dest=NULL;
+	int32_t i;
+
+	if(0 == data->first) {
+		return arg;
+	}
+	for(i=0;i<data->numIndexes;i++) {
+		src = &data->indexes[i];
+		dest = &data->replicas[i];
+		(*dest) = (*src);
+		dest->positions = NumaCopy(src->positions, sizeof(int32_t)*src->length);
+		dest->contigs_8 = NumaCopy(src->contigs_8, sizeof(uint8_t)*src->length);
+		dest->contigs_32 = NumaCopy(src->contigs_32, sizeof(uint32_t)*src->length);
+		dest->starts = NumaCopy(src->starts, sizeof(uint32_t)*src->hashLength);
+		NumaCopyEliasFano(&src->startsHashes, &dest->startsHashes);
+		NumaCopyEliasFano(&src->startsEntries, &dest->startsEntries);
+		dest->packed = NumaCopy(src->packed, sizeof(uint64_t)*RGINDEX_PACKED_NUM_WORDS(src->length, src->packedWidth));
+	}
+	return arg;
+}
+
+/* TODO */
+void *NumaReplicateRGBinaryThread(void *arg)
+{
+	char *FnName="NumaReplicateRGBinaryThread";
+	ThreadNumaData *data = (ThreadNumaData*)arg;
+	RGBinary *src=data->rg, *dest=data->rgReplica;
+	int32_t i;
+
+	if(0 == data->first) {
+		return arg;
+	}
+	(*dest) = (*src);
+	dest->contigs = malloc(sizeof(RGBinaryContig)*src->numContigs);
+	if(NULL == dest->contigs) {
+		PrintError(FnName, "dest->contigs", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<src->numContigs;i++) {
+		dest->contigs[i] = src->contigs[i];
+		dest->contigs[i].sequence = NumaCopy(src->contigs[i].sequence, sizeof(char)*src->contigs[i].numBytes);
+	}
+	return arg;
+}
+
+/* TODO */
+void *NumaCopy(void *src, size_t size)
+{
+	char *FnName="NumaCopy";
+	void *dest=NULL;
+
+	if(NULL == src) {
+		return NULL;
+	}
+	dest = malloc(size);
+	if(NULL == dest) {
+		PrintError(FnName, "dest", "Could not allocate memory", Exit, MallocMemory);
+	}
+	memcpy(dest, src, size);
+	return dest;
+}
+
+/* Copies the coded values, whose arrays may be absent */
+void NumaCopyEliasFano(RGIndexEliasFano *src, RGIndexEliasFano *dest)
+{
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+
+	(*dest) = (*src);
+	if(NULL == src->high) {
+		return;
+	}
+	RGIndexEliasFanoGetNumWords(src->length, src->universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	dest->low = NumaCopy(src->low, sizeof(uint64_t)*numLowWords);
+	dest->high = NumaCopy(src->high, sizeof(uint64_t)*numHighWords);
+	dest->select = NumaCopy(src->select, sizeof(int64_t)*numSelect);
+	dest->buckets = NumaCopy(src->buckets, sizeof(int64_t)*numBuckets);
+}
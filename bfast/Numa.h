@@ -0,0 +1,54 @@
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include "BLibDefinitions.h"
+
+/* The NUMA nodes used by the workers of the thread pool.  Without NUMA
+ * support all CPUs are treated as one simulated node. */
+typedef struct {
+	int32_t mode;
+	int32_t simulated;
+	int32_t numNodes;
+	int32_t *nodeIDs;
+	int32_t numThreads;
+	int32_t *workerNodes;
+	/* Reference genome replicas, one per node */
+	RGBinary *rgReplicas;
+	/* Per node throughput */
+	int32_t *numWorkers;
+	int64_t *numReads;
+	double *seconds;
+} Numa;
+
+typedef struct {
+	int32_t node;
+	int32_t first;
+	RGIndex *indexes;
+	RGIndex *replicas;
+	int32_t numIndexes;
+	RGBinary *rg;
+	RGBinary *rgReplica;
+} ThreadNumaData;
+
+void NumaInitialize(int32_t, int32_t);
+void NumaFree();
+int32_t NumaGetMode();
+int32_t NumaGetNumNodes();
+int32_t NumaGetWorkerNode(int32_t);
+void NumaInterleaveStart();
+void NumaInterleaveEnd();
+void NumaReplicateRGBinary(RGBinary*);
+RGBinary *NumaGetRGBinary(int32_t, RGBinary*);
+void NumaDeleteRGBinaryReplicas();
+RGIndex *NumaReplicateRGIndexes(RGIndex*, int32_t);
+void NumaDeleteRGIndexReplicas(RGIndex*, int32_t);
+void NumaAddThroughput(int32_t, int64_t, double);
+void NumaPrintThroughput(FILE*);
+void NumaRun(void *(*)(void*), RGIndex*, RGIndex*, int32_t, RGBinary*, RGBinary*);
+void *NumaBindThread(void*);
+void *NumaReplicateRGIndexesThread(void*);
+void *NumaReplicateRGBinaryThread(void*);
+void *NumaCopy(void*, size_t);
+void NumaCopyEliasFano(RGIndexEliasFano*, RGIndexEliasFano*);
+
+#endif
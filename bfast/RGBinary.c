@@ -10,6 +10,7 @@
 #include "BError.h"
 #include "BLib.h"
 #include "BLibDefinitions.h"
+#include "Metrics.h"
 #include "RGBinary.h"
 
 /* TODO */
@@ -240,6 +241,7 @@ void RGBinaryRead(char *fastaFileName,
 	}
 
 	/* Close file */
+	MetricsCountFile(MetricsBytesIn, fpRG);
 	fclose(fpRG);
 
 	if(VERBOSE>=0) {
@@ -367,6 +369,7 @@ void RGBinaryReadBinary(RGBinary *rg,
 	}
 
 	/* Close the output file */
+	MetricsCountGZ(MetricsBytesIn, fpRG);
 	gzclose(fpRG);
 
 	if(VERBOSE>=0) {
@@ -448,6 +451,7 @@ void RGBinaryWriteBinary(RGBinary *rg,
 			PrintError(FnName, NULL, "Could not output rg contig", Exit, WriteFileError);
 		}
 	}
+	MetricsCountGZ(MetricsBytesOut, fpRG);
 	gzclose(fpRG);
 
 	free(brgFileName);
@@ -616,6 +620,117 @@ void RGBinaryInsertBase(char *dest,
 	}
 }
 
+/* Four-bit packed base to character, and its reverse compliment.  The 
+ * upper two bits give the repeat (upper case) or N, see RGBinaryGetBase. 
+ * Values with both upper bits set are invalid. */
+static const char RGBinaryFourBitToBase[16] = {
+	'a', 'c', 'g', 't', 'A', 'C', 'G', 'T', 'N', 'N', 'N', 'N', 0, 0, 0, 0
+};
+static const char RGBinaryFourBitToCompliment[16] = {
+	't', 'g', 'c', 'a', 'T', 'G', 'C', 'A', 'N', 'N', 'N', 'N', 0, 0, 0, 0
+};
+/* Non-zero if any four bits in the byte have both upper bits set */
+#define RGBINARY_INVALID_FOUR_BIT(_b) ((_b) & ((_b) << 1) & 0x88)
+
+/* TODO */
+/* Decodes the sequence into the given buffer, which must hold 
+ * sequenceLength+1 characters.  The reverse compliment (reverse in color 
+ * space) is taken while decoding.  Returns 0 if the sequence is out of 
+ * range. */
+int32_t RGBinaryDecodeSequence(RGBinary *rg,
+		int32_t contig,
+		int32_t position,
+		char strand,
+		char *sequence,
+		int32_t sequenceLength)
+{
+	char *FnName="RGBinaryDecodeSequence";
+	const char *table=NULL;
+	const uint8_t *packed=NULL;
+	uint8_t curByte, invalid=0;
+	int32_t i, j;
+
+	assert(ALPHABET_SIZE==4);
+	/* Check bounds once */
+	if(contig <= 0 || rg->numContigs < contig ||
+			position < 1 ||
+			rg->contigs[contig-1].sequenceLength < position + sequenceLength - 1) {
+		return 0;
+	}
+	if(strand != FORWARD && strand != REVERSE) {
+		fprintf(stderr, "stand=%c\n", strand);
+		PrintError(FnName, "strand", "Could not understand strand", Exit, OutOfRange);
+	}
+
+	if(RGBinaryUnPacked == rg->packed) {
+		/* Simple */
+		if(FORWARD == strand) {
+			memcpy(sequence, rg->contigs[contig-1].sequence + position - 1, sizeof(char)*sequenceLength);
+		}
+		else {
+			for(i=0,j=position+sequenceLength-2;i<sequenceLength;i++,j--) {
+				sequence[i] = (NTSpace == rg->space) ? 
+					GetReverseComplimentAnyCaseBase(rg->contigs[contig-1].sequence[j]) :
+					rg->contigs[contig-1].sequence[j];
+			}
+		}
+		sequence[sequenceLength] = '\0';
+		return 1;
+	}
+
+	/* Two bases per byte, the first in the left-most four bits */
+	packed = (const uint8_t*)rg->contigs[contig-1].sequence;
+	i = 0;
+	if(FORWARD == strand) {
+		table = RGBinaryFourBitToBase;
+		j = position - 1;
+		if(1 == (j & 1) && i < sequenceLength) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i++] = table[curByte & 0x0F];
+			j++;
+		}
+		for(;i+1 < sequenceLength;i+=2,j+=2) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i] = table[curByte >> 4];
+			sequence[i+1] = table[curByte & 0x0F];
+		}
+		if(i < sequenceLength) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i++] = table[curByte >> 4];
+		}
+	}
+	else {
+		/* Walk backwards from the last base */
+		table = (NTSpace == rg->space) ? RGBinaryFourBitToCompliment : RGBinaryFourBitToBase;
+		j = position + sequenceLength - 2;
+		if(0 == (j & 1) && i < sequenceLength) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i++] = table[curByte >> 4];
+			j--;
+		}
+		for(;i+1 < sequenceLength;i+=2,j-=2) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i] = table[curByte & 0x0F];
+			sequence[i+1] = table[curByte >> 4];
+		}
+		if(i < sequenceLength) {
+			curByte = packed[j >> 1];
+			invalid |= RGBINARY_INVALID_FOUR_BIT(curByte);
+			sequence[i++] = table[curByte & 0x0F];
+		}
+	}
+	sequence[sequenceLength] = '\0';
+	if(0 != invalid) {
+		PrintError(FnName, "repeat", "Could not understand repeat", Exit, OutOfRange);
+	}
+	return 1;
+}
+
 /* TODO */
 int32_t RGBinaryGetSequence(RGBinary *rg,
 		int32_t contig,
@@ -625,10 +740,7 @@ int32_t RGBinaryGetSequence(RGBinary *rg,
 		int32_t sequenceLength)
 {
 	char *FnName="RGBinaryGetSequence";
-	char *reverseCompliment;
-	int32_t curPos;
 
-	assert(ALPHABET_SIZE==4);
 	if(contig <= 0 || rg->numContigs < contig) {
 		return 0;
 	}
@@ -640,60 +752,30 @@ int32_t RGBinaryGetSequence(RGBinary *rg,
 		PrintError(FnName, "sequence", "Could not allocate memory", Exit, MallocMemory);
 	}
 
-	/* Copy over bases */
-	for(curPos=position;curPos < position + sequenceLength;curPos++) {
-		(*sequence)[curPos-position] = RGBinaryGetBase(rg, contig, curPos);
-		if(0==(*sequence)[curPos-position]) {
-			/* Free memory */
-			free((*sequence));
-			(*sequence) = NULL;
-			return 0;
-		}
-	}
-	(*sequence)[sequenceLength] = '\0';
-
-	/* Get the reverse compliment if necessary */
-	if(strand == FORWARD) {
-		/* ignore */
-	}
-	else if(strand == REVERSE) {
-		/* Allocate memory for the reverse compliment */
-		reverseCompliment = malloc(sizeof(char)*(sequenceLength+1));
-		if(NULL == reverseCompliment) {
-			PrintError(FnName, "reverseCompliment", "Could not allocate memory", Exit, MallocMemory);
-		}
-		if(NTSpace == rg->space) {
-			/* Get the reverse compliment */
-			GetReverseComplimentAnyCase((*sequence), reverseCompliment, sequenceLength);
-		}
-		else {
-			ReverseRead((*sequence), reverseCompliment, sequenceLength);
-		}
-		free((*sequence)); /* Free memory pointed to by sequence */
-		(*sequence) = reverseCompliment; /* Point sequence to reverse compliment's memory */
-		reverseCompliment=NULL; /* Destroy the pointer for reverse compliment */
-	}
-	else {
-		fprintf(stderr, "stand=%c\n", strand);
-		PrintError(FnName, "strand", "Could not understand strand", Exit, OutOfRange);
+	if(0 == RGBinaryDecodeSequence(rg, contig, position, strand, (*sequence), sequenceLength)) {
+		/* Free memory */
+		free((*sequence));
+		(*sequence) = NULL;
+		return 0;
 	}
 	return 1;
 }
 
 /* TODO */
-void RGBinaryGetReference(RGBinary *rg,
+/* Gets the reference around the given position into the given buffer, 
+ * which must hold readLength + 2*offsetLength + 1 characters */
+void RGBinaryGetReferenceBuffer(RGBinary *rg,
 		int32_t contig,
 		int32_t position,
 		char strand,
 		int32_t offsetLength,
-		char **reference,
+		char *reference,
 		int32_t readLength,
 		int32_t *returnReferenceLength,
 		int32_t *returnPosition)
 {
-	char *FnName="RGBinaryGetReference";
+	char *FnName="RGBinaryGetReferenceBuffer";
 	int32_t startPos, endPos;
-	int success;
 
 	assert(ALPHABET_SIZE==4);
 	assert(contig > 0 && contig <= rg->numContigs);
@@ -718,27 +800,20 @@ void RGBinaryGetReference(RGBinary *rg,
 	/* Check that enough bases remain */
 	if(endPos - startPos + 1 <= 0) {
 		/* Return just one base = N */
-		assert((*reference)==NULL);
-		(*reference) = malloc(sizeof(char)*(2));
-		if(NULL==(*reference)) {
-			PrintError(FnName, "reference", "Could not allocate memory", Exit, MallocMemory);
-		}
-		(*reference)[0] = 'N';
-		(*reference)[1] = '\0';
+		reference[0] = 'N';
+		reference[1] = '\0';
 
 		(*returnReferenceLength) = 1;
 		(*returnPosition) = 1;
 	}
 	else {
 		/* Get reference */
-		success = RGBinaryGetSequence(rg,
-				contig,
-				startPos,
-				strand,
-				reference,
-				endPos - startPos + 1);
-
-		if(0 == success) {
+		if(0 == RGBinaryDecodeSequence(rg,
+					contig,
+					startPos,
+					strand,
+					reference,
+					endPos - startPos + 1)) {
 			PrintError(FnName, NULL, "Could not get reference", Exit, OutOfRange);
 		}
 
@@ -748,6 +823,37 @@ void RGBinaryGetReference(RGBinary *rg,
 	}
 }
 
+/* TODO */
+void RGBinaryGetReference(RGBinary *rg,
+		int32_t contig,
+		int32_t position,
+		char strand,
+		int32_t offsetLength,
+		char **reference,
+		int32_t readLength,
+		int32_t *returnReferenceLength,
+		int32_t *returnPosition)
+{
+	char *FnName="RGBinaryGetReference";
+
+	/* Allocate memory for the reference */
+	assert((*reference)==NULL);
+	(*reference) = malloc(sizeof(char)*(GETMAX(1, readLength + 2*offsetLength) + 1));
+	if(NULL==(*reference)) {
+		PrintError(FnName, "reference", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	RGBinaryGetReferenceBuffer(rg,
+			contig,
+			position,
+			strand,
+			offsetLength,
+			(*reference),
+			readLength,
+			returnReferenceLength,
+			returnPosition);
+}
+
 /* TODO */
 char RGBinaryGetBase(RGBinary *rg,
 		int32_t contig,
@@ -12,7 +12,9 @@ void RGBinaryWriteBinary(RGBinary*, int32_t, char*);
 void RGBinaryWriteBinaryHeader(RGBinary*, gzFile);
 void RGBinaryDelete(RGBinary*);
 void RGBinaryInsertBase(char*, int32_t, char);
+int32_t RGBinaryDecodeSequence(RGBinary*, int32_t, int32_t, char, char*, int32_t);
 int32_t RGBinaryGetSequence(RGBinary*, int32_t, int32_t, char, char**, int32_t);
+void RGBinaryGetReferenceBuffer(RGBinary*, int32_t, int32_t, char, int32_t, char*, int32_t, int32_t*, int32_t*);
 void RGBinaryGetReference(RGBinary*, int32_t, int32_t, char, int32_t, char**, int32_t, int32_t*, int32_t*);
 char RGBinaryGetBase(RGBinary*, int32_t, int32_t);
 uint8_t RGBinaryGetFourBit(RGBinary*, int32_t, int32_t);
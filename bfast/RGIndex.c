@@ -18,6 +18,7 @@
 #include "RGBinary.h"
 #include "RGRanges.h"
 #include "RGIndexExons.h"
+#include "Metrics.h"
 #include "RGIndex.h"
 
 /* TODO */
@@ -34,6 +35,7 @@ void RGIndexCreate(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t keyFilterThreshold,
 		char *tmpDir) 
 {
 
@@ -59,6 +61,7 @@ void RGIndexCreate(char *fastaFileName,
 				numThreads,
 				repeatMasker,
 				includeNs,
+				keyFilterThreshold,
 				tmpDir);
 	}
 	else {
@@ -76,6 +79,7 @@ void RGIndexCreate(char *fastaFileName,
 				numThreads,
 				repeatMasker,
 				includeNs,
+				keyFilterThreshold,
 				tmpDir);
 	}
 }
@@ -94,6 +98,7 @@ void RGIndexCreateSingle(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t keyFilterThreshold,
 		char *tmpDir) 
 {
 	//char *FnName = "RGIndexCreateSingle";
@@ -101,9 +106,12 @@ void RGIndexCreateSingle(char *fastaFileName,
 	RGIndex index;
 	RGBinary rg;
 	gzFile gzOut;
+	int64_t stageStart;
 
 	/* Get brg */
+	stageStart = MetricsStart();
 	RGBinaryReadBinary(&rg, space, fastaFileName);
+	MetricsStop(MetricsLoad, stageStart);
 	/* Make sure we have the correct reference genome */
 	assert(rg.space == space);
 	assert(4 == ALPHABET_SIZE);
@@ -178,13 +186,20 @@ void RGIndexCreateSingle(char *fastaFileName,
 	assert(index.length > 0);
 
 	/* Sort the nodes in the index */
+	stageStart = MetricsStart();
 	RGIndexSort(&index, &rg, numThreads, tmpDir);
 
 	/* Create hash table from the index */
 	RGIndexCreateHash(&index, &rg);
 
+	/* Find the keys with too many matches */
+	RGIndexCreateKeyFilter(&index, &rg, keyFilterThreshold);
+	MetricsStop(MetricsSort, stageStart);
+
 	/* Write */ 
+	stageStart = MetricsStart();
 	RGIndexPrint(gzOut, &index);
+	MetricsStop(MetricsWrite, stageStart);
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Index created.\n");
@@ -212,6 +227,7 @@ void RGIndexCreateSplit(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t keyFilterThreshold,
 		char *tmpDir) 
 {
 	char *FnName = "RGIndexCreateSplit";
@@ -225,9 +241,12 @@ void RGIndexCreateSplit(char *fastaFileName,
 	uint32_t contig_32;
 	uint32_t position;
 	gzFile *gzOuts=NULL;
+	int64_t stageStart;
 
 	/* Get brg */
+	stageStart = MetricsStart();
 	RGBinaryReadBinary(&rg, space, fastaFileName);
+	MetricsStop(MetricsLoad, stageStart);
 	/* Make sure we have the correct reference genome */
 	assert(rg.space == space);
 
@@ -400,13 +419,20 @@ void RGIndexCreateSplit(char *fastaFileName,
 		}
 
 		/* Sort the nodes in the index */
+		stageStart = MetricsStart();
 		RGIndexSort(&index, &rg, numThreads, tmpDir);
 
 		/* Create hash table from the index */
 		RGIndexCreateHash(&index, &rg);
 
+		/* Find the keys with too many matches */
+		RGIndexCreateKeyFilter(&index, &rg, keyFilterThreshold);
+		MetricsStop(MetricsSort, stageStart);
+
 		/* Write */
+		stageStart = MetricsStart();
 		RGIndexPrint(gzOuts[i], &index);
+		MetricsStop(MetricsWrite, stageStart);
 		/* TODO: output Messages */
 
 		if(VERBOSE >= 0) {
@@ -620,105 +646,592 @@ void RGIndexCreateHelper(RGIndex *index,
 /* TODO */
 void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 {
-	char *FnName = "RGIndexCreateHash";
-	uint32_t curHash, prevHash, prevStart;
-	int64_t i;
+	int64_t i, curHash, nextHash, numHashes;
 
-	if(index->length >= UINT_MAX) {
-		PrintError(FnName, "index->length", "Index length has reached its maximum", Exit, OutOfRange);
-	}
+	/* Code the starts when the hash is too wide, or the index too long, 
+	 * for 32-bit starts */
+	index->id = (RGINDEX_MAX_NARROW_HASH_WIDTH < index->hashWidth || UINT_MAX <= index->length) ? BFAST_CODED_STARTS_ID : BFAST_ID;
 
-	/* Allocate memory for the hash */
-	index->starts = malloc(sizeof(uint32_t)*index->hashLength);
-	if(NULL==index->starts) {
-		PrintError(FnName, "index->starts", "Could not allocate memory", Exit, MallocMemory);
+	/* Coded starts are sized by the number of distinct hashes */
+	numHashes = 0;
+	if(1 == RGIndexHasWideStarts(index)) {
+		if(VERBOSE >= 0) {
+			fprintf(stderr, "Counting the distinct hashes.\n");
+		}
+		for(i=0,nextHash=-1;i<index->length;i++) {
+			curHash = RGIndexGetHashIndex(index, rg, i, 0);
+			if(curHash != nextHash) {
+				numHashes++;
+				nextHash = curHash;
+			}
+		}
 	}
 
-	/* initialize */
-	for(i=0;i<index->hashLength;i++) {
-		/* Can't use -1, so use UINT_MAX */
-		index->starts[i] = UINT_MAX;
-	}
+	/* Allocate memory for the hash */
+	RGIndexStartsAllocate(index, numHashes);
 
 	/* Go through index and update the hash */
 	if(VERBOSE >= 0) {
-		fprintf(stderr, "Creating a hash.\nPass 1 out of 2.  Out of %u, currently on:\n0",
-				(uint32_t)index->length);
+		fprintf(stderr, "Creating a hash.\nOut of %lld, currently on:\n0",
+				(long long int)index->length);
 	}
 
-	prevHash = UINT_MAX;
-	for(i=0;i<index->length;i++) {
+	/* The index is sorted, so the start of each hash is the first entry 
+	 * with that hash or a larger one */
+	for(i=nextHash=numHashes=0;i<index->length;i++) {
 		if(VERBOSE >= 0 && i%RGINDEX_ROTATE_NUM==0) {
 			fprintf(stderr, "\r%lld", 
 					(long long int)i);
 		}
 
 		curHash = RGIndexGetHashIndex(index, rg, i, 0);
-		if(prevHash == curHash) {
-			/* Ignore */
+		assert(0 <= curHash && curHash < index->hashLength);
+		if(NULL != index->starts) {
+			for(;nextHash<=curHash;nextHash++) {
+				index->starts[nextHash] = i;
+			}
 		}
-		else {
-			/* Update */
-			assert(i < UINT_MAX);
-			assert(0 <= curHash && curHash < index->hashLength);
-			index->starts[curHash] = i;
-			prevHash = curHash;
+		else if(nextHash <= curHash) {
+			/* The first entry of the next distinct hash */
+			RGIndexEliasFanoSet(&index->startsHashes, numHashes, curHash);
+			RGIndexEliasFanoSet(&index->startsEntries, numHashes, i);
+			numHashes++;
+			nextHash = curHash + 1;
+		}
+	}
+	if(NULL == index->starts) {
+		RGIndexEliasFanoSet(&index->startsEntries, numHashes, index->length);
+		RGIndexEliasFanoSample(&index->startsHashes);
+		RGIndexEliasFanoSample(&index->startsEntries);
+	}
+	else {
+		/* The remaining hashes do not index anything.  Can't use -1, so use 
+		 * UINT_MAX */
+		for(;nextHash<index->hashLength;nextHash++) {
+			index->starts[nextHash] = UINT_MAX;
 		}
 	}
-	/* Test pass 1 has creation */
-	/*
-	   for(i=0;i<index->hashLength;i++) {
-	   assert(0 <= index->starts[i]);
-	   assert(index->starts[i] < index->length || index->starts[i] == UINT_MAX);
-	   }
-	   */
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "\r%lld\n", 
 				(long long int)i);
-		fprintf(stderr, "Pass 2 of 2.  Out of %lld, currently on:\n0",
-				(long long int)index->hashLength);
+		fprintf(stderr, "\rHash created.\n");
 	}
+}
 
-	/* Go through hash and reset all UINT_MAX starts */
-	for(i=index->hashLength-1, prevStart=UINT_MAX;
-			0<=i;
-			i--) {
-		if(VERBOSE >=0 && (index->hashLength-i)%RGINDEX_ROTATE_NUM == 0) {
-			fprintf(stderr, "\r%lld", 
-					(long long int)(index->hashLength-i));
+/* Returns 1 if the starts of the hash are coded, as recorded in the id of 
+ * the index */
+int32_t RGIndexHasWideStarts(RGIndex *index)
+{
+	return (BFAST_CODED_STARTS_ID == index->id) ? 1 : 0;
+}
+
+/* Gets the memory used by the starts of the hash, in bytes.  Before the 
+ * coded starts are read, the number of distinct hashes is bounded by the
+ * length of the index. */
+int64_t RGIndexGetStartsSize(RGIndex *index)
+{
+	int64_t numHashes;
+
+	if(0 == RGIndexHasWideStarts(index)) {
+		return sizeof(uint32_t)*index->hashLength;
+	}
+	numHashes = (NULL != index->startsHashes.high) ? index->startsHashes.length : GETMIN(index->length, index->hashLength);
+	return RGIndexEliasFanoGetSize(numHashes, index->hashLength) + 
+		RGIndexEliasFanoGetSize(numHashes + 1, index->length + 1);
+}
+
+/* Allocates the starts of the hash, with the given number of distinct 
+ * hashes if they are coded */
+void RGIndexStartsAllocate(RGIndex *index, int64_t numHashes)
+{
+	char *FnName = "RGIndexStartsAllocate";
+
+	if(0 == RGIndexHasWideStarts(index)) {
+		index->starts = malloc(sizeof(uint32_t)*index->hashLength);
+		if(NULL==index->starts) {
+			PrintError(FnName, "index->starts", "Could not allocate memory", Exit, MallocMemory);
 		}
-		if(UINT_MAX == index->starts[i]) {
-			index->starts[i] = prevStart;
+		return;
+	}
+	RGIndexEliasFanoAllocate(&index->startsHashes, numHashes, index->hashLength);
+	RGIndexEliasFanoAllocate(&index->startsEntries, numHashes + 1, index->length + 1);
+}
+
+/* Gets the start of the given hash, which is the length of the index if
+ * the hash and the hashes after it do not index anything */
+int64_t RGIndexGetStart(RGIndex *index, int64_t hashIndex)
+{
+	if(NULL != index->starts) {
+		return (UINT_MAX == index->starts[hashIndex]) ? index->length : index->starts[hashIndex];
+	}
+	/* The first entry of the first distinct hash not less than this one */
+	return RGIndexEliasFanoGet(&index->startsEntries, 
+			RGIndexEliasFanoRank(&index->startsHashes, hashIndex));
+}
+
+/* TODO */
+void RGIndexEliasFanoInitialize(RGIndexEliasFano *ef)
+{
+	ef->length = 0;
+	ef->universe = 0;
+	ef->lowBits = 0;
+	ef->low = NULL;
+	ef->high = NULL;
+	ef->select = NULL;
+	ef->buckets = NULL;
+}
+
+/* TODO */
+void RGIndexEliasFanoFree(RGIndexEliasFano *ef)
+{
+	free(ef->low);
+	free(ef->high);
+	free(ef->select);
+	free(ef->buckets);
+	RGIndexEliasFanoInitialize(ef);
+}
+
+/* Gets the number of 64-bit words of the low and high bits, and of the 
+ * select samples, for length values less than universe.  The low bits of 
+ * each value are the floor of log2 of universe/length, so the high bits 
+ * take at most two bits per value. */
+int32_t RGIndexEliasFanoGetNumWords(int64_t length,
+		int64_t universe,
+		int64_t *numLowWords,
+		int64_t *numHighWords,
+		int64_t *numSelect,
+		int64_t *numBuckets)
+{
+	int32_t lowBits;
+	int64_t numHigh;
+
+	for(lowBits=0;
+			lowBits < 62 && length <= (universe >> (lowBits + 1));
+			lowBits++) {
+	}
+	numHigh = ((universe - 1) >> lowBits) + 1;
+	/* One extra word so that a value may always be read from two words */
+	(*numLowWords) = RGINDEX_PACKED_NUM_WORDS(length, lowBits) + 1;
+	(*numHighWords) = ((length + numHigh) >> 6) + 1;
+	(*numSelect) = ((GETMAX(length, 1) - 1) >> RGINDEX_STARTS_SELECT_SHIFT) + 1;
+	(*numBuckets) = ((numHigh - 1) >> RGINDEX_STARTS_SELECT_SHIFT) + 1;
+	return lowBits;
+}
+
+/* Gets the memory used by length coded values less than universe, in bytes */
+int64_t RGIndexEliasFanoGetSize(int64_t length, int64_t universe)
+{
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+
+	RGIndexEliasFanoGetNumWords(length, universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	return sizeof(uint64_t)*(numLowWords + numHighWords) + sizeof(int64_t)*(numSelect + numBuckets);
+}
+
+/* Allocates length values less than universe, which are set with 
+ * RGIndexEliasFanoSet and then sampled with RGIndexEliasFanoSample */
+void RGIndexEliasFanoAllocate(RGIndexEliasFano *ef, int64_t length, int64_t universe)
+{
+	char *FnName = "RGIndexEliasFanoAllocate";
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+
+	ef->length = length;
+	ef->universe = universe;
+	ef->lowBits = RGIndexEliasFanoGetNumWords(length, universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	ef->low = calloc(numLowWords, sizeof(uint64_t));
+	if(NULL==ef->low) {
+		PrintError(FnName, "ef->low", "Could not allocate memory", Exit, MallocMemory);
+	}
+	ef->high = calloc(numHighWords, sizeof(uint64_t));
+	if(NULL==ef->high) {
+		PrintError(FnName, "ef->high", "Could not allocate memory", Exit, MallocMemory);
+	}
+	ef->select = calloc(numSelect, sizeof(int64_t));
+	if(NULL==ef->select) {
+		PrintError(FnName, "ef->select", "Could not allocate memory", Exit, MallocMemory);
+	}
+	ef->buckets = calloc(numBuckets, sizeof(int64_t));
+	if(NULL==ef->buckets) {
+		PrintError(FnName, "ef->buckets", "Could not allocate memory", Exit, MallocMemory);
+	}
+}
+
+/* Sets the i-th value, which must not be less than the value before it.  
+ * The values must be set in order. */
+void RGIndexEliasFanoSet(RGIndexEliasFano *ef, int64_t i, int64_t value)
+{
+	int64_t bit, high;
+	uint64_t low;
+	int32_t shift;
+
+	assert(0 <= i && i < ef->length);
+	assert(0 <= value && value < ef->universe);
+
+	/* The low bits, which may span two words */
+	if(0 < ef->lowBits) {
+		bit = i*ef->lowBits;
+		shift = bit & 63;
+		low = ((uint64_t)value) & ((((uint64_t)1) << ef->lowBits) - 1);
+		ef->low[bit >> 6] |= low << shift;
+		if(64 < shift + ef->lowBits) {
+			ef->low[(bit >> 6) + 1] |= low >> (64 - shift);
+		}
+	}
+	/* The high bits, in unary */
+	high = (value >> ef->lowBits) + i;
+	ef->high[high >> 6] |= ((uint64_t)1) << (high & 63);
+}
+
+/* Counts the set bits */
+static inline int32_t RGIndexPopCount(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int32_t)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* Gets the index of the lowest set bit, which must exist */
+static inline int32_t RGIndexLowestBit(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	int32_t i;
+	for(i=0;0 == ((x >> i) & 1);i++) {
+	}
+	return i;
+#endif
+}
+
+/* Gets the position of the rank-th set bit, counting from the given 
+ * position, which must be within the bits */
+static inline int64_t RGIndexSelectBit(uint64_t *words, int64_t bit, int64_t rank, uint64_t flip)
+{
+	int64_t word;
+	uint64_t bits;
+	int32_t numOnes;
+
+	word = bit >> 6;
+	bits = (words[word] ^ flip) & (~((uint64_t)0) << (bit & 63));
+	while(rank >= (numOnes = RGIndexPopCount(bits))) {
+		rank -= numOnes;
+		bits = words[++word] ^ flip;
+	}
+	for(;0 < rank;rank--) {
+		bits &= bits - 1;
+	}
+	return (word << 6) + RGIndexLowestBit(bits);
+}
+
+/* Samples the position of every 2^RGINDEX_STARTS_SELECT_SHIFT-th set bit
+ * and of every 2^RGINDEX_STARTS_SELECT_SHIFT-th zero in the high bits, 
+ * once all the values are set */
+void RGIndexEliasFanoSample(RGIndexEliasFano *ef)
+{
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+	int64_t word, numOnes, numZeros, next;
+	int32_t count;
+
+	RGIndexEliasFanoGetNumWords(ef->length, ef->universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	for(word=numOnes=numZeros=0;word<numHighWords;word++) {
+		count = RGIndexPopCount(ef->high[word]);
+		/* At most one sample of each falls in a word */
+		next = ((numOnes + (1 << RGINDEX_STARTS_SELECT_SHIFT) - 1) >> RGINDEX_STARTS_SELECT_SHIFT);
+		if(next < numSelect && (next << RGINDEX_STARTS_SELECT_SHIFT) < numOnes + count) {
+			ef->select[next] = RGIndexSelectBit(ef->high, word << 6, (next << RGINDEX_STARTS_SELECT_SHIFT) - numOnes, 0);
 		}
-		else {
-			prevStart = index->starts[i];
+		next = ((numZeros + (1 << RGINDEX_STARTS_SELECT_SHIFT) - 1) >> RGINDEX_STARTS_SELECT_SHIFT);
+		if(next < numBuckets && (next << RGINDEX_STARTS_SELECT_SHIFT) < numZeros + 64 - count) {
+			ef->buckets[next] = RGIndexSelectBit(ef->high, word << 6, (next << RGINDEX_STARTS_SELECT_SHIFT) - numZeros, ~((uint64_t)0));
 		}
+		numOnes += count;
+		numZeros += 64 - count;
 	}
-	if(VERBOSE >=0) {
-		fprintf(stderr, "\r%lld\n", 
-				(long long int)(index->hashLength));
+}
+
+/* Gets the low bits of the i-th value */
+static inline int64_t RGIndexEliasFanoGetLow(RGIndexEliasFano *ef, int64_t i)
+{
+	int64_t word;
+	uint64_t low;
+	int32_t shift;
+
+	if(0 == ef->lowBits) {
+		return 0;
+	}
+	shift = (i*ef->lowBits) & 63;
+	word = (i*ef->lowBits) >> 6;
+	low = ef->low[word] >> shift;
+	if(64 < shift + ef->lowBits) {
+		low |= ef->low[word + 1] << (64 - shift);
+	}
+	return low & ((((uint64_t)1) << ef->lowBits) - 1);
+}
+
+/* Gets the i-th value */
+int64_t RGIndexEliasFanoGet(RGIndexEliasFano *ef, int64_t i)
+{
+	int64_t bit;
+
+	assert(0 <= i && i < ef->length);
+	/* Find the set bit of this value in the high bits, from the closest
+	 * sampled one before it */
+	bit = RGIndexSelectBit(ef->high, 
+			ef->select[i >> RGINDEX_STARTS_SELECT_SHIFT], 
+			i & ((1 << RGINDEX_STARTS_SELECT_SHIFT) - 1), 
+			0);
+	return ((bit - i) << ef->lowBits) | RGIndexEliasFanoGetLow(ef, i);
+}
+
+/* Gets the number of values less than the given value, so the index of 
+ * the first value not less than it */
+int64_t RGIndexEliasFanoRank(RGIndexEliasFano *ef, int64_t value)
+{
+	int64_t bucket, bit, i, low;
+
+	assert(0 <= value && value < ef->universe);
+	/* The values with smaller high bits come before the zero ending the
+	 * previous high bucket */
+	bucket = value >> ef->lowBits;
+	bit = 0;
+	if(0 < bucket) {
+		bit = RGIndexSelectBit(ef->high, 
+				ef->buckets[(bucket - 1) >> RGINDEX_STARTS_SELECT_SHIFT], 
+				(bucket - 1) & ((1 << RGINDEX_STARTS_SELECT_SHIFT) - 1), 
+				~((uint64_t)0)) + 1;
+	}
+	i = bit - bucket;
+	/* Compare the low bits of the values in the same high bucket */
+	low = value & ((((int64_t)1) << ef->lowBits) - 1);
+	for(;0 != ((ef->high[bit >> 6] >> (bit & 63)) & 1) && RGIndexEliasFanoGetLow(ef, i) < low;bit++,i++) {
+	}
+	return i;
+}
+
+/* Writes the coded values, without the samples */
+void RGIndexEliasFanoWrite(gzFile fp, RGIndexEliasFano *ef)
+{
+	char *FnName = "RGIndexEliasFanoWrite";
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+
+	RGIndexEliasFanoGetNumWords(ef->length, ef->universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	if(gzwrite64(fp, ef->low, sizeof(uint64_t)*numLowWords)!=sizeof(uint64_t)*numLowWords ||
+			gzwrite64(fp, ef->high, sizeof(uint64_t)*numHighWords)!=sizeof(uint64_t)*numHighWords) {
+		PrintError(FnName, NULL, "Could not write coded values", Exit, WriteFileError);
+	}
+}
+
+/* Reads the coded values written by RGIndexEliasFanoWrite into the 
+ * allocated values, and samples them */
+void RGIndexEliasFanoRead(gzFile fp, RGIndexEliasFano *ef)
+{
+	char *FnName = "RGIndexEliasFanoRead";
+	int64_t numLowWords, numHighWords, numSelect, numBuckets;
+
+	RGIndexEliasFanoGetNumWords(ef->length, ef->universe, &numLowWords, &numHighWords, &numSelect, &numBuckets);
+	if(gzread64(fp, ef->low, sizeof(uint64_t)*numLowWords)!=sizeof(uint64_t)*numLowWords ||
+			gzread64(fp, ef->high, sizeof(uint64_t)*numHighWords)!=sizeof(uint64_t)*numHighWords) {
+		PrintError(FnName, NULL, "Could not read coded values", Exit, ReadFileError);
+	}
+	RGIndexEliasFanoSample(ef);
+}
+
+/* Stores the keys occurring more than threshold times in the index, with
+ * their number of occurrences, so that bfast match can reject them without
+ * searching the index.  Only keys without an N are stored, and the keys are
+ * packed two bits per base, so keys longer than 32 bases are not supported. */
+void RGIndexCreateKeyFilter(RGIndex *index, RGBinary *rg, int32_t threshold)
+{
+	char *FnName = "RGIndexCreateKeyFilter";
+	int64_t i, numKeys, length, runStart;
+	uint64_t curKey, prevKey=0;
+	int32_t curValid, prevValid=0, pass;
+
+	if(threshold <= 0) {
+		return;
+	}
+	if(32 < index->keysize) {
+		PrintError(FnName, "index->keysize", "The key filter is not supported for key sizes greater than 32, skipping", Warn, OutOfRange);
+		return;
 	}
 
-	/* Test pass 2 has creation */
-	/*
-	   for(i=0;i<index->hashLength;i++) {
-	   if(UINT_MAX == index->starts[i]) {
-	   break;
-	   }
-	   assert(0 <= index->starts[i]);
-	   assert(index->starts[i] < index->length);
-	   }
-	   while(i<index->hashLength) { // Last entries must be the maximum 
-	   assert(index->starts[i] == UINT_MAX);
-	   i++;
-	   }
-	   */
 	if(VERBOSE >= 0) {
-		fprintf(stderr, "\rHash created.\n");
+		fprintf(stderr, "Creating a key filter.\n");
+	}
+
+	/* Pass 1 counts the keys, pass 2 stores them */
+	for(pass=1,numKeys=0;pass<=2;pass++) {
+		if(2 == pass) {
+			if(0 == numKeys) {
+				break;
+			}
+			for(length=1;length<2*numKeys;length*=2) {
+				/* Keep the table at most half full */
+			}
+			RGIndexKeyFilterAllocate(index, length);
+			index->keyFilterThreshold = threshold;
+			index->keyFilterWidth = index->width;
+		}
+		/* The index is sorted, so equal keys are adjacent */
+		for(i=runStart=0;i<=index->length;i++) {
+			curValid = (i < index->length) ? RGIndexGetKey(index, rg, i, &curKey) : 0;
+			if(0 < i && (1 != curValid || 1 != prevValid || curKey != prevKey)) {
+				/* The previous run ended */
+				if(1 == prevValid && threshold < i - runStart) {
+					if(1 == pass) {
+						numKeys++;
+					}
+					else {
+						RGIndexKeyFilterInsert(index, prevKey, 
+								(UINT_MAX < i - runStart) ? UINT_MAX : (uint32_t)(i - runStart));
+					}
+				}
+				runStart = i;
+			}
+			prevValid = curValid;
+			prevKey = curKey;
+		}
+	}
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Key filter created with %lld keys.\n",
+				(long long int)index->keyFilterNumKeys);
 	}
 }
 
+/* Allocates an empty key filter with length slots */
+void RGIndexKeyFilterAllocate(RGIndex *index, int64_t length)
+{
+	char *FnName = "RGIndexKeyFilterAllocate";
+
+	assert(0 < length && 0 == (length & (length - 1)));
+	index->keyFilterNumKeys = 0;
+	index->keyFilterLength = length;
+	index->keyFilterKeys = malloc(sizeof(uint64_t)*length);
+	if(NULL == index->keyFilterKeys) {
+		PrintError(FnName, "index->keyFilterKeys", "Could not allocate memory", Exit, MallocMemory);
+	}
+	index->keyFilterCounts = calloc(length, sizeof(uint32_t));
+	if(NULL == index->keyFilterCounts) {
+		PrintError(FnName, "index->keyFilterCounts", "Could not allocate memory", Exit, MallocMemory);
+	}
+}
+
+/* Gets the first slot to probe for the key */
+static inline int64_t RGIndexKeyFilterGetSlot(RGIndex *index, uint64_t key)
+{
+	return (int64_t)(((key * 0x9E3779B97F4A7C15ULL) >> 32) & (index->keyFilterLength - 1));
+}
+
+/* TODO */
+void RGIndexKeyFilterInsert(RGIndex *index, uint64_t key, uint32_t count)
+{
+	int64_t slot;
+
+	assert(0 < count);
+	assert(index->keyFilterNumKeys < index->keyFilterLength);
+	for(slot = RGIndexKeyFilterGetSlot(index, key);
+			0 != index->keyFilterCounts[slot];
+			slot = (slot + 1) & (index->keyFilterLength - 1)) {
+		assert(key != index->keyFilterKeys[slot]);
+	}
+	index->keyFilterKeys[slot] = key;
+	index->keyFilterCounts[slot] = count;
+	index->keyFilterNumKeys++;
+}
+
+/* Returns the slot of the key, or -1 if the key is not in the filter */
+int64_t RGIndexKeyFilterFind(RGIndex *index, uint64_t key)
+{
+	int64_t slot;
+
+	for(slot = RGIndexKeyFilterGetSlot(index, key);
+			0 != index->keyFilterCounts[slot];
+			slot = (slot + 1) & (index->keyFilterLength - 1)) {
+		if(key == index->keyFilterKeys[slot]) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/* Returns the number of occurrences of the read's key if the key is in the
+ * filter, zero otherwise.  Since only keys with more than the threshold
+ * number of occurrences are stored, this is a lower bound. */
+uint32_t RGIndexKeyFilterGetCount(RGIndex *index, int8_t *read, int32_t readLength)
+{
+	uint64_t key;
+
+	if(0 == index->keyFilterLength ||
+			1 != RGIndexGetKeyFromRead(index, read, readLength, &key)) {
+		return 0;
+	}
+	return RGIndexKeyFilterGetCountFromKey(index, key);
+}
+
+/* As RGIndexKeyFilterGetCount, for a key already packed */
+uint32_t RGIndexKeyFilterGetCountFromKey(RGIndex *index, uint64_t key)
+{
+	int64_t slot;
+
+	if(0 == index->keyFilterLength) {
+		return 0;
+	}
+	slot = RGIndexKeyFilterFind(index, key);
+	return (slot < 0) ? 0 : index->keyFilterCounts[slot];
+}
+
+/* Runs the sort and merge threads of RGIndexSort.  bfast index sets this to
+ * ThreadPoolRun, so that the sort shares the workers of the command, while
+ * the tools that do not link the pool start a thread per task. */
+static void (*RGIndexThreadRunner)(void *(*)(void*), void*, size_t, int32_t) = RGIndexRunThreads;
+
+/* Sets the function running the threads of RGIndexSort */
+void RGIndexSetThreadRunner(void (*runner)(void *(*)(void*), void*, size_t, int32_t))
+{
+	RGIndexThreadRunner = (NULL == runner) ? RGIndexRunThreads : runner;
+}
+
+/* Runs the function on each of the numTasks arguments, each argSize bytes
+ * long, in its own thread, and waits for all of them to return */
+void RGIndexRunThreads(void *(*function)(void*),
+		void *args,
+		size_t argSize,
+		int32_t numTasks)
+{
+	char *FnName = "RGIndexRunThreads";
+	pthread_t *threads=NULL;
+	int32_t i, errCode;
+	void *status=NULL;
+
+	threads = malloc(sizeof(pthread_t)*numTasks);
+	if(NULL==threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numTasks;i++) {
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				function, /* start routine */
+				(char*)args + i*argSize); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+	for(i=0;i<numTasks;i++) {
+		errCode = pthread_join(threads[i],
+				&status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+	}
+	free(threads);
+}
+
 /* TODO */
 void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 {
@@ -726,9 +1239,6 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 	int64_t i, j;
 	ThreadRGIndexSortData *sortData=NULL;
 	ThreadRGIndexMergeData *mergeData=NULL;
-	pthread_t *threads=NULL;
-	int32_t errCode;
-	void *status=NULL;
 	double curPercentComplete = 0.0;
 	int32_t curNumThreads = numThreads;
 	int32_t curMergeIteration, curThread;
@@ -747,12 +1257,6 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 		if(NULL==sortData) {
 			PrintError(FnName, "sortData", "Could not allocate memory", Exit, MallocMemory);
 		}
-		/* Allocate memory for the thread point32_ters */
-		threads = malloc(sizeof(pthread_t)*numThreads);
-		if(NULL==threads) {
-			PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-		}
-
 		/* Merge sort with tmp file I/O */
 
 		/* Initialize sortData */
@@ -778,36 +1282,12 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 			assert(sortData[i-1].high < sortData[i].low);
 		}
 
-		/* Create threads */
-		for(i=0;i<numThreads;i++) {
-			/* Start thread */
-			errCode = pthread_create(&threads[i], /* thread struct */
-					NULL, /* default thread attributes */
-					RGIndexMergeSort, /* start routine */
-					(void*)(&sortData[i])); /* sortData to routine */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-			}
-		}
-
-		/* Wait for the threads to finish */
-		for(i=0;i<numThreads;i++) {
-			/* Wait for the given thread to return */
-			errCode = pthread_join(threads[i],
-					&status);
-			/* Check the return code of the thread */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-			}
-			if(i==numThreads-1 && VERBOSE >= 0) {
-				fprintf(stderr, "\rWaiting for other threads to complete...");
-			}
+		/* Run the threads */
+		RGIndexThreadRunner(RGIndexMergeSort, sortData, sizeof(ThreadRGIndexSortData), numThreads);
+		if(VERBOSE >= 0) {
+			fprintf(stderr, "\rWaiting for other threads to complete...");
 		}
 
-		/* Free memory for the threads */
-		free(threads);
-		threads=NULL;
-
 		/* Now we must merge the results from the threads */
 		/* Merge intelligently i.e. merge recursively so 
 		 * there are only nlogn merges where n is the 
@@ -827,11 +1307,6 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 			if(NULL==mergeData) {
 				PrintError(FnName, "mergeData", "Could not allocate memory", Exit, MallocMemory);
 			}
-			/* Allocate memory for the thread point32_ters */
-			threads = malloc(sizeof(pthread_t)*curNumThreads);
-			if(NULL==threads) {
-				PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-			}
 			/* Initialize data for threads */
 			for(j=0,curThread=0;j<numThreads;j+=2*i,curThread++) {
 				mergeData[curThread].index = index;
@@ -851,35 +1326,12 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 				}
 			}
 
-			/* Create threads */
-			for(j=0;j<curNumThreads;j++) {
-				/* Start thread */
-				errCode = pthread_create(&threads[j], /* thread struct */
-						NULL, /* default thread attributes */
-						RGIndexMerge, /* start routine */
-						(void*)(&mergeData[j])); /* sortData to routine */
-				if(0!=errCode) {
-					PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-				}
-			}
-
-			/* Wait for the threads to finish */
-			for(j=0;j<curNumThreads;j++) {
-				/* Wait for the given thread to return */
-				errCode = pthread_join(threads[j],
-						&status);
-				/* Check the return code of the thread */
-				if(0!=errCode) {
-					PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-				}
-			}
+			/* Run the threads */
+			RGIndexThreadRunner(RGIndexMerge, mergeData, sizeof(ThreadRGIndexMergeData), curNumThreads);
 
 			/* Free memory for the merge data */
 			free(mergeData);
 			mergeData=NULL;
-			/* Free memory for the threads */
-			free(threads);
-			threads=NULL;
 		}
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "\nMerge complete.\n");
@@ -1327,7 +1779,7 @@ typedef struct {
     uint32_t *positions;
     uint32_t index;
     uint32_t length; // # of entries in memory
-    uint32_t numLeft; // # of entries left to process
+    int64_t numLeft; // # of entries left to process
     int32_t eof;
     int32_t hasMore;
 } RGIndexMergeHelper_8_t;
@@ -1526,7 +1978,7 @@ typedef struct {
     uint32_t *positions;
     uint32_t index;
     uint32_t length; // # of entries in memory
-    uint32_t numLeft; // # of entries left to process
+    int64_t numLeft; // # of entries left to process
     int32_t eof;
     int32_t hasMore;
 } RGIndexMergeHelper_32_t;
@@ -1724,6 +2176,12 @@ void RGIndexDelete(RGIndex *index)
 	free(index->positions);
 	free(index->mask);
 	free(index->starts);
+	RGIndexEliasFanoFree(&index->startsHashes);
+	RGIndexEliasFanoFree(&index->startsEntries);
+	free(index->keyFilterKeys);
+	free(index->keyFilterCounts);
+	free(index->packed);
+	free(index->packedContigStarts);
 	free(index->packageVersion);
 
 	RGIndexInitialize(index);
@@ -1734,14 +2192,23 @@ double RGIndexGetSize(RGIndex *index, int32_t outputSize)
 {
 	double total=0.0;
 
-	/* memory used by positions */
-	total += (index->contigType==Contig_8)?(sizeof(uint8_t)*index->length):(sizeof(uint32_t)*index->length);
-	/* memory used by positions */
-	total += sizeof(uint32_t)*index->length;
+	if(0 < index->packedWidth) {
+		/* memory used by the packed contigs and positions */
+		total += sizeof(uint64_t)*RGINDEX_PACKED_NUM_WORDS(index->length, index->packedWidth);
+		total += sizeof(int64_t)*(index->packedNumContigs + 1);
+	}
+	else {
+		/* memory used by positions */
+		total += (index->contigType==Contig_8)?(sizeof(uint8_t)*index->length):(sizeof(uint32_t)*index->length);
+		/* memory used by positions */
+		total += sizeof(uint32_t)*index->length;
+	}
 	/* memory used by the mask */
 	total += sizeof(int32_t)*index->width;
 	/* memory used by starts */
-	total += sizeof(uint32_t)*index->hashLength;
+	total += RGIndexGetStartsSize(index);
+	/* memory used by the key filter */
+	total += (sizeof(uint64_t) + sizeof(uint32_t))*index->keyFilterLength;
 	/* memory used by the index base structure */
 	total += sizeof(RGIndex); 
 
@@ -1773,23 +2240,48 @@ void RGIndexPrint(gzFile fp, RGIndex *index)
 		/* Print positions */
 		if(gzwrite64(fp, index->positions, sizeof(uint32_t)*index->length)!=sizeof(uint32_t)*index->length || 
 				/* Print chomosomes */
-				gzwrite64(fp, index->contigs_8, sizeof(uint8_t)*index->length)!=sizeof(uint8_t)*index->length ||
-				/* Print the starts */
-				gzwrite64(fp, index->starts, sizeof(uint32_t)*index->hashLength)!=sizeof(uint32_t)*index->hashLength) {
-			PrintError(FnName, NULL, "Could not write index and hash", Exit, WriteFileError);
+				gzwrite64(fp, index->contigs_8, sizeof(uint8_t)*index->length)!=sizeof(uint8_t)*index->length) {
+			PrintError(FnName, NULL, "Could not write index", Exit, WriteFileError);
 		}
 	}
 	else {
 		/* Print positions */
 		if(gzwrite64(fp, index->positions, sizeof(uint32_t)*index->length)!=sizeof(uint32_t)*index->length || 
 				/* Print chomosomes */
-				gzwrite64(fp, index->contigs_32, sizeof(uint32_t)*index->length)!=sizeof(uint32_t)*index->length ||
-				/* Print the starts */
-				gzwrite64(fp, index->starts, sizeof(uint32_t)*index->hashLength)!=sizeof(uint32_t)*index->hashLength) {
-			PrintError(FnName, NULL, "Could not write index and hash", Exit, WriteFileError);
+				gzwrite64(fp, index->contigs_32, sizeof(uint32_t)*index->length)!=sizeof(uint32_t)*index->length) {
+			PrintError(FnName, NULL, "Could not write index", Exit, WriteFileError);
+		}
+	}
+
+	/* Print the starts */
+	if(0 == RGIndexHasWideStarts(index)) {
+		if(gzwrite64(fp, index->starts, sizeof(uint32_t)*index->hashLength)!=sizeof(uint32_t)*index->hashLength) {
+			PrintError(FnName, NULL, "Could not write hash", Exit, WriteFileError);
+		}
+	}
+	else {
+		/* The number of distinct hashes, then the coded starts */
+		if(gzwrite64(fp, &index->startsHashes.length, sizeof(int64_t))!=sizeof(int64_t)) {
+			PrintError(FnName, NULL, "Could not write hash", Exit, WriteFileError);
 		}
+		RGIndexEliasFanoWrite(fp, &index->startsHashes);
+		RGIndexEliasFanoWrite(fp, &index->startsEntries);
 	}
 
+	/* Print the key filter, if any, after the hash so that older versions 
+	 * can still read the index */
+	if(0 < index->keyFilterNumKeys) {
+		if(gzwrite64(fp, &index->keyFilterNumKeys, sizeof(int64_t))!=sizeof(int64_t) ||
+				gzwrite64(fp, &index->keyFilterLength, sizeof(int64_t))!=sizeof(int64_t) ||
+				gzwrite64(fp, &index->keyFilterThreshold, sizeof(int32_t))!=sizeof(int32_t) ||
+				gzwrite64(fp, &index->keyFilterWidth, sizeof(int32_t))!=sizeof(int32_t) ||
+				gzwrite64(fp, index->keyFilterKeys, sizeof(uint64_t)*index->keyFilterLength)!=sizeof(uint64_t)*index->keyFilterLength ||
+				gzwrite64(fp, index->keyFilterCounts, sizeof(uint32_t)*index->keyFilterLength)!=sizeof(uint32_t)*index->keyFilterLength) {
+			PrintError(FnName, NULL, "Could not write the key filter", Exit, WriteFileError);
+		}
+	}
+
+	MetricsCountGZ(MetricsBytesOut, fp);
 	gzclose(fp);
 }
 
@@ -1799,6 +2291,7 @@ void RGIndexRead(RGIndex *index, char *rgIndexFileName)
 	char *FnName="RGIndexRead";
 
 	gzFile fp;
+	int64_t numKeys, length, numHashes=0;
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Reading index from %s.\n",
@@ -1851,18 +2344,48 @@ void RGIndexRead(RGIndex *index, char *rgIndexFileName)
 		}
 	}
 
-	/* Allocate memory for the starts */
-	index->starts = malloc(sizeof(uint32_t)*index->hashLength);
-	if(NULL == index->starts) {
-		PrintError(FnName, "index->starts", "Could not allocate memory", Exit, MallocMemory);
+	/* Coded starts are preceded by the number of distinct hashes */
+	if(1 == RGIndexHasWideStarts(index)) {
+		if(gzread64(fp, &numHashes, sizeof(int64_t))!=sizeof(int64_t) ||
+				numHashes <= 0 || 
+				index->length < numHashes ||
+				index->hashLength < numHashes) {
+			PrintError(FnName, NULL, "Could not read in the number of distinct hashes", Exit, ReadFileError);
+		}
 	}
 
+	/* Allocate memory for the starts */
+	RGIndexStartsAllocate(index, numHashes);
+
 	/* Read in starts */
-	if(gzread64(fp, index->starts, sizeof(uint32_t)*index->hashLength)!=sizeof(uint32_t)*index->hashLength) {
-		PrintError(FnName, NULL, "Could not read in starts", Exit, ReadFileError);
+	if(0 == RGIndexHasWideStarts(index)) {
+		if(gzread64(fp, index->starts, sizeof(uint32_t)*index->hashLength)!=sizeof(uint32_t)*index->hashLength) {
+			PrintError(FnName, NULL, "Could not read in starts", Exit, ReadFileError);
+		}
+	}
+	else {
+		RGIndexEliasFanoRead(fp, &index->startsHashes);
+		RGIndexEliasFanoRead(fp, &index->startsEntries);
+	}
+
+	/* Read in the key filter, which is absent if nothing follows the hash */
+	if(gzread64(fp, &numKeys, sizeof(int64_t))==sizeof(int64_t) && 0 < numKeys) {
+		if(gzread64(fp, &length, sizeof(int64_t))!=sizeof(int64_t) ||
+				length < numKeys) {
+			PrintError(FnName, NULL, "Could not read in the key filter length", Exit, ReadFileError);
+		}
+		RGIndexKeyFilterAllocate(index, length);
+		if(gzread64(fp, &index->keyFilterThreshold, sizeof(int32_t))!=sizeof(int32_t) ||
+				gzread64(fp, &index->keyFilterWidth, sizeof(int32_t))!=sizeof(int32_t) ||
+				gzread64(fp, index->keyFilterKeys, sizeof(uint64_t)*length)!=sizeof(uint64_t)*length ||
+				gzread64(fp, index->keyFilterCounts, sizeof(uint32_t)*length)!=sizeof(uint32_t)*length) {
+			PrintError(FnName, NULL, "Could not read in the key filter", Exit, ReadFileError);
+		}
+		index->keyFilterNumKeys = numKeys;
 	}
 
 	/* close file */
+	MetricsCountGZ(MetricsBytesIn, fp);
 	gzclose(fp);
 
 	if(VERBOSE >= 0) {
@@ -1871,6 +2394,127 @@ void RGIndexRead(RGIndex *index, char *rgIndexFileName)
 	}
 }
 
+/* Replaces the contigs and positions with one coordinate per entry, stored
+ * in as few bits as the largest coordinate needs.  The coordinate is the
+ * position plus the first coordinate of the contig, so that the contig is
+ * found with a binary search over the contigs in the index.  This is only
+ * for searching the index, so it can no longer be sorted or written. */
+void RGIndexPack(RGIndex *index)
+{
+	char *FnName="RGIndexPack";
+	int64_t i, bit;
+	uint64_t coordinate, total;
+	uint32_t contig, position, endContig;
+	int32_t shift;
+	double size;
+
+	if(0 < index->packedWidth || index->length <= 0) {
+		return;
+	}
+	size = RGIndexGetSize(index, MEGABYTES);
+
+	/* Get the contigs in the index */
+	index->packedStartContig = UINT_MAX;
+	for(i=0,endContig=0;i<index->length;i++) {
+		contig = (index->contigType==Contig_8)?index->contigs_8[i]:index->contigs_32[i];
+		index->packedStartContig = GETMIN(index->packedStartContig, contig);
+		endContig = GETMAX(endContig, contig);
+	}
+	index->packedNumContigs = endContig - index->packedStartContig + 1;
+	index->packedContigStarts = calloc(index->packedNumContigs + 1, sizeof(int64_t));
+	if(NULL == index->packedContigStarts) {
+		PrintError(FnName, "index->packedContigStarts", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Each contig is as long as its last position in the index */
+	for(i=0;i<index->length;i++) {
+		contig = (index->contigType==Contig_8)?index->contigs_8[i]:index->contigs_32[i];
+		contig -= index->packedStartContig;
+		index->packedContigStarts[contig+1] = GETMAX(index->packedContigStarts[contig+1], 
+				((int64_t)index->positions[i]) + 1);
+	}
+	for(i=0;i<index->packedNumContigs;i++) {
+		index->packedContigStarts[i+1] += index->packedContigStarts[i];
+	}
+	total = index->packedContigStarts[index->packedNumContigs];
+	for(index->packedWidth=1;
+			index->packedWidth < 64 && 0 != ((total - 1) >> index->packedWidth);
+			index->packedWidth++) {
+		/* Get the number of bits for the largest coordinate */
+	}
+
+	index->packed = calloc(RGINDEX_PACKED_NUM_WORDS(index->length, index->packedWidth), sizeof(uint64_t));
+	if(NULL == index->packed) {
+		PrintError(FnName, "index->packed", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<index->length;i++) {
+		contig = (index->contigType==Contig_8)?index->contigs_8[i]:index->contigs_32[i];
+		position = index->positions[i];
+		coordinate = index->packedContigStarts[contig - index->packedStartContig] + position;
+		bit = i*index->packedWidth;
+		shift = bit & 63;
+		index->packed[bit >> 6] |= coordinate << shift;
+		if(64 < shift + index->packedWidth) {
+			index->packed[(bit >> 6) + 1] |= coordinate >> (64 - shift);
+		}
+	}
+
+	free(index->contigs_8);
+	free(index->contigs_32);
+	free(index->positions);
+	index->contigs_8 = NULL;
+	index->contigs_32 = NULL;
+	index->positions = NULL;
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Packed the index from %.2lfMB to %.2lfMB (%d bits per entry).\n",
+				size,
+				RGIndexGetSize(index, MEGABYTES),
+				index->packedWidth);
+	}
+}
+
+/* Gets the contig and position of the a-th entry */
+void RGIndexGetContigPos(RGIndex *index,
+		int64_t a,
+		uint32_t *contig,
+		uint32_t *position)
+{
+	int64_t bit;
+	uint64_t coordinate;
+	int32_t shift, low, mid, high;
+
+	if(0 == index->packedWidth) {
+		(*contig) = (index->contigType==Contig_8)?index->contigs_8[a]:index->contigs_32[a];
+		(*position) = index->positions[a];
+		return;
+	}
+
+	/* Unpack the coordinate */
+	bit = a*index->packedWidth;
+	shift = bit & 63;
+	coordinate = index->packed[bit >> 6] >> shift;
+	if(64 < shift + index->packedWidth) {
+		coordinate |= index->packed[(bit >> 6) + 1] << (64 - shift);
+	}
+	coordinate &= (((uint64_t)1) << index->packedWidth) - 1;
+
+	/* Find the last contig starting at or before the coordinate */
+	low = 0;
+	high = index->packedNumContigs - 1;
+	while(low < high) {
+		mid = (low + high + 1) >> 1;
+		if(index->packedContigStarts[mid] <= coordinate) {
+			low = mid;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	(*contig) = index->packedStartContig + low;
+	(*position) = coordinate - index->packedContigStarts[low];
+}
+
 /* TODO */
 /* Debugging function */
 void RGIndexPrintInfo(char *inputFileName)
@@ -1970,6 +2614,10 @@ void RGIndexGetHeader(char *inputFileName, RGIndex *index)
 void RGIndexReadHeader(gzFile fp, RGIndex *index) 
 {
 	char *FnName = "RGIndexReadHeader";
+
+	/* The index may not have been initialized */
+	RGIndexInitialize(index);
+
 	/* Read in header */
 	if(gzread64(fp, &index->id, sizeof(int32_t))!=sizeof(int32_t) ||
 			gzread64(fp, &index->packageVersionLength, sizeof(int32_t))!=sizeof(int32_t)) {
@@ -2010,7 +2658,9 @@ void RGIndexReadHeader(gzFile fp, RGIndex *index)
 	}
 
 	/* Error checking */
-	assert(index->id == (int)BFAST_ID);
+	if(index->id != (int)BFAST_ID && index->id != (int)BFAST_CODED_STARTS_ID) {
+		PrintError(FnName, "index->id", "Not a bfast index, or written by a newer version", Exit, OutOfRange);
+	}
 	CheckPackageCompatibility(index->packageVersion, BFASTIndexFile);
 	assert(index->length > 0);
 	assert(index->contigType == Contig_8 || index->contigType == Contig_32);
@@ -2055,7 +2705,9 @@ int64_t RGIndexGetRanges(RGIndex *index, RGBinary *rg, int8_t *read, int32_t rea
 
 /* TODO */
 /* We will append the matches if matches have already been found */
-int32_t RGIndexGetRangesBothStrands(RGIndex *index, RGBinary *rg, int8_t *read, int32_t readLength, int32_t offset, int32_t maxKeyMatches, int32_t maxNumMatches, int32_t space, int32_t strands, RGRanges *r)
+/* The keys, if given, are those of the whole read from RGIndexKeysCompute,
+ * with the read at the given offset in the whole read */
+int32_t RGIndexGetRangesBothStrands(RGIndex *index, RGBinary *rg, int8_t *read, int32_t readLength, int32_t offset, int32_t maxKeyMatches, int32_t maxNumMatches, int32_t space, int32_t strands, RGIndexKeys *keys, RGRanges *r)
 {
 	int64_t startIndexForward=0;
 	int64_t startIndexReverse=0;
@@ -2065,19 +2717,17 @@ int32_t RGIndexGetRangesBothStrands(RGIndex *index, RGBinary *rg, int8_t *read,
 	int64_t foundIndexReverse=0;
 	int64_t numMatches=0;
 	int toAdd=0;
-	int8_t reverseRead[SEQUENCE_LENGTH];
+	int8_t reverseReadBuffer[SEQUENCE_LENGTH];
+	int8_t *reverseRead=reverseReadBuffer;
+	int64_t forward=-1, reverse=-1;
 
-	/* Forward */
-	if(BothStrands == strands || ForwardStrand == strands) {
-		foundIndexForward = RGIndexGetRanges(index,
-				rg,
-				read,
-				readLength,
-				&startIndexForward,
-				&endIndexForward);
+	if(NULL != keys) {
+		/* The reverse of the read is in the reverse of the whole read */
+		reverseRead = keys->reverseRead + keys->readLength - offset - index->width;
+		forward = offset;
+		reverse = keys->numOffsets + offset;
 	}
-	/* Reverse */
-	if(BothStrands == strands || ReverseStrand == strands) {
+	else if(BothStrands == strands || ReverseStrand == strands) {
 		if(space==ColorSpace) {
 			/* In color space, the reverse compliment is just the reverse of the colors */
 			ReverseReadFourBit(read, reverseRead, readLength);
@@ -2087,13 +2737,69 @@ int32_t RGIndexGetRangesBothStrands(RGIndex *index, RGBinary *rg, int8_t *read,
 			/* Get the reverse compliment */
 			GetReverseComplimentFourBit(read, reverseRead, readLength);
 		}
+	}
 
-		foundIndexReverse = RGIndexGetRanges(index,
-				rg,
-				reverseRead,
-				readLength,
-				&startIndexReverse,
-				&endIndexReverse);
+	/* Ignore the key without searching if the key filter already has too 
+	 * many matches.  The filter is not used if the key was shortened. */
+	if(0 < index->keyFilterLength && index->width == index->keyFilterWidth) {
+		if(BothStrands == strands || ForwardStrand == strands) {
+			if(NULL == keys) {
+				numMatches += RGIndexKeyFilterGetCount(index, read, readLength);
+			}
+			else if(1 == keys->hasKeys && 1 == keys->valid[forward]) {
+				numMatches += RGIndexKeyFilterGetCountFromKey(index, keys->keys[forward]);
+			}
+		}
+		if(BothStrands == strands || ReverseStrand == strands) {
+			if(NULL == keys) {
+				numMatches += RGIndexKeyFilterGetCount(index, reverseRead, readLength);
+			}
+			else if(1 == keys->hasKeys && 1 == keys->valid[reverse]) {
+				numMatches += RGIndexKeyFilterGetCountFromKey(index, keys->keys[reverse]);
+			}
+		}
+		if(maxKeyMatches < numMatches) {
+			return 1;
+		}
+	}
+
+	/* Forward */
+	if(BothStrands == strands || ForwardStrand == strands) {
+		if(NULL == keys) {
+			foundIndexForward = RGIndexGetRanges(index,
+					rg,
+					read,
+					readLength,
+					&startIndexForward,
+					&endIndexForward);
+		}
+		else if(1 == keys->valid[forward]) {
+			foundIndexForward = RGIndexGetIndexFromHash(index,
+					rg,
+					read,
+					keys->hashIndex[forward],
+					&startIndexForward,
+					&endIndexForward);
+		}
+	}
+	/* Reverse */
+	if(BothStrands == strands || ReverseStrand == strands) {
+		if(NULL == keys) {
+			foundIndexReverse = RGIndexGetRanges(index,
+					rg,
+					reverseRead,
+					readLength,
+					&startIndexReverse,
+					&endIndexReverse);
+		}
+		else if(1 == keys->valid[reverse]) {
+			foundIndexReverse = RGIndexGetIndexFromHash(index,
+					rg,
+					reverseRead,
+					keys->hashIndex[reverse],
+					&startIndexReverse,
+					&endIndexReverse);
+		}
 	}
 
 	/* Update the number of matches */
@@ -2151,6 +2857,23 @@ int64_t RGIndexGetIndex(RGIndex *index,
 		int32_t readLength,
 		int64_t *startIndex,
 		int64_t *endIndex)
+{
+	/* Use hash to restrict low and high */
+	return RGIndexGetIndexFromHash(index,
+			rg,
+			read,
+			RGIndexGetHashIndexFromRead(index, rg, read, readLength, 0),
+			startIndex,
+			endIndex);
+}
+
+/* Searches the index for the read, whose hash index is given */
+int64_t RGIndexGetIndexFromHash(RGIndex *index,
+		RGBinary *rg,
+		int8_t *read,
+		int64_t hashIndex,
+		int64_t *startIndex,
+		int64_t *endIndex)
 {
 	int32_t cmp;
 	int32_t cont = 1;
@@ -2158,36 +2881,28 @@ int64_t RGIndexGetIndex(RGIndex *index,
 	int32_t tmpLowNumBasesEqual, tmpHighNumBasesEqual, tmpMidNumBasesEqual;
 	int64_t low, high, mid=-1;
 	int32_t lowNumBasesEqual, highNumBasesEqual, midNumBasesEqual;
-	uint32_t hashIndex;
 
-	/* Use hash to restrict low and high */
-	hashIndex = RGIndexGetHashIndexFromRead(index, rg, read, readLength, 0);
-	if(UINT_MAX == hashIndex) {
+	if(hashIndex < 0) {
 		/* Did not fall in this bin */
 		return 0;
 	}
 	//assert(0 <= hashIndex && hashIndex < index->hashLength);
-	if(UINT_MAX == index->starts[hashIndex]) {
+	low = RGIndexGetStart(index, hashIndex);
+	if(index->length == low) {
 		/* The hash from this point on does not index anything */
 		return 0;
 	}
 	else if(index->hashLength - 1 == hashIndex) {
 		/* The end must point to entries in the index */
-		low = index->starts[hashIndex];
 		high = index->length - 1;
 	}
-	else if(index->starts[hashIndex] < index->starts[hashIndex+1]) {
-		low = index->starts[hashIndex];
-		/* Check to see if this goes all the way to the end of the index */
-		if(UINT_MAX == index->starts[hashIndex+1]) {
-			high = index->length - 1;
-		}
-		else {
-			high = index->starts[hashIndex+1] - 1;
-		}
-	}
 	else {
-		return 0;
+		/* This goes all the way to the end of the index if the next hash
+		 * does not index anything */
+		high = RGIndexGetStart(index, hashIndex+1) - 1;
+		if(high < low) {
+			return 0;
+		}
 	}
 
 	/*
@@ -2201,7 +2916,7 @@ int64_t RGIndexGetIndex(RGIndex *index,
 	   fprintf(stderr, "%1c", "ACGTN"[read[i]]);
 	   }
 	   fprintf(stderr, "\n");
-	   fprintf(stderr, "hashIndex=%u\n", hashIndex);
+	   fprintf(stderr, "hashIndex=%lld\n", (long long int)hashIndex);
 	   */
 
 	//assert(low <= high);
@@ -2511,11 +3226,12 @@ int32_t RGIndexCompareRead(RGIndex *index,
 	//assert(a>=0 && a<index->length);
 
 	int32_t i;
-	uint32_t aContig = (index->contigType==Contig_8)?index->contigs_8[a]:index->contigs_32[a];
-	uint32_t aPos = index->positions[a];
+	uint32_t aContig, aPos;
 
 	uint8_t aBase;
 
+	RGIndexGetContigPos(index, a, &aContig, &aPos);
+
 	/*
 	   if(debug > 0) {
 	   fprintf(stderr, "%d\n%s", 
@@ -2562,9 +3278,9 @@ int32_t RGIndexCompareRead(RGIndex *index,
 }
 
 /* TODO */
-uint32_t RGIndexGetHashIndex(RGIndex *index,
+int64_t RGIndexGetHashIndex(RGIndex *index,
 		RGBinary *rg,
-		uint32_t a, // index in the index
+		int64_t a, // index in the index
 		int debug)
 {
 	//assert(a>=0 && a<index->length);
@@ -2572,13 +3288,14 @@ uint32_t RGIndexGetHashIndex(RGIndex *index,
 	char *FnName = "RGIndexGetHashIndex";
 
 	int32_t i;
-	uint32_t aContig = (index->contigType==Contig_8)?index->contigs_8[a]:index->contigs_32[a];
-	uint32_t aPos = index->positions[a];
+	uint32_t aContig, aPos;
 	char aBase;
 	int32_t cur = index->hashWidth-1;
-	uint32_t hashIndex = 0;
+	int64_t hashIndex = 0;
 	assert(ALPHABET_SIZE == 4);
 
+	RGIndexGetContigPos(index, a, &aContig, &aPos);
+
 	for(cur=i=0;cur<index->depth;i++) { // Skip over the first (depth) bases 
 		switch(index->mask[i]) {
 			case 0:
@@ -2608,15 +3325,15 @@ uint32_t RGIndexGetHashIndex(RGIndex *index,
 						break;
 					case 1:
 					case 'c':
-						hashIndex += pow(ALPHABET_SIZE, cur);
+						hashIndex += ((int64_t)1) << (2*cur);
 						break;
 					case 2:
 					case 'g':
-						hashIndex += pow(ALPHABET_SIZE, cur)*2;
+						hashIndex += ((int64_t)2) << (2*cur);
 						break;
 					case 3:
 					case 't':
-						hashIndex += pow(ALPHABET_SIZE, cur)*3;
+						hashIndex += ((int64_t)3) << (2*cur);
 						break;
 					default:
 						PrintError(FnName, "aBase", "Could not understand base", Exit, OutOfRange);
@@ -2634,7 +3351,7 @@ uint32_t RGIndexGetHashIndex(RGIndex *index,
 }
 
 /* TODO */
-uint32_t RGIndexGetHashIndexFromRead(RGIndex *index,
+int64_t RGIndexGetHashIndexFromRead(RGIndex *index,
 		RGBinary *rg,
 		int8_t *read,
 		int32_t readLength,
@@ -2643,7 +3360,7 @@ uint32_t RGIndexGetHashIndexFromRead(RGIndex *index,
 	char *FnName = "RGIndexGetHashIndexFromRead";
 	int32_t i=0;
 	int32_t cur = 0;
-	uint32_t hashIndex = 0;
+	int64_t hashIndex = 0;
 
 	if(0 < index->depth) {
 		/* Check if we are in the correct bin */
@@ -2662,7 +3379,7 @@ uint32_t RGIndexGetHashIndexFromRead(RGIndex *index,
 			}
 		}
 		if(hashIndex != index->binNumber - 1) {
-			return UINT_MAX;
+			return -1;
 		}
 	}
 
@@ -2686,6 +3403,220 @@ uint32_t RGIndexGetHashIndexFromRead(RGIndex *index,
 	return hashIndex;
 }
 
+/* Packs the masked bases of the a-th entry two bits per base.  Returns 0
+ * if a masked base is an N. */
+int32_t RGIndexGetKey(RGIndex *index,
+		RGBinary *rg,
+		int64_t a,
+		uint64_t *key)
+{
+	int32_t i;
+	uint32_t aContig, aPos;
+	uint8_t aBase;
+
+	RGIndexGetContigPos(index, a, &aContig, &aPos);
+	(*key) = 0;
+	for(i=0;i<index->width;i++) {
+		if(1 == index->mask[i]) {
+			/* Same as in RGIndexCompareRead */
+			aBase = RGBinaryGetFourBit(rg, aContig, aPos + i);
+			aBase = ((aBase >> 2) == 2) ? 4 : (aBase & 0x03);
+			if(4 == aBase) {
+				return 0;
+			}
+			(*key) = ((*key) << 2) | aBase;
+		}
+	}
+	return 1;
+}
+
+/* Packs the masked bases of the read two bits per base.  Returns 0 if a 
+ * masked base is an N. */
+int32_t RGIndexGetKeyFromRead(RGIndex *index,
+		int8_t *read,
+		int32_t readLength,
+		uint64_t *key)
+{
+	int32_t i;
+
+	(*key) = 0;
+	for(i=0;i<index->width;i++) {
+		if(1 == index->mask[i]) {
+			if(readLength <= i || 4 == read[i]) {
+				return 0;
+			}
+			(*key) = ((*key) << 2) | read[i];
+		}
+	}
+	return 1;
+}
+
+/* TODO */
+void RGIndexKeysInitialize(RGIndexKeys *keys)
+{
+	keys->readLength = 0;
+	keys->numOffsets = 0;
+	keys->maxNumOffsets = 0;
+	keys->hasKeys = 0;
+	keys->valid = NULL;
+	keys->hashIndex = NULL;
+	keys->keys = NULL;
+}
+
+/* TODO */
+void RGIndexKeysFree(RGIndexKeys *keys)
+{
+	free(keys->valid);
+	free(keys->hashIndex);
+	free(keys->keys);
+	RGIndexKeysInitialize(keys);
+}
+
+/* Packs the read two bits per base, with the first base in the highest
+ * bits.  Returns 1 if the read has an N, which is packed as an A. */
+static int32_t RGIndexKeysPack(int8_t *read, int32_t readLength, uint64_t *packed)
+{
+	int32_t i, hasN = 0;
+	uint64_t base;
+
+	memset(packed, 0, sizeof(uint64_t)*((readLength >> 5) + 2));
+	for(i=0;i<readLength;i++) {
+		base = read[i];
+		if(4 == base) {
+			hasN = 1;
+			base = 0;
+		}
+		packed[i >> 5] |= base << (62 - 2*(i & 31));
+	}
+	return hasN;
+}
+
+/* Gets the length (at most 32) bases from the packed read starting at the
+ * given position */
+static inline uint64_t RGIndexKeysGetBases(uint64_t *packed, int32_t pos, int32_t length)
+{
+	int32_t shift = 2*(pos & 31);
+	uint64_t bits = packed[pos >> 5] << shift;
+
+	if(0 < shift) {
+		bits |= packed[(pos >> 5) + 1] >> (64 - shift);
+	}
+	return bits >> (64 - 2*length);
+}
+
+/* Computes the hash index and the key of the read at every offset on both
+ * strands, so that consecutive offsets do not each reverse the read and 
+ * walk the mask.  The read is packed once per strand, and the key at each
+ * offset is gathered from the packed read one run of consecutive masked 
+ * bases at a time. */
+void RGIndexKeysCompute(RGIndex *index,
+		int8_t *read,
+		int32_t readLength,
+		int32_t space,
+		int32_t strands,
+		RGIndexKeys *keys)
+{
+	char *FnName="RGIndexKeysCompute";
+	int32_t i, j, strand, start, numRuns, numBases, hasN;
+	int32_t runStart[RGINDEX_KEYS_MAX_BASES], runLength[RGINDEX_KEYS_MAX_BASES];
+	uint64_t packed[(SEQUENCE_LENGTH >> 5) + 2];
+	int8_t *seq=NULL;
+	uint64_t key;
+	int64_t k, bin;
+
+	keys->readLength = readLength;
+	keys->numOffsets = GETMAX(0, readLength - index->width + 1);
+	if(keys->maxNumOffsets < keys->numOffsets) {
+		keys->maxNumOffsets = keys->numOffsets;
+		keys->valid = realloc(keys->valid, sizeof(int8_t)*2*keys->maxNumOffsets);
+		if(NULL == keys->valid) {
+			PrintError(FnName, "keys->valid", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		keys->hashIndex = realloc(keys->hashIndex, sizeof(int64_t)*2*keys->maxNumOffsets);
+		if(NULL == keys->hashIndex) {
+			PrintError(FnName, "keys->hashIndex", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		keys->keys = realloc(keys->keys, sizeof(uint64_t)*2*keys->maxNumOffsets);
+		if(NULL == keys->keys) {
+			PrintError(FnName, "keys->keys", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+	}
+
+	/* The runs of consecutive masked bases in the first (at most 32) 
+	 * masked bases */
+	for(i=numRuns=numBases=0;i<index->width && numBases<RGINDEX_KEYS_MAX_BASES;i++) {
+		if(1 == index->mask[i]) {
+			if(0 < i && 1 == index->mask[i-1] && 0 < numRuns) {
+				runLength[numRuns-1]++;
+			}
+			else {
+				runStart[numRuns] = i;
+				runLength[numRuns] = 1;
+				numRuns++;
+			}
+			numBases++;
+		}
+	}
+	keys->hasKeys = (numBases == index->keysize) ? 1 : 0;
+
+	if(BothStrands == strands || ReverseStrand == strands) {
+		if(space==ColorSpace) {
+			/* In color space, the reverse compliment is just the reverse of the colors */
+			ReverseReadFourBit(read, keys->reverseRead, readLength);
+		}
+		else {
+			GetReverseComplimentFourBit(read, keys->reverseRead, readLength);
+		}
+	}
+
+	for(strand=0;strand<2;strand++) {
+		k = strand*keys->numOffsets;
+		if((0 == strand && ReverseStrand == strands) ||
+				(1 == strand && ForwardStrand == strands)) {
+			for(i=0;i<keys->numOffsets;i++) {
+				keys->valid[k+i] = 0;
+				keys->hashIndex[k+i] = -1;
+				keys->keys[k+i] = 0;
+			}
+			continue;
+		}
+		seq = (0 == strand) ? read : keys->reverseRead;
+		hasN = RGIndexKeysPack(seq, readLength, packed);
+
+		for(i=0;i<keys->numOffsets;i++) {
+			/* The reverse key at an offset starts that many bases from 
+			 * the end of the reverse read */
+			start = (0 == strand) ? i : (readLength - i - index->width);
+
+			key = 0;
+			for(j=0;j<numRuns;j++) {
+				key = (RGINDEX_KEYS_MAX_BASES == runLength[j]) ? 0 : (key << (2*runLength[j]));
+				key |= RGIndexKeysGetBases(packed, start + runStart[j], runLength[j]);
+			}
+			keys->keys[k+i] = key;
+			keys->valid[k+i] = (0 == hasN) ? 1 : WillGenerateValidKey(index, seq + start, index->width);
+
+			if(0 == keys->valid[k+i]) {
+				keys->hashIndex[k+i] = -1;
+			}
+			else if(index->depth + index->hashWidth <= numBases) {
+				/* The first depth bases are the bin, and the next hash width
+				 * bases the hash */
+				bin = (0 < index->depth) ? (int64_t)(key >> (2*(numBases - index->depth))) : 0;
+				if(0 < index->depth && bin != index->binNumber - 1) {
+					keys->hashIndex[k+i] = -1;
+				}
+				else {
+					keys->hashIndex[k+i] = (key >> (2*(numBases - index->depth - index->hashWidth))) & ((((int64_t)1) << (2*index->hashWidth)) - 1);
+				}
+			}
+			else {
+				keys->hashIndex[k+i] = RGIndexGetHashIndexFromRead(index, NULL, seq + start, index->width, 0);
+			}
+		}
+	}
+}
+
 /* TODO */
 /* Debug function */
 void RGIndexPrintReadMasked(RGIndex *index, char *read, int offset, FILE *fp) 
@@ -2736,6 +3667,21 @@ void RGIndexInitialize(RGIndex *index)
 	index->hashWidth = 0;
 	index->hashLength = 0;
 	index->starts = NULL;
+	RGIndexEliasFanoInitialize(&index->startsHashes);
+	RGIndexEliasFanoInitialize(&index->startsEntries);
+
+	index->keyFilterThreshold = 0;
+	index->keyFilterWidth = 0;
+	index->keyFilterNumKeys = 0;
+	index->keyFilterLength = 0;
+	index->keyFilterKeys = NULL;
+	index->keyFilterCounts = NULL;
+
+	index->packedWidth = 0;
+	index->packed = NULL;
+	index->packedStartContig = 0;
+	index->packedNumContigs = 0;
+	index->packedContigStarts = NULL;
 }
 
 void RGIndexInitializeFull(RGIndex *index,
@@ -7,11 +7,36 @@
 #include "RGRanges.h"
 #include "BLibDefinitions.h"
 
-void RGIndexCreate(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
-void RGIndexCreateSingle(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
-void RGIndexCreateSplit(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
+void RGIndexCreate(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, char*);
+void RGIndexCreateSingle(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, char*);
+void RGIndexCreateSplit(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, char*);
 void RGIndexCreateHelper(RGIndex*, RGBinary*, FILE**, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
 void RGIndexCreateHash(RGIndex*, RGBinary*);
+int32_t RGIndexHasWideStarts(RGIndex*);
+int64_t RGIndexGetStartsSize(RGIndex*);
+void RGIndexStartsAllocate(RGIndex*, int64_t);
+int64_t RGIndexGetStart(RGIndex*, int64_t);
+void RGIndexEliasFanoInitialize(RGIndexEliasFano*);
+void RGIndexEliasFanoFree(RGIndexEliasFano*);
+int32_t RGIndexEliasFanoGetNumWords(int64_t, int64_t, int64_t*, int64_t*, int64_t*, int64_t*);
+int64_t RGIndexEliasFanoGetSize(int64_t, int64_t);
+void RGIndexEliasFanoAllocate(RGIndexEliasFano*, int64_t, int64_t);
+void RGIndexEliasFanoSet(RGIndexEliasFano*, int64_t, int64_t);
+void RGIndexEliasFanoSample(RGIndexEliasFano*);
+int64_t RGIndexEliasFanoGet(RGIndexEliasFano*, int64_t);
+int64_t RGIndexEliasFanoRank(RGIndexEliasFano*, int64_t);
+void RGIndexEliasFanoWrite(gzFile, RGIndexEliasFano*);
+void RGIndexEliasFanoRead(gzFile, RGIndexEliasFano*);
+void RGIndexCreateKeyFilter(RGIndex*, RGBinary*, int32_t);
+void RGIndexKeyFilterAllocate(RGIndex*, int64_t);
+void RGIndexKeyFilterInsert(RGIndex*, uint64_t, uint32_t);
+int64_t RGIndexKeyFilterFind(RGIndex*, uint64_t);
+uint32_t RGIndexKeyFilterGetCount(RGIndex*, int8_t*, int32_t);
+uint32_t RGIndexKeyFilterGetCountFromKey(RGIndex*, uint64_t);
+void RGIndexPack(RGIndex*);
+void RGIndexGetContigPos(RGIndex*, int64_t, uint32_t*, uint32_t*);
+void RGIndexSetThreadRunner(void (*)(void *(*)(void*), void*, size_t, int32_t));
+void RGIndexRunThreads(void *(*)(void*), void*, size_t, int32_t);
 void RGIndexSort(RGIndex*, RGBinary*, int32_t, char*);
 void *RGIndexMergeSort(void*);
 void RGIndexMergeSortHelper(RGIndex*, RGBinary*, int64_t, int64_t, int32_t, double*, int64_t, int64_t, int64_t, char*);
@@ -32,15 +57,21 @@ void RGIndexPrintHeader(gzFile, RGIndex*);
 void RGIndexGetHeader(char*, RGIndex*);
 void RGIndexReadHeader(gzFile, RGIndex*);
 int64_t RGIndexGetRanges(RGIndex*, RGBinary*, int8_t*, int32_t, int64_t*, int64_t*);
-int32_t RGIndexGetRangesBothStrands(RGIndex*, RGBinary*, int8_t*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGRanges*);
+int32_t RGIndexGetRangesBothStrands(RGIndex*, RGBinary*, int8_t*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexKeys*, RGRanges*);
 int64_t RGIndexGetIndex(RGIndex*, RGBinary*, int8_t*, int32_t, int64_t*, int64_t*);
+int64_t RGIndexGetIndexFromHash(RGIndex*, RGBinary*, int8_t*, int64_t, int64_t*, int64_t*);
 void RGIndexSwapAt(RGIndex*, int64_t, int64_t);
 int64_t RGIndexGetPivot(RGIndex*, RGBinary*, int64_t, int64_t);
 int32_t RGIndexCompareContigPos(RGIndex*, RGBinary*, uint32_t, uint32_t, uint32_t, uint32_t, int);
 int32_t RGIndexCompareAt(RGIndex*, RGBinary*, int64_t, int64_t, int);
 int32_t RGIndexCompareRead(RGIndex*, RGBinary*, int8_t*, int64_t, int32_t, int32_t*, int);
-uint32_t RGIndexGetHashIndex(RGIndex*, RGBinary*, uint32_t, int);
-uint32_t RGIndexGetHashIndexFromRead(RGIndex*, RGBinary*, int8_t*, int32_t, int);
+int64_t RGIndexGetHashIndex(RGIndex*, RGBinary*, int64_t, int);
+int64_t RGIndexGetHashIndexFromRead(RGIndex*, RGBinary*, int8_t*, int32_t, int);
+int32_t RGIndexGetKey(RGIndex*, RGBinary*, int64_t, uint64_t*);
+int32_t RGIndexGetKeyFromRead(RGIndex*, int8_t*, int32_t, uint64_t*);
+void RGIndexKeysInitialize(RGIndexKeys*);
+void RGIndexKeysFree(RGIndexKeys*);
+void RGIndexKeysCompute(RGIndex*, int8_t*, int32_t, int32_t, int32_t, RGIndexKeys*);
 void RGIndexPrintReadMasked(RGIndex*, char*, int, FILE*);
 void RGIndexInitialize(RGIndex*);
 void RGIndexInitializeFull(RGIndex*, RGBinary*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
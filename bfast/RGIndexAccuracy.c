@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "BError.h"
 #include "BLibDefinitions.h"
@@ -17,7 +18,12 @@
 #define SAMPLE_ROTATE_NUM 10
 char Colors[5] = "01234";
 
-/* TODO */
+/* Greedily grows the index set one index at a time.  Every candidate for the
+ * next index is scored against the same simulated reads, which are stored
+ * as bitsets.  The candidates are split across threads, and each candidate 
+ * has its own random number state derived from the seed, so the result does
+ * not depend on the number of threads.
+ * */
 void RunSearchForRGIndexAccuracies(int readLength,
 		int numEventsToSample,
 		int numRGIndexAccuraciesToSample,
@@ -27,100 +33,239 @@ void RunSearchForRGIndexAccuracies(int readLength,
 		int accuracyThreshold,
 		int space,
 		int maxNumMismatches,
-		int maxNumColorErrors)
+		int maxNumColorErrors,
+		int numThreads,
+		int seed)
 {
-	int i, j;
-	RGIndexAccuracySet curSet, bestSet;
-	RGIndexAccuracy curRGIndexAccuracy;
-	AccuracyProfile curP, bestP;
+	char *FnName="RunSearchForRGIndexAccuracies";
+	int i, j, k, best, cmp, errCode;
+	RGIndexAccuracySet curSet;
+	ReadBitsSet reads;
+	pthread_t *threads=NULL;
+	ThreadRGIndexAccuracyData *data=NULL;
+	void *status=NULL;
 
 	/* Seed random number */
-	srand(time(NULL));
+	if(seed < 0) {
+		seed = (int)(time(NULL) & INT_MAX);
+	}
+	fprintf(stderr, "Using random seed %d\n", seed);
+	srand(seed);
 
 	/* Initialize index set */
 	RGIndexAccuracySetInitialize(&curSet);
-	RGIndexAccuracySetInitialize(&bestSet);
 
 	/* Will always seed with contiguous 1s mask */
 	RGIndexAccuracySetSeed(&curSet,
 			keySize);
-	RGIndexAccuracySetSeed(&bestSet,
-			keySize);
+
+	/* Simulate the reads */
+	ReadBitsSetInitialize(&reads);
+	ReadBitsSetCreate(&reads,
+			readLength,
+			numEventsToSample,
+			maxNumMismatches,
+			(ColorSpace == space)?maxNumColorErrors:0,
+			space);
+	ReadBitsSetAddFound(&reads, &curSet.indexes[0]);
+
+	/* Allocate memory for threads */
+	threads=malloc(sizeof(pthread_t)*numThreads);
+	if(NULL==threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	/* Allocate memory to pass data to threads */
+	data=malloc(sizeof(ThreadRGIndexAccuracyData)*numThreads);
+	if(NULL==data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
 
 	fprintf(stderr, "Currently on [index set size, sample number]\n0");
 	for(i=2;i<=maxRGIndexAccuracySetSize;i++) { /* Add one index to the set */
-		/* Initialize */
-		RGIndexAccuracyInitialize(&curRGIndexAccuracy);
-		AccuracyProfileInitialize(&curP);
-		AccuracyProfileInitialize(&bestP);
-
-		/* Sample the space of possible indexes */
-		for(j=0;j<numRGIndexAccuraciesToSample;j++) { 
-			if(j%SAMPLE_ROTATE_NUM == 0) {
-				fprintf(stderr, "\r%-3d,%-9d",
-						i,
-						j);
+		/* Initialize thread data */
+		for(j=0;j<numThreads;j++) {
+			data[j].curSet = &curSet;
+			data[j].reads = &reads;
+			data[j].keySize = keySize;
+			data[j].maxKeyWidth = maxKeyWidth;
+			data[j].accuracyThreshold = accuracyThreshold;
+			data[j].numIndexesToSample = numRGIndexAccuraciesToSample;
+			data[j].setSize = i;
+			data[j].seed = seed;
+			data[j].numThreads = numThreads;
+			data[j].threadID = j;
+			RGIndexAccuracyInitialize(&data[j].best);
+			data[j].bestSample = -1;
+			data[j].bestNumCorrect = malloc(sizeof(int32_t)*reads.numLevels);
+			if(NULL == data[j].bestNumCorrect) {
+				PrintError(FnName, "data[j].bestNumCorrect", "Could not allocate memory", Exit, MallocMemory);
 			}
-			/* Initialze cur */
-			RGIndexAccuracyInitialize(&curRGIndexAccuracy);
-			AccuracyProfileInitialize(&curP);
-
-			/* Get random index */
-			do {
-				RGIndexAccuracyFree(&curRGIndexAccuracy);
-				RGIndexAccuracyGetRandom(&curRGIndexAccuracy,
-						keySize,
-						maxKeyWidth);
+		}
+
+		/* Open threads */
+		for(j=0;j<numThreads;j++) {
+			/* Start thread */
+			errCode = pthread_create(&threads[j], /* thread struct */
+					NULL, /* default thread attributes */
+					RunSearchForRGIndexAccuraciesThread, /* start routine */
+					&data[j]); /* data to routine */
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
 			}
-			while(1==RGIndexAccuracySetContains(&curSet, &curRGIndexAccuracy));
-
-			/* Push random index onto the current set */
-			RGIndexAccuracySetPush(&curSet,
-					&curRGIndexAccuracy);
-			/* Check if this is the first time */
-			if(bestSet.numRGIndexAccuracies < curSet.numRGIndexAccuracies) {
-				RGIndexAccuracySetPush(&bestSet, &curRGIndexAccuracy);
+		}
+		/* Wait for threads to return */
+		for(j=0;j<numThreads;j++) {
+			/* Wait for the given thread to return */
+			errCode = pthread_join(threads[j],
+					&status);
+			/* Check the return code of the thread */
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+			}
+		}
+
+		/* Get the best over all threads, taking the earliest sample when equal */
+		for(j=0,best=-1;j<numThreads;j++) {
+			if(data[j].bestSample < 0) {
+				continue;
+			}
+			else if(best < 0) {
+				best = j;
 			}
 			else {
-				assert(j>0);
-				assert(bestSet.numRGIndexAccuracies == curSet.numRGIndexAccuracies);
-				/* Compare accuracy profile */
-				if(AccuracyProfileCompare(&bestSet, 
-							&bestP,
-							&curSet, 
-							&curP,
-							readLength,
-							numEventsToSample,
-							space,
-							maxNumMismatches,
-							maxNumColorErrors,
-							accuracyThreshold) < 0) {
-					/* Copy index over to the current best set */
-					RGIndexAccuracySetPop(&bestSet);
-					RGIndexAccuracySetPush(&bestSet, &curRGIndexAccuracy);
-					AccuracyProfileCopy(&bestP, &curP);
+				for(k=cmp=0;0==cmp && k<reads.numLevels;k++) {
+					cmp = RGIndexAccuracyNumCorrectCompare(data[j].bestNumCorrect[k],
+							data[best].bestNumCorrect[k],
+							reads.numReads,
+							accuracyThreshold);
+				}
+				if(0 < cmp || 
+						(0 == cmp && data[j].bestSample < data[best].bestSample)) {
+					best = j;
 				}
 			}
-			/* Pop the index off the current set */
-			RGIndexAccuracySetPop(&curSet);
-			/* Free cur index */
-			RGIndexAccuracyFree(&curRGIndexAccuracy);
-			/* Free profile */
-			AccuracyProfileFree(&curP);
 		}
-		/* Free accuracy profile */
-		AccuracyProfileFree(&bestP);
-		/* Copy best index over to cur set */
-		RGIndexAccuracySetPush(&curSet, &bestSet.indexes[bestSet.numRGIndexAccuracies-1]);
+		assert(0 <= best);
+
+		/* Add the best index to the set */
+		RGIndexAccuracySetPush(&curSet, &data[best].best);
+		ReadBitsSetAddFound(&reads, &data[best].best);
+
+		/* Free thread data */
+		for(j=0;j<numThreads;j++) {
+			RGIndexAccuracyFree(&data[j].best);
+			free(data[j].bestNumCorrect);
+			data[j].bestNumCorrect=NULL;
+		}
 	}
 	fprintf(stderr, "\r--------------completed\n");
 
 	/* Print */
-	RGIndexAccuracySetPrint(&bestSet, stdout);
+	RGIndexAccuracySetPrint(&curSet, stdout);
 
 	/* Free */
+	free(threads);
+	free(data);
+	ReadBitsSetFree(&reads);
 	RGIndexAccuracySetFree(&curSet);
-	RGIndexAccuracySetFree(&bestSet);
+}
+
+/* Scores the candidates for the next index assigned to this thread, 
+ * keeping the best.  A candidate is no longer scored once it is worse than
+ * the best. */
+void *RunSearchForRGIndexAccuraciesThread(void *arg)
+{
+	char *FnName="RunSearchForRGIndexAccuraciesThread";
+	ThreadRGIndexAccuracyData *data = (ThreadRGIndexAccuracyData*)arg;
+	ReadBitsSet *reads = data->reads;
+	int32_t j, k, cmp;
+	unsigned int randomSeed;
+	uint64_t *maskBits=NULL;
+	int32_t *numCorrect=NULL;
+	RGIndexAccuracy cur;
+
+	maskBits = malloc(sizeof(uint64_t)*((data->maxKeyWidth + RGINDEXACCURACY_BITS_PER_WORD - 1)/RGINDEXACCURACY_BITS_PER_WORD));
+	if(NULL == maskBits) {
+		PrintError(FnName, "maskBits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	numCorrect = malloc(sizeof(int32_t)*reads->numLevels);
+	if(NULL == numCorrect) {
+		PrintError(FnName, "numCorrect", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	RGIndexAccuracyInitialize(&cur);
+	for(j=data->threadID;j<data->numIndexesToSample;j+=data->numThreads) {
+		if(0 == data->threadID && 0 == (j/data->numThreads)%SAMPLE_ROTATE_NUM) {
+			fprintf(stderr, "\r%-3d,%-9d",
+					data->setSize,
+					j);
+		}
+
+		/* The random number state depends only on the seed, set size and sample */
+		randomSeed = (unsigned int)data->seed;
+		randomSeed = randomSeed*2654435761U + (unsigned int)data->setSize;
+		randomSeed = randomSeed*2654435761U + (unsigned int)j;
+
+		/* Get random index */
+		do {
+			RGIndexAccuracyFree(&cur);
+			RGIndexAccuracyGetRandom(&cur,
+					data->keySize,
+					data->maxKeyWidth,
+					&randomSeed);
+		}
+		while(1==RGIndexAccuracySetContains(data->curSet, &cur));
+		RGIndexAccuracyGetBits(&cur, maskBits);
+
+		/* Compare with the best, color errors are prioritized over SNPs */
+		for(k=0, cmp=(data->bestSample < 0)?1:0;k<reads->numLevels;k++) {
+			numCorrect[k] = ReadBitsSetNumCorrect(reads,
+					maskBits,
+					cur.keyWidth,
+					k);
+			if(0 == cmp) {
+				cmp = RGIndexAccuracyNumCorrectCompare(numCorrect[k],
+						data->bestNumCorrect[k],
+						reads->numReads,
+						data->accuracyThreshold);
+				if(cmp < 0) {
+					break;
+				}
+			}
+		}
+		if(0 < cmp) {
+			RGIndexAccuracyCopy(&data->best, &cur);
+			data->bestSample = j;
+			for(k=0;k<reads->numLevels;k++) {
+				data->bestNumCorrect[k] = numCorrect[k];
+			}
+		}
+		RGIndexAccuracyFree(&cur);
+	}
+
+	free(maskBits);
+	free(numCorrect);
+
+	return NULL;
+}
+
+/* Compares the number of reads found at one level, only when either is
+ * below the accuracy threshold */
+int RGIndexAccuracyNumCorrectCompare(int32_t a,
+		int32_t b,
+		int32_t numReads,
+		int32_t accuracyThreshold)
+{
+	if(100*((int64_t)a) < accuracyThreshold*((int64_t)numReads) ||
+			100*((int64_t)b) < accuracyThreshold*((int64_t)numReads)) {
+		if(a < b) {
+			return -1;
+		}
+		else if(a > b) {
+			return 1;
+		}
+	}
+	return 0;
 }
 
 /* TODO */
@@ -894,6 +1039,49 @@ int32_t RGIndexAccuracyCheckRead(RGIndexAccuracy *index,
 	return 0;
 }
 
+/* Gets the mask as a bitset */
+void RGIndexAccuracyGetBits(RGIndexAccuracy *index,
+		uint64_t *bits)
+{
+	int32_t i;
+
+	for(i=0;i<(index->keyWidth + RGINDEXACCURACY_BITS_PER_WORD - 1)/RGINDEXACCURACY_BITS_PER_WORD;i++) {
+		bits[i] = 0;
+	}
+	for(i=0;i<index->keyWidth;i++) {
+		if(1 == index->mask[i]) {
+			bits[i/RGINDEXACCURACY_BITS_PER_WORD] |= ((uint64_t)1) << (i%RGINDEXACCURACY_BITS_PER_WORD);
+		}
+	}
+}
+
+/* Same as RGIndexAccuracyCheckRead but with the mask and the read as bitsets */
+int32_t RGIndexAccuracyCheckReadBits(uint64_t *maskBits,
+		int32_t keyWidth,
+		uint64_t *readBits,
+		int32_t readLength,
+		int32_t numWords)
+{
+	int32_t i, j;
+	int32_t numMaskWords = (keyWidth + RGINDEXACCURACY_BITS_PER_WORD - 1)/RGINDEXACCURACY_BITS_PER_WORD;
+
+	if(keyWidth > readLength) {
+		return 0;
+	}
+
+	for(i=0;i<readLength - keyWidth + 1;i++) { /* For all possible offsets */
+		for(j=0;j<numMaskWords;j++) {
+			if(0 != (maskBits[j] & ReadBitsGetWord(readBits, numWords, i + j*RGINDEXACCURACY_BITS_PER_WORD))) {
+				break;
+			}
+		}
+		if(j == numMaskWords) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
 void RGIndexAccuracyCopy(RGIndexAccuracy *dest, RGIndexAccuracy *src)
 {
 	int i;
@@ -912,7 +1100,8 @@ void RGIndexAccuracyCopy(RGIndexAccuracy *dest, RGIndexAccuracy *src)
 
 void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 		int keySize,
-		int maxKeyWidth)
+		int maxKeyWidth,
+		unsigned int *randomSeed)
 {
 	char *FnName="RGIndexAccuracyGetRandom";
 	int i, j, k;
@@ -934,7 +1123,7 @@ void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 	}
 
 	/* Choose a number of zeros to insert into the bins */
-	numLeft = rand()%(maxKeyWidth - keySize + 1);
+	numLeft = rand_r(randomSeed)%(maxKeyWidth - keySize + 1);
 	assert(numLeft >=0 && numLeft <= maxKeyWidth - keySize);
 
 	/* Allocate memory for the index */
@@ -945,7 +1134,7 @@ void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 	/* Insert into bins */
 	while(numLeft > 0) {
 		/* choose a bin between 1 and keySize-1 */
-		i = (rand()%numBins); /* Note: this is not truly inform, but a good approximation */
+		i = (rand_r(randomSeed)%numBins); /* Note: this is not truly inform, but a good approximation */
 		assert(i>=0 && i<numBins);
 		bins[i]++;
 		numLeft--;
@@ -1343,3 +1532,152 @@ void ReadPrint(Read *r, FILE *fp)
 	}
 	fprintf(fp, "\n");
 }
+
+/* Gets the word of bits starting at the given position */
+uint64_t ReadBitsGetWord(uint64_t *bits,
+		int32_t numWords,
+		int32_t position)
+{
+	int32_t word = position/RGINDEXACCURACY_BITS_PER_WORD;
+	int32_t shift = position%RGINDEXACCURACY_BITS_PER_WORD;
+	uint64_t w;
+
+	if(numWords <= word) {
+		return 0;
+	}
+	w = bits[word] >> shift;
+	if(0 < shift && word + 1 < numWords) {
+		w |= bits[word+1] << (RGINDEXACCURACY_BITS_PER_WORD - shift);
+	}
+	return w;
+}
+
+void ReadBitsSetInitialize(ReadBitsSet *set)
+{
+	set->readLength = 0;
+	set->numWords = 0;
+	set->numReads = 0;
+	set->numSNPs = 0;
+	set->numColorErrors = 0;
+	set->numLevels = 0;
+	set->bits = NULL;
+	set->found = NULL;
+	set->numFound = NULL;
+}
+
+/* Simulates reads for every number of color errors and SNPs, in the order
+ * used by AccuracyProfileCompare */
+void ReadBitsSetCreate(ReadBitsSet *set,
+		int readLength,
+		int numReads,
+		int numSNPs,
+		int numColorErrors,
+		int space)
+{
+	char *FnName="ReadBitsSetCreate";
+	int32_t i, j, k, l, level;
+	uint64_t *bits=NULL;
+	Read r;
+
+	set->readLength = readLength;
+	set->numWords = (readLength + RGINDEXACCURACY_BITS_PER_WORD - 1)/RGINDEXACCURACY_BITS_PER_WORD;
+	set->numReads = numReads;
+	set->numSNPs = numSNPs;
+	set->numColorErrors = numColorErrors;
+	set->numLevels = (numSNPs + 1)*(numColorErrors + 1);
+
+	set->bits = calloc(((int64_t)set->numLevels)*set->numReads*set->numWords, sizeof(uint64_t));
+	if(NULL == set->bits) {
+		PrintError(FnName, "set->bits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	set->found = calloc(((int64_t)set->numLevels)*set->numReads, sizeof(char));
+	if(NULL == set->found) {
+		PrintError(FnName, "set->found", "Could not allocate memory", Exit, MallocMemory);
+	}
+	set->numFound = calloc(set->numLevels, sizeof(int32_t));
+	if(NULL == set->numFound) {
+		PrintError(FnName, "set->numFound", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(i=0,level=0;i<=numColorErrors;i++) { /* color errors are prioritized */
+		for(j=0;j<=numSNPs;j++,level++) { /* SNPs are secondary */
+			for(k=0;k<numReads;k++) {
+				ReadInitialize(&r);
+				ReadGetRandom(&r,
+						readLength,
+						j,
+						i,
+						space);
+				bits = set->bits + (((int64_t)level)*set->numReads + k)*set->numWords;
+				for(l=0;l<r.length;l++) {
+					if(1 == r.profile[l]) {
+						bits[l/RGINDEXACCURACY_BITS_PER_WORD] |= ((uint64_t)1) << (l%RGINDEXACCURACY_BITS_PER_WORD);
+					}
+				}
+				ReadFree(&r);
+			}
+		}
+	}
+}
+
+/* Gets the number of reads at the given level found by the current set or the mask */
+int32_t ReadBitsSetNumCorrect(ReadBitsSet *set,
+		uint64_t *maskBits,
+		int32_t keyWidth,
+		int32_t level)
+{
+	int64_t i;
+	int32_t numCorrect = set->numFound[level];
+
+	for(i=((int64_t)level)*set->numReads;i<((int64_t)level+1)*set->numReads;i++) {
+		if(0 == set->found[i] &&
+				1 == RGIndexAccuracyCheckReadBits(maskBits, 
+					keyWidth, 
+					set->bits + i*set->numWords,
+					set->readLength,
+					set->numWords)) {
+			numCorrect++;
+		}
+	}
+	return numCorrect;
+}
+
+/* Marks the reads found by the index */
+void ReadBitsSetAddFound(ReadBitsSet *set,
+		RGIndexAccuracy *index)
+{
+	char *FnName="ReadBitsSetAddFound";
+	int32_t level;
+	int64_t i;
+	uint64_t *maskBits=NULL;
+
+	maskBits = malloc(sizeof(uint64_t)*((index->keyWidth + RGINDEXACCURACY_BITS_PER_WORD - 1)/RGINDEXACCURACY_BITS_PER_WORD));
+	if(NULL == maskBits) {
+		PrintError(FnName, "maskBits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	RGIndexAccuracyGetBits(index, maskBits);
+
+	for(level=0;level<set->numLevels;level++) {
+		for(i=((int64_t)level)*set->numReads;i<((int64_t)level+1)*set->numReads;i++) {
+			if(0 == set->found[i] &&
+					1 == RGIndexAccuracyCheckReadBits(maskBits, 
+						index->keyWidth, 
+						set->bits + i*set->numWords,
+						set->readLength,
+						set->numWords)) {
+				set->found[i] = 1;
+				set->numFound[level]++;
+			}
+		}
+	}
+
+	free(maskBits);
+}
+
+void ReadBitsSetFree(ReadBitsSet *set)
+{
+	free(set->bits);
+	free(set->found);
+	free(set->numFound);
+	ReadBitsSetInitialize(set);
+}
@@ -5,9 +5,12 @@
 
 #define RGINDEXACCURACY_MIN_PERCENT_FOUND 95
 #define RGINDEXACCURACY_NUM_TO_SAMPLE 100000 
+#define RGINDEXACCURACY_BITS_PER_WORD 64
 
 /* Functions */
-void RunSearchForRGIndexAccuracies(int, int, int, int, int, int, int, int, int, int);
+void RunSearchForRGIndexAccuracies(int, int, int, int, int, int, int, int, int, int, int, int);
+void *RunSearchForRGIndexAccuraciesThread(void*);
+int RGIndexAccuracyNumCorrectCompare(int32_t, int32_t, int32_t, int32_t);
 void RunEvaluateRGIndexAccuracies(char*, int, int, int, int, int, int);
 void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet*, int, int, int, int);
 void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet*, int, int, int, int, int);
@@ -36,7 +39,9 @@ void RGIndexAccuracySetCopyFromRGIndex(RGIndexAccuracySet*, RGIndex*);
 int RGIndexAccuracyCompare(RGIndexAccuracy*, RGIndexAccuracy*);
 int32_t RGIndexAccuracyCheckRead(RGIndexAccuracy*, Read*);
 void RGIndexAccuracyCopy(RGIndexAccuracy*, RGIndexAccuracy*);
-void RGIndexAccuracyGetRandom(RGIndexAccuracy*, int, int);
+void RGIndexAccuracyGetRandom(RGIndexAccuracy*, int, int, unsigned int*);
+void RGIndexAccuracyGetBits(RGIndexAccuracy*, uint64_t*);
+int32_t RGIndexAccuracyCheckReadBits(uint64_t*, int32_t, uint64_t*, int32_t, int32_t);
 void RGIndexAccuracyAllocate(RGIndexAccuracy*, int, int);
 void RGIndexAccuracyInitialize(RGIndexAccuracy*);
 void RGIndexAccuracyFree(RGIndexAccuracy*);
@@ -56,5 +61,12 @@ void ReadInitialize(Read*);
 void ReadAllocate(Read*, int);
 void ReadFree(Read*);
 void ReadPrint(Read*, FILE*);
+/* ReadBitsSet functions */
+void ReadBitsSetInitialize(ReadBitsSet*);
+void ReadBitsSetCreate(ReadBitsSet*, int, int, int, int, int);
+int32_t ReadBitsSetNumCorrect(ReadBitsSet*, uint64_t*, int32_t, int32_t);
+void ReadBitsSetAddFound(ReadBitsSet*, RGIndexAccuracy*);
+void ReadBitsSetFree(ReadBitsSet*);
+uint64_t ReadBitsGetWord(uint64_t*, int32_t, int32_t);
 
 #endif
@@ -15,7 +15,7 @@ int32_t RGMatchRead(gzFile fp,
 		RGMatch *m)
 {
 	char *FnName = "RGMatchRead";
-	int32_t i, numEntries;
+	int32_t numEntries;
 
 	/* Read in the read length */
 	if(gzread64(fp, &m->readLength, sizeof(int32_t))!=sizeof(int32_t)||
@@ -72,10 +72,8 @@ int32_t RGMatchRead(gzFile fp,
 	if(gzread64(fp, m->strands, sizeof(char)*m->numEntries)!=sizeof(char)*m->numEntries) {
 		PrintError(FnName, "m->strands", "Could not read in strand", Exit, ReadFileError);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		if(gzread64(fp, m->masks[i], sizeof(char)*GETMASKNUMBYTES(m))!=sizeof(char)*GETMASKNUMBYTES(m)) {
-			PrintError(FnName, "m->masks[i]", "Could not read in mask", Exit, ReadFileError);
-		}
+	if(gzread64(fp, m->masks, sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries)!=sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries) {
+		PrintError(FnName, "m->masks", "Could not read in masks", Exit, ReadFileError);
 	}
 
 	return 1;
@@ -90,6 +88,7 @@ int32_t RGMatchReadText(FILE *fp,
 	char read[SEQUENCE_LENGTH]="\0";
 	char qual[SEQUENCE_LENGTH]="\0";
 	char mask[SEQUENCE_LENGTH]="\0";
+	char *tmpMask=NULL;
 
 	/* Read the read and qual */
 	if(fscanf(fp, "%s %s",
@@ -137,8 +136,9 @@ int32_t RGMatchReadText(FILE *fp,
 					mask)==EOF) {
 			PrintError(FnName, NULL, "Could not read in match", Exit, EndOfFile);
 		}
-		free(m->masks[i]); // since we reallocated
-		m->masks[i] = RGMatchStringToMask(mask, m->readLength);
+		tmpMask = RGMatchStringToMask(mask, m->readLength);
+		memcpy(GETMASK(m, i), tmpMask, sizeof(char)*GETMASKNUMBYTES(m));
+		free(tmpMask);
 	}
 
 	return 1;
@@ -152,7 +152,6 @@ void RGMatchPrint(gzFile fp,
 	assert(fp!=NULL);
 	assert(m->readLength > 0);
 	assert(m->qualLength > 0);
-	int32_t i;
 
 	/* Print the matches to the output file */
 	/* Print read length, read, maximum reached, and number of entries. */
@@ -171,10 +170,8 @@ void RGMatchPrint(gzFile fp,
 			gzwrite64(fp, m->strands, sizeof(char)*m->numEntries)!=sizeof(char)*m->numEntries) {
 		PrintError(FnName, NULL, "Could not write contigs, positions and strands", Exit, WriteFileError);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		if(gzwrite64(fp, m->masks[i], sizeof(char)*GETMASKNUMBYTES(m))!=sizeof(char)*GETMASKNUMBYTES(m)) {
-			PrintError(FnName, NULL, "Could not write masks[i]", Exit, WriteFileError);
-		}
+	if(gzwrite64(fp, m->masks, sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries)!=sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries) {
+		PrintError(FnName, NULL, "Could not write masks", Exit, WriteFileError);
 	}
 }
 
@@ -200,7 +197,7 @@ void RGMatchPrintText(FILE *fp,
 
 	for(i=0;i<m->numEntries;i++) {
 		assert(m->contigs[i] > 0);
-		maskString=RGMatchMaskToString(m->masks[i], m->readLength);
+		maskString=RGMatchMaskToString(GETMASK(m, i), m->readLength);
 		if(0 > fprintf(fp, "\t%u\t%d\t%c\t%s",
 					m->contigs[i],
 					m->positions[i],
@@ -234,12 +231,79 @@ void RGMatchPrintFastq(FILE *fp,
 	}
 }
 
+/* Packs (contig, position, strand) into a key that orders the same as
+ * RGMatchCompareAtIndex.  The position is biased so that negative
+ * positions sort first, and FORWARD ('+') sorts before REVERSE ('-'). */
+#define RGMATCH_GETKEY(_m, _i) ( \
+		((uint64_t)(_m)->contigs[(_i)] << 33) | \
+		((uint64_t)((uint32_t)(_m)->positions[(_i)] ^ 0x80000000) << 1) | \
+		((uint64_t)(REVERSE == (_m)->strands[(_i)] ? 1 : 0)) )
+
+/* Sorts the keys along with their indexes.  The sort is stable, and the
+ * sorted keys and indexes may end up in either the given or temporary
+ * arrays, so the pointers are swapped as needed. */
+static void RGMatchSortKeys(uint64_t **keys,
+		int32_t **indexes,
+		uint64_t **tmpKeys,
+		int32_t **tmpIndexes,
+		int32_t length)
+{
+	int32_t i, j, shift;
+	int32_t counts[256];
+	uint64_t key, diff, *swapKeys=NULL;
+	int32_t index, *swapIndexes=NULL;
+
+	if(length < RGMATCH_RADIX_SORT_MIN) {
+		/* Insertion sort */
+		for(i=1;i<length;i++) {
+			key = (*keys)[i];
+			index = (*indexes)[i];
+			for(j=i;0 < j && key < (*keys)[j-1];j--) {
+				(*keys)[j] = (*keys)[j-1];
+				(*indexes)[j] = (*indexes)[j-1];
+			}
+			(*keys)[j] = key;
+			(*indexes)[j] = index;
+		}
+		return;
+	}
+
+	/* Only sort on the bytes that differ between keys */
+	for(i=1,diff=0;i<length;i++) {
+		diff |= (*keys)[i] ^ (*keys)[0];
+	}
+
+	/* LSD radix sort, one byte at a time */
+	for(shift=0;shift<64;shift+=8) {
+		if(0 == ((diff >> shift) & 0xFF)) continue;
+		memset(counts, 0, sizeof(int32_t)*256);
+		for(i=0;i<length;i++) {
+			counts[((*keys)[i] >> shift) & 0xFF]++;
+		}
+		for(i=j=0;i<256;i++) {
+			index = counts[i];
+			counts[i] = j;
+			j += index;
+		}
+		for(i=0;i<length;i++) {
+			j = counts[((*keys)[i] >> shift) & 0xFF]++;
+			(*tmpKeys)[j] = (*keys)[i];
+			(*tmpIndexes)[j] = (*indexes)[i];
+		}
+		swapKeys = (*keys); (*keys) = (*tmpKeys); (*tmpKeys) = swapKeys;
+		swapIndexes = (*indexes); (*indexes) = (*tmpIndexes); (*tmpIndexes) = swapIndexes;
+	}
+}
+
 /* TODO */
 void RGMatchRemoveDuplicates(RGMatch *m,
 		int32_t maxNumMatches)
 {
-	int32_t i;
-	int32_t prevIndex=0;
+	char *FnName="RGMatchRemoveDuplicates";
+	int32_t i, j, numUnique, offsetsLength;
+	uint64_t *keys=NULL, *tmpKeys=NULL;
+	int32_t *indexes=NULL, *tmpIndexes=NULL;
+	RGMatch u;
 
 	/* Check to see if the max has been reached.  If so free all matches and return.
 	 * We should remove duplicates before checking against maxNumMatches. */
@@ -251,27 +315,83 @@ void RGMatchRemoveDuplicates(RGMatch *m,
 
 	if(m->numEntries > 0) {
 
-		/* Quick sort the data structure */
-		RGMatchQuickSort(m, 0, m->numEntries-1);
+		/* Sort the keys of the entries */
+		keys = malloc(sizeof(uint64_t)*m->numEntries);
+		tmpKeys = malloc(sizeof(uint64_t)*m->numEntries);
+		indexes = malloc(sizeof(int32_t)*m->numEntries);
+		tmpIndexes = malloc(sizeof(int32_t)*m->numEntries);
+		if(NULL == keys || NULL == tmpKeys || NULL == indexes || NULL == tmpIndexes) {
+			PrintError(FnName, "keys", "Could not allocate memory", Exit, MallocMemory);
+		}
+		for(i=0;i<m->numEntries;i++) {
+			assert(m->contigs[i] < ((uint32_t)1 << 31));
+			keys[i] = RGMATCH_GETKEY(m, i);
+			indexes[i] = i;
+		}
+		RGMatchSortKeys(&keys, &indexes, &tmpKeys, &tmpIndexes, m->numEntries);
+
+		/* Count the unique entries */
+		for(i=numUnique=1;i<m->numEntries;i++) {
+			if(keys[i] != keys[i-1]) numUnique++;
+		}
 
-		/* Remove duplicates */
-		prevIndex=0;
-		for(i=1;i<m->numEntries;i++) {
-			if(RGMatchCompareAtIndex(m, prevIndex, m, i)==0) {
-				/* union of masks */
-				RGMatchUnionMasks(m, prevIndex, i);
-				RGMatchUnionOffsets(m, prevIndex, i);
+		/* Gather the unique entries into new storage */
+		RGMatchInitialize(&u);
+		u.readLength = m->readLength;
+		RGMatchAllocate(&u, numUnique);
+		if(NULL != m->offsets) {
+			RGMatchAllocateOffsets(&u, m->offsetsLength);
+		}
+		for(i=0,j=-1;i<m->numEntries;i++) {
+			if(0 == i || keys[i] != keys[i-1]) {
+				j++;
+				u.contigs[j] = m->contigs[indexes[i]];
+				u.positions[j] = m->positions[indexes[i]];
+				u.strands[j] = m->strands[indexes[i]];
+				memcpy(GETMASK(&u, j), GETMASK(m, indexes[i]), sizeof(char)*GETMASKNUMBYTES(m));
+				if(NULL != m->offsets) {
+					u.offsetsStart[j] = u.offsetsLength;
+				}
 			}
 			else {
-				prevIndex++;
-				/* Copy to prevIndex (incremented) */
-				RGMatchCopyAtIndex(m, prevIndex, m, i);
+				/* union of masks */
+				int32_t k;
+				char *dest = GETMASK(&u, j), *src = GETMASK(m, indexes[i]);
+				for(k=0;k<GETMASKNUMBYTES(m);k++) {
+					dest[k] |= src[k];
+				}
+			}
+			/* union of offsets */
+			if(NULL != m->offsets) {
+				offsetsLength = m->numOffsets[indexes[i]];
+				memcpy(u.offsets + u.offsetsLength, GETOFFSETS(m, indexes[i]), sizeof(int32_t)*offsetsLength);
+				u.offsetsLength += offsetsLength;
+				u.numOffsets[j] += offsetsLength;
 			}
 		}
-
-		/* Reallocate pair */
-		/* does not make sense if there are no entries */
-		RGMatchReallocate(m, prevIndex+1);
+		assert(j+1 == numUnique);
+
+		/* Swap in the unique entries */
+		free(m->contigs);
+		free(m->positions);
+		free(m->strands);
+		free(m->masks);
+		RGMatchFreeOffsets(m);
+		m->numEntries = u.numEntries;
+		m->contigs = u.contigs;
+		m->positions = u.positions;
+		m->strands = u.strands;
+		m->masks = u.masks;
+		m->numOffsets = u.numOffsets;
+		m->offsetsStart = u.offsetsStart;
+		m->offsets = u.offsets;
+		m->offsetsLength = u.offsetsLength;
+		m->offsetsMaxLength = u.offsetsMaxLength;
+
+		free(keys);
+		free(tmpKeys);
+		free(indexes);
+		free(tmpIndexes);
 
 		/* Check to see if we have too many matches */
 		if(NULL == m->offsets && maxNumMatches < m->numEntries) {
@@ -282,6 +402,47 @@ void RGMatchRemoveDuplicates(RGMatch *m,
 	}
 }
 
+/* Allocates a single entry used for swapping entries of m.  The
+ * offsets of m are shared (not copied) so that moving an entry only
+ * moves its span of offsets. */
+static RGMatch *RGMatchAllocateTemp(RGMatch *m)
+{
+	char *FnName="RGMatchAllocateTemp";
+	RGMatch *temp=NULL;
+
+	temp=malloc(sizeof(RGMatch));
+	if(NULL == temp) {
+		PrintError(FnName, "temp", "Could not allocate memory", Exit, MallocMemory);
+	}
+	RGMatchInitialize(temp);
+	temp->readLength = m->readLength;
+	RGMatchAllocate(temp, 1);
+	if(NULL != m->offsets) {
+		temp->numOffsets = calloc(1, sizeof(int32_t));
+		if(NULL == temp->numOffsets) {
+			PrintError(FnName, "temp->numOffsets", "Could not allocate memory", Exit, MallocMemory);
+		}
+		temp->offsetsStart = calloc(1, sizeof(int32_t));
+		if(NULL == temp->offsetsStart) {
+			PrintError(FnName, "temp->offsetsStart", "Could not allocate memory", Exit, MallocMemory);
+		}
+		temp->offsets = m->offsets;
+		temp->offsetsLength = m->offsetsLength;
+		temp->offsetsMaxLength = m->offsetsMaxLength;
+	}
+	return temp;
+}
+
+static void RGMatchFreeTemp(RGMatch *temp)
+{
+	temp->offsets = NULL; // shared
+	free(temp->numOffsets);
+	free(temp->offsetsStart);
+	temp->numOffsets = temp->offsetsStart = NULL;
+	RGMatchFree(temp);
+	free(temp);
+}
+
 /* TODO */
 void RGMatchQuickSort(RGMatch *m, int32_t low, int32_t high)
 {
@@ -298,25 +459,7 @@ void RGMatchQuickSort(RGMatch *m, int32_t low, int32_t high)
 		}
 
 		/* Allocate memory for the temp used for swapping */
-		temp=malloc(sizeof(RGMatch));
-		if(NULL == temp) {
-			PrintError("RGMatchQuickSort", "temp", "Could not allocate memory", Exit, MallocMemory);
-		}
-		RGMatchInitialize(temp);
-		temp->readLength = m->readLength;
-		RGMatchAllocate(temp, 1);
-		if(NULL != m->offsets) {
-			temp->numOffsets = malloc(sizeof(int32_t));
-			if(NULL == temp->numOffsets) {
-				PrintError("RGMatchQuickSort", "temp->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			temp->numOffsets[0]=0;
-			temp->offsets = malloc(sizeof(int32_t*)); // include offsets just in case
-			if(NULL == temp->offsets) {
-				PrintError("RGMatchQuickSort", "temp->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			temp->offsets[0]=NULL;
-		}
+		temp=RGMatchAllocateTemp(m);
 
 		pivot = (low+high)/2;
 
@@ -343,8 +486,7 @@ void RGMatchQuickSort(RGMatch *m, int32_t low, int32_t high)
 		/* Free temp before the recursive call, otherwise we have a worst
 		 * case of O(n) space (NOT IN PLACE) 
 		 * */
-		RGMatchFree(temp);
-		free(temp);
+		RGMatchFreeTemp(temp);
 		temp=NULL;
 
 		RGMatchQuickSort(m, low, pivot-1);
@@ -355,32 +497,13 @@ void RGMatchQuickSort(RGMatch *m, int32_t low, int32_t high)
 /* TODO */
 void RGMatchShellSort(RGMatch *m, int32_t low, int32_t high)
 {
-	char *FnName="RGMatchShellSort";
 	int32_t i, j, inc;
 	RGMatch *temp=NULL;
 
 	inc = ROUND((high - low + 1) / 2);
 
 	/* Allocate memory for the temp used for swapping */
-	temp=malloc(sizeof(RGMatch));
-	if(NULL == temp) {
-		PrintError(FnName, "temp", "Could not allocate memory", Exit, MallocMemory);
-	}
-	RGMatchInitialize(temp);
-	temp->readLength = m->readLength;
-	RGMatchAllocate(temp, 1);
-	if(NULL != m->offsets) {
-		temp->numOffsets = malloc(sizeof(int32_t));
-		if(NULL == temp->numOffsets) {
-			PrintError("RGMatchQuickSort", "temp->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-		}
-		temp->numOffsets[0]=0;
-		temp->offsets = malloc(sizeof(int32_t*)); // include offsets just in case
-		if(NULL == temp->offsets) {
-			PrintError("RGMatchQuickSort", "temp->offsets", "Could not allocate memory", Exit, MallocMemory);
-		}
-		temp->offsets[0]=NULL;
-	}
+	temp=RGMatchAllocateTemp(m);
 
 	while(0 < inc) {
 		for(i=inc + low;i<=high;i++) {
@@ -395,8 +518,7 @@ void RGMatchShellSort(RGMatch *m, int32_t low, int32_t high)
 		inc = ROUND(inc / SHELL_SORT_GAP_DIVIDE_BY);
 	}
 
-	RGMatchFree(temp);
-	free(temp);
+	RGMatchFreeTemp(temp);
 	temp=NULL;
 }
 
@@ -459,19 +581,7 @@ void RGMatchAppend(RGMatch *dest, RGMatch *src)
 
 		// Must allocate if we had no entries
 		if(0 == start && NULL != src->offsets && NULL == dest->offsets) {
-			dest->numOffsets = malloc(sizeof(int32_t)*dest->numEntries);
-			if(NULL == dest->numOffsets) {
-				PrintError(FnName, "dest->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			dest->offsets = malloc(sizeof(int32_t*)*dest->numEntries);
-			if(NULL == dest->offsets) {
-				PrintError(FnName, "dest->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			// initialize
-			for(i=0;i<dest->numEntries;i++) {
-				dest->numOffsets[i] = 0;
-				dest->offsets[i] = NULL;
-			}
+			RGMatchAllocateOffsets(dest, src->offsetsLength);
 		}
 
 		/* Copy over the entries */
@@ -488,8 +598,6 @@ void RGMatchAppend(RGMatch *dest, RGMatch *src)
 /* TODO */
 void RGMatchCopyAtIndex(RGMatch *dest, int32_t destIndex, RGMatch *src, int32_t srcIndex)
 {
-	char *FnName="RGMatchCopyAtIndex";
-	int32_t i;
 	assert(srcIndex >= 0 && srcIndex < src->numEntries);
 	assert(destIndex >= 0 && destIndex < dest->numEntries);
 
@@ -498,21 +606,18 @@ void RGMatchCopyAtIndex(RGMatch *dest, int32_t destIndex, RGMatch *src, int32_t
 		dest->contigs[destIndex] = src->contigs[srcIndex];
 		dest->strands[destIndex] = src->strands[srcIndex];
 		assert(GETMASKNUMBYTES(dest) == GETMASKNUMBYTES(src));
-		assert(NULL != dest->masks[destIndex]);
-		assert(NULL != src->masks[srcIndex]);
-		for(i=0;i<GETMASKNUMBYTES(dest);i++) {
-			dest->masks[destIndex][i] = src->masks[srcIndex][i];
-		}
+		memcpy(GETMASK(dest, destIndex), GETMASK(src, srcIndex), sizeof(char)*GETMASKNUMBYTES(dest));
 		if(NULL != src->offsets) {
 			assert(NULL != dest->offsets);
-			free(dest->offsets[destIndex]);
-			dest->numOffsets[destIndex]=src->numOffsets[srcIndex];
-			dest->offsets[destIndex] = malloc(sizeof(int32_t)*dest->numOffsets[destIndex]);
-			if(NULL == dest->offsets[destIndex]) {
-				PrintError(FnName, "dest->offsets[destIndex]", "Could not allocate memory", Exit, MallocMemory);
+			if(src->offsets == dest->offsets) {
+				/* Same storage, so only the span is copied */
+				dest->offsetsStart[destIndex] = src->offsetsStart[srcIndex];
+				dest->numOffsets[destIndex] = src->numOffsets[srcIndex];
 			}
-			for(i=0;i<src->numOffsets[srcIndex];i++) {
-				dest->offsets[destIndex][i] = src->offsets[srcIndex][i];
+			else {
+				memcpy(RGMatchAppendOffsets(dest, destIndex, src->numOffsets[srcIndex]),
+						GETOFFSETS(src, srcIndex),
+						sizeof(int32_t)*src->numOffsets[srcIndex]);
 			}
 		}
 	}
@@ -522,7 +627,6 @@ void RGMatchCopyAtIndex(RGMatch *dest, int32_t destIndex, RGMatch *src, int32_t
 void RGMatchAllocate(RGMatch *m, int32_t numEntries)
 {
 	char *FnName = "RGMatchAllocate";
-	int32_t i;
 	assert(m->numEntries==0);
 	m->numEntries = numEntries;
 	assert(m->positions==NULL);
@@ -540,16 +644,10 @@ void RGMatchAllocate(RGMatch *m, int32_t numEntries)
 	if(NULL == m->strands) {
 		PrintError(FnName, "m->strands", "Could not allocate memory", Exit, MallocMemory);
 	}
-	m->masks = malloc(sizeof(char*)*numEntries); 
-	if(NULL == m->masks) {
+	m->masks = calloc(GETMASKNUMBYTES(m)*numEntries, sizeof(char)); 
+	if(NULL == m->masks && 0 < numEntries) {
 		PrintError(FnName, "m->masks", "Could not allocate memory", Exit, MallocMemory);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		m->masks[i] = calloc(GETMASKNUMBYTES(m), sizeof(char)); 
-		if(NULL == m->masks[i]) {
-			PrintError(FnName, "m->masks[i]", "Could not allocate memory", Exit, MallocMemory);
-		}
-	}
 }
 
 /* TODO */
@@ -575,36 +673,26 @@ void RGMatchReallocate(RGMatch *m, int32_t numEntries)
 		if(numEntries > 0 && NULL == m->strands) {
 			PrintError(FnName, "m->strands", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		for(i=numEntries;i<prevNumEntries;i++) {
-			free(m->masks[i]);
-		}
-		m->masks = realloc(m->masks, sizeof(char*)*numEntries); 
-		if(NULL == m->masks) {
+		m->masks = realloc(m->masks, sizeof(char)*GETMASKNUMBYTES(m)*numEntries); 
+		if(NULL == m->masks && 0 < GETMASKNUMBYTES(m)) {
 			PrintError(FnName, "m->masks", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		for(i=prevNumEntries;i<m->numEntries;i++) {
-			m->masks[i] = calloc(GETMASKNUMBYTES(m), sizeof(char)); 
-			if(NULL == m->masks[i]) {
-				PrintError(FnName, "m->masks[i]", "Could not allocate memory", Exit, MallocMemory);
-			}
+		if(prevNumEntries < numEntries) {
+			memset(GETMASK(m, prevNumEntries), 0, sizeof(char)*GETMASKNUMBYTES(m)*(numEntries - prevNumEntries));
 		}
 		if(NULL != m->offsets) {
-			for(i=numEntries;i<prevNumEntries;i++) {
-				free(m->offsets[i]);
-				m->offsets[i]=NULL;
-				m->numOffsets[i]=0;
-			}
+			/* The offsets of removed entries are left in the storage */
 			m->numOffsets = realloc(m->numOffsets, sizeof(int32_t)*numEntries);
 			if(NULL == m->numOffsets) {
 				PrintError(FnName, "m->numOffsets", "Could not allocate memory", Exit, MallocMemory);
 			}
-			m->offsets = realloc(m->offsets, sizeof(int32_t*)*numEntries);
-			if(NULL == m->offsets) {
-				PrintError(FnName, "m->offsets", "Could not allocate memory", Exit, MallocMemory);
+			m->offsetsStart = realloc(m->offsetsStart, sizeof(int32_t)*numEntries);
+			if(NULL == m->offsetsStart) {
+				PrintError(FnName, "m->offsetsStart", "Could not allocate memory", Exit, MallocMemory);
 			}
 			for(i=prevNumEntries;i<m->numEntries;i++) {
 				m->numOffsets[i]=0;
-				m->offsets[i]=NULL;
+				m->offsetsStart[i]=m->offsetsLength;
 			}
 		}
 	}
@@ -618,7 +706,6 @@ void RGMatchReallocate(RGMatch *m, int32_t numEntries)
 /* Does not free read */
 void RGMatchClearMatches(RGMatch *m) 
 {
-	int32_t i;
 	/* Free */
 	free(m->contigs);
 	free(m->positions);
@@ -626,45 +713,22 @@ void RGMatchClearMatches(RGMatch *m)
 	m->contigs=NULL;
 	m->positions=NULL;
 	m->strands=NULL;
-	for(i=0;i<m->numEntries;i++) {
-		free(m->masks[i]);
-	}
 	free(m->masks);
 	m->masks=NULL;
-	if(NULL != m->offsets) {
-		free(m->numOffsets);
-		m->numOffsets=NULL;
-		for(i=0;i<m->numEntries;i++) {
-			free(m->offsets[i]);
-		}
-		free(m->offsets);
-		m->offsets=NULL;
-	}
+	RGMatchFreeOffsets(m);
 	m->numEntries=0;
 }
 
 /* TODO */
 void RGMatchFree(RGMatch *m) 
 {
-	int32_t i;
 	free(m->read);
 	free(m->qual);
 	free(m->contigs);
 	free(m->positions);
 	free(m->strands);
-	for(i=0;i<m->numEntries;i++) {
-		free(m->masks[i]);
-	}
 	free(m->masks);
-	if(NULL != m->offsets) {
-		free(m->numOffsets);
-		m->numOffsets=NULL;
-		for(i=0;i<m->numEntries;i++) {
-			free(m->offsets[i]);
-		}
-		free(m->offsets);
-		m->offsets=NULL;
-	}
+	RGMatchFreeOffsets(m);
 	RGMatchInitialize(m);
 }
 
@@ -682,7 +746,72 @@ void RGMatchInitialize(RGMatch *m)
 	m->strands=NULL;
 	m->masks=NULL;
 	m->numOffsets=NULL;
+	m->offsetsStart=NULL;
+	m->offsets=NULL;
+	m->offsetsLength=0;
+	m->offsetsMaxLength=0;
+}
+
+/* TODO */
+/* Allocates empty offsets for each entry, with room for maxLength offsets in total */
+void RGMatchAllocateOffsets(RGMatch *m, int32_t maxLength)
+{
+	char *FnName="RGMatchAllocateOffsets";
+	int32_t i;
+
+	assert(NULL == m->offsets);
+	m->numOffsets = malloc(sizeof(int32_t)*GETMAX(1, m->numEntries));
+	if(NULL == m->numOffsets) {
+		PrintError(FnName, "m->numOffsets", "Could not allocate memory", Exit, MallocMemory);
+	}
+	m->offsetsStart = malloc(sizeof(int32_t)*GETMAX(1, m->numEntries));
+	if(NULL == m->offsetsStart) {
+		PrintError(FnName, "m->offsetsStart", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<m->numEntries;i++) {
+		m->numOffsets[i] = 0;
+		m->offsetsStart[i] = 0;
+	}
+	m->offsetsLength = 0;
+	m->offsetsMaxLength = GETMAX(1, maxLength);
+	m->offsets = malloc(sizeof(int32_t)*m->offsetsMaxLength);
+	if(NULL == m->offsets) {
+		PrintError(FnName, "m->offsets", "Could not allocate memory", Exit, MallocMemory);
+	}
+}
+
+/* TODO */
+/* Reserves room for the given number of offsets at the end of the 
+ * storage for the entry at the given index, returning the start */
+int32_t *RGMatchAppendOffsets(RGMatch *m, int32_t index, int32_t numOffsets)
+{
+	char *FnName="RGMatchAppendOffsets";
+
+	assert(NULL != m->offsets);
+	if(m->offsetsMaxLength < m->offsetsLength + numOffsets) {
+		m->offsetsMaxLength = GETMAX(2*m->offsetsMaxLength, m->offsetsLength + numOffsets);
+		m->offsets = realloc(m->offsets, sizeof(int32_t)*m->offsetsMaxLength);
+		if(NULL == m->offsets) {
+			PrintError(FnName, "m->offsets", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+	}
+	m->offsetsStart[index] = m->offsetsLength;
+	m->numOffsets[index] = numOffsets;
+	m->offsetsLength += numOffsets;
+	return m->offsets + m->offsetsStart[index];
+}
+
+/* TODO */
+void RGMatchFreeOffsets(RGMatch *m)
+{
+	free(m->numOffsets);
+	free(m->offsetsStart);
+	free(m->offsets);
+	m->numOffsets=NULL;
+	m->offsetsStart=NULL;
 	m->offsets=NULL;
+	m->offsetsLength=0;
+	m->offsetsMaxLength=0;
 }
 
 /* TODO */
@@ -723,7 +852,7 @@ int32_t RGMatchCheck(RGMatch *m, RGBinary *rg)
 
 	/* Check mask */
 	for(i=0;i<m->numEntries;i++) {
-		char *mask = RGMatchMaskToString(m->masks[i], m->readLength);
+		char *mask = RGMatchMaskToString(GETMASK(m, i), m->readLength);
 		char reference[SEQUENCE_LENGTH]="\0";
 
 		if(m->strands[i] == FORWARD) {
@@ -928,25 +1057,24 @@ void RGMatchUpdateMask(char *mask, int32_t pos)
 void RGMatchUnionMasks(RGMatch *m, int32_t dest, int32_t src)
 {
 	int32_t i;
+	char *maskDest = GETMASK(m, dest);
+	char *maskSrc = GETMASK(m, src);
 	for(i=0;i<GETMASKNUMBYTES(m);i++) {
-		m->masks[dest][i] |= m->masks[src][i];
+		maskDest[i] |= maskSrc[i];
 	}
 }
 
 void RGMatchUnionOffsets(RGMatch *m, int32_t dest, int32_t src)
 {
-	char *FnName="RGMatchUnionOffsets";
-	int32_t i, prevNumOffsets;
+	int32_t prevStart, prevNumOffsets;
+	int32_t *offsets=NULL;
 
 	if(NULL == m->offsets) return;
 
+	/* Move the union to the end of the storage */
+	prevStart=m->offsetsStart[dest];
 	prevNumOffsets=m->numOffsets[dest];
-	m->numOffsets[dest] += m->numOffsets[src];
-	m->offsets[dest] = realloc(m->offsets[dest], sizeof(int32_t)*m->numOffsets[dest]);
-	if(NULL == m->offsets[dest]) {
-		PrintError(FnName, "m->offsets[dest]", "Could not allocate memory", Exit, MallocMemory);
-	}
-	for(i=0;i<m->numOffsets[src];i++) {
-		m->offsets[dest][i+prevNumOffsets] = m->offsets[src][i];
-	}
+	offsets = RGMatchAppendOffsets(m, dest, prevNumOffsets + m->numOffsets[src]);
+	memcpy(offsets, m->offsets + prevStart, sizeof(int32_t)*prevNumOffsets);
+	memcpy(offsets + prevNumOffsets, GETOFFSETS(m, src), sizeof(int32_t)*m->numOffsets[src]);
 }
@@ -21,6 +21,9 @@ void RGMatchReallocate(RGMatch*, int32_t);
 void RGMatchClearMatches(RGMatch*);
 void RGMatchFree(RGMatch*);
 void RGMatchInitialize(RGMatch*);
+void RGMatchAllocateOffsets(RGMatch*, int32_t);
+int32_t *RGMatchAppendOffsets(RGMatch*, int32_t, int32_t);
+void RGMatchFreeOffsets(RGMatch*);
 int32_t RGMatchCheck(RGMatch*, RGBinary*);
 void RGMatchFilterOutOfRange(RGMatch*, int32_t);
 char *RGMatchMaskToString(char*, int32_t);
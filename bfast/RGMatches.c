@@ -68,7 +68,7 @@ int32_t RGMatchesReadWithOffsets(gzFile fp,
 		RGMatches *m)
 {
 	char *FnName = "RGMatchesReadWithOffsets";
-	int32_t i, j;
+	int32_t i, j, length;
 
 	if(1 != RGMatchesRead(fp, m)) {
 		return EOF;
@@ -76,26 +76,26 @@ int32_t RGMatchesReadWithOffsets(gzFile fp,
 
 	/* Read each end */
 	for(i=0;i<m->numEnds;i++) {
-		m->ends[i].numOffsets = malloc(sizeof(int32_t)*m->ends[i].numEntries);
-		if(NULL == m->ends[i].numOffsets) {
-			PrintError(FnName, "numOffsets", "Could not allocate memory", Exit, MallocMemory);
-		}
-		m->ends[i].offsets = malloc(sizeof(int32_t*)*m->ends[i].numEntries);
-		if(NULL == m->ends[i].offsets) {
-			PrintError(FnName, "offsets", "Could not allocate memory", Exit, MallocMemory);
-		}
+		RGMatchAllocateOffsets(&m->ends[i], 0);
 		if(gzread64(fp, m->ends[i].numOffsets, sizeof(int32_t)*m->ends[i].numEntries) != sizeof(int32_t)*m->ends[i].numEntries) {
 			PrintError(FnName, "numOffsets", "Could not read from file", Exit, ReadFileError);
 		}
-		for(j=0;j<m->ends[i].numEntries;j++) {
-			m->ends[i].offsets[j] = malloc(sizeof(int32_t)*m->ends[i].numOffsets[j]);
-			if(NULL == m->ends[i].offsets[j]) {
-				PrintError(FnName, "offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			if(gzread64(fp, m->ends[i].offsets[j], sizeof(int32_t)*m->ends[i].numOffsets[j]) != sizeof(int32_t)*m->ends[i].numOffsets[j]) {
-				PrintError(FnName, "offsets[j]", "Could not read from file", Exit, ReadFileError);
+		/* The offsets of all entries are stored back to back */
+		for(j=length=0;j<m->ends[i].numEntries;j++) {
+			m->ends[i].offsetsStart[j] = length;
+			length += m->ends[i].numOffsets[j];
+		}
+		if(m->ends[i].offsetsMaxLength < length) {
+			m->ends[i].offsetsMaxLength = length;
+			m->ends[i].offsets = realloc(m->ends[i].offsets, sizeof(int32_t)*length);
+			if(NULL == m->ends[i].offsets) {
+				PrintError(FnName, "offsets", "Could not reallocate memory", Exit, ReallocMemory);
 			}
 		}
+		m->ends[i].offsetsLength = length;
+		if(gzread64(fp, m->ends[i].offsets, sizeof(int32_t)*length) != sizeof(int32_t)*length) {
+			PrintError(FnName, "offsets", "Could not read from file", Exit, ReadFileError);
+		}
 	}
 
 	return 1;
@@ -181,7 +181,7 @@ void RGMatchesPrintWithOffsets(gzFile fp,
 			PrintError(FnName, "numOffsets", "Could not write to file", Exit, WriteFileError);
 		}
 		for(j=0;j<m->ends[i].numEntries;j++) {
-			if(gzwrite64(fp, m->ends[i].offsets[j], sizeof(int32_t)*m->ends[i].numOffsets[j]) != sizeof(int32_t)*m->ends[i].numOffsets[j]) {
+			if(gzwrite64(fp, GETOFFSETS(&m->ends[i], j), sizeof(int32_t)*m->ends[i].numOffsets[j]) != sizeof(int32_t)*m->ends[i].numOffsets[j]) {
 				PrintError(FnName, "offsets[j]", "Could not write to file", Exit, WriteFileError);
 			}
 		}
@@ -353,6 +353,104 @@ int32_t RGMatchesMergeFilesAndOutput(gzFile *tempFPs,
 	return numMatches;
 }
 
+/* Merges matches from the same read, where the reads resolved with an
+ * index were not searched with the later indexes.  numPasses gives the
+ * number of files each read is in, starting with the first file. */
+int32_t RGMatchesMergeCascadeAndOutput(gzFile *tempFPs,
+		int32_t numFiles,
+		uint8_t *numPasses,
+		int64_t numReads,
+		gzFile outputFP,
+		int32_t maxNumMatches)
+{
+	char *FnName="RGMatchesMergeCascadeAndOutput";
+	int64_t i;
+	int32_t j, k;
+	int32_t numMatches=0;
+	RGMatches m, next;
+
+	RGMatchesInitialize(&m);
+	RGMatchesInitialize(&next);
+
+	if(VERBOSE >=0) {
+		fputs("\r[0]", stderr);
+	}
+	for(i=0;i<numReads;i++) {
+		assert(0 < numPasses[i] && numPasses[i] <= numFiles);
+		if(RGMatchesRead(tempFPs[0], &m)==EOF) {
+			PrintError(FnName, NULL, "Did not read in the correct # of entries", Exit, OutOfRange);
+		}
+		// Append
+		for(j=1;j<numPasses[i];j++) {
+			if(RGMatchesRead(tempFPs[j], &next)==EOF) {
+				PrintError(FnName, NULL, "Did not read in the correct # of entries", Exit, OutOfRange);
+			}
+			if(0 != strcmp(m.readName, next.readName)) {
+				PrintError(FnName, NULL, "Read names do not match", Exit, OutOfRange);
+			}
+			RGMatchesAppend(&m, &next);
+			RGMatchesFree(&next);
+		}
+		// Remove duplicates
+		RGMatchesRemoveDuplicates(&m, maxNumMatches);
+		// Count matches
+		for(k=0;k<m.numEnds;k++) {
+			if(0 < m.ends[k].numEntries) {
+				numMatches++;
+				break;
+			}
+		}
+		RGMatchesPrint(outputFP, &m);
+		RGMatchesFree(&m);
+		if(VERBOSE >= 0 && 0 == (i+1) % RGMATCH_MERGE_ROTATE_NUM) {
+			fprintf(stderr, "\r[%lld]", (long long int)(i+1));
+		}
+	}
+	// We must finish all at the same time
+	for(j=0;j<numFiles;j++) {
+		if(RGMatchesRead(tempFPs[j], &next)!=EOF) {
+			PrintError(FnName, NULL, "Did not read in the correct # of entries", Exit, OutOfRange);
+		}
+	}
+
+	if(VERBOSE >=0) {
+		fprintf(stderr, "\r[%lld]... completed.\n", (long long int)numReads);
+	}
+
+	return numMatches;
+}
+
+/* Returns 1 if every end has between one and maxCandidates candidate
+ * locations, each covering at least minCoverage percent of the read with
+ * matching keys, and 0 otherwise */
+int32_t RGMatchesIsResolved(RGMatches *m,
+		int32_t maxCandidates,
+		int32_t minCoverage)
+{
+	int32_t i, j, k, numCovered;
+	char *mask=NULL;
+
+	for(i=0;i<m->numEnds;i++) {
+		if(1 == m->ends[i].maxReached ||
+				m->ends[i].numEntries <= 0 ||
+				maxCandidates < m->ends[i].numEntries) {
+			return 0;
+		}
+		for(j=0;j<m->ends[i].numEntries;j++) {
+			mask = GETMASK(&m->ends[i], j);
+			for(k=numCovered=0;k<m->ends[i].readLength;k++) {
+				if(0 != (mask[GETMASKBYTE(k)] & (0x01 << (k % 8)))) {
+					numCovered++;
+				}
+			}
+			if(100*numCovered < minCoverage*m->ends[i].readLength) {
+				return 0;
+			}
+		}
+	}
+	return (0 < m->numEnds) ? 1 : 0;
+}
+
 /* TODO */
 void RGMatchesAppend(RGMatches *dest, RGMatches *src)
 {
@@ -618,14 +716,14 @@ int32_t RGMatchesMergeIndexBins(gzFile *tempOutputIndexBinFPs,
 				}
 				for(j=0;j<matches.ends[i].numEntries;j++) { // count # of matches per offset
 					for(k=0;k<matches.ends[i].numOffsets[j];k++) {
-						numKeyMatches[matches.ends[i].offsets[j][k]]++;
+						numKeyMatches[GETOFFSETS(&matches.ends[i], j)[k]]++;
 					}
 				}
 				for(j=k=0;j<matches.ends[i].numEntries;j++) {
 					// Find any offset that is below the bound
                                         int keyMissCount = 0;
 					for(l=0;l<matches.ends[i].numOffsets[j];l++) {
-						if(numKeyMatches[matches.ends[i].offsets[j][l]] <= maxKeyMatches) {
+						if(numKeyMatches[GETOFFSETS(&matches.ends[i], j)[l]] <= maxKeyMatches) {
                                                     keyMissCount++;
                                                     break;
                                                 }
@@ -643,28 +741,26 @@ int32_t RGMatchesMergeIndexBins(gzFile *tempOutputIndexBinFPs,
 							matches.ends[i].strands[k] = matches.ends[i].strands[j];
 						}
 						// Zero out mask
-						for(l=0;l<GETMASKNUMBYTESFROMLENGTH(matches.ends[i].readLength);l++) {
-							matches.ends[i].masks[k][l] = 0;
-						}
+						memset(GETMASK(&matches.ends[i], k), 0, sizeof(char)*GETMASKNUMBYTES((&matches.ends[i])));
 						// Copy over masks based on kept offsets
 						for(l=0;l<matches.ends[i].numOffsets[j];l++) { // for each offset
-							if(numKeyMatches[matches.ends[i].offsets[j][l]] <= maxKeyMatches) {
+							if(numKeyMatches[GETOFFSETS(&matches.ends[i], j)[l]] <= maxKeyMatches) {
 								// Add ot the mask
 								for(m=0;m<index->width;m++) {
 									if(FORWARD == matches.ends[i].strands[j]) {
 										if(1 == index->mask[m]) {
-											int32_t offset = matches.ends[i].offsets[j][l] + m; 
+											int32_t offset = GETOFFSETS(&matches.ends[i], j)[l] + m; 
 											// Color space already adjusted
 											//if(ColorSpace == index->space) offset++;
-											RGMatchUpdateMask(matches.ends[i].masks[k], offset); 
+											RGMatchUpdateMask(GETMASK(&matches.ends[i], k), offset); 
 										}
 									}
 									else {
 										if(1 == index->mask[index->width - m - 1]) {
-											int32_t offset = matches.ends[i].offsets[j][l] + m; 
+											int32_t offset = GETOFFSETS(&matches.ends[i], j)[l] + m; 
 											// Color space already adjusted
 											//if(ColorSpace == index->space) offset--;
-											RGMatchUpdateMask(matches.ends[i].masks[k], offset); 
+											RGMatchUpdateMask(GETMASK(&matches.ends[i], k), offset); 
 										}
 									}
 								}
@@ -674,14 +770,7 @@ int32_t RGMatchesMergeIndexBins(gzFile *tempOutputIndexBinFPs,
 					}
 				}
 				// remove offsets
-				for(j=0;j<matches.ends[i].numEntries;j++) {
-					free(matches.ends[i].offsets[j]);
-					matches.ends[i].offsets[j]=NULL;
-				}
-				free(matches.ends[i].numOffsets);
-				matches.ends[i].numOffsets=NULL;
-				free(matches.ends[i].offsets);
-				matches.ends[i].offsets=NULL;
+				RGMatchFreeOffsets(&matches.ends[i]);
 				// reallocate
 				RGMatchReallocate(&matches.ends[i], k); // important that k is preserved up to this point
 				// check if there were too many matches by removing duplicates
@@ -14,6 +14,8 @@ void RGMatchesPrintText(FILE*, RGMatches*);
 void RGMatchesPrintFastq(FILE*, RGMatches*);
 void RGMatchesRemoveDuplicates(RGMatches*, int32_t);
 int32_t RGMatchesMergeFilesAndOutput(gzFile*, int32_t, gzFile, int32_t, int32_t);
+int32_t RGMatchesMergeCascadeAndOutput(gzFile*, int32_t, uint8_t*, int64_t, gzFile, int32_t);
+int32_t RGMatchesIsResolved(RGMatches*, int32_t, int32_t);
 int32_t RGMatchesMergeThreadTempFilesIntoOutputTempFile(gzFile*, int32_t, gzFile);
 int32_t RGMatchesCompareAtIndex(RGMatches*, int32_t, RGMatches*, int32_t);
 void RGMatchesAppend(RGMatches*, RGMatches*);
@@ -7,18 +7,28 @@
 #include "BLibDefinitions.h"
 #include "BError.h"
 #include "RGMatch.h"
+#include "RGIndex.h"
 #include "RGRanges.h"
 
 /* TODO */
+/* Expands the ranges directly into the matches.  The matches are 
+ * reserved once for all ranges, and the mask of each range is built 
+ * once and copied to each of its entries.  Without offsets, an entry 
+ * that hits the same diagonal as an entry from the previous range on
+ * the same strand is merged as it arrives.  This is a best-effort
+ * pre-merge: other duplicates are left for RGMatchRemoveDuplicates. */
 void RGRangesCopyToRGMatch(RGRanges *r,
 		RGIndex *index,
 		RGMatch *m,
 		int32_t space,
 		int32_t copyOffsets)
 {
-	char *FnName="RGRangesCopyToRGMatch";
 	int64_t i, j, counter, numEntries, prevNumEntries;
-	int32_t k;
+	int64_t prev, prevStart[2], prevEnd[2], curStart;
+	int32_t k, s, maskNumBytes, position, adjustment;
+	uint32_t contig, indexPosition;
+	char mask[GETMASKNUMBYTESFROMLENGTH(SEQUENCE_LENGTH)+1];
+	char *dest=NULL;
 
 	if(0 < r->numEntries) {
 		prevNumEntries = m->numEntries;
@@ -28,136 +38,140 @@ void RGRangesCopyToRGMatch(RGRanges *r,
 		RGMatchReallocate(m, prevNumEntries + numEntries); 
 		if(1 == copyOffsets && NULL == m->offsets) {
 			assert(0 == prevNumEntries);
-			m->numOffsets = malloc(sizeof(int32_t)*m->numEntries);
-			if(NULL == m->numOffsets) {
-				PrintError(FnName, "m->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			m->offsets = malloc(sizeof(int32_t*)*m->numEntries);
-			if(NULL == m->offsets) {
-				PrintError(FnName, "m->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			for(i=0;i<m->numEntries;i++) {
-				m->numOffsets[i] = 0;
-				m->offsets[i] = NULL;
-			}
+			RGMatchAllocateOffsets(m, m->numEntries);
 		}
+		maskNumBytes = GETMASKNUMBYTES(m);
+		assert(maskNumBytes <= GETMASKNUMBYTESFROMLENGTH(SEQUENCE_LENGTH)+1);
+		/* In color space we removed the first base/color so we need to 
+		 * decrement the positions by one.
+		 * */
+		adjustment = (ColorSpace == space) ? 1 : 0;
+
 		/* Copy over for each range */
 		counter = prevNumEntries;
+		prevStart[0] = prevStart[1] = prevEnd[0] = prevEnd[1] = counter;
 		for(i=0;i<r->numEntries;i++) {
+			assert(0 <= r->startIndex[i] && r->endIndex[i] < index->length);
+			s = (FORWARD == r->strand[i]) ? 0 : 1;
+
+			/* Build the mask for this range */
+			memset(mask, 0, sizeof(char)*maskNumBytes);
+			if(FORWARD == r->strand[i]) {
+				for(k=0;k<index->width;k++) {
+					if(1 == index->mask[k]) {
+						RGMatchUpdateMask(mask, r->offset[i] + k + adjustment);
+					}
+				}
+			}
+			else {
+				for(k=0;k<index->width;k++) {
+					if(1 == index->mask[index->width - k - 1]) {
+						RGMatchUpdateMask(mask, r->offset[i] + k - adjustment);
+					}
+				}
+			}
+
 			/* Copy over for the given range */
+			curStart = counter;
 			for(j=r->startIndex[i];j<=r->endIndex[i];j++) {
-				assert(j>=0 && j<index->length);
-				assert(counter >= 0 && counter < m->numEntries);
 				/* Get contig number */ 
-				if(index->contigType == Contig_8) {
-					m->contigs[counter] = index->contigs_8[j];
-				}
-				else {
-					m->contigs[counter] = index->contigs_32[j];
-				}
+				RGIndexGetContigPos(index, j, &contig, &indexPosition);
 				/* Adjust position with the offset */
 				if(FORWARD == r->strand[i]) {
-					m->positions[counter] = index->positions[j] - r->offset[i];
+					position = indexPosition - r->offset[i] - adjustment;
 				}
 				else {
-					m->positions[counter] = index->positions[j] + index->width + r->offset[i] - m->readLength;
-				}
-				m->strands[counter] = r->strand[i];
-				if(ColorSpace == space) {
-					/* In color space we removed the first base/color so we need to 
-					 * decrement the positions by one.
-					 * */
-					m->positions[counter]--;
+					position = indexPosition + index->width + r->offset[i] - m->readLength - adjustment;
 				}
-				// Update mask
-				if(FORWARD == m->strands[counter]) {
-					for(k=0;k<index->width;k++) {
-						if(1 == index->mask[k]) {
-							int32_t offset = r->offset[i] + k;
-							if(ColorSpace == space) offset++;
-							RGMatchUpdateMask(m->masks[counter], 
-									offset);
+
+				if(0 == copyOffsets && prevEnd[s] - prevStart[s] <= RGRANGES_MAX_MERGE_LENGTH) {
+					/* Entries with the same key are not ordered by contig and
+					 * position, so search the whole previous range */
+					for(prev=prevStart[s];prev < prevEnd[s];prev++) {
+						if(m->contigs[prev] == contig && 
+								m->positions[prev] == position) {
+							break;
 						}
 					}
-				}
-				else {
-					for(k=0;k<index->width;k++) {
-						if(1 == index->mask[index->width - k - 1]) {
-							int32_t offset = r->offset[i] + k;
-							if(ColorSpace == space) offset--;
-							RGMatchUpdateMask(m->masks[counter], 
-									offset);
+					if(prev < prevEnd[s]) {
+						/* Same diagonal, so union the masks */
+						dest = GETMASK(m, prev);
+						for(k=0;k<maskNumBytes;k++) {
+							dest[k] |= mask[k];
 						}
+						continue;
 					}
 				}
+
+				assert(counter >= 0 && counter < m->numEntries);
+				m->contigs[counter] = contig;
+				m->positions[counter] = position;
+				m->strands[counter] = r->strand[i];
+				memcpy(GETMASK(m, counter), mask, sizeof(char)*maskNumBytes);
 				// Copy offsets if necessary
 				if(1 == copyOffsets) {
+					int32_t *offset=NULL;
 					assert(0 == m->numOffsets[counter]);
-					m->numOffsets[counter]=1;
-					m->offsets[counter] = malloc(sizeof(int32_t));
-					if(NULL == m->offsets[counter]) {
-						PrintError(FnName, "m->offsets[counter]", "Could not allocate memory", Exit, MallocMemory);
-					}
-					m->offsets[counter][0] = r->offset[i];
+					offset = RGMatchAppendOffsets(m, counter, 1);
+					offset[0] = r->offset[i];
 					// Adjust for color space
 					if(ColorSpace == space) {
-						if(FORWARD == m->strands[counter]) m->offsets[counter][0]++;
-						else m->offsets[counter][0]--;
+						if(FORWARD == m->strands[counter]) offset[0]++;
+						else offset[0]--;
 					}
 				}
 				counter++;
 			}
+			prevStart[s] = curStart;
+			prevEnd[s] = counter;
+		}
+		assert(prevNumEntries < counter && counter <= m->numEntries);
+		if(counter < m->numEntries) {
+			RGMatchReallocate(m, counter);
+		}
+	}
+}
+
+/* TODO */
+/* Reserves room for at least the given number of ranges */
+void RGRangesReserve(RGRanges *r, int32_t maxNumEntries)
+{
+	if(r->maxNumEntries < maxNumEntries) {
+		r->maxNumEntries = maxNumEntries;
+		r->startIndex = realloc(r->startIndex, sizeof(int64_t)*maxNumEntries); 
+		if(NULL == r->startIndex) {
+			PrintError("RGRangesReserve", "r->startIndex", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		r->endIndex = realloc(r->endIndex, sizeof(int64_t)*maxNumEntries); 
+		if(NULL == r->endIndex) {
+			PrintError("RGRangesReserve", "r->endIndex", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		r->strand = realloc(r->strand, sizeof(char)*maxNumEntries); 
+		if(NULL == r->strand) {
+			PrintError("RGRangesReserve", "r->strand", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		r->offset = realloc(r->offset, sizeof(int32_t)*maxNumEntries); 
+		if(NULL == r->offset) {
+			PrintError("RGRangesReserve", "r->offset", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		assert(counter == m->numEntries);
 	}
 }
 
 void RGRangesAllocate(RGRanges *r, int32_t numEntries)
 {
 	assert(r->numEntries==0);
+	RGRangesReserve(r, numEntries);
 	r->numEntries = numEntries;
-	assert(r->startIndex==NULL);
-	r->startIndex = malloc(sizeof(int64_t)*numEntries); 
-	if(NULL == r->startIndex) {
-		PrintError("RGRangesAllocate", "r->startIndex", "Could not allocate memory", Exit, MallocMemory);
-	}
-	assert(r->endIndex==NULL);
-	r->endIndex = malloc(sizeof(int64_t)*numEntries); 
-	if(NULL == r->endIndex) {
-		PrintError("RGRangesAllocate", "r->endIndex", "Could not allocate memory", Exit, MallocMemory);
-	}
-	assert(r->strand==NULL);
-	r->strand = malloc(sizeof(char)*numEntries); 
-	if(NULL == r->strand) {
-		PrintError("RGRangesAllocate", "r->strand", "Could not allocate memory", Exit, MallocMemory);
-	}
-	assert(r->offset==NULL);
-	r->offset = malloc(sizeof(int32_t)*numEntries); 
-	if(NULL == r->offset) {
-		PrintError("RGRangesAllocate", "r->offset", "Could not allocate memory", Exit, MallocMemory);
-	}
 }
 
 void RGRangesReallocate(RGRanges *r, int32_t numEntries)
 {
 	if(numEntries > 0) {
-		r->numEntries = numEntries;
-		r->startIndex = realloc(r->startIndex, sizeof(int64_t)*numEntries); 
-		if(numEntries > 0 && NULL == r->startIndex) {
-			PrintError("RGRangesReallocate", "r->startIndex", "Could not reallocate memory", Exit, ReallocMemory);
-		}
-		r->endIndex = realloc(r->endIndex, sizeof(int64_t)*numEntries); 
-		if(numEntries > 0 && NULL == r->endIndex) {
-			PrintError("RGRangesReallocate", "r->endIndex", "Could not reallocate memory", Exit, ReallocMemory);
-		}
-		r->strand = realloc(r->strand, sizeof(char)*numEntries); 
-		if(numEntries > 0 && NULL == r->strand) {
-			PrintError("RGRangesReallocate", "r->strand", "Could not reallocate memory", Exit, ReallocMemory);
-		}
-		r->offset = realloc(r->offset, sizeof(int32_t)*numEntries); 
-		if(numEntries > 0 && NULL == r->offset) {
-			PrintError("RGRangesReallocate", "r->offset", "Could not reallocate memory", Exit, ReallocMemory);
+		if(r->maxNumEntries < numEntries) {
+			/* Grow geometrically */
+			RGRangesReserve(r, GETMAX(numEntries, 2*r->maxNumEntries));
 		}
+		r->numEntries = numEntries;
 	}
 	else {
 		RGRangesFree(r);
@@ -166,18 +180,17 @@ void RGRangesReallocate(RGRanges *r, int32_t numEntries)
 
 void RGRangesFree(RGRanges *r) 
 {
-	if(r->numEntries>0) {
-		free(r->startIndex);
-		free(r->endIndex);
-		free(r->strand);
-		free(r->offset);
-	}
+	free(r->startIndex);
+	free(r->endIndex);
+	free(r->strand);
+	free(r->offset);
 	RGRangesInitialize(r);
 }
 
 void RGRangesInitialize(RGRanges *r)
 {
 	r->numEntries=0;
+	r->maxNumEntries=0;
 	r->startIndex=NULL;
 	r->endIndex=NULL;
 	r->strand=NULL;
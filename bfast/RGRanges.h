@@ -5,6 +5,7 @@
 #include "BLibDefinitions.h"
 
 void RGRangesCopyToRGMatch(RGRanges*, RGIndex*, RGMatch*, int32_t, int32_t);
+void RGRangesReserve(RGRanges*, int32_t);
 void RGRangesAllocate(RGRanges*, int32_t);
 void RGRangesReallocate(RGRanges*, int32_t);
 void RGRangesFree(RGRanges*);
@@ -13,6 +13,7 @@
 #include "RGMatch.h"
 #include "RGRanges.h"
 #include "RGReads.h"
+#include "Metrics.h"
 
 /* TODO 
  * */
@@ -35,7 +36,8 @@ void RGReadsFindMatches(RGIndex *index,
 		int maxKeyMatches,
                 double keyMissFraction,
 		int maxNumMatches,
-		int strands)
+		int strands,
+		RGIndexKeys *keys)
 {
 	int64_t i;
 	int readLength=0;
@@ -43,7 +45,7 @@ void RGReadsFindMatches(RGIndex *index,
 	RGReads reads;
 	RGRanges ranges;
 	int readOffset = 0;
-        int count, total;
+        int count, total, rejected;
 
         if(match->maxReached < 0) { // ignore
             return;
@@ -66,6 +68,17 @@ void RGReadsFindMatches(RGIndex *index,
 			read,
 			readLength);
 
+	/* Get the keys for all offsets and both strands at once */
+	RGIndexKeysCompute(index,
+			read,
+			readLength,
+			space,
+			strands,
+			keys);
+
+	/* Reserve a forward and reverse range for each offset */
+	RGRangesReserve(&ranges, 2*((0 < numOffsets) ? numOffsets : GETMAX(1, readLength)));
+
 	/* Merge all reads */
 	/* This may be necessary for a large number of generated reads, but omit for now */
 	/*
@@ -77,7 +90,7 @@ void RGReadsFindMatches(RGIndex *index,
 	   RGReadsRemoveDuplicates(reads);
 	   }
 	   */
-        count = total = 0;
+        count = total = rejected = 0;
 
 	if(0 < numOffsets) { /* Go through the offsets */
 		for(i=0;0 <= match->maxReached && // have not reached the maximum
@@ -93,9 +106,11 @@ void RGReadsFindMatches(RGIndex *index,
 					maxNumMatches,
 					space,
 					strands,
+					keys,
 					&ranges)) {
                           case 1:
                             count++;
+                            rejected++;
                             break;
                           case 2:
                             count++;
@@ -122,9 +137,11 @@ void RGReadsFindMatches(RGIndex *index,
 					maxNumMatches,
 					space,
 					strands,
+					keys,
 					&ranges)) {
                           case 1:
                             count++;
+                            rejected++;
                             break;
                           case 2:
                             count++;
@@ -139,6 +156,9 @@ void RGReadsFindMatches(RGIndex *index,
 		}
 	}
 
+        MetricsCount(MetricsIndexLookups, total);
+        MetricsCount(MetricsKeysRejected, rejected);
+
         if(0 == total) {
             // ignore
         }
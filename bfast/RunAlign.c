@@ -51,6 +51,10 @@ void RunAlign(
 			readFileName,
 			NULL,
 			IndexesMemorySerial,
+			0,
+			PREFETCH_MEMORY_AVAILABLE,
+			0,
+			DEFAULT_CASCADE_COVERAGE,
 			compression,
 			space,
 			1,
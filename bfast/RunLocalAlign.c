@@ -2,7 +2,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include <pthread.h>
 #include "BLibDefinitions.h"
 #include "BError.h"
 #include "BLib.h"
@@ -14,6 +13,9 @@
 #include "AlignedEntry.h" 
 #include "ScoringMatrix.h"
 #include "Align.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include "RunLocalAlign.h"
 
 /* TODO */
@@ -42,6 +44,7 @@ void RunAligner(char *fastaFileName,
 	gzFile outputFP=NULL;
 	gzFile matchFP=NULL;
 	int32_t startTime, endTime;
+	int64_t stageStart;
 	RGBinary rg;
 	int32_t totalReferenceGenomeTime=0;
 	int32_t totalAlignedTime=0;
@@ -49,9 +52,13 @@ void RunAligner(char *fastaFileName,
 	int32_t seconds, minutes, hours;
 
 	startTime = time(NULL);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("load reference");
 	RGBinaryReadBinary(&rg,
 			NTSpace, // always NT space
 			fastaFileName);
+	TRACE_END();
+	MetricsStop(MetricsLoad, stageStart);
 	endTime = time(NULL);
 	/* Unpack */
 	/*
@@ -114,9 +121,11 @@ void RunAligner(char *fastaFileName,
 	}
 
 	/* Close the match file */
+	MetricsCountGZ(MetricsBytesIn, matchFP);
 	gzclose(matchFP);
 
 	/* Close output file */
+	MetricsCountGZ(MetricsBytesOut, outputFP);
 	gzclose(outputFP);
 
 	/* Free the Reference Genome */
@@ -202,12 +211,11 @@ void RunDynamicProgramming(gzFile matchFP,
 	int32_t numAligned=0;
 	int32_t numNotAligned=0;
 	int32_t startTime, endTime;
+	int64_t stageStart;
 	int64_t numLocalAlignments=0;
+	int64_t numPrunedAlignments=0;
 	/* Thread specific data */
 	ThreadData *data;
-	pthread_t *threads=NULL;
-	int32_t errCode;
-	void *status;
 	RGMatches *matchQueue=NULL;
 	AlignedRead *alignedQueue=NULL;
 	int32_t matchQueueLength=0;
@@ -234,11 +242,6 @@ void RunDynamicProgramming(gzFile matchFP,
 	if(NULL==data) {
 		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
 	}
-	/* Allocate memory for thread ids */
-	threads = malloc(sizeof(pthread_t)*numThreads);
-	if(NULL==threads) {
-		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-	}
 
 	/* Start file handling timer */
 	startTime = time(NULL);
@@ -276,9 +279,13 @@ void RunDynamicProgramming(gzFile matchFP,
 	}
 
 	startTime = time(NULL);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("read");
 	while(0 != (numMatchesRead = GetMatches(matchFP, &matchFPctr, startReadNum, endReadNum, matchQueue, queueLength))) {
+		TRACE_END();
 		endTime = time(NULL);
 		(*totalFileHandlingTime) += endTime - startTime;
+		MetricsStop(MetricsRead, stageStart);
 
 		numReadsProcessed += numMatchesRead;
 		matchQueueLength = numMatchesRead;
@@ -298,6 +305,7 @@ void RunDynamicProgramming(gzFile matchFP,
 			data[i].unconstrained = unconstrained;
 			data[i].bestOnly = bestOnly;
 			data[i].numLocalAlignments = 0;
+			data[i].numPrunedAlignments = 0;
 			data[i].avgMismatchQuality = avgMismatchQuality;
 			data[i].matchScore = matchScore;
 			data[i].mismatchScore = mismatchScore;
@@ -310,42 +318,18 @@ void RunDynamicProgramming(gzFile matchFP,
 			data[i].alignedQueue = alignedQueue;
 		}
 
-		/* Create threads */
+		/* Run the threads */
 		startTime = time(NULL);
-		for(i=0;i<numThreads;i++) {
-			/* Start thread */
-			errCode = pthread_create(&threads[i], /* thread struct */
-					NULL, /* default thread attributes */
-					RunDynamicProgrammingThread, /* start routine */
-					&data[i]); /* data to routine */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-			}
-			if(VERBOSE >= DEBUG) {
-				fprintf(stderr, "Created threadID:%d\n",
-						i);
-			}
-		}
-
-		/* Wait for the threads to finish */
-		for(i=0;i<numThreads;i++) {
-			/* Wait for the given thread to return */
-			errCode = pthread_join(threads[i],
-					&status);
-			if(VERBOSE >= DEBUG) {
-				fprintf(stderr, "Thread returned with errCode:%d\n",
-						errCode);
-			}
-			/* Check the return code of the thread */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-			}
-		}
+		TRACE_BEGIN("join align");
+		ThreadPoolRun(RunDynamicProgrammingThread, data, sizeof(ThreadData), numThreads);
+		TRACE_END();
 		endTime = time(NULL);
 		(*totalAlignedTime) += (endTime - startTime);
 
 		// Output to file 
 		startTime = time(NULL);
+		stageStart = MetricsStart();
+		TRACE_BEGIN("output");
 		for(i=0;i<matchQueueLength;i++) {
 			AlignedReadPrint(&alignedQueue[i],
 					outputFP);
@@ -355,6 +339,8 @@ void RunDynamicProgramming(gzFile matchFP,
 			RGMatchesFree(&matchQueue[i]);
 			outputCtr++;
 		}
+		TRACE_END();
+		MetricsStop(MetricsWrite, stageStart);
 		endTime = time(NULL);
 		(*totalFileHandlingTime) += endTime - startTime;
 
@@ -363,6 +349,7 @@ void RunDynamicProgramming(gzFile matchFP,
 			numAligned += data[i].numAligned;
 			numNotAligned += data[i].numNotAligned;
 			numLocalAlignments += data[i].numLocalAlignments;
+			numPrunedAlignments += data[i].numPrunedAlignments;
 		}
 
 		if(VERBOSE >= 0) {
@@ -370,7 +357,11 @@ void RunDynamicProgramming(gzFile matchFP,
 		}
 
 		startTime = time(NULL);
+		stageStart = MetricsStart();
+		TRACE_BEGIN("read");
 	}
+	TRACE_END();
+	MetricsStop(MetricsRead, stageStart);
 
 
 	if(0 <= VERBOSE) {
@@ -382,6 +373,9 @@ void RunDynamicProgramming(gzFile matchFP,
 
 	if(VERBOSE >=0) {
 		fprintf(stderr, "Performed %lld local alignments.\n", (long long int)numLocalAlignments);
+		if(BestOnly == bestOnly) {
+			fprintf(stderr, "Skipped %lld local alignments that could not reach the best score.\n", (long long int)numPrunedAlignments);
+		}
 		fprintf(stderr, "Outputted alignments for %d reads.\n", numAligned);
 		fprintf(stderr, "Outputted %d reads for which there were no alignments.\n", numNotAligned); 
 		fprintf(stderr, "Outputting complete.\n");
@@ -391,7 +385,6 @@ void RunDynamicProgramming(gzFile matchFP,
 	free(matchQueue);
 	free(alignedQueue);
 	free(data);
-	free(threads);
 }
 
 /* TODO */
@@ -422,10 +415,10 @@ void *RunDynamicProgrammingThread(void *arg)
 	/* Local variables */
 	//char *FnName = "RunDynamicProgrammingThread";
 	int32_t j, wasAligned, queueIndex;
-	AlignMatrix matrix;
-	
-	/* Initialize */
-	AlignMatrixInitialize(&matrix);
+	/* The matrix is kept by the worker across batches */
+	AlignMatrix *matrix = &ThreadPoolGetWorker(threadID)->matrix;
+	int64_t stageStart = MetricsStart();
+	TRACE_BEGIN("align");
 
 	/* Go through each read in the match file */
 	for(queueIndex=threadID;queueIndex<queueLength;queueIndex+=numThreads) {
@@ -454,7 +447,8 @@ void *RunDynamicProgrammingThread(void *arg)
                                         pairedEndLength,
                                         mirroringType,
                                         forceMirroring,
-                                        &matrix);
+                                        matrix,
+                                        &data->numPrunedAlignments);
 
                         for(j=wasAligned=0;j<alignedQueue[queueIndex].numEnds;j++) {
                                 if(0 < alignedQueue[queueIndex].ends[j].numEntries) {
@@ -497,9 +491,8 @@ void *RunDynamicProgrammingThread(void *arg)
                 /* Free memory */
                 RGMatchesFree(&matchQueue[queueIndex]);
 	}
-	/* Free the matrix, free your mind */
-	AlignMatrixFree(&matrix);
-
+	TRACE_END();
+	MetricsStop(MetricsAlign, stageStart);
 	return arg;
 }
 
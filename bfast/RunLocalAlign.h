@@ -28,6 +28,7 @@ typedef struct {
 	int32_t unconstrained;
 	int32_t bestOnly;
 	int64_t numLocalAlignments;
+	int64_t numPrunedAlignments;
 	int32_t avgMismatchQuality;
         double matchScore;
 	double mismatchScore;
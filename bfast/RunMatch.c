@@ -2,9 +2,11 @@
 #include <assert.h>
 #include <string.h>
 #include <time.h>
+#include <sys/time.h>
 #include <pthread.h>
 #include <errno.h>
 #include <limits.h>
+#include <unistd.h>
 #include <zlib.h>
 #include "BLibDefinitions.h"
 #include "BError.h"
@@ -16,6 +18,10 @@
 #include "RGMatches.h"
 #include "MatchesReadInputFiles.h"
 #include "aflib.h"
+#include "ThreadPool.h"
+#include "Numa.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include "RunMatch.h"
 
 /* TODO */
@@ -26,6 +32,10 @@ void RunMatch(
 		char *readFileName, 
 		char *offsetsInput,
 		int loadAllIndexes,
+		int packIndexes,
+		int prefetchMemory,
+		int cascadeCandidates,
+		int cascadeCoverage,
 		int compression,
 		int space,
 		int startReadNum,
@@ -55,6 +65,7 @@ void RunMatch(
 	int32_t numOffsets=0;
 
 	AFILE *seqFP=NULL;
+	ReadsStream readsInput;
 	gzFile tmpSeqFP=NULL; // for secondary index search
 	char *tmpSeqFileName=NULL; // for secondary index search
 	gzFile outputFP;
@@ -64,11 +75,13 @@ void RunMatch(
 	int numReads;
 
 	time_t startTime, endTime;
+	int64_t stageStart;
 	int seconds, minutes, hours;
 	int totalReadRGTime = 0;
 	int totalDataStructureTime = 0; /* This will only give the to load and deleted the indexes (excludes searching and other things) */
 	int totalSearchTime = 0; /* This will only give the time searching (excludes load times and other things) */
 	int totalOutputTime = 0; /* This wll only give the total time to merge and output */
+	ThreadPrefetchData prefetch;
 
 	RGMatches tempRGMatches;
 	RGBinary rg;
@@ -114,13 +127,22 @@ void RunMatch(
 
 	/* Read in the reference genome */
 	startTime = time(NULL);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("load reference");
+	NumaInterleaveStart();
 	RGBinaryReadBinary(&rg,
 			space,
 			fastaFileName);
+	NumaInterleaveEnd();
 	assert(rg.space == space);
+	NumaReplicateRGBinary(&rg);
+	TRACE_END();
+	MetricsStop(MetricsLoad, stageStart);
 	endTime = time(NULL);
 	totalReadRGTime = endTime - startTime;
 
+	PrefetchInitialize(&prefetch, prefetchMemory, packIndexes, space);
+
 	/* Read in the offsets */
 	numOffsets = (NULL == offsetsInput) ? 0 : ReadOffsets(offsetsInput, &offsets);
 
@@ -135,26 +157,26 @@ void RunMatch(
 			PrintError(FnName, readFileName, "Could not open readFileName for reading", Exit, OpenFileError);
 		}
 	}
-	/* Read the reads to the thread temp files */
-	if(VERBOSE >= 0) {
-		fprintf(stderr, "Reading %s into a temp file.\n",
+	/* The reads are parsed as the first index is searched.  They are only
+	 * copied to a temp file if the main indexes are searched in more than 
+	 * one pass. */
+	if(1 < numMainIndexes && IndexesMemoryAll != loadAllIndexes) {
+		if(VERBOSE >= 0) {
+			fprintf(stderr, "Reading %s, copying to a temp file.\n",
+					(readFileName == NULL) ? "stdin" : readFileName);
+		}
+		tmpSeqFP = OpenTmpGZFile(tmpDir, &tmpSeqFileName);
+	}
+	else if(VERBOSE >= 0) {
+		fprintf(stderr, "Reading %s.\n",
 				(readFileName == NULL) ? "stdin" : readFileName);
 	}
-	/* This will close the reads file */
-	WriteReadsToTempFile(seqFP,
-			&tmpSeqFP,
-			&tmpSeqFileName,
+	ReadsStreamInitialize(&readsInput,
+			seqFP,
 			startReadNum,
 			endReadNum,
-			tmpDir,
-			&numReads,
-			space);
-	/* Close the read file */
-	AFILE_afclose(seqFP);
-	if(VERBOSE >= 0) {
-		fprintf(stderr, "Will process %d reads.\n",
-				numReads);
-	}
+			space,
+			tmpSeqFP);
 
 	/* Open output file */
 	if(0 == (outputFP=gzdopen(fileno(fpOut), "wb"))) {
@@ -169,6 +191,10 @@ void RunMatch(
 			offsets,
 			numOffsets,
 			loadAllIndexes,
+			packIndexes,
+			&prefetch,
+			cascadeCandidates,
+			cascadeCoverage,
 			space,
 			keySize,
 			maxKeyMatches,
@@ -179,6 +205,7 @@ void RunMatch(
 			queueLength,
 			&tmpSeqFP,
 			&tmpSeqFileName,
+			&readsInput,
 			outputFP,
 			(0 < numSecondaryIndexes)?CopyForNextSearch:EndSearch,
 			MainIndexes,
@@ -189,6 +216,13 @@ void RunMatch(
 			&totalOutputTime
 				);
 
+	/* All reads have been read */
+	numReads = readsInput.numRead;
+	ReadsStreamFree(&readsInput);
+	/* Close the read file */
+	MetricsCountAFILE(MetricsBytesIn, seqFP);
+	AFILE_afclose(seqFP);
+
 	/* Do secondary index search */
 
 	if(0 < numSecondaryIndexes) { /* Only if there are secondary indexes */
@@ -205,6 +239,10 @@ void RunMatch(
 					offsets,
 					numOffsets,
 					loadAllIndexes,
+					packIndexes,
+					&prefetch,
+					cascadeCandidates,
+					cascadeCoverage,
 					space,
 					keySize,
 					maxKeyMatches,
@@ -215,6 +253,7 @@ void RunMatch(
 					queueLength,
 					&tmpSeqFP,
 					&tmpSeqFileName,
+					NULL,
 					outputFP,
 					EndSearch,
 					SecondaryIndexes,
@@ -235,6 +274,7 @@ void RunMatch(
 				RGMatchesFree(&tempRGMatches);
 			}
 			CloseTmpGZFile(&tmpSeqFP, &tmpSeqFileName, 1);
+			MetricsCountGZ(MetricsBytesOut, outputFP);
 			gzclose(outputFP);
 		}
 	}
@@ -265,11 +305,14 @@ void RunMatch(
 	free(secondaryIndexIDs);
 
 	/* Free reference genome */
+	NumaDeleteRGBinaryReplicas();
 	RGBinaryDelete(&rg);
 
 	/* Free offsets */
 	free(offsets);
 
+	PrefetchFree(&prefetch);
+
 	/* Print timing */
 	if(timing == 1) {
 		/* Read RG time */
@@ -293,6 +336,16 @@ void RunMatch(
 				hours,
 				minutes,
 				seconds);
+		/* Background data structure time, overlapped with searching */
+		seconds = prefetch.loadTime;
+		hours = seconds/3600;
+		seconds -= hours*3600;
+		minutes = seconds/60;
+		seconds -= minutes*60;
+		fprintf(stderr, "Total time loading indexes while searching: %d hour, %d minutes and %d seconds.\n",
+				hours,
+				minutes,
+				seconds);
 		/* Search time */
 		seconds = totalSearchTime;
 		hours = seconds/3600;
@@ -314,6 +367,8 @@ void RunMatch(
 				hours,
 				minutes,
 				seconds);
+		/* Search throughput per NUMA node */
+		NumaPrintThroughput(stderr);
 	}
 }
 
@@ -324,6 +379,10 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int packIndexes,
+		ThreadPrefetchData *prefetch,
+		int cascadeCandidates,
+		int cascadeCoverage,
 		int space,
 		int keySize,
 		int maxKeyMatches,
@@ -334,6 +393,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int queueLength,
 		gzFile *tmpSeqFP,
 		char **tmpSeqFileName,
+		ReadsStream *readsInput,
 		gzFile outputFP,
 		int copyForNextSearch,
 		int indexesType,
@@ -352,6 +412,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	int numWritten=0, numReads=0;
 	int numMatches = 0;
 	time_t startTime, endTime;
+	int64_t stageStart;
 	int seconds, minutes, hours;
 	AFILE tempRGMatchesAFP;
 	char *tempRGMatchesFileName=NULL;
@@ -360,6 +421,10 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	gzFile *tempOutputIndexBinFPs=NULL;
 	char **tempOutputIndexBinFileNames=NULL;
 	RGIndex tempIndex;
+	uint8_t *numPasses=NULL;
+	int64_t numCascadeReads=0, numResolved;
+	gzFile cascadeFP=NULL;
+	char *cascadeFileName=NULL;
 
 	/* IDEA: for each index, split search into threads generating one output file per thread.
 	 * After the threads have finished their searches, merge their output into one output file
@@ -418,6 +483,9 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				offsets,
 				numOffsets,
 				loadAllIndexes,
+				packIndexes,
+				NULL,
+				NULL,
 				space,
 				keySize,
 				maxKeyMatches,
@@ -428,6 +496,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				queueLength,
 				tmpSeqFP,
 				tmpSeqFileName,
+				readsInput,
 				tempOutputFP,
 				0,
 				tmpDir,
@@ -436,6 +505,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				totalSearchTime,
 				totalOutputTime
 					);
+		readsInput=NULL;
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "Searching index files 1-%d... complete\n", numIndexes);
 		}
@@ -464,6 +534,9 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						offsets,
 						numOffsets,
 						loadAllIndexes,
+						packIndexes,
+						prefetch,
+						(indexNum+1 < numIndexes) ? indexFileNames[indexNum+1] : NULL,
 						space,
 						keySize,
 						maxKeyMatches,
@@ -474,6 +547,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						queueLength,
 						tmpSeqFP,
 						tmpSeqFileName,
+						readsInput,
 						tempOutputIndexFPs[uniqueIndexCtr],
 						0,
 						tmpDir,
@@ -482,6 +556,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						totalSearchTime,
 						totalOutputTime
 							);
+				readsInput=NULL;
 				if(VERBOSE >= 0) {
 					fprintf(stderr, "Searching index file %d/%d (index #%d, bin #%d) complete...\n", 
 							indexNum+1, numIndexes,
@@ -519,6 +594,9 @@ int FindMatchesInIndexSet(char **indexFileNames,
 							offsets,
 							numOffsets,
 							loadAllIndexes,
+							packIndexes,
+							prefetch,
+							(indexNum+1 < numIndexes) ? indexFileNames[indexNum+1] : NULL,
 							space,
 							keySize,
 							maxKeyMatches,
@@ -529,6 +607,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 							queueLength,
 							tmpSeqFP,
 							tmpSeqFileName,
+							readsInput,
 							tempOutputIndexBinFPs[uniqueIndexBinCtr],
 							1,
 							tmpDir,
@@ -537,6 +616,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 							totalSearchTime,
 							totalOutputTime
 								);
+					readsInput=NULL;
 					if(VERBOSE >= 0) {
 						fprintf(stderr, "Searching index file %d/%d (index #%d, bin #%d) complete...\n", 
 								indexNum+1, numIndexes,
@@ -558,6 +638,8 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				RGIndexGetHeader(indexFileNames[indexNum-1], &tempIndex); // use previous
 
 				startTime=time(NULL);
+				stageStart = MetricsStart();
+				TRACE_BEGIN("merge bins");
 				numMatches = RGMatchesMergeIndexBins(tempOutputIndexBinFPs,
 						numBins,
 						tempOutputIndexFPs[uniqueIndexCtr],
@@ -565,6 +647,8 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						maxKeyMatches,
                                                 keyMissFraction,
 						maxNumMatches);
+				TRACE_END();
+				MetricsStop(MetricsMerge, stageStart);
 				endTime=time(NULL);
 				if(VERBOSE >= 0 && timing == 1) {
 					seconds = (int)(endTime - startTime);
@@ -594,6 +678,40 @@ int FindMatchesInIndexSet(char **indexFileNames,
 			if(VERBOSE >= 0) {
 				fprintf(stderr, "Found %d matches.\n", numMatches);
 			}
+
+			/* Do not search the resolved reads with the remaining indexes */
+			if(0 < cascadeCandidates && uniqueIndexCtr < numUniqueIndexes - 1) {
+				startTime=time(NULL);
+				stageStart = MetricsStart();
+				TRACE_BEGIN("cascade");
+				numResolved = CascadeFilterReads(&tempOutputIndexFPs[uniqueIndexCtr],
+						&tempOutputIndexFileNames[uniqueIndexCtr],
+						&cascadeFP,
+						&cascadeFileName,
+						tmpSeqFP,
+						tmpSeqFileName,
+						tmpDir,
+						uniqueIndexCtr,
+						&numPasses,
+						&numCascadeReads,
+						cascadeCandidates,
+						cascadeCoverage,
+						maxNumMatches);
+				TRACE_END();
+				MetricsStop(MetricsMerge, stageStart);
+				endTime=time(NULL);
+				(*totalOutputTime)+=endTime-startTime;
+				if(VERBOSE >= 0) {
+					fprintf(stderr, "Resolved %lld reads, which will not be searched with the remaining index%s.\n",
+							(long long int)numResolved,
+							(uniqueIndexCtr + 2 < numUniqueIndexes) ? "es" : "");
+				}
+			}
+		}
+
+		/* The matches of the reads searched with the last index */
+		if(NULL != cascadeFP) {
+			CloseTmpGZFile(&cascadeFP, &cascadeFileName, 1);
 		}
 
 		/* Merge temporary output from each index and output to the output file. */
@@ -608,12 +726,26 @@ int FindMatchesInIndexSet(char **indexFileNames,
 			}
 
 			startTime=time(NULL);
+			stageStart = MetricsStart();
+			TRACE_BEGIN("merge indexes");
 			/* Merge the temp index files into the all indexes file */
-			numWritten=RGMatchesMergeFilesAndOutput(tempOutputIndexFPs,
-					numUniqueIndexes,
-					tempOutputFP,
-					maxNumMatches,
-					queueLength);
+			if(NULL != numPasses) {
+				numWritten=RGMatchesMergeCascadeAndOutput(tempOutputIndexFPs,
+						numUniqueIndexes,
+						numPasses,
+						numCascadeReads,
+						tempOutputFP,
+						maxNumMatches);
+			}
+			else {
+				numWritten=RGMatchesMergeFilesAndOutput(tempOutputIndexFPs,
+						numUniqueIndexes,
+						tempOutputFP,
+						maxNumMatches,
+						queueLength);
+			}
+			TRACE_END();
+			MetricsStop(MetricsMerge, stageStart);
 			endTime=time(NULL);
 			if(VERBOSE >= 0 && timing == 1) {
 				seconds = (int)(endTime - startTime);
@@ -644,7 +776,9 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	}
 
 	/* Close the temporary read files */
-	CloseTmpGZFile(tmpSeqFP, tmpSeqFileName, 1);
+	if(NULL != (*tmpSeqFP)) {
+		CloseTmpGZFile(tmpSeqFP, tmpSeqFileName, 1);
+	}
 
 	if(CopyForNextSearch == copyForNextSearch) {
 		/* Go through the temporary output file and output those reads that have 
@@ -664,11 +798,15 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		tempRGMatchesAFP.gz = OpenTmpGZFile(tmpDir, &tempRGMatchesFileName);
 
 		startTime=time(NULL);
+		stageStart = MetricsStart();
 		assert(tempOutputFP != outputFP); // this is very important
-		numWritten=ReadTempReadsAndOutput(tempOutputFP,
+		TRACE_BEGIN("merge unmatched");
+		numWritten=ReadTempReadsAndOutput(&tempOutputFP,
 				tempOutputFileName,
 				outputFP,
 				&tempRGMatchesAFP);
+		TRACE_END();
+		MetricsStop(MetricsMerge, stageStart);
 		endTime=time(NULL);
 		(*totalOutputTime)+=endTime-startTime;
 
@@ -698,12 +836,14 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		CloseTmpGZFile(&tempOutputFP, &tempOutputFileName, 1);
 	}
 	else {
+		MetricsCountGZ(MetricsBytesOut, tempOutputFP);
 		gzclose(tempOutputFP);
 	}
 
 	/* Free memory for temporary file pointers */
 	free(tempOutputIndexFPs);
 	free(tempOutputIndexFileNames);
+	free(numPasses);
 
 	if(VERBOSE >= 0) {
 		if(MainIndexes == indexesType) {
@@ -725,6 +865,9 @@ int FindMatches(char **indexFileName,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int packIndexes,
+		ThreadPrefetchData *prefetch,
+		char *nextIndexFileName,
 		int space,
 		int keySize,
 		int maxKeyMatches,
@@ -735,6 +878,7 @@ int FindMatches(char **indexFileName,
 		int queueLength,
 		gzFile *tmpSeqFP,
 		char **tmpSeqFileName,
+		ReadsStream *readsInput,
 		gzFile outputFP,
 		int outputOffsets,
 		char *tmpDir,
@@ -745,27 +889,29 @@ int FindMatches(char **indexFileName,
 {
 	char *FnName = "FindMatches";
 	int i, j, k;
-	RGIndex *indexes=NULL;
+	RGIndex *indexes=NULL, *replicas=NULL;
 	int numMatches = 0;
 	time_t startTime, endTime;
 	int errCode;
 	ThreadIndexData *data=NULL;
-	pthread_t *threads=NULL;
 	void *status;
-	RGMatches *matchQueue=NULL;
+	int64_t stageStart;
+	RGMatches *matchQueue=NULL, *matchQueues[2]={NULL, NULL};
 	int32_t matchQueueLength=queueLength;
 	int32_t returnNumMatches=0, numReadsProcessed=0;
+	int32_t cur;
+	ReadsStream tmpReadsInput;
+	ThreadReadData readData;
+	pthread_t readThread;
 
-	/* Allocate memory for threads */
-	threads=malloc(sizeof(pthread_t)*numThreads);
-	if(NULL==threads) {
-		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-	}
 	/* Allocate memory to pass data to threads */
 	data=malloc(sizeof(ThreadIndexData)*numThreads);
 	if(NULL==data) {
 		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
 	}
+	for(i=0;i<numThreads;i++) {
+		RGIndexKeysInitialize(&data[i].keys);
+	}
 	/* Allocate memory for the indexes */
 	indexes=malloc(sizeof(RGIndex)*numIndexes);
 	if(NULL==indexes) {
@@ -778,8 +924,14 @@ int FindMatches(char **indexFileName,
 
 	/* Read in the RG Index */
 	startTime = time(NULL);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("load index");
+	NumaInterleaveStart();
 	for(i=0;i<numIndexes;i++) {
-		ReadRGIndex(indexFileName[i], &indexes[i], space);
+		/* Use the index if it was loaded while searching the previous one */
+		if(NULL == prefetch || 0 == PrefetchGet(prefetch, indexFileName[i], &indexes[i])) {
+			ReadRGIndex(indexFileName[i], &indexes[i], space, packIndexes);
+		}
 		if(IndexesMemoryAll == loadAllIndexes && 0 < indexes[i].depth) {
 			PrintError(FnName, "index[i].depth", "Cannot use binned indexes when loading all into memory", Exit, OutOfRange);
 		}
@@ -799,16 +951,33 @@ int FindMatches(char **indexFileName,
 			indexes[i].keysize = keySize;
 		}
 	}
+	NumaInterleaveEnd();
+	/* Copy the indexes to each NUMA node */
+	replicas = NumaReplicateRGIndexes(indexes, numIndexes);
+	TRACE_END();
+	MetricsStop(MetricsLoad, stageStart);
 	endTime = time(NULL);
 	(*totalDataStructureTime)+=endTime - startTime;	
 
-	/* Set position to read from the beginning of the file */
-	ReopenTmpGZFile(tmpSeqFP, tmpSeqFileName);
+	/* Load the next index while this one is searched */
+	if(NULL != prefetch && NULL != nextIndexFileName) {
+		PrefetchStart(prefetch, indexes, numIndexes, nextIndexFileName);
+	}
 
-	/* Allocate match queue */
-	matchQueue = malloc(sizeof(RGMatches)*matchQueueLength); 
-	if(NULL == matchQueue) {
-		PrintError(FnName, "matchQueue", "Could not allocate memory", Exit, MallocMemory);
+	/* Read from the temporary read file, unless reads are given */
+	if(NULL == readsInput) {
+		/* Set position to read from the beginning of the file */
+		ReopenTmpGZFile(tmpSeqFP, tmpSeqFileName);
+		ReadsStreamInitializeTmp(&tmpReadsInput, (*tmpSeqFP), space);
+		readsInput = &tmpReadsInput;
+	}
+
+	/* Allocate match queues, one being searched while the other is read */
+	for(i=0;i<2;i++) {
+		matchQueues[i] = malloc(sizeof(RGMatches)*matchQueueLength); 
+		if(NULL == matchQueues[i]) {
+			PrintError(FnName, "matchQueues[i]", "Could not allocate memory", Exit, MallocMemory);
+		}
 	}
 
 	/* For each read */
@@ -816,20 +985,40 @@ int FindMatches(char **indexFileName,
 		fprintf(stderr, "Reads processed: 0");
 	}
 
-	// Run
+	// Read in the first reads
 	startTime = time(NULL);
-	while(0!=(numMatches = GetReads((*tmpSeqFP), matchQueue, matchQueueLength, space))) { // Read in data
-		endTime = time(NULL);
-		(*totalOutputTime)+=endTime - startTime;
+	stageStart = MetricsStart();
+	cur = 0;
+	TRACE_BEGIN("read");
+	numMatches = ReadsStreamGetReads(readsInput, matchQueues[cur], matchQueueLength);
+	TRACE_END();
+	MetricsStop(MetricsRead, stageStart);
+	endTime = time(NULL);
+	(*totalOutputTime)+=endTime - startTime;
+
+	// Run
+	while(0 != numMatches) {
+		matchQueue = matchQueues[cur];
+
+		// Read in the next reads while searching 
+		readData.readsInput = readsInput;
+		readData.matchQueue = matchQueues[1-cur];
+		readData.matchQueueLength = matchQueueLength;
+		readData.numRead = 0;
+		errCode = pthread_create(&readThread, NULL, GetReadsThread, &readData);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
 	
 		// Initialize arguments to threads 
 		for(i=0;i<numThreads;i++) {
 			data[i].matchQueue = matchQueue;
 			data[i].matchQueueLength = numMatches;
 			data[i].numThreads = numThreads;
-			data[i].indexes = indexes;
+			/* Search the copies local to the node of the thread */
+			data[i].indexes = (NULL == replicas) ? indexes : replicas + NumaGetWorkerNode(i)*numIndexes;
 			data[i].numIndexes = numIndexes;
-			data[i].rg = rg;
+			data[i].rg = NumaGetRGBinary(NumaGetWorkerNode(i), rg);
 			data[i].offsets = offsets;
 			data[i].numOffsets = numOffsets;
 			data[i].space = space;
@@ -840,35 +1029,22 @@ int FindMatches(char **indexFileName,
 			data[i].outputOffsets = outputOffsets;
 			data[i].threadID = i;
 		}
-		// Spawn threads
+		// Run the threads
 		startTime = time(NULL);
-		/* Open threads */
+		TRACE_BEGIN("join search");
+		ThreadPoolRun(FindMatchesThread, data, sizeof(ThreadIndexData), numThreads);
+		TRACE_END();
 		for(i=0;i<numThreads;i++) {
-			/* Start thread */
-			errCode = pthread_create(&threads[i], /* thread struct */
-					NULL, /* default thread attributes */
-					FindMatchesThread, /* start routine */
-					&data[i]); /* data to routine */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-			}
-		}
-		/* Wait for threads to return */
-		for(i=0;i<numThreads;i++) {
-			/* Wait for the given thread to return */
-			errCode = pthread_join(threads[i],
-					&status);
-			/* Check the return code of the thread */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-			}
 			returnNumMatches += data[i].numMatches;
+			NumaAddThroughput(NumaGetWorkerNode(i), data[i].numReads, data[i].searchTime);
 		}
 		endTime = time(NULL);
 		(*totalSearchTime)+=endTime - startTime;
 
 		/* Output to file */
 		startTime = time(NULL);
+		stageStart = MetricsStart();
+		TRACE_BEGIN("output");
 		for(i=0;i<numMatches;i++) {
 			if(0 == outputOffsets) {
 				RGMatchesPrint(outputFP, 
@@ -879,8 +1055,6 @@ int FindMatches(char **indexFileName,
 						&matchQueue[i]);
 			}
 		}
-		endTime = time(NULL);
-		(*totalOutputTime)+=endTime - startTime;
 
 		numReadsProcessed += numMatches;
 		if(VERBOSE >= 0) {
@@ -891,12 +1065,21 @@ int FindMatches(char **indexFileName,
 		for(i=0;i<numMatches;i++) {
 			RGMatchesFree(&matchQueue[i]);
 		}
-
-		// For reading
-		startTime = time(NULL);
+		TRACE_END();
+		MetricsStop(MetricsWrite, stageStart);
+
+		// Wait for the next reads
+		TRACE_BEGIN("join read");
+		errCode = pthread_join(readThread, &status);
+		TRACE_END();
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		numMatches = readData.numRead;
+		cur = 1-cur;
+		endTime = time(NULL);
+		(*totalOutputTime)+=endTime - startTime;
 	}
-	endTime = time(NULL);
-	(*totalOutputTime)+=endTime - startTime;
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "\rReads processed: %d\n", numReadsProcessed);
@@ -908,23 +1091,44 @@ int FindMatches(char **indexFileName,
 				(1 == numIndexes) ? "" : "es");
 	}
 	startTime = time(NULL);
+	stageStart = MetricsStart();
+	NumaDeleteRGIndexReplicas(replicas, numIndexes);
 	for(i=0;i<numIndexes;i++) {
 		RGIndexDelete(&indexes[i]);
 	}
 	free(indexes);
+	MetricsStop(MetricsLoad, stageStart);
 	endTime = time(NULL);
 	(*totalDataStructureTime)+=endTime - startTime;	
 
-	// Free match queue
-	free(matchQueue);
+	// Free match queues
+	free(matchQueues[0]);
+	free(matchQueues[1]);
+	if(readsInput == &tmpReadsInput) {
+		ReadsStreamFree(&tmpReadsInput);
+	}
 
 	/* Free thread data */
-	free(threads);
+	for(i=0;i<numThreads;i++) {
+		RGIndexKeysFree(&data[i].keys);
+	}
 	free(data);
 
 	return returnNumMatches;
 }
 
+/* TODO */
+void *GetReadsThread(void *arg)
+{
+	ThreadReadData *data=(ThreadReadData*)arg;
+	int64_t stageStart = MetricsStart();
+	TRACE_BEGIN("read");
+	data->numRead = ReadsStreamGetReads(data->readsInput, data->matchQueue, data->matchQueueLength);
+	TRACE_END();
+	MetricsStop(MetricsRead, stageStart);
+	return arg;
+}
+
 /* TODO */
 void *FindMatchesThread(void *arg)
 {
@@ -948,7 +1152,14 @@ void *FindMatchesThread(void *arg)
 	int whichStrand = data->whichStrand;
 	int outputOffsets = data->outputOffsets;
 	int threadID = data->threadID;
+	struct timeval startTime, endTime;
+	int64_t stageStart;
 	data->numMatches = 0;
+	data->numReads = 0;
+
+	gettimeofday(&startTime, NULL);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("search");
 
         for(i=threadID;i<matchQueueLength;i+=numThreads) {
                 /* Read */
@@ -970,7 +1181,8 @@ void *FindMatchesThread(void *arg)
                                                 maxKeyMatches,
                                                 keyMissFraction,
                                                 maxNumMatches,
-                                                whichStrand);
+                                                whichStrand,
+                                                &data->keys);
                         }
                         else {
                                 for(k=0;k<numIndexes && 0 <= matchQueue[i].ends[j].maxReached;k++) {
@@ -989,9 +1201,11 @@ void *FindMatchesThread(void *arg)
                                                         maxKeyMatches,
                                                         keyMissFraction,
                                                         maxNumMatches,
-                                                        whichStrand);
+                                                        whichStrand,
+                                                        &data->keys);
                                 }
                         }
+                        MetricsCount(MetricsCALs, matchQueue[i].ends[j].numEntries);
                         if(0 < matchQueue[i].ends[j].numEntries && 0 <= matchQueue[i].ends[j].maxReached) {
                                 foundMatch = 1;
                         }
@@ -1001,7 +1215,250 @@ void *FindMatchesThread(void *arg)
                         //DEBUGGING
                         //RGMatchesCheck(&matchQueue[i], rg);
                 }
+                data->numReads++;
 	}
+	TRACE_END();
+	MetricsStop(MetricsSearch, stageStart);
+	gettimeofday(&endTime, NULL);
+	data->searchTime = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_usec - startTime.tv_usec)/1000000.0;
+
+	return arg;
+}
+
+/* Reads the matches found with one index, which are in the order of the
+ * reads searched with it, and replaces the temporary read file with the
+ * reads that are not yet resolved.  A read is resolved by the matches
+ * found with all the indexes it was searched with, so the matches of the
+ * reads not yet resolved are kept in cascadeFP.  numPasses holds the
+ * number of indexes each read of the index set is searched with.  Returns
+ * the number of reads resolved. */
+int64_t CascadeFilterReads(gzFile *indexFP,
+		char **indexFileName,
+		gzFile *cascadeFP,
+		char **cascadeFileName,
+		gzFile *tmpSeqFP,
+		char **tmpSeqFileName,
+		char *tmpDir,
+		int32_t pass,
+		uint8_t **numPasses,
+		int64_t *numReads,
+		int32_t maxCandidates,
+		int32_t minCoverage,
+		int32_t maxNumMatches)
+{
+	char *FnName="CascadeFilterReads";
+	gzFile nextSeqFP=NULL, nextCascadeFP=NULL;
+	char *nextSeqFileName=NULL, *nextCascadeFileName=NULL;
+	RGMatches m, prev;
+	int64_t i, numResolved=0;
+	int32_t j;
+
+	assert(pass < UCHAR_MAX);
+	assert(0 == pass || NULL != (*cascadeFP));
+
+	ReopenTmpGZFile(indexFP, indexFileName);
+	if(0 < pass) {
+		ReopenTmpGZFile(cascadeFP, cascadeFileName);
+	}
+	nextSeqFP = OpenTmpGZFile(tmpDir, &nextSeqFileName);
+	nextCascadeFP = OpenTmpGZFile(tmpDir, &nextCascadeFileName);
+
+	RGMatchesInitialize(&m);
+	RGMatchesInitialize(&prev);
+	i = 0;
+	while(EOF != RGMatchesRead((*indexFP), &m)) {
+		if(0 == pass) {
+			/* Grow by doubling */
+			if(0 == (*numReads) || 0 == ((*numReads) & ((*numReads) - 1))) {
+				(*numPasses) = realloc((*numPasses), sizeof(uint8_t)*2*((*numReads) + 1));
+				if(NULL == (*numPasses)) {
+					PrintError(FnName, "numPasses", "Could not reallocate memory", Exit, ReallocMemory);
+				}
+			}
+			(*numPasses)[(*numReads)++] = 1;
+		}
+		else {
+			/* Add the matches found with the previous indexes */
+			if(EOF == RGMatchesRead((*cascadeFP), &prev)) {
+				PrintError(FnName, NULL, "Did not read in the correct # of entries", Exit, OutOfRange);
+			}
+			if(0 != strcmp(m.readName, prev.readName)) {
+				PrintError(FnName, NULL, "Read names do not match", Exit, OutOfRange);
+			}
+			RGMatchesAppend(&m, &prev);
+			RGMatchesFree(&prev);
+			RGMatchesRemoveDuplicates(&m, maxNumMatches);
+		}
+		/* Skip the reads resolved with the previous indexes */
+		while(i < (*numReads) && (*numPasses)[i] != pass + 1) {
+			i++;
+		}
+		assert(i < (*numReads));
+
+		if(1 == RGMatchesIsResolved(&m, maxCandidates, minCoverage)) {
+			numResolved++;
+		}
+		else {
+			/* Search it with the next index */
+			(*numPasses)[i]++;
+			RGMatchesPrint(nextCascadeFP, &m);
+			for(j=0;j<m.numEnds;j++) {
+				RGMatchClearMatches(&m.ends[j]);
+				m.ends[j].maxReached = 0;
+			}
+			RGMatchesPrint(nextSeqFP, &m);
+		}
+		RGMatchesFree(&m);
+		i++;
+	}
+	if(0 < pass && EOF != RGMatchesRead((*cascadeFP), &prev)) {
+		PrintError(FnName, NULL, "Did not read in the correct # of entries", Exit, OutOfRange);
+	}
+
+	/* Replace the temporary files */
+	CloseTmpGZFile(tmpSeqFP, tmpSeqFileName, 1);
+	(*tmpSeqFP) = nextSeqFP;
+	(*tmpSeqFileName) = nextSeqFileName;
+	if(0 < pass) {
+		CloseTmpGZFile(cascadeFP, cascadeFileName, 1);
+	}
+	(*cascadeFP) = nextCascadeFP;
+	(*cascadeFileName) = nextCascadeFileName;
+
+	return numResolved;
+}
+
+/* TODO */
+void PrefetchInitialize(ThreadPrefetchData *data, int prefetchMemory, int packIndexes, int space)
+{
+	data->prefetchMemory = prefetchMemory;
+	data->packIndexes = packIndexes;
+	data->space = space;
+	data->started = 0;
+	data->indexFileName = NULL;
+	RGIndexInitialize(&data->index);
+	data->loadTime = 0;
+}
+
+/* Starts loading the next index in the background, but only if it fits in
+ * the memory budget together with the indexes being searched */
+void PrefetchStart(ThreadPrefetchData *data, RGIndex *indexes, int32_t numIndexes, char *indexFileName)
+{
+	char *FnName="PrefetchStart";
+	RGIndex header;
+	double currentSize=0.0, nextSize=0.0, budget=0.0;
+	long numPages, pageSize;
+	int32_t i;
+	int errCode;
+
+	assert(0 == data->started);
+
+	if(0 == data->prefetchMemory) {
+		return;
+	}
+
+	/* The header gives the size of the next index */
+	RGIndexInitialize(&header);
+	RGIndexGetHeader(indexFileName, &header);
+	nextSize = RGIndexGetSize(&header, MEGABYTES);
+	RGIndexDelete(&header);
+
+	for(i=0;i<numIndexes;i++) {
+		currentSize += RGIndexGetSize(&indexes[i], MEGABYTES);
+	}
+	if(NumaReplicate == NumaGetMode()) {
+		currentSize *= NumaGetNumNodes();
+	}
+
+	if(PREFETCH_MEMORY_AVAILABLE == data->prefetchMemory) {
+		/* The current indexes are already resident */
+		numPages = sysconf(_SC_AVPHYS_PAGES);
+		pageSize = sysconf(_SC_PAGESIZE);
+		if(0 < numPages && 0 < pageSize) {
+			budget = currentSize + (((double)numPages)*pageSize)/(1024.0*1024.0);
+		}
+	}
+	else {
+		budget = data->prefetchMemory;
+	}
+
+	if(budget < currentSize + nextSize) {
+		if(VERBOSE >= 0) {
+			fprintf(stderr, "Not loading the next index while searching (%.1lfMB needed, %.1lfMB allowed).\n",
+					currentSize + nextSize,
+					budget);
+		}
+		return;
+	}
+
+	data->indexFileName = indexFileName;
+	RGIndexInitialize(&data->index);
+	errCode = pthread_create(&data->thread, NULL, PrefetchThread, data);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+	}
+	data->started = 1;
+}
+
+/* Waits for the index being loaded in the background.  Returns 1 and moves
+ * it to index if it is the given index file, otherwise returns 0. */
+int PrefetchGet(ThreadPrefetchData *data, char *indexFileName, RGIndex *index)
+{
+	char *FnName="PrefetchGet";
+	int errCode;
+	void *status;
+
+	if(0 == data->started) {
+		return 0;
+	}
+
+	errCode = pthread_join(data->thread, &status);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+	}
+	data->started = 0;
+
+	if(0 != strcmp(data->indexFileName, indexFileName)) {
+		RGIndexDelete(&data->index);
+		return 0;
+	}
+	(*index) = data->index;
+	return 1;
+}
+
+/* TODO */
+void PrefetchFree(ThreadPrefetchData *data)
+{
+	char *FnName="PrefetchFree";
+	int errCode;
+	void *status;
+
+	if(1 == data->started) {
+		errCode = pthread_join(data->thread, &status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		/* The index was never searched */
+		RGIndexDelete(&data->index);
+		data->started = 0;
+	}
+}
+
+/* TODO */
+void *PrefetchThread(void *arg)
+{
+	ThreadPrefetchData *data=(ThreadPrefetchData*)arg;
+	time_t startTime, endTime;
+	int64_t stageStart;
+
+	startTime = time(NULL);
+	stageStart = MetricsStart();
+	NumaInterleaveStart();
+	ReadRGIndex(data->indexFileName, &data->index, data->space, data->packIndexes);
+	NumaInterleaveEnd();
+	MetricsStop(MetricsLoad, stageStart);
+	endTime = time(NULL);
+	data->loadTime += endTime - startTime;
 
 	return arg;
 }
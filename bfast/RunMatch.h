@@ -13,7 +13,9 @@
 #endif
 
 #include <stdio.h>
+#include <pthread.h>
 #include "BLibDefinitions.h"
+#include "MatchesReadInputFiles.h"
 
 typedef struct {
 	RGMatches *matchQueue;
@@ -32,8 +34,32 @@ typedef struct {
 	int numMatches;
 	int outputOffsets;
 	int threadID;
+	/* For the throughput per NUMA node */
+	int64_t numReads;
+	double searchTime;
+	/* The keys of the current read, reused across reads and batches */
+	RGIndexKeys keys;
 } ThreadIndexData;
 
+typedef struct {
+	ReadsStream *readsInput;
+	RGMatches *matchQueue;
+	int32_t matchQueueLength;
+	int32_t numRead;
+} ThreadReadData;
+
+/* The next index, loaded while the current one is searched */
+typedef struct {
+	int prefetchMemory;
+	int packIndexes;
+	int space;
+	int started;
+	char *indexFileName;
+	RGIndex index;
+	pthread_t thread;
+	int loadTime;
+} ThreadPrefetchData;
+
 void RunMatch(
 		char *fastaFileName,
 		char *mainIndexes,
@@ -41,6 +67,10 @@ void RunMatch(
 		char *readFileName,
 		char *offsets,
 		int loadAllIndexes,
+		int packIndexes,
+		int prefetchMemory,
+		int cascadeCandidates,
+		int cascadeCoverage,
 		int compression,
 		int space,
 		int startReadNum,
@@ -63,6 +93,10 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int packIndexes,
+		ThreadPrefetchData *prefetch,
+		int cascadeCandidates,
+		int cascadeCoverage,
 		int colorSpace,
 		int keySize,
 		int maxKeyMatches,
@@ -73,6 +107,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int queueLength,
 		gzFile *tmpSeqFP,
 		char **tmpSeqFileName,
+		ReadsStream *readsInput,
 		gzFile outputFP,
 		int copyForNextSearch,
 		int indexesType,
@@ -87,6 +122,9 @@ int FindMatches(char **indexFileName,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int packIndexes,
+		ThreadPrefetchData *prefetch,
+		char *nextIndexFileName,
 		int colorSpace,
 		int keySize,
 		int maxKeyMatches,
@@ -97,6 +135,7 @@ int FindMatches(char **indexFileName,
 		int queueLength,
 		gzFile *tmpSeqFP,
 		char **tmpSeqFileName,
+		ReadsStream *readsInput,
 		gzFile outputFP,
 		int outputOffsets,
 		char *tmpDir,
@@ -104,6 +143,13 @@ int FindMatches(char **indexFileName,
 		int *totalDataStructureTime,
 		int *totalSearchTime,
 		int *totalOutputTime);
+void *GetReadsThread(void *arg);
 void *FindMatchesThread(void *arg);
+int64_t CascadeFilterReads(gzFile*, char**, gzFile*, char**, gzFile*, char**, char*, int32_t, uint8_t**, int64_t*, int32_t, int32_t, int32_t);
+void PrefetchInitialize(ThreadPrefetchData*, int, int, int);
+void PrefetchStart(ThreadPrefetchData*, RGIndex*, int32_t, char*);
+int PrefetchGet(ThreadPrefetchData*, char*, RGIndex*);
+void PrefetchFree(ThreadPrefetchData*);
+void *PrefetchThread(void*);
 
 #endif
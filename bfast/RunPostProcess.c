@@ -5,7 +5,6 @@
 #include <zlib.h>
 #include <limits.h>
 #include <math.h>
-#include <pthread.h>
 #include "BLibDefinitions.h"
 #include "BLib.h"
 #include "BError.h"
@@ -15,9 +14,14 @@
 #include "ScoringMatrix.h"
 #include "AlignMatrix.h"
 #include "Align.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include "RunPostProcess.h"
 
 #define MAXIMUM_RESCUE_MAPQ 30
+#define PAIRING_SWEEP_MIN_PAIRS 64
+#define PAIRING_MAX_WINDOW_SUMS 16
 	
 static inline int getStrandDiff(char strandA, char strandB, int strandedness)
 {
@@ -126,13 +130,11 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 	int32_t mappedEndCountsNumEnds=-1;
 	int8_t *foundTypes=NULL;
 	char *readGroupString=NULL;
-	pthread_t *threads=NULL;
-	int errCode;
-	void *status=NULL;
 	PostProcessThreadData *data=NULL;
 	ScoringMatrix sm;
 	int32_t matchScore ,mismatchScore, numRead, queueIndex;
 	int32_t numReadsProcessed = 0;
+	int64_t stageStart;
 	AlignedRead *alignQueue=NULL;
 	int32_t alignQueueLength = 0;
 	int32_t **numEntries=NULL;
@@ -191,11 +193,6 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 
 	AlignedReadConvertPrintHeader(fpReported, rg, outputFormat, readGroup);
 
-	/* Allocate memory for threads */
-	threads=malloc(sizeof(pthread_t)*numThreads);
-	if(NULL==threads) {
-		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-	}
 	/* Allocate memory to pass data to threads */
 	data=malloc(sizeof(PostProcessThreadData)*numThreads);
 	if(NULL==data) {
@@ -232,7 +229,11 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 	}
 	numRead = 0;
         PEDBinsInitialize(&bins, insertSizeSpecified, insertSizeAvg, insertSizeStdDev);
+	stageStart = MetricsStart();
+	TRACE_BEGIN("read");
 	while(0 != (numRead = GetAlignedReads(fp, alignQueue, alignQueueLength))) {
+		TRACE_END();
+		MetricsStop(MetricsRead, stageStart);
 
 		/* Get the PEDBins if necessary */
                 if(0 == unpaired) {
@@ -269,29 +270,14 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 			data[i].numThreads = numThreads;
 		}
 
-		/* Open threads */
-		for(i=0;i<numThreads;i++) {
-			/* Start thread */
-			errCode = pthread_create(&threads[i], /* thread struct */
-					NULL, /* default thread attributes */
-					ReadInputFilterAndOutputThread, /* start routine */
-					&data[i]); /* data to routine */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-			}
-		}
-		/* Wait for threads to return */
-		for(i=0;i<numThreads;i++) {
-			/* Wait for the given thread to return */
-			errCode = pthread_join(threads[i],
-					&status);
-			/* Check the return code of the thread */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-			}
-		}
+		/* Run the threads */
+		TRACE_BEGIN("join filter");
+		ThreadPoolRun(ReadInputFilterAndOutputThread, data, sizeof(PostProcessThreadData), numThreads);
+		TRACE_END();
 
 		/* Print to Output file */
+		stageStart = MetricsStart();
+		TRACE_BEGIN("output");
 		for(queueIndex=0;queueIndex<numRead;queueIndex++) {
 			int32_t numEnds=0;
 			if(NoneFound == foundTypes[queueIndex]) {
@@ -348,6 +334,8 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 			/* Free memory */
 			AlignedReadFree(&alignQueue[queueIndex]);
 		}
+		TRACE_END();
+		MetricsStop(MetricsFormat, stageStart);
 
 		// Free
 		for(i=0;i<numRead;i++) {
@@ -360,7 +348,11 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "Reads processed: %d\n%s", numReadsProcessed, BREAK_LINE);
 		}
+		stageStart = MetricsStart();
+		TRACE_BEGIN("read");
 	}
+	TRACE_END();
+	MetricsStop(MetricsRead, stageStart);
         /* Free */
         PEDBinsFree(&bins);
 	if(0 <= VERBOSE) {
@@ -369,13 +361,18 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 
 
 	/* Close output files, if necessary */
+	stageStart = MetricsStart();
 	if(BAF == outputFormat) {
+		MetricsCountGZ(MetricsBytesOut, fpReportedGZ);
 		gzclose(fpReportedGZ);
 	}
 	else {
+		MetricsCountFile(MetricsBytesOut, fpReported);
 		fclose(fpReported);
 	}
+	MetricsStop(MetricsWrite, stageStart);
 	/* Close the input file */
+	MetricsCountGZ(MetricsBytesIn, fp);
 	gzclose(fp);
 
 	if(VERBOSE>=0) {
@@ -399,7 +396,6 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 	}
 	free(mappedEndCounts);
 	free(readGroupString);
-	free(threads);
 	free(data);
 	free(alignQueue);
 	free(foundTypes);
@@ -432,8 +428,10 @@ void *ReadInputFilterAndOutputThread(void *arg)
 	int32_t *numEntriesN = data->numEntriesN;
 	int32_t j;
 	int32_t queueIndex=0;
-	AlignMatrix matrix;
-	AlignMatrixInitialize(&matrix); 
+	/* The matrix is kept by the worker across batches */
+	AlignMatrix *matrix = &ThreadPoolGetWorker(threadID)->matrix;
+	int64_t stageStart = MetricsStart();
+	TRACE_BEGIN("filter");
 
 	for(queueIndex=threadID;queueIndex<queueLength;queueIndex+=numThreads) {
 
@@ -451,7 +449,7 @@ void *ReadInputFilterAndOutputThread(void *arg)
                 /* Filter */
                 foundTypes[queueIndex] = FilterAlignedRead(&alignQueue[queueIndex],
                                 rg,
-                                &matrix,
+                                matrix,
                                 sm,
                                 algorithm,
                                 strandedness,
@@ -464,9 +462,8 @@ void *ReadInputFilterAndOutputThread(void *arg)
                                 minimumNormalizedScore,
                                 bins);
 	}
-
-	// Free
-	AlignMatrixFree(&matrix);
+	TRACE_END();
+	MetricsStop(MetricsFilter, stageStart);
 
 	return arg;
 }
@@ -484,6 +481,12 @@ int32_t GetAlignedReads(gzFile fp, AlignedRead *alignQueue, int32_t maxToRead)
 	return numRead;
 }
 
+static inline int32_t getPairedPenalty(double numStd,
+                                       int mismatchScore)
+{
+  return (int)(mismatchScore * -1.0 * log10( erfc(M_SQRT1_2 * numStd)) + 0.499);
+}
+
 static int32_t getPairedScore(AlignedEntry *aOne,
                               AlignedEntry *aTwo,
                               int strandedness,
@@ -514,11 +517,445 @@ static int32_t getPairedScore(AlignedEntry *aOne,
           }
       }
   }
-  s -= (int)(mismatchScore * -1.0 * log10( erfc(M_SQRT1_2 * numStd)) + 0.499);
+  s -= getPairedPenalty(numStd, mismatchScore);
 
   return s;
 }
 
+/* Pairing engine.  Every pairing outside of the insert window (wrong
+ * strands, different contigs, or more than INSERT_MAX_STD standard
+ * deviations from the mean insert) receives the same maximum penalty,
+ * so its paired score is just the sum of the two end scores less that
+ * penalty.  Only pairings inside the window need to be scored
+ * individually, and these are found by sweeping over both ends sorted
+ * by contig, strand and position.  The remaining (discordant) pairings
+ * are accounted for in bulk from the distinct scores of each end. */
+typedef struct {
+	uint32_t contig;
+	char strand;
+	int32_t position;
+	int32_t index;
+} PairingKey;
+
+typedef struct {
+	int32_t bestScore;
+	int32_t bestNum;
+	int32_t penultimateScore;
+	int32_t penultimateNum;
+	/* Paired score of any pairing outside the insert window, less the sum of the end scores */
+	int32_t maxPenalty;
+	/* Pairings inside the insert window, sorted by end one then end two index */
+	int32_t numInWindow;
+	int32_t *inWindowI;
+	int32_t *inWindowJ;
+	int32_t *inWindowScore;
+	/* Distinct scores of end two (descending) and their counts */
+	int32_t numScoresTwo;
+	int32_t *scoresTwo;
+	int32_t *scoresTwoCounts;
+} PairingEngine;
+
+static int PairingKeyCompare(const void *a, const void *b)
+{
+	const PairingKey *x = (const PairingKey*)a;
+	const PairingKey *y = (const PairingKey*)b;
+	if(x->contig != y->contig) return (x->contig < y->contig) ? -1 : 1;
+	if(x->strand != y->strand) return (x->strand < y->strand) ? -1 : 1;
+	if(x->position != y->position) return (x->position < y->position) ? -1 : 1;
+	return COMPAREINTS(x->index, y->index);
+}
+
+/* Returns the index of the first key on the given contig and strand (or after) */
+static int32_t PairingKeyLowerBound(PairingKey *keys,
+		int32_t n,
+		uint32_t contig,
+		char strand)
+{
+	int32_t low = 0, high = n, mid;
+	while(low < high) {
+		mid = (low + high)/2;
+		if(keys[mid].contig < contig || (keys[mid].contig == contig && keys[mid].strand < strand)) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+static int PairingScoreCompareDescending(const void *a, const void *b)
+{
+	return COMPAREINTS(*(const int32_t*)b, *(const int32_t*)a);
+}
+
+static int PairingInWindowCompare(const void *a, const void *b)
+{
+	const int32_t *x = (const int32_t*)a;
+	const int32_t *y = (const int32_t*)b;
+	if(x[0] != y[0]) return COMPAREINTS(x[0], y[0]);
+	return COMPAREINTS(x[1], y[1]);
+}
+
+static inline void PairingEngineAddScore(PairingEngine *p,
+		int32_t score,
+		int32_t num)
+{
+	if(p->bestScore < score) {
+		p->penultimateScore = p->bestScore;
+		p->penultimateNum = p->bestNum;
+		p->bestScore = score;
+		p->bestNum = num;
+	}
+	else if(p->bestScore == score) {
+		p->bestNum += num;
+	}
+	else if(p->penultimateScore < score) {
+		p->penultimateScore = score;
+		p->penultimateNum = num;
+	}
+	else if(p->penultimateScore == score) {
+		p->penultimateNum += num;
+	}
+}
+
+static void PairingEngineInitialize(PairingEngine *p)
+{
+	p->bestScore = INT_MIN;
+	p->bestNum = 0;
+	p->penultimateScore = INT_MIN;
+	p->penultimateNum = 0;
+	p->maxPenalty = 0;
+	p->numInWindow = 0;
+	p->inWindowI = p->inWindowJ = p->inWindowScore = NULL;
+	p->numScoresTwo = 0;
+	p->scoresTwo = p->scoresTwoCounts = NULL;
+}
+
+static void PairingEngineFree(PairingEngine *p)
+{
+	free(p->inWindowI);
+	free(p->inWindowJ);
+	free(p->inWindowScore);
+	free(p->scoresTwo);
+	free(p->scoresTwoCounts);
+	PairingEngineInitialize(p);
+}
+
+/* Returns the distinct scores of the end in descending order, and stores their counts */
+static int32_t PairingEngineGetDistinctScores(AlignedEnd *end,
+		int32_t **scores,
+		int32_t **counts)
+{
+	char *FnName="PairingEngineGetDistinctScores";
+	int32_t i, n;
+
+	(*scores) = malloc(sizeof(int32_t)*end->numEntries);
+	if(NULL == (*scores)) {
+		PrintError(FnName, "scores", "Could not allocate memory", Exit, MallocMemory);
+	}
+	(*counts) = malloc(sizeof(int32_t)*end->numEntries);
+	if(NULL == (*counts)) {
+		PrintError(FnName, "counts", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<end->numEntries;i++) {
+		(*scores)[i] = end->entries[i].score;
+	}
+	qsort((*scores), end->numEntries, sizeof(int32_t), PairingScoreCompareDescending);
+	for(i=n=0;i<end->numEntries;i++) {
+		if(0 < n && (*scores)[n-1] == (*scores)[i]) {
+			(*counts)[n-1]++;
+		}
+		else {
+			(*scores)[n] = (*scores)[i];
+			(*counts)[n] = 1;
+			n++;
+		}
+	}
+	return n;
+}
+
+/* Returns the number of entries with the given score, zero if none */
+static int32_t PairingEngineGetScoreCount(int32_t *scores,
+		int32_t *counts,
+		int32_t n,
+		int64_t score)
+{
+	int32_t low = 0, high = n-1, mid;
+	while(low <= high) {
+		mid = (low + high)/2;
+		if(scores[mid] == score) {
+			return counts[mid];
+		}
+		else if(score < scores[mid]) { // descending
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return 0;
+}
+
+/* Returns the largest sum of two end scores strictly less than bound, or INT64_MIN if none */
+static int64_t PairingEngineGetNextSum(int32_t *scoresOne,
+		int32_t numScoresOne,
+		int32_t *scoresTwo,
+		int32_t numScoresTwo,
+		int64_t bound)
+{
+	int32_t i, low, high, mid;
+	int64_t next = INT64_MIN;
+
+	for(i=0;i<numScoresOne;i++) {
+		// first (largest) score of end two such that the sum is less than the bound
+		low = 0; high = numScoresTwo;
+		while(low < high) {
+			mid = (low + high)/2;
+			if((int64_t)scoresOne[i] + scoresTwo[mid] < bound) {
+				high = mid;
+			}
+			else {
+				low = mid + 1;
+			}
+		}
+		if(low < numScoresTwo && next < (int64_t)scoresOne[i] + scoresTwo[low]) {
+			next = (int64_t)scoresOne[i] + scoresTwo[low];
+		}
+	}
+	return next;
+}
+
+/* Scores all pairings, returns 1 if successful, 0 if the caller should 
+ * fall back to scoring all pairings */
+static int PairingEngineSweep(PairingEngine *p,
+		AlignedRead *tmpA,
+		int positioning,
+		int strandedness,
+		int avgMismatchQuality,
+		int matchScore,
+		int mismatchScore,
+		PEDBins *b)
+{
+	char *FnName="PairingEngineSweep";
+	AlignedEnd *one = &tmpA->ends[0];
+	AlignedEnd *two = &tmpA->ends[1];
+	PairingKey *keysOne=NULL, *keysTwo=NULL;
+	int32_t *scoresOne=NULL, *scoresOneCounts=NULL, numScoresOne;
+	int32_t *inWindow=NULL, inWindowMem;
+	int32_t i, j, k, start=0, groupStart=0, groupEnd=0, numFound;
+	int64_t windowLow, windowHigh, sum, bound, numSum;
+	char strandTwo=FORWARD;
+	int sign=1;
+
+	// Insert window, with some slack so that anything outside surely receives the maximum penalty
+	if(!(0 < b->std) || !(fabs(b->avg) + INSERT_MAX_STD * b->std < INT_MAX)) {
+		return 0;
+	}
+	windowLow = (int64_t)floor(b->avg - INSERT_MAX_STD * b->std) - 1;
+	windowHigh = (int64_t)ceil(b->avg + INSERT_MAX_STD * b->std) + 1;
+	p->maxPenalty = getPairedPenalty(INSERT_MAX_STD, mismatchScore);
+
+	// Sort both ends by contig, strand, and position
+	keysOne = malloc(sizeof(PairingKey)*one->numEntries);
+	if(NULL == keysOne) {
+		PrintError(FnName, "keysOne", "Could not allocate memory", Exit, MallocMemory);
+	}
+	keysTwo = malloc(sizeof(PairingKey)*two->numEntries);
+	if(NULL == keysTwo) {
+		PrintError(FnName, "keysTwo", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<one->numEntries;i++) {
+		keysOne[i].contig = one->entries[i].contig;
+		keysOne[i].strand = one->entries[i].strand;
+		keysOne[i].position = one->entries[i].position;
+		keysOne[i].index = i;
+	}
+	for(j=0;j<two->numEntries;j++) {
+		keysTwo[j].contig = two->entries[j].contig;
+		keysTwo[j].strand = two->entries[j].strand;
+		keysTwo[j].position = two->entries[j].position;
+		keysTwo[j].index = j;
+	}
+	qsort(keysOne, one->numEntries, sizeof(PairingKey), PairingKeyCompare);
+	qsort(keysTwo, two->numEntries, sizeof(PairingKey), PairingKeyCompare);
+
+	// Sweep the mates within the insert window 
+	inWindowMem = one->numEntries + two->numEntries;
+	inWindow = malloc(sizeof(int32_t)*3*inWindowMem);
+	if(NULL == inWindow) {
+		PrintError(FnName, "inWindow", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<one->numEntries;i++) {
+		PairingKey *key = &keysOne[i];
+		if(0 == i || key->contig != keysOne[i-1].contig || key->strand != keysOne[i-1].strand) {
+			// New group: find the mates on the same contig and the compatible strand
+			strandTwo = (0 == getStrandDiff(key->strand, key->strand, positioning)) ? key->strand : ((FORWARD == key->strand) ? REVERSE : FORWARD);
+			sign = getPositionDiff(0, 1, key->strand, strandTwo, strandedness, positioning);
+			groupStart = PairingKeyLowerBound(keysTwo, two->numEntries, key->contig, strandTwo);
+			for(groupEnd=groupStart;groupEnd<two->numEntries;groupEnd++) {
+				if(keysTwo[groupEnd].contig != key->contig || keysTwo[groupEnd].strand != strandTwo) break;
+			}
+			start = groupStart;
+		}
+		if(0 != getStrandDiff(key->strand, strandTwo, positioning)) {
+			continue;
+		}
+		// positions within [low, high] (the window moves monotonically with the position)
+		int64_t low = (0 < sign) ? key->position + windowLow : key->position - windowHigh;
+		int64_t high = (0 < sign) ? key->position + windowHigh : key->position - windowLow;
+		while(start < groupEnd && keysTwo[start].position < low) {
+			start++;
+		}
+		for(j=start;j<groupEnd && keysTwo[j].position <= high;j++) {
+			if(inWindowMem <= p->numInWindow) {
+				inWindowMem *= 2;
+				inWindow = realloc(inWindow, sizeof(int32_t)*3*inWindowMem);
+				if(NULL == inWindow) {
+					PrintError(FnName, "inWindow", "Could not reallocate memory", Exit, ReallocMemory);
+				}
+			}
+			inWindow[3*p->numInWindow] = key->index;
+			inWindow[3*p->numInWindow+1] = keysTwo[j].index;
+			inWindow[3*p->numInWindow+2] = getPairedScore(&one->entries[key->index], 
+					&two->entries[keysTwo[j].index],
+					positioning,
+					strandedness,
+					avgMismatchQuality,
+					matchScore,
+					mismatchScore,
+					b);
+			p->numInWindow++;
+		}
+	}
+	free(keysOne);
+	free(keysTwo);
+	qsort(inWindow, p->numInWindow, sizeof(int32_t)*3, PairingInWindowCompare);
+
+	p->inWindowI = malloc(sizeof(int32_t)*(1 + p->numInWindow));
+	p->inWindowJ = malloc(sizeof(int32_t)*(1 + p->numInWindow));
+	p->inWindowScore = malloc(sizeof(int32_t)*(1 + p->numInWindow));
+	if(NULL == p->inWindowI || NULL == p->inWindowJ || NULL == p->inWindowScore) {
+		PrintError(FnName, "p->inWindow", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(k=0;k<p->numInWindow;k++) {
+		p->inWindowI[k] = inWindow[3*k];
+		p->inWindowJ[k] = inWindow[3*k+1];
+		p->inWindowScore[k] = inWindow[3*k+2];
+		PairingEngineAddScore(p, p->inWindowScore[k], 1);
+	}
+	free(inWindow);
+
+	// Add the best two distinct scores of the pairings outside of the window
+	numScoresOne = PairingEngineGetDistinctScores(one, &scoresOne, &scoresOneCounts);
+	p->numScoresTwo = PairingEngineGetDistinctScores(two, &p->scoresTwo, &p->scoresTwoCounts);
+	bound = INT64_MAX;
+	for(numFound=k=0;numFound < 2 && k < PAIRING_MAX_WINDOW_SUMS;k++) {
+		sum = PairingEngineGetNextSum(scoresOne, numScoresOne, p->scoresTwo, p->numScoresTwo, bound);
+		if(INT64_MIN == sum) {
+			break;
+		}
+		// # of pairings with this sum
+		for(i=0,numSum=0;i<numScoresOne;i++) {
+			numSum += (int64_t)scoresOneCounts[i] * PairingEngineGetScoreCount(p->scoresTwo, p->scoresTwoCounts, p->numScoresTwo, sum - scoresOne[i]);
+		}
+		// remove those within the window
+		for(i=0;i<p->numInWindow;i++) {
+			if(sum == (int64_t)one->entries[p->inWindowI[i]].score + two->entries[p->inWindowJ[i]].score) {
+				numSum--;
+			}
+		}
+		if(0 < numSum) {
+			PairingEngineAddScore(p, (int32_t)(sum - p->maxPenalty), (int32_t)numSum);
+			numFound++;
+		}
+		bound = sum;
+	}
+	free(scoresOne);
+	free(scoresOneCounts);
+
+	// Too many pairings within the window share the same scores
+	return (numFound < 2 && PAIRING_MAX_WINDOW_SUMS <= k) ? 0 : 1;
+}
+
+/* Scores all pairings */
+static void PairingEngineAllPairs(PairingEngine *p,
+		AlignedRead *tmpA,
+		int positioning,
+		int strandedness,
+		int avgMismatchQuality,
+		int matchScore,
+		int mismatchScore,
+		PEDBins *b)
+{
+	int32_t i, j;
+
+	for(i=0;i<tmpA->ends[0].numEntries;i++) {
+		for(j=0;j<tmpA->ends[1].numEntries;j++) {
+			PairingEngineAddScore(p, getPairedScore(&tmpA->ends[0].entries[i], 
+						&tmpA->ends[1].entries[j],
+						positioning,
+						strandedness,
+						avgMismatchQuality,
+						matchScore,
+						mismatchScore,
+						b), 1);
+		}
+	}
+}
+
+/* Gets the nth (zero-based) best scoring pairing, ordered by end one then end two index */
+static void PairingEngineGetBest(PairingEngine *p,
+		AlignedRead *tmpA,
+		int32_t n,
+		int32_t *bestI,
+		int32_t *bestJ,
+		int positioning,
+		int strandedness,
+		int avgMismatchQuality,
+		int matchScore,
+		int mismatchScore,
+		PEDBins *b)
+{
+	int32_t i, j, k, numRow;
+
+	k = 0;
+	for(i=0;i<tmpA->ends[0].numEntries;i++) {
+		if(NULL != p->inWindowI) {
+			// count the best pairings for this entry of end one without scoring the row
+			int64_t mate = (int64_t)p->bestScore + p->maxPenalty - tmpA->ends[0].entries[i].score;
+			numRow = PairingEngineGetScoreCount(p->scoresTwo, p->scoresTwoCounts, p->numScoresTwo, mate);
+			for(;k<p->numInWindow && p->inWindowI[k] < i;k++);
+			for(;k<p->numInWindow && p->inWindowI[k] == i;k++) {
+				if(mate == tmpA->ends[1].entries[p->inWindowJ[k]].score) numRow--;
+				if(p->bestScore == p->inWindowScore[k]) numRow++;
+			}
+			if(numRow <= n) {
+				n -= numRow;
+				continue;
+			}
+		}
+		for(j=0;j<tmpA->ends[1].numEntries;j++) {
+			if(p->bestScore == getPairedScore(&tmpA->ends[0].entries[i], 
+						&tmpA->ends[1].entries[j],
+						positioning,
+						strandedness,
+						avgMismatchQuality,
+						matchScore,
+						mismatchScore,
+						b)) {
+				if(0 == n) {
+					(*bestI) = i;
+					(*bestJ) = j;
+					return;
+				}
+				n--;
+			}
+		}
+	}
+	PrintError("PairingEngineGetBest", "n", "Could not find the best pairing", Exit, OutOfRange);
+}
+
 void DoPairing(AlignedRead *tmpA, 
                int algorithm,
                int positioning, 
@@ -529,82 +966,27 @@ void DoPairing(AlignedRead *tmpA,
                int mismatchScore,
                PEDBins *b)
 {
-  char *FnName="DoPairing";
-  int32_t i, j;
-      int32_t bestScore, bestNum;
-      int32_t penultimateScore, penultimateNum;
-      int32_t *bestScoreIndexesI = NULL;
-      int32_t *bestScoreIndexesJ = NULL;
-      int32_t bestScoreIndexesMem = 16;
-
-      bestScoreIndexesI = malloc(sizeof(int32_t) * bestScoreIndexesMem);
-      if(NULL == bestScoreIndexesI) {
-          PrintError(FnName, "bestScoreIndexesI", "Could not allocate memory", Exit, MallocMemory);
-      }
-      bestScoreIndexesJ = malloc(sizeof(int32_t) * bestScoreIndexesMem);
-      if(NULL == bestScoreIndexesJ) {
-          PrintError(FnName, "bestScoreIndexesJ", "Could not allocate memory", Exit, MallocMemory);
-      }
-
-      bestScore = INT_MIN;
-      bestNum = 0;
-      penultimateScore = INT_MIN;
-      penultimateNum = 0;
-
-      for(i=0;i<tmpA->ends[0].numEntries;i++) {
-          for(j=0;j<tmpA->ends[1].numEntries;j++) {
-              int32_t score = getPairedScore(&tmpA->ends[0].entries[i], 
-                                             &tmpA->ends[1].entries[j],
-                                             positioning,
-                                             strandedness,
-                                             avgMismatchQuality,
-                                             matchScore,
-                                             mismatchScore,
-                                             b);
-              if(bestScore < score) {
-                  penultimateScore = bestScore;
-                  penultimateNum = bestNum;
-                  bestScore = score;
-                  bestNum = 1;
-                  bestScoreIndexesI[bestNum-1] = i;
-                  bestScoreIndexesJ[bestNum-1] = j;
-              }
-              else if(bestScore == score) {
-                  bestNum++;
-                  if(bestScoreIndexesMem < bestNum) {
-                      bestScoreIndexesMem = bestNum;
-                      bestScoreIndexesI = realloc(bestScoreIndexesI, sizeof(int32_t) * bestScoreIndexesMem);
-                      if(NULL == bestScoreIndexesI) {
-                          PrintError(FnName, "bestScoreIndexesI", "Could not allocate memory", Exit, ReallocMemory);
-                      }
-                      bestScoreIndexesJ = realloc(bestScoreIndexesJ, sizeof(int32_t) * bestScoreIndexesMem);
-                      if(NULL == bestScoreIndexesJ) {
-                          PrintError(FnName, "bestScoreIndexesJ", "Could not allocate memory", Exit, ReallocMemory);
-                      }
-                  }
-                  bestScoreIndexesI[bestNum-1] = i;
-                  bestScoreIndexesJ[bestNum-1] = j;
-              }
-              else if(penultimateScore < score) {
-                  penultimateScore = score;
-                  penultimateNum = 1;
-              }
-              else if(penultimateScore == score) {
-                  penultimateNum++;
-              }
-          }
+      int32_t i, bestI, bestJ;
+      PairingEngine p;
+
+      PairingEngineInitialize(&p);
+      if(tmpA->ends[0].numEntries * tmpA->ends[1].numEntries < PAIRING_SWEEP_MIN_PAIRS ||
+         0 == PairingEngineSweep(&p, tmpA, positioning, strandedness, avgMismatchQuality, matchScore, mismatchScore, b)) {
+          PairingEngineFree(&p);
+          PairingEngineAllPairs(&p, tmpA, positioning, strandedness, avgMismatchQuality, matchScore, mismatchScore, b);
       }
       
-      if(1 < bestNum) {
+      if(1 < p.bestNum) {
           if(1 == randomBest) {
               // pick a random one
-              i = (int)(drand48() * bestNum);
+              i = (int)(drand48() * p.bestNum);
+              PairingEngineGetBest(&p, tmpA, i, &bestI, &bestJ, positioning, strandedness, avgMismatchQuality, matchScore, mismatchScore, b);
               // copy over
-              if(i != bestScoreIndexesI[i]) {
-                  AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexesI[i]]);
+              if(i != bestI) {
+                  AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestI]);
               }
-              if(i != bestScoreIndexesJ[i]) {
-                  AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexesJ[i]]);
+              if(i != bestJ) {
+                  AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestJ]);
               }
               // reallocate
               AlignedEndReallocate(&tmpA->ends[0], 1);
@@ -616,11 +998,12 @@ void DoPairing(AlignedRead *tmpA,
           }
       }
       else {
-          if(0 != bestScoreIndexesI[0]) {
-              AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexesI[0]]);
+          PairingEngineGetBest(&p, tmpA, 0, &bestI, &bestJ, positioning, strandedness, avgMismatchQuality, matchScore, mismatchScore, b);
+          if(0 != bestI) {
+              AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestI]);
           }
-          if(0 != bestScoreIndexesJ[0]) {
-              AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexesJ[0]]);
+          if(0 != bestJ) {
+              AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestJ]);
           }
           // reallocate
           AlignedEndReallocate(&tmpA->ends[0], 1);
@@ -628,11 +1011,12 @@ void DoPairing(AlignedRead *tmpA,
       }
           
       // update mapping quality
-      if(1 == bestNum) {
+      if(1 == p.bestNum) {
           int32_t mapq = MAXIMUM_MAPPING_QUALITY;
-          if(penultimateNum <= 0) {
-              penultimateScore = GETMAX(tmpA->ends[i].entries[0].score, tmpA->ends[1].entries[0].score);
-              penultimateNum = 1;
+          if(p.penultimateNum <= 0) {
+              // only one pairing: each end had a single entry
+              p.penultimateScore = tmpA->ends[1].entries[0].score;
+              p.penultimateNum = 1;
           }
           /*
              mapq = (bestScore - penultimateScore) * avgMismatchQuality / mismatchScore;
@@ -645,8 +1029,8 @@ void DoPairing(AlignedRead *tmpA,
              */
           double sf = 0.2;
           sf *= 250.0 / (matchScore * GETMAX(tmpA->ends[0].readLength, tmpA->ends[1].readLength)); // scale based on the best possible alignment score 
-          sf *= (bestNum / (1.0 * penultimateNum)); // scale based on number of sub-optimal mappings
-          sf *= (double)(bestScore - penultimateScore + 1); // scale based on distance to the sub-optimal mapping
+          sf *= (p.bestNum / (1.0 * p.penultimateNum)); // scale based on number of sub-optimal mappings
+          sf *= (double)(p.bestScore - p.penultimateScore + 1); // scale based on distance to the sub-optimal mapping
           mapq = (int32_t)(sf + 0.99999);
           if(mapq > MAXIMUM_MAPPING_QUALITY) mapq = MAXIMUM_MAPPING_QUALITY;
           else if(mapq <= 0) mapq = 1;
@@ -658,8 +1042,7 @@ void DoPairing(AlignedRead *tmpA,
       }
       
       // free
-      free(bestScoreIndexesI);
-      free(bestScoreIndexesJ);
+      PairingEngineFree(&p);
 }
 
 int FilterAlignedRead(AlignedRead *a,
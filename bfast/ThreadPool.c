@@ -0,0 +1,208 @@
+/* config.h defines _GNU_SOURCE, which is needed for the CPU affinity */
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "AlignMatrix.h"
+#include "ThreadPool.h"
+
+/* The pool shared by all stages */
+static ThreadPool pool = {NULL, NULL, 0, 0,
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	NULL, NULL, 0, 0, 0, 0, 0};
+
+/* Starts the workers.  This should be called once when the program starts,
+ * as the workers and their scratch are kept until ThreadPoolStop. */
+void ThreadPoolStart(int32_t numThreads, int32_t cpuAffinity)
+{
+	char *FnName="ThreadPoolStart";
+	int32_t i;
+	int errCode;
+
+	assert(0 < numThreads);
+
+	if(0 < pool.numThreads) {
+		ThreadPoolStop();
+	}
+
+#ifndef HAVE_PTHREAD_SETAFFINITY_NP
+	if(1 == cpuAffinity) {
+		PrintError(FnName, "cpuAffinity", "CPU affinity is not supported on this system", Warn, OutOfRange);
+		cpuAffinity = 0;
+	}
+#endif
+
+	pool.threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == pool.threads) {
+		PrintError(FnName, "pool.threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	pool.workers = malloc(sizeof(ThreadPoolWorker)*numThreads);
+	if(NULL == pool.workers) {
+		PrintError(FnName, "pool.workers", "Could not allocate memory", Exit, MallocMemory);
+	}
+	pool.numThreads = numThreads;
+	pool.cpuAffinity = cpuAffinity;
+	pool.function = NULL;
+	pool.args = NULL;
+	pool.argSize = 0;
+	pool.numTasks = 0;
+	pool.numRunning = 0;
+	pool.batch = 0;
+	pool.shutdown = 0;
+
+	for(i=0;i<numThreads;i++) {
+		pool.workers[i].workerID = i;
+		AlignMatrixInitialize(&pool.workers[i].matrix);
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_create(&pool.threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				ThreadPoolWorkerThread, /* start routine */
+				&pool.workers[i]); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+}
+
+/* Waits for the workers to exit and frees their scratch */
+void ThreadPoolStop()
+{
+	char *FnName="ThreadPoolStop";
+	int32_t i;
+	int errCode;
+	void *status;
+
+	if(0 == pool.numThreads) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+
+	for(i=0;i<pool.numThreads;i++) {
+		errCode = pthread_join(pool.threads[i],
+				&status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		AlignMatrixFree(&pool.workers[i].matrix);
+	}
+
+	free(pool.threads);
+	free(pool.workers);
+	pool.threads = NULL;
+	pool.workers = NULL;
+	pool.numThreads = 0;
+}
+
+/* Runs the function on each of the numTasks arguments, each argSize bytes
+ * long, and waits for all of them to return.  The pool is started if this
+ * is called before ThreadPoolStart.  A pool with fewer workers than tasks 
+ * is kept, so that the workers keep their scratch and CPU or NUMA 
+ * bindings, and each worker runs every task assigned to it in turn.  The
+ * tasks of a batch must therefore not wait on each other. */
+void ThreadPoolRun(void *(*function)(void*),
+		void *args,
+		size_t argSize,
+		int32_t numTasks)
+{
+	if(0 == pool.numThreads) {
+		ThreadPoolStart(numTasks, pool.cpuAffinity);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.function = function;
+	pool.args = (char*)args;
+	pool.argSize = argSize;
+	pool.numTasks = numTasks;
+	pool.numRunning = pool.numThreads;
+	pool.batch++;
+	pthread_cond_broadcast(&pool.start);
+	while(0 < pool.numRunning) {
+		pthread_cond_wait(&pool.done, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/* Gets the worker that runs the given task, and so its scratch */
+ThreadPoolWorker *ThreadPoolGetWorker(int32_t taskID)
+{
+	assert(0 < pool.numThreads);
+	return &pool.workers[taskID % pool.numThreads];
+}
+
+/* TODO */
+void *ThreadPoolWorkerThread(void *arg)
+{
+	ThreadPoolWorker *worker = (ThreadPoolWorker*)arg;
+	int64_t batch = 0;
+	int32_t taskID;
+	void *(*function)(void*);
+	char *args;
+	size_t argSize;
+	int32_t numTasks, numThreads;
+
+	if(1 == pool.cpuAffinity) {
+		ThreadPoolSetAffinity(worker->workerID);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	while(1) {
+		while(0 == pool.shutdown && batch == pool.batch) {
+			pthread_cond_wait(&pool.start, &pool.lock);
+		}
+		if(1 == pool.shutdown) {
+			break;
+		}
+		batch = pool.batch;
+		function = pool.function;
+		args = pool.args;
+		argSize = pool.argSize;
+		numTasks = pool.numTasks;
+		numThreads = pool.numThreads;
+		pthread_mutex_unlock(&pool.lock);
+
+		for(taskID=worker->workerID;taskID<numTasks;taskID+=numThreads) {
+			function(args + taskID*argSize);
+		}
+
+		pthread_mutex_lock(&pool.lock);
+		pool.numRunning--;
+		if(0 == pool.numRunning) {
+			pthread_cond_signal(&pool.done);
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return arg;
+}
+
+/* Pins the calling worker to one CPU */
+void ThreadPoolSetAffinity(int32_t workerID)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+	char *FnName="ThreadPoolSetAffinity";
+	long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t cpus;
+
+	if(numCPUs <= 0) {
+		return;
+	}
+	CPU_ZERO(&cpus);
+	CPU_SET(workerID % numCPUs, &cpus);
+	if(0 != pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus)) {
+		PrintError(FnName, "pthread_setaffinity_np", "Could not set the CPU affinity", Warn, ThreadError);
+	}
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <pthread.h>
+#include "AlignMatrix.h"
+
+/* Scratch kept by each worker across batches */
+typedef struct {
+	int32_t workerID;
+	AlignMatrix matrix;
+} ThreadPoolWorker;
+
+/* Long-lived workers shared by all stages.  Task i of a batch is always run
+ * by worker i modulo the number of workers, so that a task can use the
+ * scratch of its worker. */
+typedef struct {
+	pthread_t *threads;
+	ThreadPoolWorker *workers;
+	int32_t numThreads;
+	int32_t cpuAffinity;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	/* The current batch */
+	void *(*function)(void*);
+	char *args;
+	size_t argSize;
+	int32_t numTasks;
+	int32_t numRunning;
+	int64_t batch;
+	int32_t shutdown;
+} ThreadPool;
+
+void ThreadPoolStart(int32_t, int32_t);
+void ThreadPoolStop();
+void ThreadPoolRun(void *(*)(void*), void*, size_t, int32_t);
+ThreadPoolWorker *ThreadPoolGetWorker(int32_t);
+void *ThreadPoolWorkerThread(void*);
+void ThreadPoolSetAffinity(int32_t);
+
+#endif
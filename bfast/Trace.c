@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <config.h>
+#include <unistd.h>
+
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#ifndef DISABLE_TRACE
+
+/* The tracer of the current command, disabled unless a file was given */
+static Trace trace;
+
+/* Enables the tracer, the spans being written to the given file by
+ * TraceFree.  Nothing is recorded when the file name is NULL. */
+void TraceInitialize(char *command, char *fileName)
+{
+	char *FnName="TraceInitialize";
+
+	if(NULL == fileName) {
+		return;
+	}
+	assert(0 == trace.enabled);
+
+	trace.command = strdup(command);
+	trace.fileName = strdup(fileName);
+	if(NULL == trace.command || NULL == trace.fileName) {
+		PrintError(FnName, "trace", "Could not allocate memory", Exit, MallocMemory);
+	}
+	MetricsRegistryInitialize(&trace.threads, sizeof(TraceThread), TraceTakeThread);
+	trace.startNanos = MetricsGetNanos();
+	trace.enabled = 1;
+
+	/* The calling thread is always the first */
+	TraceGetThread();
+}
+
+/* Writes the spans as Chrome trace events and frees them.  This should be
+ * called once all other threads are done. */
+void TraceFree()
+{
+	char *FnName="TraceFree";
+	FILE *fp=NULL;
+	int32_t i;
+
+	if(0 == trace.enabled) {
+		return;
+	}
+
+	if(!(fp = fopen(trace.fileName, "wb"))) {
+		PrintError(FnName, trace.fileName, "Could not open file for writing", Exit, OpenFileError);
+	}
+	TracePrint(fp);
+	fclose(fp);
+
+	trace.enabled = 0;
+	for(i=0;i<trace.threads.numEntries;i++) {
+		free(((TraceThread*)trace.threads.entries[i])->spans);
+	}
+	MetricsRegistryFree(&trace.threads);
+	free(trace.command);
+	trace.command = NULL;
+	free(trace.fileName);
+	trace.fileName = NULL;
+}
+
+/* Opens a span on the calling thread.  The name must not be freed. */
+void TraceBegin(char *name)
+{
+	TraceThread *thread=NULL;
+
+	if(0 == trace.enabled) {
+		return;
+	}
+	thread = TraceGetThread();
+	assert(thread->depth < TRACE_MAX_DEPTH);
+	thread->names[thread->depth] = name;
+	thread->starts[thread->depth] = MetricsGetNanos();
+	thread->depth++;
+}
+
+/* Closes the last span opened on the calling thread */
+void TraceEnd()
+{
+	TraceThread *thread=NULL;
+	TraceSpan *span=NULL;
+
+	if(0 == trace.enabled) {
+		return;
+	}
+	thread = TraceGetThread();
+	assert(0 < thread->depth);
+	thread->depth--;
+	span = &thread->spans[thread->numSpans % TRACE_RING_LENGTH];
+	span->name = thread->names[thread->depth];
+	span->start = thread->starts[thread->depth];
+	span->duration = MetricsGetNanos() - span->start;
+	thread->numSpans++;
+}
+
+/* Returns the ring of the calling thread */
+TraceThread *TraceGetThread()
+{
+	return MetricsRegistryGet(&trace.threads);
+}
+
+/* Allocates the ring of a new entry, and closes any spans left open by the
+ * last thread to use it */
+void TraceTakeThread(void *arg)
+{
+	char *FnName="TraceTakeThread";
+	TraceThread *thread=arg;
+
+	if(NULL == thread->spans) {
+		thread->spans = malloc(sizeof(TraceSpan)*TRACE_RING_LENGTH);
+		if(NULL == thread->spans) {
+			PrintError(FnName, "thread->spans", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	thread->depth = 0;
+}
+
+/* Prints the spans as complete ("X") events of the Chrome trace event
+ * format, in microseconds from the start of the command.  A ring used by
+ * more than one thread, one after the other, is shown as one thread whose
+ * name and "threadsMerged" give their number. */
+void TracePrint(FILE *fp)
+{
+	int64_t i, first, numDropped=0;
+	int32_t j, pid=(int32_t)getpid();
+	char *separator="";
+	TraceThread *thread=NULL;
+	TraceSpan *span=NULL;
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for(j=0;j<trace.threads.numEntries;j++) {
+		thread = (TraceThread*)trace.threads.entries[j];
+		if(1 < thread->entry.numThreads) {
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s thread %d (%d threads merged)\",\"threadsMerged\":%d}}",
+					separator,
+					pid,
+					thread->entry.threadID,
+					trace.command,
+					thread->entry.threadID,
+					thread->entry.numThreads,
+					thread->entry.numThreads);
+		}
+		else {
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s thread %d\",\"threadsMerged\":1}}",
+					separator,
+					pid,
+					thread->entry.threadID,
+					trace.command,
+					thread->entry.threadID);
+		}
+		separator = ",\n";
+		/* Only the last spans are kept */
+		first = 0;
+		if(TRACE_RING_LENGTH < thread->numSpans) {
+			first = thread->numSpans - TRACE_RING_LENGTH;
+			numDropped += first;
+		}
+		for(i=first;i<thread->numSpans;i++) {
+			span = &thread->spans[i % TRACE_RING_LENGTH];
+			fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"bfast\",\"ph\":\"X\",\"ts\":%.3lf,\"dur\":%.3lf,\"pid\":%d,\"tid\":%d}",
+					separator,
+					span->name,
+					(span->start - trace.startNanos)/1000.0,
+					span->duration/1000.0,
+					pid,
+					thread->entry.threadID);
+		}
+	}
+	fprintf(fp, "\n],\n");
+	fprintf(fp, "\"displayTimeUnit\":\"ms\",\n");
+	fprintf(fp, "\"otherData\":{\"command\":\"%s\",\"version\":\"%s\",\"droppedSpans\":%lld}\n",
+			trace.command,
+			PACKAGE_VERSION,
+			(long long int)numDropped);
+	fprintf(fp, "}\n");
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <pthread.h>
+#include <config.h>
+#include "BLibDefinitions.h"
+#include "Metrics.h"
+
+/* The number of spans kept for each thread, older spans being overwritten */
+#define TRACE_RING_LENGTH 65536
+/* The number of spans a thread may have open at once */
+#define TRACE_MAX_DEPTH 16
+
+/* Spans are recorded with these macros, so that the tracer is compiled out
+ * with --disable-trace. */
+#ifndef DISABLE_TRACE
+#define TRACE_INITIALIZE(_command, _fileName) TraceInitialize(_command, _fileName)
+#define TRACE_FREE() TraceFree()
+#define TRACE_BEGIN(_name) TraceBegin(_name)
+#define TRACE_END() TraceEnd()
+#else
+#define TRACE_INITIALIZE(_command, _fileName)
+#define TRACE_FREE()
+#define TRACE_BEGIN(_name)
+#define TRACE_END()
+#endif
+
+#ifndef DISABLE_TRACE
+
+typedef struct {
+	char *name;
+	int64_t start;
+	int64_t duration;
+} TraceSpan;
+
+/* The spans of one thread, see MetricsRegistryEntry.  Only the owning 
+ * thread writes to its ring, so no lock is taken. */
+typedef struct {
+	MetricsRegistryEntry entry;
+	int64_t numSpans;
+	TraceSpan *spans;
+	int32_t depth;
+	char *names[TRACE_MAX_DEPTH];
+	int64_t starts[TRACE_MAX_DEPTH];
+} TraceThread;
+
+typedef struct {
+	int32_t enabled;
+	char *command;
+	char *fileName;
+	int64_t startNanos;
+	MetricsRegistry threads;
+} Trace;
+
+void TraceInitialize(char*, char*);
+void TraceFree();
+void TraceBegin(char*);
+void TraceEnd();
+TraceThread *TraceGetThread();
+void TraceTakeThread(void*);
+void TracePrint(FILE*);
+
+#endif
+
+#endif
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <config.h>
 #include <time.h>
+#include <limits.h>
 #include <unistd.h>  
 
 #include "../bfast/BError.h"
@@ -25,6 +26,8 @@ int PrintUsage()
 	fprintf(stderr, "\t-i\tFILE\tinput specification file\n");
 	fprintf(stderr, "\t-f\tFILE\tSpecifies the file name of the FASTA reference genome\n");
 	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
+	fprintf(stderr, "\t-s\tINT\trandom number seed (default from the time)\n");
+	fprintf(stderr, "\t-g\tINT\tinstead of reads, print a random reference genome\n\t\t\tof this length in FASTA format (-f and -i are ignored)\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 
 	fprintf(stderr, "\nInput specification file:\n");
@@ -60,15 +63,19 @@ int main(int argc, char *argv[])
 	int pairedEndLength = 0;
 	int numReads = 0;
 	int lineNumber = 0;
+	int seed = -1;
+	int64_t genomeLength = 0;
 	char *inputFileName=NULL;
 	int c;
 	FILE *fpIn=NULL;
 
-	while((c = getopt(argc, argv, "f:i:A:h")) >= 0) {
+	while((c = getopt(argc, argv, "f:g:i:s:A:h")) >= 0) {
 		switch(c) {
 			case 'f': fastaFileName=strdup(optarg);break;
+			case 'g': genomeLength=strtoll(optarg, NULL, 10); break;
 			case 'h': return PrintUsage();
 			case 'i': inputFileName = strdup(optarg); break;
+			case 's': seed=atoi(optarg); break;
 			case 'A': space=atoi(optarg); break;
 			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
 		}
@@ -78,6 +85,19 @@ int main(int argc, char *argv[])
 		return PrintUsage();
 	}
 
+	/* Seed random number */
+	if(seed < 0) {
+		seed = (int)(time(NULL) & INT_MAX);
+	}
+	srand(seed);
+
+	if(0 < genomeLength) {
+		GenerateReference(genomeLength, stdout);
+		free(inputFileName);
+		free(fastaFileName);
+		return 0;
+	}
+
 	if(NULL == fastaFileName) {
 		PrintError(Name, "fastaFileName", "Command line argument", Exit, OutOfRange);
 	}
@@ -160,9 +180,6 @@ void GenerateReads(RGBinary *rg,
 		PrintError(FnName, "rg->space", "The reference genome must be given in nucleotide space", Exit, OutOfRange);
 	}
 
-	/* Seed random number */
-	srand(time(NULL));
-
 	/* Get the reference genome length */
 	for(i=0;i<rg->numContigs;i++) {
 		rgLength += rg->contigs[i].sequenceLength;
@@ -257,9 +274,6 @@ void GenerateReadsFP(RGBinary *rg,
 		PrintError(FnName, "rg->space", "The reference genome must be given in nucleotide space", Exit, OutOfRange);
 	}
 
-	/* Seed random number */
-	srand(time(NULL));
-
 	/* Get the reference genome length */
 	for(i=0;i<rg->numContigs;i++) {
 		rgLength += rg->contigs[i].sequenceLength;
@@ -304,3 +318,27 @@ void GenerateReadsFP(RGBinary *rg,
 			numReads,
 			numReads);
 }
+
+/* Prints a random reference genome, split evenly into contigs */
+void GenerateReference(int64_t genomeLength,
+		FILE *fp)
+{
+	int64_t i, j, contigLength;
+	char line[BGENERATEREADS_FASTA_LINE_LENGTH+1]="\0";
+
+	contigLength = (genomeLength + BGENERATEREADS_NUM_CONTIGS - 1)/BGENERATEREADS_NUM_CONTIGS;
+	for(i=0;i<BGENERATEREADS_NUM_CONTIGS && i*contigLength < genomeLength;i++) {
+		fprintf(fp, ">contig%d\n", (int)(i+1));
+		for(j=0;j<contigLength && i*contigLength + j < genomeLength;j++) {
+			line[j%BGENERATEREADS_FASTA_LINE_LENGTH] = DNA[rand()%4];
+			if(BGENERATEREADS_FASTA_LINE_LENGTH - 1 == j%BGENERATEREADS_FASTA_LINE_LENGTH) {
+				line[BGENERATEREADS_FASTA_LINE_LENGTH] = '\0';
+				fprintf(fp, "%s\n", line);
+			}
+		}
+		if(0 != j%BGENERATEREADS_FASTA_LINE_LENGTH) {
+			line[j%BGENERATEREADS_FASTA_LINE_LENGTH] = '\0';
+			fprintf(fp, "%s\n", line);
+		}
+	}
+}
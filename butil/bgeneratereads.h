@@ -3,6 +3,10 @@
 
 #include "../bfast/RGBinary.h"
 
+#define BGENERATEREADS_NUM_CONTIGS 4
+#define BGENERATEREADS_FASTA_LINE_LENGTH 60
+
 void GenerateReads(RGBinary*, int, int, int, int, int, int, int, int, int, int);
 void GenerateReadsFP(RGBinary*, int, int, int, int, int, int, int, int, int, int, int, FILE*);
+void GenerateReference(int64_t, FILE*);
 #endif
@@ -680,6 +680,7 @@ void GetMatchesFromContigPos(RGIndex *index,
 			INT_MAX,
 			rg->space,
 			BothStrands,
+			NULL,
 			&ranges);
 
 	/* Transfer ranges to matches */
@@ -24,6 +24,12 @@
 /* Prints a histogram that counts the number of unique k-mers in the genome
  * that occur X number of times.  The k-mer chosen comes from the 
  * layout of the index.
+ *
+ * The index is split into one range per thread at key boundaries.  Each
+ * thread walks its range, packing the key of each entry so that runs of 
+ * the same key are found by comparing words, and only searches the index
+ * for the reverse compliment once per run.  The per-thread histograms are
+ * then summed.
  * */
 
 int PrintUsage()
@@ -35,6 +41,7 @@ int PrintUsage()
 	fprintf(stderr, "\t-s\tINT\tStrands 0: both strands 1: forward only 2: reverse only\n");
 	fprintf(stderr, "\t-n\tINT\tSpecifies the number of threads to use (Default 1)\n");
 	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
+	fprintf(stderr, "\t-b\tFILE\tAlso write the hash bucket occupancy histogram to this file\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
 			PACKAGE_BUGREPORT);
@@ -45,6 +52,7 @@ int main(int argc, char *argv[])
 {
 	char *indexFileName=NULL;
 	char *fastaFileName=NULL;
+	char *bucketsFileName=NULL;
 	int numThreads = 1;
 	int whichStrand = 0;
 	int space = NTSpace;
@@ -52,8 +60,9 @@ int main(int argc, char *argv[])
 	RGBinary rg;
 	RGIndex index;
 
-	while((c = getopt(argc, argv, "f:i:n:s:A:h")) >= 0) {
+	while((c = getopt(argc, argv, "b:f:i:n:s:A:h")) >= 0) {
 		switch(c) {
+			case 'b': bucketsFileName=strdup(optarg); break;
 			case 'f': fastaFileName=strdup(optarg); break;
 			case 'h': return PrintUsage();
 			case 'i': indexFileName=strdup(optarg); break;
@@ -74,6 +83,9 @@ int main(int argc, char *argv[])
 	if(NULL == fastaFileName) {
 		PrintError(Name, "fastaFileName", "Command line option", Exit, InputArguments);
 	}
+	if(numThreads <= 0) {
+		PrintError(Name, "numThreads", "Command line option", Exit, InputArguments);
+	}
 
 	assert(whichStrand == BothStrands || whichStrand == ForwardStrand || whichStrand == ReverseStrand);
 
@@ -92,12 +104,22 @@ int main(int argc, char *argv[])
 			numThreads);
 	fprintf(stderr, "%s", BREAK_LINE);
 
+	if(NULL != bucketsFileName) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Writing hash bucket occupancy to %s.\n", bucketsFileName);
+		PrintBucketOccupancy(&index, bucketsFileName);
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+
 	fprintf(stderr, "%s", BREAK_LINE);
 	fprintf(stderr, "Cleaning up.\n");
 	/* Delete the index */
 	RGIndexDelete(&index);
 	/* Delete the rg */
 	RGBinaryDelete(&rg);
+	free(indexFileName);
+	free(fastaFileName);
+	free(bucketsFileName);
 	fprintf(stderr, "%s", BREAK_LINE);
 	fprintf(stderr, "Terminating successfully!\n");
 	fprintf(stderr, "%s", BREAK_LINE);
@@ -105,97 +127,102 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+/* Packs the bases of the key at the given place in the index, four bits
+ * per base, so that keys can be compared a word at a time */
+void GetKey(RGIndex *index,
+		RGBinary *rg,
+		int64_t a,
+		uint64_t *key,
+		int32_t numKeyWords)
+{
+	char *FnName="GetKey";
+	int32_t i, cur;
+	uint32_t aContig = (index->contigType==Contig_8)?index->contigs_8[a]:index->contigs_32[a];
+	uint32_t aPos = index->positions[a];
+	uint64_t aBase;
+
+	memset(key, 0, sizeof(uint64_t)*numKeyWords);
+	for(i=cur=0;i<index->width;i++) {
+		switch(index->mask[i]) {
+			case 0:
+				/* Ignore base */
+				break;
+			case 1:
+				/* Same as RGIndexCompareRead */
+				aBase = RGBinaryGetFourBit(rg, aContig, aPos + i);
+				aBase = ((aBase >> 2) == 2) ? 4 : (aBase & 0x03);
+				key[cur/BINDEXHIST_BASES_PER_WORD] |= aBase << (4*(cur%BINDEXHIST_BASES_PER_WORD));
+				cur++;
+				break;
+			default:
+				PrintError(FnName, NULL, "Could not understand mask", Exit, OutOfRange);
+		}
+	}
+}
+
 /* TODO */
+int CompareKeys(uint64_t *a,
+		uint64_t *b,
+		int32_t numKeyWords)
+{
+	int32_t i;
+	for(i=0;i<numKeyWords;i++) {
+		if(a[i] != b[i]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Splits the index into equal parts, moving each split forward to the
+ * start of the next key so that every key is counted by one thread */
 void GetPivots(RGIndex *index,
 		RGBinary *rg,
 		int64_t *starts,
 		int64_t *ends,
 		int64_t numThreads)
 {
-	/*
-	   char *FnName="GetPivots";
-	   */
+	char *FnName="GetPivots";
 	int64_t i, ind;
-	int32_t returnLength, returnPosition;
-	int8_t readInt[SEQUENCE_LENGTH];
-	RGReads reads;
-	RGRanges ranges;
+	int32_t numKeyWords = (index->keysize + BINDEXHIST_BASES_PER_WORD - 1)/BINDEXHIST_BASES_PER_WORD;
+	uint64_t *prevKey=NULL, *curKey=NULL;
 
-	RGReadsInitialize(&reads);
-	RGRangesInitialize(&ranges);
-
-	/* One less than threads since numThreads-1 will divide
-	 * the index into numThread parts */
-	RGReadsAllocate(&reads, numThreads-1);
-	for(i=0;i<reads.numReads;i++) {
-		/* Get the place in the index */
-		ind = (i+1)*((index->length)/numThreads);
-		/* Initialize */
-		reads.readLength[i] = index->width;
-		reads.offset[i] = 0;
-		/* Allocate memory */
-		reads.reads[i] = NULL;
-		/* Get read */
-		RGBinaryGetReference(rg,
-				(index->contigType == Contig_8)?(index->contigs_8[ind]):(index->contigs_32[ind]),
-				index->positions[ind],
-				FORWARD,
-				0,
-				&reads.reads[i],
-				reads.readLength[i],
-				&returnLength,
-				&returnPosition);
-		assert(returnLength == reads.readLength[i]);
-		assert(returnPosition == index->positions[ind]);
-	}
-	/* Search reads in the index */
-	/* Get the matches */
-	for(i=0;i<reads.numReads;i++) {
-		ConvertSequenceToIntegers(reads.reads[i], readInt, reads.readLength[i]);
-		RGIndexGetRangesBothStrands(index,
-				rg,
-				readInt,
-				reads.readLength[i],
-				reads.offset[i],
-				INT_MAX,
-				INT_MAX,
-				SpaceDoesNotMatter,
-				ForwardStrand,
-				&ranges);
+	prevKey = malloc(sizeof(uint64_t)*numKeyWords);
+	if(NULL == prevKey) {
+		PrintError(FnName, "prevKey", "Could not allocate memory", Exit, MallocMemory);
+	}
+	curKey = malloc(sizeof(uint64_t)*numKeyWords);
+	if(NULL == curKey) {
+		PrintError(FnName, "curKey", "Could not allocate memory", Exit, MallocMemory);
 	}
 
-	/* Update starts and ends */
 	starts[0] = 0;
-	for(i=0;i<numThreads-1;i++) {
-		starts[i+1] = ranges.endIndex[i]+1;
-		ends[i] = ranges.endIndex[i];
+	for(i=1;i<numThreads;i++) {
+		/* Get the place in the index */
+		ind = GETMAX(starts[i-1], i*((index->length)/numThreads));
+		if(0 < ind && ind < index->length) {
+			GetKey(index, rg, ind-1, prevKey, numKeyWords);
+			GetKey(index, rg, ind, curKey, numKeyWords);
+			while(0 == CompareKeys(prevKey, curKey, numKeyWords)) {
+				ind++;
+				if(index->length <= ind) {
+					break;
+				}
+				GetKey(index, rg, ind, curKey, numKeyWords);
+			}
+		}
+		starts[i] = ind;
+		ends[i-1] = ind-1;
 	}
 	ends[numThreads-1] = index->length-1;
 
-	/*
-	   for(i=0;i<numThreads;i++) {
-	   fprintf(stderr, "%lld\t%lld\t%lld\n",
-	   i,
-	   starts[i],
-	   ends[i]);
-	   }
-	   */
-
 	/* Check */
-	for(i=1;i<numThreads;i++) {
-		assert(RGIndexCompareAt(index,
-					rg,
-					ends[i-1],
-					starts[i],
-					0)<0);
-	}
-	for(i=0;i<numThreads;i++) {
-		assert(starts[i] <= ends[i]);
-	}
 	for(i=0;i<numThreads-1;i++) {
 		assert(ends[i] == starts[i+1] - 1);
 	}
 
+	free(prevKey);
+	free(curKey);
 }
 
 /* TODO */
@@ -212,8 +239,8 @@ void PrintHistogram(RGIndex *index,
 	int errCode;
 	void *status;
 	FILE *fp;
-	int64_t numDifferent, numTotal, cur, sum, totalForward, totalReverse;
-	int numCountsLeft;
+	int64_t numDifferent, numTotal, totalForward, totalReverse;
+	Counts c;
 
 	/* Allocate memory for the thread starts and ends */
 	starts = malloc(sizeof(int64_t)*numThreads);
@@ -251,13 +278,12 @@ void PrintHistogram(RGIndex *index,
 		numTotal += ends[i] - starts[i] + 1;
 		data[i].index = index;
 		data[i].rg = rg;
-		data[i].c.counts = NULL;
-		data[i].c.maxCount = NULL;
+		CountsInitialize(&data[i].c);
 		data[i].whichStrand = whichStrand;
 		data[i].numDifferent = 0;
 		data[i].threadID = i+1;
 	}
-	assert(numTotal == index->length || (ColorSpace == rg->space && numTotal == index->length - 1));
+	assert(numTotal == index->length);
 
 	fprintf(stderr, "In total, will examine %lld reads.\n",
 			(long long int)(index->length));
@@ -288,17 +314,20 @@ void PrintHistogram(RGIndex *index,
 	}
 	fprintf(stderr, "\n");
 
-	/* Get the total number of different */
+	/* Sum the histograms and totals from the threads */
 	numDifferent = 0;
 	totalForward = 0;
 	totalReverse = 0;
+	CountsInitialize(&c);
 	for(i=0;i<numThreads;i++) {
 		numDifferent += data[i].numDifferent;
 		totalForward += data[i].totalForward;
 		totalReverse += data[i].totalReverse;
+		CountsMerge(&c, &data[i].c);
+		CountsFree(&data[i].c);
 	}
 
-	/* Print counts from threads */
+	/* Print counts */
 	if(!(fp = fdopen(fileno(stdout), "w"))) {
 		PrintError(FnName, "stdout", "Could not open stdout for writing", Exit, OpenFileError);
 	}
@@ -306,44 +335,18 @@ void PrintHistogram(RGIndex *index,
 	fprintf(fp, "# Number of unique reads was: %lld\n",
 			(long long int)numDifferent);
 	fprintf(fp, "# Found counts for %lld mismatches:\n",
-			(long long int)i);
-
-	/* Print the counts, sum over all threads */
-	numCountsLeft = numThreads;
-	cur = 0;
-	while(numCountsLeft > 0) {
-		/* Get the result from all threads */
-		sum = 0;
-		for(j=0;j<numThreads;j++) {
-			if(cur <= data[j].c.maxCount[i]) {
-				assert(data[j].c.counts[i][cur] >= 0);
-				sum += data[j].c.counts[i][cur]; 
-				/* Update */
-				if(data[j].c.maxCount[i] == cur) {
-					numCountsLeft--;
-				}
-			}
-		}
-		assert(sum >= 0);
-		/* Print */
-		if(cur>0) {
-			fprintf(fp, "%lld\t%lld\n",
-					(long long int)cur,
-					(long long int)sum);
-		}
-		cur++;
+			(long long int)0);
+
+	for(j=1;j<=c.maxCount;j++) {
+		assert(c.counts[j] >= 0);
+		fprintf(fp, "%lld\t%lld\n",
+				(long long int)j,
+				(long long int)c.counts[j]);
 	}
 	fclose(fp);
 
 	/* Free memory */
-	for(i=0;i<numThreads;i++) {
-		free(data[i].c.counts[0]);
-		data[i].c.counts[0] = NULL;
-		free(data[i].c.counts);
-		data[i].c.counts=NULL;
-		free(data[i].c.maxCount);
-		data[i].c.maxCount = NULL;
-	}
+	CountsFree(&c);
 	free(threads);
 	free(data);
 	free(starts);
@@ -365,47 +368,33 @@ void *PrintHistogramThread(void *arg)
 	Counts *c = &data->c;
 	int whichStrand = data->whichStrand;
 	int threadID = data->threadID;
-	int numMismatchesEnd = 0;
-	int numMismatchesStart = 0;
+	int32_t numKeyWords = (index->keysize + BINDEXHIST_BASES_PER_WORD - 1)/BINDEXHIST_BASES_PER_WORD;
 
 	/* Local variables */
-	int skip;
-	int64_t i=0;
-	int64_t j=0;
 	int64_t curIndex=0, nextIndex=0;
 	int64_t counter=0;
 	int64_t numDifferent = 0;
 	int64_t numReadsNoMismatches = 0;
-	int64_t numReadsNoMismatchesTotal = 0;
 	int64_t numForward, numReverse;
 	int64_t totalForward, totalReverse; 
-	int64_t numMatches;
+	uint64_t *curKey=NULL, *nextKey=NULL, *tmpKey=NULL;
 
-	/* Allocate memory to hold histogram data */
-	c->counts = malloc(sizeof(int64_t*)*(numMismatchesEnd - numMismatchesStart + 1));
-	if(NULL == c->counts) {
-		PrintError(FnName, "c->counts", "Could not allocate memory", Exit, MallocMemory);
+	curKey = malloc(sizeof(uint64_t)*numKeyWords);
+	if(NULL == curKey) {
+		PrintError(FnName, "curKey", "Could not allocate memory", Exit, MallocMemory);
 	}
-	c->maxCount = malloc(sizeof(int64_t)*(numMismatchesEnd - numMismatchesStart + 1));
-	if(NULL == c->maxCount) {
-		PrintError(FnName, "c->maxCount", "Could not allocate memory", Exit, MallocMemory);
-	}
-
-	/* Initialize counts */
-	for(i=0;i<(numMismatchesEnd - numMismatchesStart + 1);i++) {
-		c->counts[i] = malloc(sizeof(int64_t));
-		if(NULL == c->counts[i]) {
-			PrintError(FnName, "c->counts[i]", "Could not allocate memory", Exit, MallocMemory);
-		}
-		c->counts[i][0] = 0;
-		c->maxCount[i] = 0;
+	nextKey = malloc(sizeof(uint64_t)*numKeyWords);
+	if(NULL == nextKey) {
+		PrintError(FnName, "nextKey", "Could not allocate memory", Exit, MallocMemory);
 	}
 
 	/* Go through every possible read in the genome using the index */
-	/* Go through the index */
 	totalForward = 0;
 	totalReverse = 0;
-	for(curIndex=startIndex, nextIndex=startIndex, counter=0, numDifferent=0;
+	if(startIndex <= endIndex) {
+		GetKey(index, rg, startIndex, curKey, numKeyWords);
+	}
+	for(curIndex=startIndex, counter=0, numDifferent=0;
 			curIndex <= endIndex;
 			curIndex = nextIndex) {
 		if(counter >= BINDEXHIST_ROTATE_NUM) {
@@ -414,82 +403,45 @@ void *PrintHistogramThread(void *arg)
 					(long long int)(curIndex-startIndex));
 			counter -= BINDEXHIST_ROTATE_NUM;
 		}
-		/* Try each mismatch */
-		skip=0;
-		i=0;
-
-		/* Get the matches for the contig/pos */
-		if(0==GetMatchesFromContigPos(index,
-					rg,
-					(index->contigType == Contig_8)?(index->contigs_8[curIndex]):(index->contigs_32[curIndex]),
-					index->positions[curIndex],
-					&numForward, 
-					&numReverse) && 0 == i) {
-			/* Skip over the rest */
-			skip =1 ;
-			nextIndex++;
-		}
-		else {
-			numMatches = numForward + numReverse;
-			assert(numMatches > 0);
-
-			/* Update the value of numReadsNoMismatches and numDifferent
-			 * if we have the results for no mismatches */
-			if(i==0) {
-				assert(numForward > 0);
-				totalForward += numForward;
-				assert(numReverse >= 0);
-				totalReverse += numReverse;
-				/* If the reverse compliment does not match the + strand then it will only match the - strand.
-				 * Count it as unique as well as the + strand read.
-				 * */
-				if((BothStrands == whichStrand || ReverseStrand == whichStrand) &&
-						numReverse == 0) {
-					numDifferent+=2;
-					numReadsNoMismatches = 2;
-				}
-				else {
-					/* Count only the + strand as a unique read. */
-					numReadsNoMismatches = 1;
-					numDifferent++;
-				}	
-				/* This will be the basis for update c->counts */
-				numReadsNoMismatchesTotal += numReadsNoMismatches;
-
-				/* Add the range since we will be skipping over them */
-				if(numForward <= 0) {
-					nextIndex++;
-					counter++;
-				}
-				else {
-					nextIndex += numForward;
-					counter += numForward;
-				}
-			}
 
-			/* Add to our list.  We may have to reallocate this array */
-			if(numMatches > c->maxCount[i]) {
-				j = c->maxCount[i]+1; /* This will determine where we begin initialization after reallocation */
-				/* Reallocate */
-				c->maxCount[i] = numMatches;
-				assert(c->maxCount[i] > 0);
-				c->counts[i] = realloc(c->counts[i], sizeof(int64_t)*(c->maxCount[i]+1));
-				if(NULL == c->counts[i]) {
-					PrintError(FnName, "counts", "Could not allocate memory", Exit, MallocMemory);
-				}
-				/* Initialize from j to maxCount */
-				while(j<=c->maxCount[i]) {
-					c->counts[i][j] = 0;
-					j++;
-				}
+		/* Find the end of the run of entries with this key */
+		for(nextIndex=curIndex+1;nextIndex <= endIndex;nextIndex++) {
+			GetKey(index, rg, nextIndex, nextKey, numKeyWords);
+			if(0 != CompareKeys(curKey, nextKey, numKeyWords)) {
+				break;
 			}
-			assert(numReadsNoMismatches > 0);
-			assert(numMatches <= c->maxCount[i]);
-			assert(c->counts[i][numMatches] >= 0);
-			/* Add the number of reads that were found with no mismatches */
-			c->counts[i][numMatches] += numReadsNoMismatches;
-			assert(c->counts[i][numMatches] > 0);
 		}
+		numForward = nextIndex - curIndex;
+		counter += numForward;
+
+		/* Get the matches for the reverse compliment */
+		numReverse = GetReverseMatches(index,
+				rg,
+				(index->contigType == Contig_8)?(index->contigs_8[curIndex]):(index->contigs_32[curIndex]),
+				index->positions[curIndex]);
+
+		totalForward += numForward;
+		totalReverse += numReverse;
+		/* If the reverse compliment does not match the + strand then it will only match the - strand.
+		 * Count it as unique as well as the + strand read.
+		 * */
+		if((BothStrands == whichStrand || ReverseStrand == whichStrand) &&
+				numReverse == 0) {
+			numDifferent+=2;
+			numReadsNoMismatches = 2;
+		}
+		else {
+			/* Count only the + strand as a unique read. */
+			numReadsNoMismatches = 1;
+			numDifferent++;
+		}	
+
+		CountsAdd(c, numForward + numReverse, numReadsNoMismatches);
+
+		/* The key that ended the run starts the next one */
+		tmpKey = curKey;
+		curKey = nextKey;
+		nextKey = tmpKey;
 	}
 	fprintf(stderr, "\rthreadID:%2d\t%10lld", 
 			threadID,
@@ -500,29 +452,28 @@ void *PrintHistogramThread(void *arg)
 	data->totalForward = totalForward;
 	data->totalReverse = totalReverse;
 
+	free(curKey);
+	free(nextKey);
+
 	return NULL;
 }
 
-/* Get the matches for the contig/pos */
-int GetMatchesFromContigPos(RGIndex *index,
+/* Get the number of matches to the reverse compliment of the read at the contig/pos */
+int64_t GetReverseMatches(RGIndex *index,
 		RGBinary *rg,
 		uint32_t curContig,
-		uint32_t curPos,
-		int64_t *numForward,
-		int64_t *numReverse)
+		uint32_t curPos)
 {
-	char *FnName = "GetMatchesFromContigPos";
 	int returnLength, returnPosition;
 	char *read=NULL;
 	RGRanges ranges;
-	RGMatch match;
 	int readLength = index->width;
 	int8_t readInt[SEQUENCE_LENGTH];
 	int32_t i;
+	int64_t numReverse = 0;
 
 	/* Initialize */
 	RGRangesInitialize(&ranges);
-	RGMatchInitialize(&match);
 
 	/* Get the read */
 	RGBinaryGetReference(rg,
@@ -547,44 +498,114 @@ int GetMatchesFromContigPos(RGIndex *index,
 			INT_MAX,
 			INT_MAX,
 			rg->space,
-			BothStrands,
+			ReverseStrand,
+			NULL,
 			&ranges);
 
-	/* Transfer ranges to matches */
-	RGRangesCopyToRGMatch(&ranges,
-			index,
-			&match,
-			rg->space,
-			0);
+	for(i=0;i<ranges.numEntries;i++) {
+		numReverse += ranges.endIndex[i] - ranges.startIndex[i] + 1;
+	}
 
-	/* Remove duplicates */
-	RGMatchRemoveDuplicates(&match,
-			INT_MAX);
+	RGRangesFree(&ranges);
+	free(read);
+	read=NULL;
 
-	assert(0 < match.numEntries);
-	(*numForward) = (*numReverse) = 0;
+	return numReverse;
+}
 
-	for(i=0;i<match.numEntries;i++) {
-		switch(match.strands[i]) {
-			case FORWARD:
-				(*numForward)++;
-				break;
-			case REVERSE:
-				(*numReverse)++;
-				break;
-			default:
-				PrintError(FnName, NULL, "Could not understand strand", Exit, OutOfRange);
-				break;
+/* TODO */
+void CountsInitialize(Counts *c)
+{
+	c->counts = NULL;
+	c->maxCount = 0;
+}
+
+/* TODO */
+void CountsAdd(Counts *c,
+		int64_t count,
+		int64_t value)
+{
+	char *FnName="CountsAdd";
+	int64_t j;
+
+	/* Add to our list.  We may have to reallocate this array */
+	if(NULL == c->counts || c->maxCount < count) {
+		j = (NULL == c->counts) ? 0 : c->maxCount+1; /* This will determine where we begin initialization after reallocation */
+		c->maxCount = GETMAX(c->maxCount, count);
+		c->counts = realloc(c->counts, sizeof(int64_t)*(c->maxCount+1));
+		if(NULL == c->counts) {
+			PrintError(FnName, "c->counts", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		/* Initialize from j to maxCount */
+		while(j<=c->maxCount) {
+			c->counts[j] = 0;
+			j++;
 		}
 	}
+	c->counts[count] += value;
+}
 
-	assert((*numForward) > 0); /* It should at least match itself ! */
-	assert((*numReverse) >= 0);
+/* Adds the histogram in src to dest */
+void CountsMerge(Counts *dest,
+		Counts *src)
+{
+	int64_t j;
+	for(j=0;NULL != src->counts && j<=src->maxCount;j++) {
+		if(0 < src->counts[j]) {
+			CountsAdd(dest, j, src->counts[j]);
+		}
+	}
+}
 
-	RGRangesFree(&ranges);
-	RGMatchFree(&match);
-	free(read);
-	read=NULL;
+/* TODO */
+void CountsFree(Counts *c)
+{
+	free(c->counts);
+	CountsInitialize(c);
+}
 
-	return 1;
+/* Prints the number of hash buckets holding each number of index entries */
+void PrintBucketOccupancy(RGIndex *index,
+		char *bucketsFileName)
+{
+	char *FnName="PrintBucketOccupancy";
+	FILE *fp=NULL;
+	int64_t i, start, end;
+	Counts c;
+
+	CountsInitialize(&c);
+	if(1 == RGIndexHasWideStarts(index)) {
+		/* Only the non-empty buckets are coded */
+		for(i=0;i<index->startsHashes.length;i++) {
+			start = RGIndexEliasFanoGet(&index->startsEntries, i);
+			end = RGIndexEliasFanoGet(&index->startsEntries, i+1);
+			CountsAdd(&c, end - start, 1);
+		}
+		CountsAdd(&c, 0, index->hashLength - index->startsHashes.length);
+	}
+	else {
+		/* Entries for each bucket, as in RGIndexGetIndex */
+		for(i=0;i<index->hashLength;i++) {
+			start = RGIndexGetStart(index, i);
+			end = (index->hashLength - 1 == i) ? index->length : GETMAX(start, RGIndexGetStart(index, i+1));
+			CountsAdd(&c, end - start, 1);
+		}
+	}
+
+	if(!(fp = fopen(bucketsFileName, "w"))) {
+		PrintError(FnName, bucketsFileName, "Could not open file for writing", Exit, OpenFileError);
+	}
+	fprintf(fp, "# Hash width was: %d\n", (int)index->hashWidth);
+	fprintf(fp, "# Number of buckets was: %lld\n", (long long int)index->hashLength);
+	fprintf(fp, "# Entries per bucket and number of buckets:\n");
+	for(i=0;i<=c.maxCount;i++) {
+		if(0 < c.counts[i]) {
+			fprintf(fp, "%lld\t%lld\n",
+					(long long int)i,
+					(long long int)c.counts[i]);
+		}
+	}
+	fclose(fp);
+
+	CountsFree(&c);
 }
@@ -5,9 +5,12 @@
 #include "../bfast/RGBinary.h"
 #include "../bfast/RGMatch.h"
 
+/* Four bits per base */
+#define BINDEXHIST_BASES_PER_WORD 16
+
 typedef struct {
-	int64_t **counts;
-	int64_t *maxCount;
+	int64_t *counts;
+	int64_t maxCount;
 } Counts;
 
 typedef struct {
@@ -17,7 +20,7 @@ typedef struct {
 	RGBinary *rg;
 	Counts c;
 	int whichStrand;
-	int numDifferent;
+	int64_t numDifferent;
 	int64_t totalForward;
 	int64_t totalReverse;
 	int threadID;
@@ -25,7 +28,14 @@ typedef struct {
 
 void PrintHistogram(RGIndex*, RGBinary*, int, int);
 void *PrintHistogramThread(void *arg);
+void GetKey(RGIndex*, RGBinary*, int64_t, uint64_t*, int32_t);
+int CompareKeys(uint64_t*, uint64_t*, int32_t);
 void GetPivots(RGIndex*, RGBinary*, int64_t*, int64_t*, int64_t);
-int GetMatchesFromContigPos(RGIndex*, RGBinary*, uint32_t, uint32_t, int64_t*, int64_t*);
+int64_t GetReverseMatches(RGIndex*, RGBinary*, uint32_t, uint32_t);
+void CountsInitialize(Counts*);
+void CountsAdd(Counts*, int64_t, int64_t);
+void CountsMerge(Counts*, Counts*);
+void CountsFree(Counts*);
+void PrintBucketOccupancy(RGIndex*, char*);
 
 #endif
@@ -0,0 +1,1027 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <config.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../bfast/BLibDefinitions.h"
+#include "../bfast/BError.h"
+#include "../bfast/BLib.h"
+#include "../bfast/RGBinary.h"
+#include "../bfast/RGIndex.h"
+#include "../bfast/RGMatch.h"
+#include "../bfast/AlignedEntry.h"
+#include "../bfast/AlignedEnd.h"
+#include "../bfast/AlignedRead.h"
+#include "../bfast/AlignedReadConvert.h"
+#include "../bfast/AlignMatrix.h"
+#include "../bfast/ScoringMatrix.h"
+#include "../bfast/Align.h"
+#include "../bfast/AlignColorSpace.h"
+#include "bkernelbench.h"
+
+#define Name "bkernelbench"
+
+/* Times the inner kernels in isolation.  Each kernel is run for a number
+ * of warmup repetitions and then for a number of timed repetitions, each
+ * over the same synthetic inputs created from the random number seed
+ * before the timing starts.  The spread of the rates over the repetitions
+ * is reported as percentiles.  Kernels in the same group are alternative
+ * implementations of the same thing: they are reported relative to the
+ * first kernel in the group and must give the same checksum.
+ *
+ * The index and reference kernels need a reference genome (-f) and an
+ * index (-i), for example made from bgeneratereads -g.  The packed index
+ * kernels search a second copy of the index with packed contigs and
+ * positions (see RGIndexPack).
+ *
+ * The alignment kernels share one generator of synthetic reads, each with
+ * a seed in its middle, a few mismatches and at most one short indel.  The
+ * constrained kernels align them filling in only the band and the whole 
+ * rectangle (see AlignSetBanded), so both the speed up and the identical 
+ * alignments of the band are checked.  Compare read lengths with -l.
+ * */
+
+Kernel Kernels[] = {
+	{"getindex", "getindex", "lookups", 1, 1, 0, KernelGetIndexCreate, KernelGetIndexRun},
+	{"getindex.packed", "getindex", "lookups", 1, 1, 0, KernelGetIndexCreate, KernelGetIndexPackedRun},
+	{"compareread", "compareread", "compares", 1, 1, 0, KernelCompareReadCreate, KernelCompareReadRun},
+	{"compareread.packed", "compareread", "compares", 1, 1, 0, KernelCompareReadCreate, KernelCompareReadPackedRun},
+	{"getsequence", "getsequence", "bases", 1, 0, 0, KernelGetSequenceCreate, KernelGetSequenceRun},
+	{"gapped", "gapped", "cells", 0, 0, 0, KernelAlignCreate, KernelGappedRun},
+	{"constrained", "constrained", "cells", 0, 0, 0, KernelAlignCreate, KernelConstrainedRun},
+	{"constrained.full", "constrained", "cells", 0, 0, 0, KernelAlignCreate, KernelConstrainedFullRun},
+	{"ungapped", "ungapped", "cells", 0, 0, 0, KernelAlignCreate, KernelUngappedRun},
+	{"ungapped.scalar", "ungapped", "cells", 0, 0, 0, KernelAlignCreate, KernelUngappedScalarRun},
+	{"removeduplicates", "removeduplicates", "entries", 0, 0, 0, KernelRemoveDuplicatesCreate, KernelRemoveDuplicatesRun},
+	{"printsam", "printsam", "records", 1, 0, 1, KernelPrintSAMCreate, KernelPrintSAMRun}
+};
+
+int PrintUsage()
+{
+	int32_t i;
+	fprintf(stderr, "%s %s\n", "bfast", PACKAGE_VERSION);
+	fprintf(stderr, "\nUsage:%s [options]\n", Name);
+	fprintf(stderr, "\t-f\tFILE\tSpecifies the file name of the FASTA reference genome\n");
+	fprintf(stderr, "\t-i\tFILE\tSpecifies the bfast index file name\n");
+	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
+	fprintf(stderr, "\t-k\tSTRING\tcomma separated list of kernels [%s]\n", BKERNELBENCH_DEFAULT_KERNELS);
+	fprintf(stderr, "\t\t\t\t");
+	for(i=0;i<sizeof(Kernels)/sizeof(Kernel);i++) {
+		fprintf(stderr, "%s%s", (0 == i) ? "" : ",", Kernels[i].name);
+	}
+	fprintf(stderr, "\n");
+	fprintf(stderr, "\t-l\tINT\tread length [%d]\n", BKERNELBENCH_DEFAULT_READ_LENGTH);
+	fprintf(stderr, "\t-n\tINT\tnumber of operations per repetition [%d]\n", BKERNELBENCH_DEFAULT_NUM_OPS);
+	fprintf(stderr, "\t-r\tINT\tnumber of timed repetitions [%d]\n", BKERNELBENCH_DEFAULT_REPETITIONS);
+	fprintf(stderr, "\t-w\tINT\tnumber of warmup repetitions [%d]\n", BKERNELBENCH_DEFAULT_WARMUP);
+	fprintf(stderr, "\t-o\tINT\toffset into the reference on either side of the read [%d]\n", OFFSET_LENGTH);
+	fprintf(stderr, "\t-s\tINT\trandom number seed [%d]\n", BKERNELBENCH_DEFAULT_SEED);
+	fprintf(stderr, "\t-x\tFILE\tSpecifies the file name storing the scoring matrix\n");
+	fprintf(stderr, "\t-h\t\tprints this help message\n");
+	fprintf(stderr, "\nsend bugs to %s\n",
+			PACKAGE_BUGREPORT);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	char *fastaFileName=NULL;
+	char *indexFileName=NULL;
+	char *kernelsString=NULL;
+	char *scoringMatrixFileName=NULL;
+	int32_t space=NTSpace, readLength=BKERNELBENCH_DEFAULT_READ_LENGTH;
+	int32_t numOps=BKERNELBENCH_DEFAULT_NUM_OPS, numRepetitions=BKERNELBENCH_DEFAULT_REPETITIONS;
+	int32_t numWarmup=BKERNELBENCH_DEFAULT_WARMUP, offset=OFFSET_LENGTH, seed=BKERNELBENCH_DEFAULT_SEED;
+	int32_t i, j, numKernels, groupStart;
+	Kernel *kernels[BKERNELBENCH_MAX_KERNELS];
+	double *rates=NULL;
+	double median, *groupMedians=NULL;
+	uint64_t checksum, *groupChecksums=NULL;
+	RGBinary rg;
+	RGIndex index, packedIndex;
+	ScoringMatrix sm;
+	AlignMatrix matrix;
+	KernelData data;
+	int c;
+
+	while((c = getopt(argc, argv, "f:i:k:l:n:o:r:s:w:x:A:h")) >= 0) {
+		switch(c) {
+			case 'f': fastaFileName=strdup(optarg); break;
+			case 'h': return PrintUsage();
+			case 'i': indexFileName=strdup(optarg); break;
+			case 'k': kernelsString=strdup(optarg); break;
+			case 'l': readLength=atoi(optarg); break;
+			case 'n': numOps=atoi(optarg); break;
+			case 'o': offset=atoi(optarg); break;
+			case 'r': numRepetitions=atoi(optarg); break;
+			case 's': seed=atoi(optarg); break;
+			case 'w': numWarmup=atoi(optarg); break;
+			case 'x': scoringMatrixFileName=strdup(optarg); break;
+			case 'A': space=atoi(optarg); break;
+			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
+		}
+	}
+
+	if(argc != optind) {
+		return PrintUsage();
+	}
+
+	if(NTSpace != space && ColorSpace != space) {
+		PrintError(Name, "space", "Command line option", Exit, InputArguments);
+	}
+	if(readLength <= 0 || SEQUENCE_LENGTH <= readLength + 2*offset) {
+		PrintError(Name, "readLength", "Command line option", Exit, InputArguments);
+	}
+	if(numOps <= 0) {
+		PrintError(Name, "numOps", "Command line option", Exit, InputArguments);
+	}
+	if(numRepetitions <= 0) {
+		PrintError(Name, "numRepetitions", "Command line option", Exit, InputArguments);
+	}
+	if(numWarmup < 0) {
+		PrintError(Name, "numWarmup", "Command line option", Exit, InputArguments);
+	}
+	if(offset <= 0) {
+		PrintError(Name, "offset", "Command line option", Exit, InputArguments);
+	}
+	if(NULL != indexFileName && NULL == fastaFileName) {
+		PrintError(Name, "fastaFileName", "An index requires the reference genome", Exit, InputArguments);
+	}
+	if(NULL == kernelsString) {
+		kernelsString=strdup(BKERNELBENCH_DEFAULT_KERNELS);
+	}
+
+	ScoringMatrixInitialize(&sm);
+	if(NULL != scoringMatrixFileName) {
+		ScoringMatrixRead(scoringMatrixFileName, &sm, space);
+	}
+	AlignMatrixInitialize(&matrix);
+	AlignMatrixReallocate(&matrix, readLength+1, readLength+2*offset+1);
+
+	KernelDataInitialize(&data);
+	data.sm = &sm;
+	data.matrix = &matrix;
+	data.space = space;
+	data.readLength = readLength;
+	data.offset = offset;
+	data.numOps = numOps;
+
+	if(NULL != fastaFileName) {
+		RGBinaryReadBinary(&rg, space, fastaFileName);
+		data.rg = &rg;
+	}
+	if(NULL != indexFileName) {
+		RGIndexRead(&index, indexFileName);
+		if(index.space != space) {
+			PrintError(Name, indexFileName, "The index is not in the given space", Exit, OutOfRange);
+		}
+		data.index = &index;
+		RGIndexRead(&packedIndex, indexFileName);
+		RGIndexPack(&packedIndex);
+		data.packedIndex = &packedIndex;
+	}
+
+	numKernels = KernelBenchGetKernels(kernelsString, kernels, space, data.rg, data.index);
+
+	rates = malloc(sizeof(double)*numRepetitions);
+	if(NULL == rates) {
+		PrintError(Name, "rates", "Could not allocate memory", Exit, MallocMemory);
+	}
+	groupMedians = malloc(sizeof(double)*numKernels);
+	if(NULL == groupMedians) {
+		PrintError(Name, "groupMedians", "Could not allocate memory", Exit, MallocMemory);
+	}
+	groupChecksums = malloc(sizeof(uint64_t)*numKernels);
+	if(NULL == groupChecksums) {
+		PrintError(Name, "groupChecksums", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	fprintf(stdout, "#kernel\tgroup\tunits\tops\trepetitions\tmin/sec\tp10/sec\tp50/sec\tp90/sec\tmax/sec\trelative\tchecksum\tcheck\n");
+	for(i=0;i<numKernels;i++) {
+		KernelBenchRun(kernels[i], &data, numWarmup, numRepetitions, seed, rates, &checksum);
+		median = KernelBenchGetPercentile(rates, numRepetitions, 0.5);
+
+		/* Compare with the first kernel in the group */
+		for(j=groupStart=0;j<i;j++) {
+			if(0 == strcmp(kernels[j]->group, kernels[i]->group)) {
+				groupStart = j;
+				break;
+			}
+		}
+		if(j == i) {
+			groupStart = i;
+		}
+		groupMedians[i] = median;
+		groupChecksums[i] = checksum;
+
+		fprintf(stdout, "%s\t%s\t%s\t%d\t%d\t%.4g\t%.4g\t%.4g\t%.4g\t%.4g\t%.3lf\t%016llx\t%s\n",
+				kernels[i]->name,
+				kernels[i]->group,
+				kernels[i]->units,
+				numOps,
+				numRepetitions,
+				KernelBenchGetPercentile(rates, numRepetitions, 0.0),
+				KernelBenchGetPercentile(rates, numRepetitions, 0.1),
+				median,
+				KernelBenchGetPercentile(rates, numRepetitions, 0.9),
+				KernelBenchGetPercentile(rates, numRepetitions, 1.0),
+				(0 < groupMedians[groupStart]) ? median/groupMedians[groupStart] : 0.0,
+				(unsigned long long int)checksum,
+				(checksum == groupChecksums[groupStart]) ? "ok" : "differs");
+		fflush(stdout);
+	}
+
+	/* Free */
+	free(rates);
+	free(groupMedians);
+	free(groupChecksums);
+	AlignMatrixFree(&matrix);
+	if(NULL != data.index) {
+		RGIndexDelete(&index);
+		RGIndexDelete(&packedIndex);
+	}
+	if(NULL != data.rg) {
+		RGBinaryDelete(&rg);
+	}
+	free(fastaFileName);
+	free(indexFileName);
+	free(kernelsString);
+	free(scoringMatrixFileName);
+
+	return 0;
+}
+
+/* TODO */
+void KernelDataInitialize(KernelData *d)
+{
+	d->rg = NULL;
+	d->index = NULL;
+	d->packedIndex = NULL;
+	d->sm = NULL;
+	d->matrix = NULL;
+	d->space = NTSpace;
+	d->readLength = 0;
+	d->offset = 0;
+	d->numOps = 0;
+	d->reads = NULL;
+	d->entries = NULL;
+	d->sequences = NULL;
+	d->colors = NULL;
+	d->masks = NULL;
+	d->references = NULL;
+	d->referenceLength = 0;
+	d->contigs = NULL;
+	d->positions = NULL;
+	d->matches = NULL;
+	d->alignedReads = NULL;
+	d->fp = NULL;
+}
+
+/* Frees the synthetic inputs, keeping the reference, index and settings */
+void KernelDataFree(KernelData *d)
+{
+	int32_t i;
+
+	for(i=0;i<d->numOps;i++) {
+		if(NULL != d->reads) free(d->reads[i]);
+		if(NULL != d->sequences) free(d->sequences[i]);
+		if(NULL != d->colors) free(d->colors[i]);
+		if(NULL != d->masks) free(d->masks[i]);
+		if(NULL != d->references) free(d->references[i]);
+		if(NULL != d->matches) RGMatchFree(&d->matches[i]);
+		if(NULL != d->alignedReads) AlignedReadFree(&d->alignedReads[i]);
+	}
+	free(d->reads);
+	free(d->entries);
+	free(d->sequences);
+	free(d->colors);
+	free(d->masks);
+	free(d->references);
+	free(d->contigs);
+	free(d->positions);
+	free(d->matches);
+	free(d->alignedReads);
+	d->reads = NULL;
+	d->entries = NULL;
+	d->sequences = d->colors = d->masks = d->references = NULL;
+	d->contigs = d->positions = NULL;
+	d->matches = NULL;
+	d->alignedReads = NULL;
+	d->referenceLength = 0;
+	if(NULL != d->fp) {
+		fclose(d->fp);
+		d->fp = NULL;
+	}
+}
+
+/* Gets the kernels from the comma separated list, "all" being every kernel
+ * that can be run with the given reference and index */
+int32_t KernelBenchGetKernels(char *kernelsString,
+		Kernel **kernels,
+		int32_t space,
+		RGBinary *rg,
+		RGIndex *index)
+{
+	char *FnName="KernelBenchGetKernels";
+	char *pch=NULL;
+	int32_t i, numKernels=0, all;
+
+	pch = strtok(kernelsString, ",");
+	while(NULL != pch) {
+		all = (0 == strcmp(pch, "all")) ? 1 : 0;
+		for(i=0;i<sizeof(Kernels)/sizeof(Kernel);i++) {
+			if(1 == all || 0 == strcmp(pch, Kernels[i].name)) {
+				if((1 == Kernels[i].needsReference && NULL == rg) ||
+						(1 == Kernels[i].needsIndex && NULL == index) ||
+						(1 == Kernels[i].needsNTSpace && NTSpace != space)) {
+					if(0 == all) {
+						PrintError(FnName, pch, "This kernel needs a reference genome (-f), an index (-i) or NT space", Exit, InputArguments);
+					}
+					continue;
+				}
+				if(BKERNELBENCH_MAX_KERNELS <= numKernels) {
+					PrintError(FnName, "numKernels", "Too many kernels", Exit, OutOfRange);
+				}
+				kernels[numKernels++] = &Kernels[i];
+				if(0 == all) {
+					break;
+				}
+			}
+		}
+		if(0 == all && (0 == numKernels || 0 != strcmp(pch, kernels[numKernels-1]->name))) {
+			PrintError(FnName, pch, "Could not understand kernel", Exit, InputArguments);
+		}
+		pch = strtok(NULL, ",");
+	}
+
+	return numKernels;
+}
+
+/* Runs the warmup and timed repetitions of a kernel, reseeding before
+ * each so that every repetition sees the same inputs */
+void KernelBenchRun(Kernel *k,
+		KernelData *d,
+		int32_t numWarmup,
+		int32_t numRepetitions,
+		int32_t seed,
+		double *rates,
+		uint64_t *checksum)
+{
+	char *FnName="KernelBenchRun";
+	int32_t i;
+	int64_t numUnits;
+	uint64_t c;
+	double startTime, seconds;
+
+	for(i=-numWarmup;i<numRepetitions;i++) {
+		srand(seed);
+		k->create(d);
+
+		numUnits = 0;
+		startTime = KernelBenchGetTime();
+		c = k->run(d, &numUnits);
+		seconds = KernelBenchGetTime() - startTime;
+
+		KernelDataFree(d);
+
+		if(-numWarmup == i) {
+			(*checksum) = c;
+		}
+		else if((*checksum) != c) {
+			PrintError(FnName, k->name, "The checksum differed between repetitions", Warn, OutOfRange);
+		}
+		if(0 <= i) {
+			rates[i] = (0 < seconds) ? numUnits/seconds : 0.0;
+		}
+	}
+	qsort(rates, numRepetitions, sizeof(double), KernelBenchCompareDoubles);
+}
+
+/* Gets the percentile of the sorted values, interpolating between them */
+double KernelBenchGetPercentile(double *values,
+		int32_t numValues,
+		double percentile)
+{
+	double position = percentile*(numValues - 1);
+	int32_t low = (int32_t)position;
+
+	if(numValues - 1 <= low) {
+		return values[numValues-1];
+	}
+	return values[low] + (position - low)*(values[low+1] - values[low]);
+}
+
+/* TODO */
+double KernelBenchGetTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+/* TODO */
+int KernelBenchCompareDoubles(const void *a, const void *b)
+{
+	double x = *((double*)a), y = *((double*)b);
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/* Gets the read at the given entry of the index */
+void KernelBenchGetIndexRead(KernelData *d,
+		int64_t entry,
+		int8_t *read)
+{
+	char *sequence=NULL;
+	int32_t returnLength, returnPosition;
+
+	RGBinaryGetReference(d->rg,
+			(d->index->contigType == Contig_8) ? d->index->contigs_8[entry] : d->index->contigs_32[entry],
+			d->index->positions[entry],
+			FORWARD,
+			0,
+			&sequence,
+			d->index->width,
+			&returnLength,
+			&returnPosition);
+	assert(returnLength == d->index->width);
+	ConvertSequenceToIntegers(sequence, read, d->index->width);
+	free(sequence);
+}
+
+/* Creates a reference and a read aligning in its middle.  The read
+ * carries a seed in its middle (the positions set in the mask), a few 
+ * mismatches and at most one short indel on either side of the seed, so
+ * that it can be aligned both with and without the constraint. */
+void KernelBenchGetAlignCase(KernelData *d,
+		int32_t i)
+{
+	char *FnName="KernelBenchGetAlignCase";
+	int32_t j, seedStart, indelType, indelLength, indelPosition, numMismatches;
+	int32_t colorsLength;
+	char *read=NULL, *reference=NULL, *mask=NULL;
+	char base;
+
+	d->referenceLength = d->readLength + 2*d->offset;
+	reference = d->references[i] = malloc(sizeof(char)*(d->referenceLength+1));
+	if(NULL == d->references[i]) {
+		PrintError(FnName, "d->references[i]", "Could not allocate memory", Exit, MallocMemory);
+	}
+	read = d->sequences[i] = malloc(sizeof(char)*(d->readLength+1));
+	if(NULL == d->sequences[i]) {
+		PrintError(FnName, "d->sequences[i]", "Could not allocate memory", Exit, MallocMemory);
+	}
+	mask = d->masks[i] = malloc(sizeof(char)*(d->readLength+1));
+	if(NULL == d->masks[i]) {
+		PrintError(FnName, "d->masks[i]", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(j=0;j<d->referenceLength;j++) {
+		reference[j] = DNA[rand()%4];
+	}
+	reference[d->referenceLength]='\0';
+
+	/* The seed sits in the middle of the read */
+	seedStart = (d->readLength - BKERNELBENCH_SEED_LENGTH)/2;
+	for(j=0;j<d->readLength;j++) {
+		mask[j] = (seedStart <= j && j < seedStart + BKERNELBENCH_SEED_LENGTH) ? '1' : '0';
+	}
+	mask[d->readLength]='\0';
+
+	/* 0: no indel 1: deletion 2: insertion, placed either before or after the seed */
+	indelType = rand()%3;
+	indelLength = 1 + rand()%BKERNELBENCH_MAX_INDEL_LENGTH;
+	if(d->offset < indelLength) {
+		indelLength = d->offset;
+	}
+	if(0 == rand()%2) {
+		/* After the seed */
+		indelPosition = seedStart + BKERNELBENCH_SEED_LENGTH + rand()%(d->readLength - seedStart - BKERNELBENCH_SEED_LENGTH);
+		for(j=0;j<d->readLength;j++) {
+			if(j < indelPosition || 0 == indelType) {
+				read[j] = reference[d->offset+j];
+			}
+			else if(1 == indelType) {
+				read[j] = reference[d->offset+j+indelLength];
+			}
+			else if(j < indelPosition + indelLength) {
+				read[j] = DNA[rand()%4];
+			}
+			else {
+				read[j] = reference[d->offset+j-indelLength];
+			}
+		}
+	}
+	else {
+		/* Before the seed, keeping the base preceding the seed so that
+		 * the first color of the seed also matches */
+		indelPosition = indelLength + rand()%(seedStart - indelLength);
+		for(j=0;j<d->readLength;j++) {
+			if(indelPosition <= j || 0 == indelType) {
+				read[j] = reference[d->offset+j];
+			}
+			else if(1 == indelType) {
+				read[j] = reference[d->offset+j-indelLength];
+			}
+			else if(indelPosition - indelLength <= j) {
+				read[j] = DNA[rand()%4];
+			}
+			else {
+				read[j] = reference[d->offset+j+indelLength];
+			}
+		}
+	}
+	read[d->readLength]='\0';
+
+	/* Add mismatches outside of the seed and the base preceding it */
+	numMismatches = d->readLength/BKERNELBENCH_MISMATCH_RATE;
+	for(j=0;j<numMismatches;j++) {
+		int32_t index = rand()%d->readLength;
+		if('1' != mask[index] && '1' != mask[index+1]) {
+			base = DNA[rand()%4];
+			while(base == read[index]) {
+				base = DNA[rand()%4];
+			}
+			read[index] = base;
+		}
+	}
+
+	/* Colors without the start base */
+	d->colors[i] = strdup(read);
+	if(NULL == d->colors[i]) {
+		PrintError(FnName, "d->colors[i]", "Could not allocate memory", Exit, MallocMemory);
+	}
+	colorsLength = d->readLength;
+	ConvertReadToColorSpace(&d->colors[i], &colorsLength);
+	for(j=0;j<d->readLength;j++) {
+		d->colors[i][j] = d->colors[i][j+1];
+	}
+	d->colors[i][d->readLength]='\0';
+}
+
+/* TODO */
+void KernelGetIndexCreate(KernelData *d)
+{
+	char *FnName="KernelGetIndexCreate";
+	int32_t i;
+
+	d->reads = malloc(sizeof(int8_t*)*d->numOps);
+	if(NULL == d->reads) {
+		PrintError(FnName, "d->reads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<d->numOps;i++) {
+		d->reads[i] = malloc(sizeof(int8_t)*d->index->width);
+		if(NULL == d->reads[i]) {
+			PrintError(FnName, "d->reads[i]", "Could not allocate memory", Exit, MallocMemory);
+		}
+		KernelBenchGetIndexRead(d, (((int64_t)rand())*RAND_MAX + rand()) % d->index->length, d->reads[i]);
+	}
+}
+
+/* TODO */
+uint64_t KernelGetIndexRun(KernelData *d,
+		int64_t *numUnits)
+{
+	return KernelGetIndexRunHelper(d, d->index, numUnits);
+}
+
+/* TODO */
+uint64_t KernelGetIndexPackedRun(KernelData *d,
+		int64_t *numUnits)
+{
+	return KernelGetIndexRunHelper(d, d->packedIndex, numUnits);
+}
+
+/* TODO */
+uint64_t KernelGetIndexRunHelper(KernelData *d,
+		RGIndex *index,
+		int64_t *numUnits)
+{
+	int32_t i;
+	int64_t startIndex, endIndex;
+	uint64_t checksum = 0;
+
+	for(i=0;i<d->numOps;i++) {
+		startIndex = endIndex = -1;
+		if(0 < RGIndexGetIndex(index, d->rg, d->reads[i], index->width, &startIndex, &endIndex)) {
+			checksum = checksum*1000003 + (endIndex - startIndex + 1);
+		}
+		else {
+			checksum = checksum*1000003;
+		}
+	}
+	(*numUnits) = d->numOps;
+	return checksum;
+}
+
+/* Reads are compared with an entry next to theirs in the index, so that
+ * most of the key is compared as when searching the index */
+void KernelCompareReadCreate(KernelData *d)
+{
+	char *FnName="KernelCompareReadCreate";
+	int32_t i;
+	int64_t entry;
+
+	d->reads = malloc(sizeof(int8_t*)*d->numOps);
+	if(NULL == d->reads) {
+		PrintError(FnName, "d->reads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	d->entries = malloc(sizeof(int64_t)*d->numOps);
+	if(NULL == d->entries) {
+		PrintError(FnName, "d->entries", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<d->numOps;i++) {
+		d->reads[i] = malloc(sizeof(int8_t)*d->index->width);
+		if(NULL == d->reads[i]) {
+			PrintError(FnName, "d->reads[i]", "Could not allocate memory", Exit, MallocMemory);
+		}
+		entry = (((int64_t)rand())*RAND_MAX + rand()) % d->index->length;
+		KernelBenchGetIndexRead(d, entry, d->reads[i]);
+		entry += rand()%3 - 1;
+		d->entries[i] = GETMIN(GETMAX(entry, 0), d->index->length - 1);
+	}
+}
+
+/* TODO */
+uint64_t KernelCompareReadRun(KernelData *d,
+		int64_t *numUnits)
+{
+	return KernelCompareReadRunHelper(d, d->index, numUnits);
+}
+
+/* TODO */
+uint64_t KernelCompareReadPackedRun(KernelData *d,
+		int64_t *numUnits)
+{
+	return KernelCompareReadRunHelper(d, d->packedIndex, numUnits);
+}
+
+/* TODO */
+uint64_t KernelCompareReadRunHelper(KernelData *d,
+		RGIndex *index,
+		int64_t *numUnits)
+{
+	int32_t i, cmp, numBasesEqual;
+	uint64_t checksum = 0;
+
+	for(i=0;i<d->numOps;i++) {
+		cmp = RGIndexCompareRead(index, d->rg, d->reads[i], d->entries[i], 0, &numBasesEqual, 0);
+		checksum = checksum*1000003 + (cmp + 1)*SEQUENCE_LENGTH + numBasesEqual;
+	}
+	(*numUnits) = d->numOps;
+	return checksum;
+}
+
+/* Gets the reference around a read, as when aligning */
+void KernelGetSequenceCreate(KernelData *d)
+{
+	char *FnName="KernelGetSequenceCreate";
+	int32_t i, contig, contigLength;
+
+	d->referenceLength = d->readLength + 2*d->offset;
+	d->contigs = malloc(sizeof(int32_t)*d->numOps);
+	if(NULL == d->contigs) {
+		PrintError(FnName, "d->contigs", "Could not allocate memory", Exit, MallocMemory);
+	}
+	d->positions = malloc(sizeof(int32_t)*d->numOps);
+	if(NULL == d->positions) {
+		PrintError(FnName, "d->positions", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<d->numOps;i++) {
+		do {
+			contig = 1 + rand()%d->rg->numContigs;
+			contigLength = d->rg->contigs[contig-1].sequenceLength;
+		} while(contigLength < d->referenceLength);
+		d->contigs[i] = contig;
+		d->positions[i] = 1 + rand()%(contigLength - d->referenceLength + 1);
+	}
+}
+
+/* TODO */
+uint64_t KernelGetSequenceRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, j;
+	char *sequence=NULL;
+	uint64_t checksum = 0;
+
+	for(i=0;i<d->numOps;i++) {
+		if(1 == RGBinaryGetSequence(d->rg, d->contigs[i], d->positions[i], FORWARD, &sequence, d->referenceLength)) {
+			for(j=0;j<d->referenceLength;j++) {
+				checksum = checksum*31 + sequence[j];
+			}
+			free(sequence);
+			sequence=NULL;
+		}
+	}
+	(*numUnits) = ((int64_t)d->numOps)*d->referenceLength;
+	return checksum;
+}
+
+/* TODO */
+void KernelAlignCreate(KernelData *d)
+{
+	char *FnName="KernelAlignCreate";
+	int32_t i;
+
+	if(d->readLength < 2*BKERNELBENCH_SEED_LENGTH) {
+		PrintError(FnName, "d->readLength", "The read length is too short for the alignment kernels", Exit, OutOfRange);
+	}
+	d->sequences = malloc(sizeof(char*)*d->numOps);
+	d->colors = malloc(sizeof(char*)*d->numOps);
+	d->masks = malloc(sizeof(char*)*d->numOps);
+	d->references = malloc(sizeof(char*)*d->numOps);
+	if(NULL == d->sequences || NULL == d->colors || NULL == d->masks || NULL == d->references) {
+		PrintError(FnName, "d->sequences", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<d->numOps;i++) {
+		KernelBenchGetAlignCase(d, i);
+	}
+}
+
+/* TODO */
+uint64_t KernelGappedRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, j;
+	uint64_t checksum = 0;
+	AlignedEntry a;
+
+	for(i=0;i<d->numOps;i++) {
+		AlignedEntryInitialize(&a);
+		AlignGapped(d->sequences[i],
+				d->colors[i],
+				NULL,
+				d->readLength,
+				d->references[i],
+				d->referenceLength,
+				Unconstrained,
+				d->sm,
+				&a,
+				d->matrix,
+				d->space,
+				d->offset,
+				0,
+				0,
+				1,
+				FORWARD,
+				NEGATIVE_INFINITY);
+		checksum = checksum*1000003 + (uint32_t)a.score;
+		checksum = checksum*1000003 + a.position;
+		/* The aligned read is packed two to a byte */
+		for(j=0;NULL != a.alnRead && j<a.alnReadLength/2 + 1;j++) {
+			checksum = checksum*31 + a.alnRead[j];
+		}
+		AlignedEntryFree(&a);
+	}
+	(*numUnits) = ((int64_t)d->numOps)*(d->readLength+1)*(d->referenceLength+1);
+	return checksum;
+}
+
+/* The constrained gapped alignment, filling in only the band */
+uint64_t KernelConstrainedRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, j;
+	uint64_t checksum = 0;
+	AlignedEntry a;
+
+	for(i=0;i<d->numOps;i++) {
+		AlignedEntryInitialize(&a);
+		AlignGappedConstrained(d->sequences[i],
+				d->colors[i],
+				d->masks[i],
+				d->readLength,
+				d->references[i],
+				d->referenceLength,
+				d->sm,
+				&a,
+				d->matrix,
+				d->space,
+				d->offset,
+				0,
+				0,
+				1,
+				FORWARD);
+		checksum = checksum*1000003 + (uint32_t)a.score;
+		checksum = checksum*1000003 + a.position;
+		checksum = checksum*1000003 + (uint32_t)a.alnReadLength;
+		/* The aligned read is packed two to a byte */
+		for(j=0;NULL != a.alnRead && j<a.alnReadLength/2 + 1;j++) {
+			checksum = checksum*31 + a.alnRead[j];
+		}
+		AlignedEntryFree(&a);
+	}
+	/* The cells of the whole rectangle, so that the rates compare */
+	(*numUnits) = ((int64_t)d->numOps)*(d->readLength+1)*(d->referenceLength+1);
+	return checksum;
+}
+
+/* The constrained gapped alignment, filling in the whole rectangle */
+uint64_t KernelConstrainedFullRun(KernelData *d,
+		int64_t *numUnits)
+{
+	uint64_t checksum;
+
+	AlignSetBanded(0);
+	checksum = KernelConstrainedRun(d, numUnits);
+	AlignSetBanded(1);
+	return checksum;
+}
+
+/* TODO */
+uint64_t KernelUngappedRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, numOffsets = d->referenceLength - d->readLength + 1;
+	uint64_t checksum = 0;
+	AlignedEntry a;
+
+	for(i=0;i<d->numOps;i++) {
+		AlignedEntryInitialize(&a);
+		if(1 == AlignColorSpaceUngapped(d->colors[i],
+					NULL,
+					d->readLength,
+					d->references[i],
+					d->referenceLength,
+					Unconstrained,
+					d->sm,
+					&a,
+					0,
+					1,
+					FORWARD)) {
+			checksum = checksum*1000003 + (uint32_t)a.score;
+			checksum = checksum*1000003 + a.position;
+		}
+		AlignedEntryFree(&a);
+	}
+	(*numUnits) = ((int64_t)d->numOps)*d->readLength*numOffsets;
+	return checksum;
+}
+
+/* Scores each starting position separately with the traceback, as
+ * before the starting positions were scored in lanes */
+uint64_t KernelUngappedScalarRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, j, score, maxScore, maxPosition, alphabetSize;
+	int32_t numOffsets = d->referenceLength - d->readLength + 1;
+	char maxNT[SEQUENCE_LENGTH];
+	uint64_t checksum = 0;
+
+	for(i=0;i<d->numOps;i++) {
+		alphabetSize = AlignColorSpaceGetAlphabetSize(d->colors[i], d->readLength, d->references[i], d->referenceLength);
+		maxScore = NEGATIVE_INFINITY;
+		maxPosition = -1;
+		for(j=0;j<numOffsets;j++) {
+			score = AlignColorSpaceUngappedTraceback(d->colors[i],
+					NULL,
+					d->readLength,
+					d->references[i] + j,
+					Unconstrained,
+					d->sm,
+					alphabetSize,
+					maxNT);
+			if(maxScore < score) {
+				maxScore = score;
+				maxPosition = 1 + j;
+			}
+		}
+		if(NEGATIVE_INFINITY < maxScore) {
+			checksum = checksum*1000003 + (uint32_t)maxScore;
+			checksum = checksum*1000003 + maxPosition;
+		}
+	}
+	(*numUnits) = ((int64_t)d->numOps)*d->readLength*numOffsets;
+	return checksum;
+}
+
+/* Matches with many duplicate entries, as from overlapping keys */
+void KernelRemoveDuplicatesCreate(KernelData *d)
+{
+	char *FnName="KernelRemoveDuplicatesCreate";
+	int32_t i, j;
+
+	d->matches = malloc(sizeof(RGMatch)*d->numOps);
+	if(NULL == d->matches) {
+		PrintError(FnName, "d->matches", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<d->numOps;i++) {
+		RGMatchInitialize(&d->matches[i]);
+		d->matches[i].readLength = d->readLength;
+		RGMatchAllocate(&d->matches[i], BKERNELBENCH_NUM_MATCH_ENTRIES);
+		for(j=0;j<BKERNELBENCH_NUM_MATCH_ENTRIES;j++) {
+			d->matches[i].contigs[j] = 1 + rand()%2;
+			d->matches[i].positions[j] = 1 + rand()%BKERNELBENCH_MATCH_POSITION_RANGE;
+			d->matches[i].strands[j] = (0 == rand()%2) ? FORWARD : REVERSE;
+			RGMatchUpdateMask(GETMASK(&d->matches[i], j), rand()%d->readLength);
+		}
+	}
+}
+
+/* TODO */
+uint64_t KernelRemoveDuplicatesRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i, j;
+	uint64_t checksum = 0;
+
+	for(i=0;i<d->numOps;i++) {
+		RGMatchRemoveDuplicates(&d->matches[i], INT_MAX);
+		for(j=0;j<d->matches[i].numEntries;j++) {
+			checksum = checksum*1000003 + d->matches[i].contigs[j];
+			checksum = checksum*1000003 + d->matches[i].positions[j];
+			checksum = checksum*1000003 + d->matches[i].strands[j];
+		}
+	}
+	(*numUnits) = ((int64_t)d->numOps)*BKERNELBENCH_NUM_MATCH_ENTRIES;
+	return checksum;
+}
+
+/* Reads aligned without gaps with a few mismatches */
+void KernelPrintSAMCreate(KernelData *d)
+{
+	char *FnName="KernelPrintSAMCreate";
+	int32_t i, j, contig, contigLength, position;
+	char readName[SEQUENCE_LENGTH]="\0";
+	char qual[SEQUENCE_LENGTH]="\0";
+	char *reference=NULL;
+	char read[SEQUENCE_LENGTH]="\0";
+	AlignedEnd *end=NULL;
+
+	d->alignedReads = malloc(sizeof(AlignedRead)*d->numOps);
+	if(NULL == d->alignedReads) {
+		PrintError(FnName, "d->alignedReads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(j=0;j<d->readLength;j++) {
+		qual[j] = BKERNELBENCH_QUAL;
+	}
+	qual[d->readLength]='\0';
+
+	for(i=0;i<d->numOps;i++) {
+		do {
+			contig = 1 + rand()%d->rg->numContigs;
+			contigLength = d->rg->contigs[contig-1].sequenceLength;
+		} while(contigLength < d->readLength);
+		position = 1 + rand()%(contigLength - d->readLength + 1);
+
+		reference=NULL;
+		if(0 == RGBinaryGetSequence(d->rg, contig, position, FORWARD, &reference, d->readLength)) {
+			PrintError(FnName, "reference", "Could not get the reference", Exit, OutOfRange);
+		}
+		for(j=0;j<d->readLength;j++) {
+			reference[j] = ToUpper(reference[j]);
+			read[j] = (0 == rand()%BKERNELBENCH_MISMATCH_RATE) ? DNA[rand()%4] : reference[j];
+		}
+		read[d->readLength]='\0';
+
+		sprintf(readName, "read%d", i+1);
+		AlignedReadInitialize(&d->alignedReads[i]);
+		AlignedReadAllocate(&d->alignedReads[i], readName, 1, NTSpace);
+		end = &d->alignedReads[i].ends[0];
+		AlignedEndInitialize(end);
+		AlignedEndAllocate(end, read, qual, 1);
+		end->entries[0].contig = contig;
+		end->entries[0].strand = FORWARD;
+		end->entries[0].mappingQuality = 255;
+		AlignedEntryUpdateAlignment(&end->entries[0],
+				position,
+				d->readLength,
+				d->readLength,
+				d->readLength,
+				read,
+				reference);
+		free(reference);
+	}
+
+	d->fp = tmpfile();
+	if(NULL == d->fp) {
+		PrintError(FnName, "d->fp", "Could not open a temporary file", Exit, OpenFileError);
+	}
+}
+
+/* TODO */
+uint64_t KernelPrintSAMRun(KernelData *d,
+		int64_t *numUnits)
+{
+	int32_t i;
+
+	for(i=0;i<d->numOps;i++) {
+		AlignedReadConvertPrintSAM(&d->alignedReads[i],
+				d->rg,
+				BestScore,
+				NULL,
+				"",
+				NULL,
+				0,
+				0,
+				d->fp);
+	}
+	fflush(d->fp);
+	(*numUnits) = d->numOps;
+	/* The number of bytes written */
+	return (uint64_t)ftell(d->fp);
+}
@@ -0,0 +1,88 @@
+#ifndef BKERNELBENCH_H_
+#define BKERNELBENCH_H_
+
+#define BKERNELBENCH_DEFAULT_KERNELS "all"
+#define BKERNELBENCH_DEFAULT_NUM_OPS 10000
+#define BKERNELBENCH_DEFAULT_REPETITIONS 20
+#define BKERNELBENCH_DEFAULT_WARMUP 2
+#define BKERNELBENCH_DEFAULT_SEED 1
+#define BKERNELBENCH_DEFAULT_READ_LENGTH 50
+#define BKERNELBENCH_MAX_KERNELS 64
+#define BKERNELBENCH_NUM_MATCH_ENTRIES 64
+#define BKERNELBENCH_MATCH_POSITION_RANGE 256
+#define BKERNELBENCH_MISMATCH_RATE 25
+#define BKERNELBENCH_SEED_LENGTH 12
+#define BKERNELBENCH_MAX_INDEL_LENGTH 5
+#define BKERNELBENCH_QUAL 'I'
+
+/* The inputs to a kernel, created before each repetition */
+typedef struct {
+	RGBinary *rg;
+	RGIndex *index;
+	RGIndex *packedIndex; /* the same index, packed */
+	ScoringMatrix *sm;
+	AlignMatrix *matrix;
+	int32_t space;
+	int32_t readLength;
+	int32_t offset;
+	int32_t numOps;
+	/* Synthetic inputs */
+	int8_t **reads;
+	int64_t *entries;
+	char **sequences;
+	char **colors;
+	char **masks;
+	char **references;
+	int32_t referenceLength;
+	int32_t *contigs;
+	int32_t *positions;
+	RGMatch *matches;
+	AlignedRead *alignedReads;
+	FILE *fp;
+} KernelData;
+
+/* A kernel, where kernels in the same group are alternatives that should
+ * give the same checksum */
+typedef struct {
+	char *name;
+	char *group;
+	char *units;
+	int32_t needsReference;
+	int32_t needsIndex;
+	int32_t needsNTSpace;
+	void (*create)(KernelData*);
+	uint64_t (*run)(KernelData*, int64_t*);
+} Kernel;
+
+void KernelDataInitialize(KernelData*);
+void KernelDataFree(KernelData*);
+int32_t KernelBenchGetKernels(char*, Kernel**, int32_t, RGBinary*, RGIndex*);
+void KernelBenchRun(Kernel*, KernelData*, int32_t, int32_t, int32_t, double*, uint64_t*);
+double KernelBenchGetPercentile(double*, int32_t, double);
+double KernelBenchGetTime();
+int KernelBenchCompareDoubles(const void*, const void*);
+void KernelBenchGetIndexRead(KernelData*, int64_t, int8_t*);
+void KernelBenchGetAlignCase(KernelData*, int32_t);
+/* Kernels */
+void KernelGetIndexCreate(KernelData*);
+uint64_t KernelGetIndexRun(KernelData*, int64_t*);
+uint64_t KernelGetIndexPackedRun(KernelData*, int64_t*);
+uint64_t KernelGetIndexRunHelper(KernelData*, RGIndex*, int64_t*);
+void KernelCompareReadCreate(KernelData*);
+uint64_t KernelCompareReadRun(KernelData*, int64_t*);
+uint64_t KernelCompareReadPackedRun(KernelData*, int64_t*);
+uint64_t KernelCompareReadRunHelper(KernelData*, RGIndex*, int64_t*);
+void KernelGetSequenceCreate(KernelData*);
+uint64_t KernelGetSequenceRun(KernelData*, int64_t*);
+void KernelAlignCreate(KernelData*);
+uint64_t KernelGappedRun(KernelData*, int64_t*);
+uint64_t KernelConstrainedRun(KernelData*, int64_t*);
+uint64_t KernelConstrainedFullRun(KernelData*, int64_t*);
+uint64_t KernelUngappedRun(KernelData*, int64_t*);
+uint64_t KernelUngappedScalarRun(KernelData*, int64_t*);
+void KernelRemoveDuplicatesCreate(KernelData*);
+uint64_t KernelRemoveDuplicatesRun(KernelData*, int64_t*);
+void KernelPrintSAMCreate(KernelData*);
+uint64_t KernelPrintSAMRun(KernelData*, int64_t*);
+
+#endif
@@ -4,7 +4,8 @@
 #include <string.h>
 #include <config.h>
 #include <limits.h>
-#include <unistd.h>  
+#include <pthread.h>
+#include <unistd.h>
 
 #include "../bfast/BLibDefinitions.h"
 #include "../bfast/BError.h"
@@ -16,6 +17,14 @@
 
 /* Finds all contiguous repeats in the genome specified by the index that fall within the
  * specified unit length range and minimum contiguous length.
+ *
+ * Each contig is split into segments that are scanned by separate threads.
+ * For each unit length, the number of bases that agree with the base one
+ * unit length further on is tracked as we move along the contig, so that
+ * the repeat starting at each position is found in constant time per
+ * unit length.  The sequence is compared sixteen bases at a time.
+ * The repeats found in each segment are printed in order, using the last
+ * repeat of the previous segment to drop overlapping repeats.
  * */
 
 int PrintUsage()
@@ -26,33 +35,39 @@ int PrintUsage()
 	fprintf(stderr, "\t-m\tINT\tMinimum unit length\n");
 	fprintf(stderr, "\t-M\tINT\tMaximum unit length\n");
 	fprintf(stderr, "\t-r\tINT\tMinimum total repeat length\n");
+	fprintf(stderr, "\t-n\tINT\tSpecifies the number of threads to use (Default 1)\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
 			PACKAGE_BUGREPORT);
 	return 1;
 }
 
-int main(int argc, char *argv[]) 
+int main(int argc, char *argv[])
 {
+	char *FnName="main";
 	FILE *fp;
 	char *fastaFileName=NULL;
 	int minUnitLength=-1, maxUnitLength=-1;
 	int minLength=-1;
-	char unit[MAX_UNIT_LENGTH+1]="\0";
+	int numThreads=1;
 	RGBinary rg;
-	int c;
+	int c, i, j, errCode;
+	pthread_t *threads=NULL;
+	ThreadData *data=NULL;
+	void *status=NULL;
 
-	while((c = getopt(argc, argv, "f:m:r:M:h")) >= 0) {
+	while((c = getopt(argc, argv, "f:m:n:r:M:h")) >= 0) {
 		switch(c) {
 			case 'f': fastaFileName=strdup(optarg); break;
 			case 'h': return PrintUsage();
-			case 'm': minUnitLength=atoi(optarg); break; 
-			case 'M': maxUnitLength=atoi(optarg); break; 
+			case 'm': minUnitLength=atoi(optarg); break;
+			case 'M': maxUnitLength=atoi(optarg); break;
+			case 'n': numThreads=atoi(optarg); break;
 			case 'r': minLength=atoi(optarg); break;
 			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
 		}
 	}
-	
+
 	if(1 == argc || argc != optind) {
 		return PrintUsage();
 	}
@@ -69,6 +84,9 @@ int main(int argc, char *argv[])
 	if(minLength <= 0) {
 		PrintError(Name, "minLength", "Command line option", Exit, InputArguments);
 	}
+	if(numThreads <= 0) {
+		PrintError(Name, "numThreads", "Command line option", Exit, InputArguments);
+	}
 
 	assert(minUnitLength <= maxUnitLength);
 	assert(maxUnitLength <= MAX_UNIT_LENGTH);
@@ -79,6 +97,27 @@ int main(int argc, char *argv[])
 
 	/* Read in the rg binary file */
 	RGBinaryReadBinary(&rg, NTSpace, fastaFileName);
+	if(RGBinaryPacked != rg.packed) {
+		PrintError(Name, "rg.packed", "The reference genome must be packed", Exit, OutOfRange);
+	}
+
+	/* Allocate memory for threads */
+	threads=malloc(sizeof(pthread_t)*numThreads);
+	if(NULL==threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	/* Allocate memory to pass data to threads */
+	data=malloc(sizeof(ThreadData)*numThreads);
+	if(NULL==data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numThreads;i++) {
+		data[i].minUnitLength = minUnitLength;
+		data[i].maxUnitLength = maxUnitLength;
+		data[i].minLength = minLength;
+		data[i].repeats = NULL;
+		data[i].numRepeats = data[i].maxNumRepeats = 0;
+	}
 
 	fprintf(stderr, "Currently on:\n%2d %9d", -1, -1);
 	/* For each contig */
@@ -86,100 +125,80 @@ int main(int argc, char *argv[])
 	for(curContig=1, curContigIndex=0;
 			curContig <= rg.numContigs && curContigIndex < rg.numContigs;
 			curContig++, curContigIndex++) {
-		/* For each starting position */
-		int curPos;
+		int32_t sequenceLength = rg.contigs[curContigIndex].sequenceLength;
+		int32_t startPos, numActive;
+		uint64_t *words = BRepeatPackContig(&rg, curContig);
 		int prevBestUnitLength=-1;
 		int prevBestStart=-1;
 		int prevBestLength=-1;
 		int prevBestEnd=-1;
-		for(curPos=1;
-				curPos <= rg.contigs[curContigIndex].sequenceLength;
-				curPos++) {
-			if(curPos%BREPEAT_ROTATE_NUM==0) {
-				fprintf(stderr, "\r%2d %9d",
-						curContig,
-						curPos);
-			}
-
-			if(ToLower(RGBinaryGetBase(&rg, curContig, curPos)) != 'n') {
-
-				/* For each unit length */
-				int bestEnd=-1;
-				char bestUnit[MAX_UNIT_LENGTH+1]="\0";
-				int bestUnitLength=-1;
-				int curUnitLength;
-				for(curUnitLength=minUnitLength;curUnitLength<=maxUnitLength;curUnitLength++) { /* For each unit length */
-					/* Check bounds */
-					if(curPos + curUnitLength - 1 <= rg.contigs[curContigIndex].sequenceLength) {
-						/* Get the current unit */
-						int i;
-						for(i=0;i<curUnitLength;i++) {
-							unit[i] = ToLower(RGBinaryGetBase(&rg,
-										curContig,
-										curPos+i));
-						}
-						unit[curUnitLength]='\0';
-						int end = curPos+curUnitLength-1;
-
-						/* extend the unit */
-						int cont=1;
-						int curStart;
-						for(curStart=curPos + curUnitLength;cont==1 && curStart <= rg.contigs[curContigIndex].sequenceLength-curUnitLength+1;curStart+=curUnitLength) {
-							/* Check that the bases match cur */
-							int j;
-							for(j=0;j<curUnitLength;j++) {
-								if(unit[j] != ToLower(RGBinaryGetBase(&rg, curContig, curStart+j))) {
-									cont = 0;
-								}
-							}
-							if(cont == 1) {
-								end = curStart+curUnitLength-1;
-							}
-						}
-
-						if(end-curPos+1 >= minLength && 
-								(end - curPos +1 ) > curUnitLength && 
-								(bestEnd <= 0 || end-curPos+1 > (bestEnd - curPos + 1))) {
-							bestEnd = end;
-							strcpy(bestUnit, unit);
-							bestUnitLength = curUnitLength;
-						}
-					}
 
+		/* Scan numThreads segments at a time */
+		for(startPos=0;startPos<sequenceLength;startPos+=numThreads*BREPEAT_SEGMENT_LENGTH) {
+			for(i=numActive=0;i<numThreads && startPos + i*BREPEAT_SEGMENT_LENGTH < sequenceLength;i++,numActive++) {
+				data[i].words = words;
+				data[i].sequenceLength = sequenceLength;
+				data[i].startPos = startPos + i*BREPEAT_SEGMENT_LENGTH;
+				data[i].endPos = GETMIN(data[i].startPos + BREPEAT_SEGMENT_LENGTH, sequenceLength);
+				/* Start thread */
+				errCode = pthread_create(&threads[i], /* thread struct */
+						NULL, /* default thread attributes */
+						BRepeatFindRepeats, /* start routine */
+						&data[i]); /* data to routine */
+				if(0!=errCode) {
+					PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
 				}
-				if(bestEnd > 0 && 
-						bestUnitLength < (bestEnd - curPos + 1)) {
-					assert(bestEnd-curPos+1 >= minLength);
+			}
+			/* Wait for threads to return */
+			for(i=0;i<numActive;i++) {
+				/* Wait for the given thread to return */
+				errCode = pthread_join(threads[i],
+						&status);
+				/* Check the return code of the thread */
+				if(0!=errCode) {
+					PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+				}
+			}
+
+			/* Print the repeats in order */
+			for(i=0;i<numActive;i++) {
+				for(j=0;j<data[i].numRepeats;j++) {
+					Repeat *r = &data[i].repeats[j];
+					int curPos = r->position;
+					int bestEnd = r->position + r->length - 1;
 
 					if(curPos == prevBestStart + 1 &&
-							prevBestUnitLength == bestUnitLength && 
-							prevBestLength == (bestEnd-curPos+1)) {
+							prevBestUnitLength == r->unitLength &&
+							prevBestLength == r->length) {
 						/* Skip */
 					}
 					else if(bestEnd <= prevBestEnd) {
 						/* Skip */
 					}
 					else {
-						fprintf(fp, "contig%d:%d-%d\t%d\t%d\t%s\n",
-								curContig,
-								curPos,
-								bestEnd,
-								bestEnd-curPos+1,
-								bestUnitLength,
-								bestUnit);
-						fflush(fp);
+						BRepeatPrintRepeat(fp, words, curContig, r);
 					}
-					prevBestUnitLength = bestUnitLength;
+					prevBestUnitLength = r->unitLength;
 					prevBestStart = curPos;
-					prevBestLength = bestEnd-curPos+1;
+					prevBestLength = r->length;
 					prevBestEnd = bestEnd;
 				}
+				fprintf(stderr, "\r%2d %9d",
+						curContig,
+						data[i].endPos);
 			}
+			fflush(fp);
 		}
+		free(words);
 	}
 
 	fprintf(stderr, "\n%s", BREAK_LINE);
 	fprintf(stderr, "Cleaning up.\n");
+	for(i=0;i<numThreads;i++) {
+		free(data[i].repeats);
+	}
+	free(data);
+	free(threads);
 	/* Delete the rg */
 	RGBinaryDelete(&rg);
 	fclose(fp);
@@ -189,3 +208,170 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+/* Packs the contig into four bits per base, ignoring case, with
+ * two words of padding so that a word can be read at any position */
+uint64_t *BRepeatPackContig(RGBinary *rg,
+		int32_t contig)
+{
+	char *FnName="BRepeatPackContig";
+	int32_t i, numWords;
+	int32_t sequenceLength = rg->contigs[contig-1].sequenceLength;
+	uint8_t *sequence = (uint8_t*)rg->contigs[contig-1].sequence;
+	uint64_t *words=NULL;
+
+	numWords = sequenceLength/BREPEAT_BASES_PER_WORD + 2;
+	words = calloc(numWords, sizeof(uint64_t));
+	if(NULL == words) {
+		PrintError(FnName, "words", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Two bases per byte, the first in the left-most four bits.  The
+	 * repeat bit is cleared so that only the base, or N, remains. */
+	for(i=0;i<sequenceLength;i++) {
+		uint64_t code = (0 == (i & 1)) ? (sequence[i/2] >> 4) : (sequence[i/2] & 0x0F);
+		code &= 0x0B;
+		words[i/BREPEAT_BASES_PER_WORD] |= code << (4*(i%BREPEAT_BASES_PER_WORD));
+	}
+
+	return words;
+}
+
+/* Returns the sixteen bases starting at the given position */
+uint64_t BRepeatGetWord(uint64_t *words,
+		int32_t position)
+{
+	int32_t index = position/BREPEAT_BASES_PER_WORD;
+	int32_t shift = 4*(position%BREPEAT_BASES_PER_WORD);
+
+	if(0 == shift) {
+		return words[index];
+	}
+	return (words[index] >> shift) | (words[index+1] << (64 - shift));
+}
+
+/* Returns the number of consecutive bases starting at the given position
+ * that are the same as the base one unit length further on */
+int32_t BRepeatRunLength(uint64_t *words,
+		int32_t sequenceLength,
+		int32_t position,
+		int32_t unitLength)
+{
+	int32_t runLength = 0;
+	int32_t maxRunLength = sequenceLength - position - unitLength;
+	uint64_t x;
+
+	while(runLength < maxRunLength) {
+		x = BRepeatGetWord(words, position + runLength) ^ BRepeatGetWord(words, position + unitLength + runLength);
+		if(0 == x) {
+			runLength += BREPEAT_BASES_PER_WORD;
+		}
+		else {
+			/* Add the bases before the first that differs */
+			x |= (x >> 1);
+			x |= (x >> 2);
+			x &= 0x1111111111111111ULL;
+#ifdef __GNUC__
+			runLength += __builtin_ctzll(x)/4;
+#else
+			while(0 == (x & 0x01)) {
+				runLength++;
+				x >>= 4;
+			}
+#endif
+			break;
+		}
+	}
+	return GETMAX(0, GETMIN(runLength, maxRunLength));
+}
+
+/* Finds the longest repeat starting at each position of a segment,
+ * preferring the shortest unit length */
+void *BRepeatFindRepeats(void *arg)
+{
+	char *FnName="BRepeatFindRepeats";
+	ThreadData *data = (ThreadData*)arg;
+	int32_t curPos, curUnitLength, numUnitLengths;
+	int32_t *runLengths=NULL;
+
+	numUnitLengths = data->maxUnitLength - data->minUnitLength + 1;
+	runLengths = malloc(sizeof(int32_t)*numUnitLengths);
+	if(NULL == runLengths) {
+		PrintError(FnName, "runLengths", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	data->numRepeats = 0;
+	for(curPos=data->startPos;curPos<data->endPos;curPos++) {
+		int32_t bestLength=-1, bestUnitLength=-1;
+
+		for(curUnitLength=data->minUnitLength;curUnitLength<=data->maxUnitLength;curUnitLength++) {
+			int32_t *runLength = &runLengths[curUnitLength - data->minUnitLength];
+			/* The run from the previous position continues here */
+			if(data->startPos < curPos && 0 < (*runLength)) {
+				(*runLength)--;
+			}
+			else {
+				(*runLength) = BRepeatRunLength(data->words, data->sequenceLength, curPos, curUnitLength);
+			}
+		}
+
+		if(BREPEAT_BASE_N == ((data->words[curPos/BREPEAT_BASES_PER_WORD] >> (4*(curPos%BREPEAT_BASES_PER_WORD))) & 0x0F)) {
+			continue;
+		}
+
+		for(curUnitLength=data->minUnitLength;curUnitLength<=data->maxUnitLength;curUnitLength++) {
+			int32_t runLength = runLengths[curUnitLength - data->minUnitLength];
+			/* At least two complete copies of the unit */
+			if(curPos + curUnitLength <= data->sequenceLength &&
+					curUnitLength <= runLength) {
+				int32_t length = (1 + runLength/curUnitLength)*curUnitLength;
+				if(data->minLength <= length && bestLength < length) {
+					bestLength = length;
+					bestUnitLength = curUnitLength;
+				}
+			}
+		}
+
+		if(0 < bestLength) {
+			if(data->maxNumRepeats <= data->numRepeats) {
+				data->maxNumRepeats = GETMAX(1024, 2*data->maxNumRepeats);
+				data->repeats = realloc(data->repeats, sizeof(Repeat)*data->maxNumRepeats);
+				if(NULL == data->repeats) {
+					PrintError(FnName, "data->repeats", "Could not reallocate memory", Exit, ReallocMemory);
+				}
+			}
+			data->repeats[data->numRepeats].position = curPos + 1;
+			data->repeats[data->numRepeats].length = bestLength;
+			data->repeats[data->numRepeats].unitLength = bestUnitLength;
+			data->numRepeats++;
+		}
+	}
+
+	free(runLengths);
+
+	return arg;
+}
+
+/* TODO */
+void BRepeatPrintRepeat(FILE *fp,
+		uint64_t *words,
+		int32_t contig,
+		Repeat *r)
+{
+	int32_t i;
+	char unit[MAX_UNIT_LENGTH+1]="\0";
+
+	for(i=0;i<r->unitLength;i++) {
+		int32_t pos = r->position - 1 + i;
+		uint8_t code = (words[pos/BREPEAT_BASES_PER_WORD] >> (4*(pos%BREPEAT_BASES_PER_WORD))) & 0x0F;
+		unit[i] = (BREPEAT_BASE_N == code) ? 'n' : "acgt"[code & 0x03];
+	}
+	unit[r->unitLength]='\0';
+
+	fprintf(fp, "contig%d:%d-%d\t%d\t%d\t%s\n",
+			contig,
+			r->position,
+			r->position + r->length - 1,
+			r->length,
+			r->unitLength,
+			unit);
+}
@@ -2,6 +2,35 @@
 #define BREPEAT_H_
 
 #define MAX_UNIT_LENGTH 2048
-#define BREPEAT_ROTATE_NUM 1000
+/* Positions scanned by one thread at a time, a multiple of BREPEAT_BASES_PER_WORD */
+#define BREPEAT_SEGMENT_LENGTH 1048576
+/* Four bits per base */
+#define BREPEAT_BASES_PER_WORD 16
+#define BREPEAT_BASE_N 0x08
+
+typedef struct {
+	int32_t position;
+	int32_t length;
+	int32_t unitLength;
+} Repeat;
+
+typedef struct {
+	uint64_t *words;
+	int32_t sequenceLength;
+	int32_t startPos;
+	int32_t endPos;
+	int32_t minUnitLength;
+	int32_t maxUnitLength;
+	int32_t minLength;
+	Repeat *repeats;
+	int32_t numRepeats;
+	int32_t maxNumRepeats;
+} ThreadData;
+
+uint64_t *BRepeatPackContig(RGBinary*, int32_t);
+uint64_t BRepeatGetWord(uint64_t*, int32_t);
+int32_t BRepeatRunLength(uint64_t*, int32_t, int32_t, int32_t);
+void *BRepeatFindRepeats(void*);
+void BRepeatPrintRepeat(FILE*, uint64_t*, int32_t, Repeat*);
 
 #endif
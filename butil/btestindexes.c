@@ -34,6 +34,8 @@ void PrintUsage()
 	fprintf(stderr, "\t-w\tINT\tmaximum key width\n");
 	fprintf(stderr, "\t-n\tINT\tmaximum index set size\n");
 	fprintf(stderr, "\t-t\tINT\taccuracy percent threshold (0-100)\n");
+	fprintf(stderr, "\t-T\tINT\tnumber of threads (default 1)\n");
+	fprintf(stderr, "\t-R\tINT\trandom number seed (default from the time)\n");
 	fprintf(stderr, "******************************* Evaluate Options (for -a 1) ***********************************\n");
 	fprintf(stderr, "\t-f\tSTRING\tinput file name\n");
 	fprintf(stderr, "\t-I\tINT\tmaximum insertion length (-a 1)\n");
@@ -61,6 +63,8 @@ void PrintProgramParameters(arguments *args)
 	fprintf(stderr, "key width:\t\t\t%d\n", args->maxKeyWidth);
 	fprintf(stderr, "max index set size:\t\t%d\n", args->maxIndexSetSize);
 	fprintf(stderr, "accuracy percent threshold:\t%d\n", args->accuracyThreshold);
+	fprintf(stderr, "number of threads:\t\t%d\n", args->numThreads);
+	fprintf(stderr, "random number seed:\t\t%d\n", args->seed);
 	fprintf(stderr, "input file name:\t\t%s\n", args->inputFileName);
 	fprintf(stderr, "maximum insertion length:\t%d\n", args->maxInsertionLength);
 	fprintf(stderr, "maximum number of mismatches:\t%d\n", args->maxNumMismatches);
@@ -79,6 +83,8 @@ void AssignDefaultValues(arguments *args)
 	args->maxKeyWidth=0;
 	args->maxIndexSetSize=0;
 	args->accuracyThreshold=0;
+	args->numThreads=1;
+	args->seed=-1;
 	args->space=0;
 	args->maxNumMismatches=0;
 	args->maxInsertionLength=0;
@@ -99,6 +105,9 @@ void ValidateArguments(arguments *args)
 			PrintError(FnName, "Command line argument", "keySize", Exit, OutOfRange);		}		if(args->maxKeyWidth <= 0) {			PrintError(FnName, "Command line argument", "maxKeyWidth", Exit, OutOfRange);		}
 		if(args->maxIndexSetSize <= 0) {
 			PrintError(FnName, "Command line argument", "maxIndexSetSize", Exit, OutOfRange);		}		if(args->accuracyThreshold < 0) {			PrintError(FnName, "Command line argument", "accuracyThreshold", Exit, OutOfRange);		}
+		if(args->numThreads <= 0) {
+			PrintError(FnName, "Command line argument", "numThreads", Exit, OutOfRange);
+		}
 		if(args->keySize > args->maxKeyWidth) {
 			PrintError(FnName, "Command line argument", "keySize > maxKeyWidth", Exit, OutOfRange);		}		if(args->keySize > args->readLength) {			PrintError(FnName, "Command line argument", "keySize > readLength", Exit, OutOfRange);		}
 		if(args->maxKeyWidth > args->readLength) {
@@ -165,9 +174,15 @@ void ParseCommandLineArguments(int argc, char *argv[], arguments *args)
 			case 'S':
 				args->numEventsToSample = atoi(argv[i+1]);
 				break;
+			case 'R':
+				args->seed = atoi(argv[i+1]);
+				break;
 			case 't':
 				args->accuracyThreshold = atoi(argv[i+1]);
 				break;
+			case 'T':
+				args->numThreads = atoi(argv[i+1]);
+				break;
 			case 'w':
 				args->maxKeyWidth = atoi(argv[i+1]);
 				break;
@@ -209,7 +224,9 @@ int main(int argc, char *argv[])
 					args.accuracyThreshold,
 					args.space,
 					args.maxNumMismatches,
-					args.maxNumColorErrors);
+					args.maxNumColorErrors,
+					args.numThreads,
+					args.seed);
 			break;
 		case EvaluateRGIndexAccuracies:
 			RunEvaluateRGIndexAccuracies(args.inputFileName,
@@ -13,6 +13,8 @@ typedef struct {
 	int maxKeyWidth;
 	int maxIndexSetSize;
 	int accuracyThreshold;
+	int numThreads;
+	int seed;
 	int space;
 	int maxNumMismatches;
 	int maxInsertionLength;
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <config.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "../bfast/BLibDefinitions.h"
+#include "../bfast/BError.h"
+
+#define Name "btime"
+
+/* Runs a command and writes its wall time in seconds and its peak resident
+ * memory in kilobytes.  The time is taken directly around the fork and the
+ * wait, and the peak memory is the maximum resident set size that the
+ * kernel reports for the command when it exits, so that short commands are
+ * measured as well as long ones.  Used by tests/bench.sh.
+ * */
+
+int PrintUsage()
+{
+	fprintf(stderr, "%s %s\n", "bfast", PACKAGE_VERSION);
+	fprintf(stderr, "\nUsage:%s [options] <command> [arguments]\n", Name);
+	fprintf(stderr, "\t-o\tFILE\tSpecifies the file to write the seconds and peak kilobytes to (Default stdout)\n");
+	fprintf(stderr, "\t-h\t\tprints this help message\n");
+	fprintf(stderr, "\nsend bugs to %s\n",
+			PACKAGE_BUGREPORT);
+	return 1;
+}
+
+double GetSeconds()
+{
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1000000000.0;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec/1000000.0;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	char *outputFileName=NULL;
+	FILE *fp=stdout;
+	struct rusage usage;
+	double start, end;
+	pid_t pid;
+	int c, status;
+
+	/* Stop at the command, so that its own options are not parsed */
+	while((c = getopt(argc, argv, "+o:h")) >= 0) {
+		switch(c) {
+			case 'h': return PrintUsage();
+			case 'o': outputFileName=strdup(optarg); break;
+			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
+		}
+	}
+
+	if(argc == optind) {
+		return PrintUsage();
+	}
+
+	start = GetSeconds();
+	pid = fork();
+	if(pid < 0) {
+		PrintError(Name, "pid", "Could not fork", Exit, OutOfRange);
+	}
+	else if(0 == pid) {
+		execvp(argv[optind], argv + optind);
+		PrintError(Name, argv[optind], "Could not run the command", Exit, OutOfRange);
+	}
+	if(wait4(pid, &status, 0, &usage) != pid) {
+		PrintError(Name, "pid", "Could not wait for the command", Exit, OutOfRange);
+	}
+	end = GetSeconds();
+
+	if(NULL != outputFileName) {
+		if(!(fp = fopen(outputFileName, "w"))) {
+			PrintError(Name, outputFileName, "Could not open file for writing", Exit, OpenFileError);
+		}
+	}
+	/* ru_maxrss is in kilobytes on Linux */
+	fprintf(fp, "%.3lf %ld\n", end - start, (long int)usage.ru_maxrss);
+	if(NULL != outputFileName) {
+		fclose(fp);
+		free(outputFileName);
+	}
+
+	if(WIFEXITED(status)) {
+		return WEXITSTATUS(status);
+	}
+	return 1;
+}
@@ -0,0 +1,131 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+# Benchmarks each stage of bfast on a synthetic reference genome and
+# synthetic reads.  The reference and reads only depend on the settings
+# below, so that reports from different versions can be compared.  Any
+# setting can be given in the environment, for example:
+#   BENCH_NUM_READS=1000000 BENCH_THREADS="1 8" make bench
+BENCH_VERSION=${BENCH_VERSION:-"unknown"};
+BENCH_SEED=${BENCH_SEED:-"1"};
+BENCH_GENOME_LENGTH=${BENCH_GENOME_LENGTH:-"1000000"};
+BENCH_NUM_READS=${BENCH_NUM_READS:-"100000"};
+BENCH_READ_LENGTH=${BENCH_READ_LENGTH:-"50"};
+BENCH_PAIRED_END_LENGTH=${BENCH_PAIRED_END_LENGTH:-"500"};
+BENCH_NUM_SNPS=${BENCH_NUM_SNPS:-"1"};
+BENCH_NUM_ERRORS=${BENCH_NUM_ERRORS:-"2"};
+BENCH_SPACES=${BENCH_SPACES:-"0 1"};
+BENCH_ENDS=${BENCH_ENDS:-"1 2"};
+BENCH_THREADS=${BENCH_THREADS:-"1 2 4"};
+BENCH_MASK=${BENCH_MASK:-"1111111111111111111111"};
+BENCH_WIDTH=${BENCH_WIDTH:-"12"};
+BENCH_DIR=${BENCH_DIR:-"bench/"};
+BENCH_REPORT=${BENCH_REPORT:-"${BENCH_DIR}bench.report.txt"};
+BUTIL_PREFIX="../butil/";
+BENCH_TMP_DIR=$BENCH_DIR"tmp/";
+BENCH_TIME=$BENCH_DIR"bench.time";
+
+# Runs one stage, appending its time and peak memory to the report.  Both
+# are measured by btime, the peak memory being the maximum resident set
+# size of the stage when it exits.
+run_stage()
+{
+	STAGE=$1;
+	SPACE=$2;
+	ENDS=$3;
+	THREADS=$4;
+	NUM=$5;
+	CMD=$6;
+
+	${BUTIL_PREFIX}btime -o $BENCH_TIME sh -c "exec $CMD" 2> /dev/null;
+	RETURN_CODE=$?;
+
+	if [ "$RETURN_CODE" -ne "0" ]; then
+		# Run again without piping anything
+		echo "RETURN CODE=$RETURN_CODE";
+		echo $CMD;
+		sh -c "$CMD";
+		exit 1;
+	fi
+
+	echo "$BENCH_VERSION $STAGE $SPACE $ENDS $THREADS $NUM `cat $BENCH_TIME`" | \
+		awk '{ printf "%s\t%s\t%s\t%s\t%s\t%s\t%.3f\t%.1f\t%s\n", $1, $2, $3, $4, $5, $6, $7, (0 < $7) ? $6 / $7 : 0, $8 }' | \
+		tee -a $BENCH_REPORT;
+}
+
+echo "      Benchmarking.";
+
+mkdir -p $BENCH_DIR $BENCH_TMP_DIR;
+
+# Report header
+echo "# bfast benchmark" > $BENCH_REPORT;
+echo "# seed=$BENCH_SEED genome_length=$BENCH_GENOME_LENGTH num_reads=$BENCH_NUM_READS read_length=$BENCH_READ_LENGTH paired_end_length=$BENCH_PAIRED_END_LENGTH mask=$BENCH_MASK width=$BENCH_WIDTH" >> $BENCH_REPORT;
+echo "# items are bases for fasta2brg and index, and reads otherwise" >> $BENCH_REPORT;
+echo "# version	stage	space	ends	threads	items	seconds	items_per_second	peak_rss_kb" | tee -a $BENCH_REPORT;
+
+# Generate the reference genome
+RG_FASTA=$BENCH_DIR"bench.fa";
+CMD=$BUTIL_PREFIX"bgeneratereads -g $BENCH_GENOME_LENGTH -s $BENCH_SEED > $RG_FASTA";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	exit 1;
+fi
+
+# Always need the nucleotide space reference to generate reads
+run_stage fasta2brg 0 NA 1 $BENCH_GENOME_LENGTH $CMD_PREFIX"bfast fasta2brg -f $RG_FASTA -A 0";
+
+for SPACE in $BENCH_SPACES
+do
+	echo "        Testing -A "$SPACE;
+
+	if [ "$SPACE" -ne "0" ]; then
+		run_stage fasta2brg $SPACE NA 1 $BENCH_GENOME_LENGTH $CMD_PREFIX"bfast fasta2brg -f $RG_FASTA -A $SPACE";
+	fi
+
+	# Build the index with each number of threads, keeping the last one.  The
+	# number of threads used to build an index must be a power of two.
+	for THREADS in $BENCH_THREADS
+	do
+		INDEX_THREADS="1";
+		while [ `expr $INDEX_THREADS \* 2` -le "$THREADS" ]; do
+			INDEX_THREADS=`expr $INDEX_THREADS \* 2`;
+		done
+		rm -f $RG_FASTA.*.bif;
+		run_stage index $SPACE NA $INDEX_THREADS $BENCH_GENOME_LENGTH $CMD_PREFIX"bfast index -f $RG_FASTA -A $SPACE -m $BENCH_MASK -w $BENCH_WIDTH -i 1 -n $INDEX_THREADS -T $BENCH_TMP_DIR";
+	done
+
+	for ENDS in $BENCH_ENDS
+	do
+		# Generate the reads, with color errors only in color space
+		PAIRED_END=`expr $ENDS - 1`;
+		NUM_ERRORS=`expr $SPACE \\* $BENCH_NUM_ERRORS`;
+		SPEC=$BENCH_DIR"reads.$SPACE.$ENDS.txt";
+		READS=$BENCH_DIR"reads.$SPACE.$ENDS.fastq";
+		echo "0 0 0 $BENCH_NUM_SNPS $NUM_ERRORS $BENCH_READ_LENGTH $PAIRED_END $BENCH_PAIRED_END_LENGTH $BENCH_NUM_READS" > $SPEC;
+		CMD=$BUTIL_PREFIX"bgeneratereads -f $RG_FASTA -i $SPEC -A $SPACE -s $BENCH_SEED > $READS";
+		eval $CMD 2> /dev/null;
+		if [ "$?" -ne "0" ]; then
+			echo $CMD;
+			exit 1;
+		fi
+
+		for THREADS in $BENCH_THREADS
+		do
+			MATCHES=$BENCH_DIR"bfast.matches.file.$SPACE.$ENDS.$THREADS.bmf";
+			ALIGN=$BENCH_DIR"bfast.aligned.file.$SPACE.$ENDS.$THREADS.baf";
+			SAM=$BENCH_DIR"bfast.reported.file.$SPACE.$ENDS.$THREADS.sam";
+			run_stage match $SPACE $ENDS $THREADS $BENCH_NUM_READS $CMD_PREFIX"bfast match -f $RG_FASTA -r $READS -A $SPACE -n $THREADS -T $BENCH_TMP_DIR > $MATCHES";
+			run_stage localalign $SPACE $ENDS $THREADS $BENCH_NUM_READS $CMD_PREFIX"bfast localalign -f $RG_FASTA -m $MATCHES -A $SPACE -n $THREADS > $ALIGN";
+			run_stage postprocess $SPACE $ENDS $THREADS $BENCH_NUM_READS $CMD_PREFIX"bfast postprocess -f $RG_FASTA -i $ALIGN -a 3 -n $THREADS > $SAM";
+			rm -f $MATCHES $ALIGN $SAM;
+		done
+	done
+done
+
+# Keep only the report
+rm -rf $BENCH_TMP_DIR $BENCH_TIME $RG_FASTA* $BENCH_DIR"reads."*;
+
+echo "      Benchmark report written to $BENCH_REPORT.";
+exit 0
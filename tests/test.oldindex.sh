@@ -0,0 +1,50 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Reading an index built by an earlier version.";
+
+OLD_DIR=$OUTPUT_DIR"oldindex/";
+OUTPUT_ID=$OUTPUT_ID_NT;
+mkdir $OLD_DIR
+
+# The index in old.index.bif.bz2 was built by an earlier release with
+# -A 0 -m 111101111011101111 -w 8 -d 0.  Build the same index with this
+# version next to it and check that both find the same matches.
+cp $OUTPUT_DIR$OUTPUT_ID".fa" $OUTPUT_DIR$OUTPUT_ID".fa.nt.brg" $OLD_DIR.
+bunzip2 -c $OUTPUT_DIR"old.index.bif.bz2" > $OLD_DIR$OUTPUT_ID".fa.nt.1.1.bif";
+if [ "$?" -ne "0" ]; then
+	exit 1
+fi
+
+RG_FASTA=$OLD_DIR$OUTPUT_ID".fa";
+READS=$OUTPUT_DIR"reads.$OUTPUT_ID.fastq";
+
+CMD=$CMD_PREFIX"bfast index -f $RG_FASTA -A 0 -m 111101111011101111 -w 8 -d 0 -i 2 -n $NUM_THREADS -T $TMP_DIR";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	eval $CMD;
+	exit 1
+fi
+
+for INDEX in 1 2
+do
+	CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -r $READS -A 0 -i $INDEX -n $NUM_THREADS -T $TMP_DIR > ${OLD_DIR}bfast.matches.file.$INDEX.bmf";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+cmp -s ${OLD_DIR}bfast.matches.file.1.bmf ${OLD_DIR}bfast.matches.file.2.bmf;
+if [ "$?" -ne "0" ]; then
+	echo "Matches from the old index differ.";
+	exit 1
+fi
+
+# Test passed!
+echo "      Old index read.";
+exit 0